@@ -0,0 +1,608 @@
+﻿// Headless batch runner: simulates a map for N hours without a window and
+// writes aggregate metrics. Shares all simulation code with the GUI build.
+#include "Graph.h"
+#include "MapGenerator.h"
+#include "HeadlessSimulation.h"
+#include "ScenarioSweep.h"
+#include "DemandModel.h"
+#include "TrafficAssignment.h"
+#include "PredictionBacktest.h"
+#include "EngineRun.h"
+#include "SelfTest.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+        << "  --map <file>              Load a .map file instead of generating a city\n"
+        << "  --layout <name>           grid | complex | random | highway | coastal (default: complex)\n"
+        << "  --size <n>                Grid size / node count for grid and random layouts\n"
+        << "  --hours <h>               Simulated hours (default: 1)\n"
+        << "  --tick-rate <hz>          Simulation ticks per simulated second (default: 60)\n"
+        << "  --cars <n>                Cars spawned at the start (default: 50)\n"
+        << "  --no-auto-spawn           Disable the built-in traffic generator\n"
+        << "  --accidents-per-hour <r>  Random accident rate (default: 2)\n"
+        << "  --demand <file>           Origin-destination demand matrix driving the traffic generator\n"
+        << "  --start-hour <h>          Time of day the simulation starts at (default: 8)\n"
+        << "  --start-day <d>           Day of the week the simulation starts on, 0 = Monday (default: 0)\n"
+        << "  --no-signals              Let cars cross intersections without traffic lights\n"
+        << "  --signal-plan <name>      fixed | actuated (default: fixed)\n"
+        << "  --trip-output <file>      Record every completed trip to a binary trip file\n"
+        << "  --trajectory-interval <s> Also record car positions every s simulated seconds\n"
+        << "  --trajectory-stride <n>   Only record the positions of every n-th car\n"
+        << "  --export-trips <file>     Convert a trip file to CSV (to --output or stdout) and exit\n"
+        << "  --export-trajectories <file> Convert the positions in a trip file to CSV and exit\n"
+        << "  --speed-output <file>     Record every road's measured speed once per prediction round\n"
+        << "  --profile <file>          Start from a time-of-week speed profile\n"
+        << "  --profile-output <file>   Save the time-of-week speed profile at the end of the run\n"
+        << "  --build-profile <file>    Learn a profile from a speed file (onto --profile) to --profile-output and exit\n"
+        << "  --speed-feed <source>     Feed \"time,edge,speed\" observations to prediction from a file, pipe,\n"
+        << "                            - (stdin) or unix:<socket>\n"
+        << "  --backtest <file>         Score every predictor on a speed file (to --output or stdout) and exit\n"
+        << "  --seed <n>                Master random seed (default: 1)\n"
+        << "  --replicas <n>            Run n independent replicas in parallel (default: 1)\n"
+        << "  --threads <n>             Worker threads for replicas (default: all cores)\n"
+        << "  --processes <n>           Split the map into n regions simulated by n processes (Linux)\n"
+        << "  --time-warp               Skip ahead over ticks in which no event can happen\n"
+        << "  --output <file>           Write metrics (or the sweep summary) as CSV to this file\n"
+        << "  --replica-output <file>   Write one CSV row per replica to this file\n"
+        << "  --save-checkpoint <file>  Save the full simulation state at the end of the run\n"
+        << "  --load-checkpoint <file>  Continue from a saved state (same map and tick rate)\n"
+        << "  --accident <edge>         Start the run with an accident on this road (repeatable)\n"
+        << "  --close <edge>            Close this road for the whole run (repeatable)\n"
+        << "  --assign                  Solve the user-equilibrium assignment of --demand instead of simulating\n"
+        << "  --assign-method <name>    fw (Frank-Wolfe) | msa (default: fw)\n"
+        << "  --max-iterations <n>      Assignment iteration limit (default: 100)\n"
+        << "  --target-gap <g>          Assignment relative gap to stop at (default: 1e-4)\n"
+        << "  --engine <name>           agent | meso | micro (default: agent); meso and micro only move\n"
+        << "                            the --demand trips\n"
+        << "  --self-test               Run the built-in round-trip checks and exit (status 1 on failure)\n"
+        << "  --verbose                 Keep the per-event console output (single replica only)\n";
+}
+
+bool buildMap(Graph& cityMap, const std::string& mapFile, const std::string& layout, int size) {
+    if (!mapFile.empty()) {
+        cityMap.loadFromFile(mapFile);
+        return cityMap.getNodeCount() > 0;
+    }
+
+    if (layout == "grid") {
+        MapGenerator::generateSimpleGrid(cityMap, size > 0 ? size : 8);
+    }
+    else if (layout == "complex") {
+        MapGenerator::generateComplexCity(cityMap);
+    }
+    else if (layout == "random") {
+        MapGenerator::generateRandomCity(cityMap, size > 0 ? size : 30);
+    }
+    else if (layout == "highway") {
+        MapGenerator::generateHighwayNetwork(cityMap);
+    }
+    else if (layout == "coastal") {
+        MapGenerator::generateCoastalStyleCity(cityMap);
+    }
+    else {
+        std::cerr << "Unknown layout: " << layout << std::endl;
+        return false;
+    }
+    return cityMap.getNodeCount() > 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    HeadlessOptions options;
+    std::string mapFile;
+    std::string layout = "complex";
+    std::string outputFile;
+    std::string replicaOutputFile;
+    std::string saveCheckpointFile;
+    std::string loadCheckpointFile;
+    std::string demandFile;
+    std::string exportTripsFile;
+    std::string exportTrajectoriesFile;
+    std::string backtestFile;
+    std::string profileFile;
+    std::string profileOutputFile;
+    std::string profileSourceFile;
+    int size = 0;
+    int replicas = 1;
+    int threads = 0;
+    bool verbose = false;
+    bool selfTest = false;
+    bool assign = false;
+    AssignmentOptions assignmentOptions;
+    TrafficEngine engine = TrafficEngine::AGENT;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "--map") == 0 && hasValue) mapFile = argv[++i];
+        else if (std::strcmp(arg, "--layout") == 0 && hasValue) layout = argv[++i];
+        else if (std::strcmp(arg, "--size") == 0 && hasValue) size = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--hours") == 0 && hasValue) options.simulatedHours = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "--tick-rate") == 0 && hasValue) options.tickRate = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(arg, "--cars") == 0 && hasValue) options.initialCars = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--no-auto-spawn") == 0) options.autoSpawn = false;
+        else if (std::strcmp(arg, "--accidents-per-hour") == 0 && hasValue) options.accidentsPerHour = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(arg, "--demand") == 0 && hasValue) demandFile = argv[++i];
+        else if (std::strcmp(arg, "--start-hour") == 0 && hasValue) options.startHour = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(arg, "--start-day") == 0 && hasValue) options.startDay = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--no-signals") == 0) options.signals = false;
+        else if (std::strcmp(arg, "--signal-plan") == 0 && hasValue) {
+            const char* plan = argv[++i];
+            if (std::strcmp(plan, "fixed") == 0) options.signalPlan = SignalPlan::FIXED_TIME;
+            else if (std::strcmp(plan, "actuated") == 0) options.signalPlan = SignalPlan::ACTUATED;
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--trip-output") == 0 && hasValue) options.tripFile = argv[++i];
+        else if (std::strcmp(arg, "--trajectory-interval") == 0 && hasValue) options.tripRecording.trajectoryInterval = static_cast<float>(std::atof(argv[++i]));
+        else if (std::strcmp(arg, "--trajectory-stride") == 0 && hasValue) options.tripRecording.trajectoryCarStride = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--export-trips") == 0 && hasValue) exportTripsFile = argv[++i];
+        else if (std::strcmp(arg, "--export-trajectories") == 0 && hasValue) exportTrajectoriesFile = argv[++i];
+        else if (std::strcmp(arg, "--speed-output") == 0 && hasValue) options.speedFile = argv[++i];
+        else if (std::strcmp(arg, "--profile") == 0 && hasValue) profileFile = argv[++i];
+        else if (std::strcmp(arg, "--profile-output") == 0 && hasValue) profileOutputFile = argv[++i];
+        else if (std::strcmp(arg, "--build-profile") == 0 && hasValue) profileSourceFile = argv[++i];
+        else if (std::strcmp(arg, "--speed-feed") == 0 && hasValue) options.speedFeed = argv[++i];
+        else if (std::strcmp(arg, "--backtest") == 0 && hasValue) backtestFile = argv[++i];
+        else if (std::strcmp(arg, "--seed") == 0 && hasValue) options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(arg, "--replicas") == 0 && hasValue) replicas = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--threads") == 0 && hasValue) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--processes") == 0 && hasValue) options.processes = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--time-warp") == 0) options.timeWarp = true;
+        else if (std::strcmp(arg, "--output") == 0 && hasValue) outputFile = argv[++i];
+        else if (std::strcmp(arg, "--replica-output") == 0 && hasValue) replicaOutputFile = argv[++i];
+        else if (std::strcmp(arg, "--save-checkpoint") == 0 && hasValue) saveCheckpointFile = argv[++i];
+        else if (std::strcmp(arg, "--load-checkpoint") == 0 && hasValue) loadCheckpointFile = argv[++i];
+        else if (std::strcmp(arg, "--accident") == 0 && hasValue) options.accidentEdges.push_back(std::atoi(argv[++i]));
+        else if (std::strcmp(arg, "--close") == 0 && hasValue) options.closedEdges.push_back(std::atoi(argv[++i]));
+        else if (std::strcmp(arg, "--assign") == 0) assign = true;
+        else if (std::strcmp(arg, "--assign-method") == 0 && hasValue) {
+            const char* method = argv[++i];
+            if (std::strcmp(method, "fw") == 0) assignmentOptions.method = AssignmentOptions::Method::FRANK_WOLFE;
+            else if (std::strcmp(method, "msa") == 0) assignmentOptions.method = AssignmentOptions::Method::MSA;
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--max-iterations") == 0 && hasValue) assignmentOptions.maxIterations = std::atoi(argv[++i]);
+        else if (std::strcmp(arg, "--target-gap") == 0 && hasValue) assignmentOptions.targetGap = std::atof(argv[++i]);
+        else if (std::strcmp(arg, "--engine") == 0 && hasValue) {
+            const char* name = argv[++i];
+            if (std::strcmp(name, "agent") == 0) engine = TrafficEngine::AGENT;
+            else if (std::strcmp(name, "meso") == 0) engine = TrafficEngine::MESOSCOPIC;
+            else if (std::strcmp(name, "micro") == 0) engine = TrafficEngine::MICROSCOPIC;
+            else {
+                std::cerr << "Unknown engine: " << name << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--self-test") == 0) selfTest = true;
+        else if (std::strcmp(arg, "--verbose") == 0) verbose = true;
+        else if (std::strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.simulatedHours <= 0.0 || options.tickRate <= 0.0f || replicas < 1 || options.processes < 1) {
+        std::cerr << "Hours, tick rate, replicas and processes must be positive" << std::endl;
+        return 1;
+    }
+
+    if (replicas > 1 && !saveCheckpointFile.empty()) {
+        std::cerr << "--save-checkpoint needs a single replica" << std::endl;
+        return 1;
+    }
+    if (replicas > 1 && !options.tripFile.empty()) {
+        std::cerr << "--trip-output needs a single replica" << std::endl;
+        return 1;
+    }
+    if (replicas > 1 && !options.speedFile.empty()) {
+        std::cerr << "--speed-output needs a single replica" << std::endl;
+        return 1;
+    }
+    if (replicas > 1 && !options.speedFeed.empty()) {
+        std::cerr << "--speed-feed needs a single replica" << std::endl;
+        return 1;
+    }
+    if (replicas > 1 && !profileOutputFile.empty()) {
+        std::cerr << "--profile-output needs a single replica" << std::endl;
+        return 1;
+    }
+    if (options.startDay < 0 || options.startDay >= SpeedProfile::DAYS) {
+        std::cerr << "--start-day must be 0 (Monday) to 6 (Sunday)" << std::endl;
+        return 1;
+    }
+
+    if (options.processes > 1) {
+        // Accidents and their reroutes would have to reach every region mid-tick
+        const char* conflict = replicas > 1 ? "--replicas" :
+            !saveCheckpointFile.empty() ? "--save-checkpoint" :
+            !loadCheckpointFile.empty() ? "--load-checkpoint" :
+            !options.tripFile.empty() ? "--trip-output" :
+            options.timeWarp ? "--time-warp" :
+            !options.accidentEdges.empty() ? "--accident" :
+            options.accidentsPerHour > 0.0f ? "random accidents (use --accidents-per-hour 0)" : nullptr;
+        if (conflict) {
+            std::cerr << "--processes does not support " << conflict << std::endl;
+            return 1;
+        }
+    }
+
+    if (engine != TrafficEngine::AGENT) {
+        // The other engines have no prediction, accidents, recorders or checkpoints
+        const char* conflict = replicas > 1 ? "--replicas" :
+            options.processes > 1 ? "--processes" :
+            !saveCheckpointFile.empty() ? "--save-checkpoint" :
+            !loadCheckpointFile.empty() ? "--load-checkpoint" :
+            !options.tripFile.empty() ? "--trip-output" :
+            !options.speedFile.empty() ? "--speed-output" :
+            !options.speedFeed.empty() ? "--speed-feed" :
+            options.timeWarp ? "--time-warp" :
+            assign ? "--assign" : nullptr;
+        if (conflict) {
+            std::cerr << "--engine does not support " << conflict << std::endl;
+            return 1;
+        }
+    }
+
+    if (!exportTripsFile.empty() || !exportTrajectoriesFile.empty()) {
+        std::ofstream file;
+        if (!outputFile.empty()) {
+            file.open(outputFile);
+            if (!file.is_open()) {
+                std::cerr << "Error: Could not open file " << outputFile << std::endl;
+                return 1;
+            }
+        }
+        std::ostream& out = outputFile.empty() ? std::cout : file;
+        bool exported = exportTripsFile.empty() ?
+            TripRecorder::exportTrajectories(exportTrajectoriesFile, out) :
+            TripRecorder::exportTrips(exportTripsFile, out);
+        return exported ? 0 : 1;
+    }
+
+    // Speeds recorded by a run, or converted from outside logs, folded into
+    // the profile frame by frame as a live run would
+    if (!profileSourceFile.empty()) {
+        if (profileOutputFile.empty()) {
+            std::cerr << "--build-profile needs --profile-output" << std::endl;
+            return 1;
+        }
+        SpeedSeries series;
+        if (!SpeedRecorder::load(profileSourceFile, series)) {
+            return 1;
+        }
+
+        SpeedProfile profile(PredictionConfig::PROFILE_MAX_DAYS);
+        if (!profileFile.empty() && !profile.loadFromFile(profileFile)) {
+            return 1;
+        }
+        std::vector<int> edgeIds;
+        std::vector<float> limits, shares(static_cast<size_t>(series.getEdgeCount()));
+        for (int slot = 0; slot < series.getEdgeCount(); slot++) {
+            edgeIds.push_back(series.map.getEdgeAt(slot).id);
+            limits.push_back(static_cast<float>(series.map.getEdgeAt(slot).speedLimit));
+        }
+        profile.remap(edgeIds);
+
+        for (size_t frame = 0; frame < series.getFrameCount(); frame++) {
+            const float* speeds = series.frame(frame);
+            for (size_t row = 0; row < shares.size(); row++) {
+                shares[row] = std::min(speeds[row] / limits[row], 1.0f);
+            }
+            profile.observe(series.weekTimes[frame], shares.data());
+        }
+        profile.foldCurrentBin();
+        if (!profile.saveToFile(profileOutputFile)) {
+            return 1;
+        }
+        std::cout << "Profile: " << series.getEdgeCount() << " roads, " << series.getFrameCount()
+            << " rounds, " << profile.getFilledBins() << " filled bins saved to " << profileOutputFile << std::endl;
+        return 0;
+    }
+
+    if (!backtestFile.empty()) {
+        SpeedSeries series;
+        if (!SpeedRecorder::load(backtestFile, series)) {
+            return 1;
+        }
+
+        BacktestOptions backtestOptions;
+        backtestOptions.threads = threads;
+        PredictionBacktest backtest(series, backtestOptions);
+        BacktestResult result = backtest.run();
+
+        std::cout << "Backtest: " << result.edges << " roads, " << result.frames << " rounds of "
+            << series.roundSeconds << " s on " << result.threadsUsed << " threads in "
+            << result.wallSeconds << " s" << std::endl;
+        PredictionBacktest::writeScores(result, std::cout);
+
+        if (!outputFile.empty()) {
+            std::ofstream out(outputFile);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open file " << outputFile << std::endl;
+                return 1;
+            }
+            PredictionBacktest::writeScores(result, out);
+        }
+        return 0;
+    }
+
+    // The simulation systems report every event on std::cout, which would
+    // dominate the run time and bury the results. Without a buffer the stream
+    // is in a bad state and every insertion returns before formatting anything,
+    // which also keeps concurrent replicas from touching shared stream state.
+    std::streambuf* consoleBuffer = std::cout.rdbuf();
+    if (!verbose || replicas > 1) {
+        std::cout.rdbuf(nullptr);
+    }
+
+    if (selfTest) {
+        std::vector<SelfTestResult> results = SelfTest::runAll();
+        std::cout.rdbuf(consoleBuffer);
+        SelfTest::writeResults(results, std::cout);
+        return SelfTest::allPassed(results) ? 0 : 1;
+    }
+
+    Graph cityMap;
+    if (!buildMap(cityMap, mapFile, layout, size)) {
+        std::cout.rdbuf(consoleBuffer);
+        std::cerr << "Failed to build the map" << std::endl;
+        return 1;
+    }
+
+    if (!demandFile.empty()) {
+        auto demand = std::make_shared<DemandModel>(cityMap);
+        if (!demand->loadFromFile(demandFile, cityMap)) {
+            std::cout.rdbuf(consoleBuffer);
+            return 1;
+        }
+        options.demand = demand;
+    }
+
+    if (!profileFile.empty()) {
+        auto profile = std::make_shared<SpeedProfile>(PredictionConfig::PROFILE_MAX_DAYS);
+        if (!profile->loadFromFile(profileFile)) {
+            std::cout.rdbuf(consoleBuffer);
+            return 1;
+        }
+        options.profile = profile;
+    }
+
+    if (assign) {
+        std::cout.rdbuf(consoleBuffer);
+        if (!options.demand) {
+            std::cerr << "--assign needs a --demand matrix" << std::endl;
+            return 1;
+        }
+
+        auto setupStart = std::chrono::steady_clock::now();
+        TrafficAssignment assignment(cityMap);
+        assignment.setDemand(options.demand->getFlows(options.startHour * 3600.0));
+        double setupMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - setupStart).count();
+
+        assignmentOptions.threads = threads;
+        bool converged = assignment.solve(assignmentOptions);
+
+        std::cout << "Map: " << cityMap.getNodeCount() << " nodes, " << assignment.getLinkCount()
+            << " links, " << assignment.getOriginCount() << " origins, "
+            << assignment.getTotalDemand() << " veh/h (setup " << setupMilliseconds << " ms)" << std::endl;
+        TrafficAssignment::writeHistory(assignment.getHistory(), std::cout);
+
+        double solveMilliseconds = 0.0;
+        for (const auto& report : assignment.getHistory()) {
+            solveMilliseconds += report.milliseconds;
+        }
+        std::cout << (converged ? "Converged" : "Stopped at the iteration limit") << " in "
+            << solveMilliseconds << " ms" << std::endl;
+        if (assignment.getUnassignedDemand() > 0.0) {
+            std::cout << "Unassigned (no path): " << assignment.getUnassignedDemand() << " veh/h" << std::endl;
+        }
+
+        if (!outputFile.empty()) {
+            std::ofstream out(outputFile);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open file " << outputFile << std::endl;
+                return 1;
+            }
+            TrafficAssignment::writeLinkResults(assignment.getLinkResults(), out);
+        }
+        return 0;
+    }
+
+    if (engine != TrafficEngine::AGENT) {
+        std::cout.rdbuf(consoleBuffer);
+        if (!options.demand) {
+            std::cerr << "--engine needs a --demand matrix" << std::endl;
+            return 1;
+        }
+
+        EngineRun engineRun(cityMap, engine, options);
+        EngineMetrics engineMetrics = engineRun.run();
+
+        std::cout << "Map: " << cityMap.getNodeCount() << " nodes, "
+            << cityMap.getEdgeCount() << " roads" << std::endl;
+        EngineRun::writeMetrics(engineMetrics, std::cout);
+
+        if (!outputFile.empty()) {
+            std::ofstream out(outputFile);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open file " << outputFile << std::endl;
+                return 1;
+            }
+            EngineRun::writeMetrics(engineMetrics, out);
+        }
+        return 0;
+    }
+
+    if (replicas > 1) {
+        SweepOptions sweepOptions;
+        sweepOptions.replicas = replicas;
+        sweepOptions.threads = threads;
+        sweepOptions.scenario = options;
+        sweepOptions.checkpointFile = loadCheckpointFile;
+
+        // Fail once up front rather than once per replica
+        if (!loadCheckpointFile.empty()) {
+            Graph probeMap = cityMap;
+            HeadlessSimulation probe(probeMap, options);
+            if (!probe.loadCheckpoint(loadCheckpointFile)) {
+                std::cout.rdbuf(consoleBuffer);
+                return 1;
+            }
+        }
+
+        ScenarioSweep sweep(cityMap, sweepOptions);
+        SweepResult result = sweep.run();
+
+        std::cout.rdbuf(consoleBuffer);
+
+        std::cout << "Map: " << cityMap.getNodeCount() << " nodes, "
+            << cityMap.getEdgeCount() << " roads" << std::endl;
+        std::cout << "Sweep: " << replicas << " replicas on " << result.threadsUsed
+            << " threads in " << result.wallSeconds << " s" << std::endl;
+        ScenarioSweep::writeSummary(result, std::cout);
+
+        if (!outputFile.empty()) {
+            std::ofstream out(outputFile);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open file " << outputFile << std::endl;
+                return 1;
+            }
+            ScenarioSweep::writeSummary(result, out);
+        }
+
+        if (!replicaOutputFile.empty()) {
+            std::ofstream out(replicaOutputFile);
+            if (!out.is_open()) {
+                std::cerr << "Error: Could not open file " << replicaOutputFile << std::endl;
+                return 1;
+            }
+            ScenarioSweep::writeReplicas(result, out);
+        }
+        return 0;
+    }
+
+    HeadlessSimulation simulation(cityMap, options);
+    if ((!options.tripFile.empty() && !simulation.getTripRecorder()) ||
+        (!options.speedFile.empty() && !simulation.getSpeedRecorder()) ||
+        (!options.speedFeed.empty() && !simulation.getSpeedFeed())) {
+        std::cout.rdbuf(consoleBuffer);
+        return 1;
+    }
+
+    double loadMilliseconds = 0.0;
+    if (!loadCheckpointFile.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        bool loaded = simulation.loadCheckpoint(loadCheckpointFile);
+        loadMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - loadStart).count();
+        if (!loaded) {
+            std::cout.rdbuf(consoleBuffer);
+            return 1;
+        }
+    }
+
+    HeadlessMetrics metrics = simulation.run();
+
+    std::cout.rdbuf(consoleBuffer);
+
+    if (simulation.hasFailed()) {
+        std::cerr << "Multi-process run stopped early" << std::endl;
+        return 1;
+    }
+
+    if (!loadCheckpointFile.empty()) {
+        std::cout << "Loaded " << loadCheckpointFile << " in " << loadMilliseconds << " ms" << std::endl;
+    }
+    if (!saveCheckpointFile.empty()) {
+        if (!simulation.saveCheckpoint(saveCheckpointFile)) {
+            return 1;
+        }
+        std::cout << "Saved " << saveCheckpointFile << std::endl;
+    }
+
+    if (TripRecorder* recorder = simulation.getTripRecorder()) {
+        if (!recorder->close()) {
+            return 1;
+        }
+        std::cout << "Recorded " << recorder->getTripCount() << " trips";
+        if (recorder->getSampleCount() > 0) {
+            std::cout << " and " << recorder->getSampleCount() << " positions";
+        }
+        std::cout << " to " << recorder->getFilename() << " (" << recorder->getStallCount()
+            << " stalls)" << std::endl;
+    }
+
+    if (SpeedRecorder* recorder = simulation.getSpeedRecorder()) {
+        if (!recorder->close()) {
+            return 1;
+        }
+        std::cout << "Recorded " << recorder->getFrameCount() << " speed rounds to "
+            << recorder->getFilename() << std::endl;
+    }
+
+    if (SpeedFeed* feed = simulation.getSpeedFeed()) {
+        std::cout << "Fed " << feed->getObservationCount() << " speed observations from " << feed->getSource()
+            << " (" << feed->getUnknownCount() << " on unknown roads, " << feed->getMalformedCount()
+            << " malformed lines)" << std::endl;
+    }
+
+    if (!profileOutputFile.empty()) {
+        if (!simulation.saveProfile(profileOutputFile)) {
+            return 1;
+        }
+        std::cout << "Saved profile with " << simulation.getProfile().getFilledBins() << " filled bins to "
+            << profileOutputFile << std::endl;
+    }
+
+    CarSimulation::PoolStats pool = simulation.getPoolStats();
+    std::cout << "Vehicle pool: " << pool.fleetCapacity << " slots, " << pool.freeRoutes
+        << " free routes, " << pool.routeReuses << " reused; allocations: " << pool.fleetAllocations
+        << " fleet, " << pool.routeAllocations << " route, " << pool.plannerAllocations << " planner" << std::endl;
+    if (options.timeWarp) {
+        std::cout << "Time warp: " << metrics.warpedTicks << " of " << metrics.ticks << " ticks skipped ahead" << std::endl;
+    }
+
+    std::cout << "Map: " << cityMap.getNodeCount() << " nodes, "
+        << cityMap.getEdgeCount() << " roads" << std::endl;
+    if (options.processes > 1) {
+        const auto& partition = simulation.getPartition();
+        auto [fewest, most] = std::minmax_element(partition.roadsPerRegion.begin(), partition.roadsPerRegion.end());
+        std::cout << "Partition: " << partition.regions << " regions of " << *fewest << "-" << *most
+            << " roads, " << partition.cutRoads << " roads between regions" << std::endl;
+    }
+    HeadlessSimulation::writeMetrics(metrics, std::cout);
+
+    if (!outputFile.empty()) {
+        std::ofstream out(outputFile);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not open file " << outputFile << std::endl;
+            return 1;
+        }
+        HeadlessSimulation::writeMetrics(metrics, out);
+    }
+
+    return 0;
+}
@@ -1,24 +1,32 @@
 #include "AccidentSystem.h"
 #include "Graph.h"
+#include "Checkpoint.h"
 #include <iostream>
 #include <algorithm>
+#include <limits>
 
-AccidentSystem::AccidentSystem(Graph* graph) : graphRef(graph) {}
+AccidentSystem::AccidentSystem(Graph* graph, std::uint64_t seed)
+    : graphRef(graph), randomGen(seed), incidentsRaised(0), accidentsDetected(0),
+    detectionSecondsSum(0.0f) {}
 
 void AccidentSystem::createAccident(int edgeId, float duration) {
-    for (auto& accident : activeAccidents) {
-        if (accident.edgeId == edgeId && accident.isActive) {
-            std::cout << "Accident already active on edge " << edgeId << std::endl;
-            return;
-        }
+    if (hasAccidentOnEdge(edgeId)) {
+        std::cout << "Accident already active on edge " << edgeId << std::endl;
+        return;
     }
 
+    // A detected incident on the edge becomes this accident
+    activeAccidents.erase(std::remove_if(activeAccidents.begin(), activeAccidents.end(),
+        [edgeId](const Accident& accident) { return accident.edgeId == edgeId && accident.isIncident; }),
+        activeAccidents.end());
+
     Accident newAccident;
     newAccident.edgeId = edgeId;
     newAccident.duration = duration;
     newAccident.elapsed = 0.0f;
     newAccident.isActive = true;
-    newAccident.clock.restart();
+    newAccident.isIncident = false;
+    newAccident.detected = false;
 
     activeAccidents.push_back(newAccident);
 
@@ -30,6 +38,38 @@ void AccidentSystem::createAccident(int edgeId, float duration) {
         << " for " << duration << " seconds" << std::endl;
 }
 
+bool AccidentSystem::raiseIncident(int edgeId, float duration) {
+    for (auto& accident : activeAccidents) {
+        if (accident.edgeId != edgeId || !accident.isActive) continue;
+
+        if (accident.isIncident) {
+            accident.duration = accident.elapsed + duration;
+        }
+        else if (!accident.detected) {
+            accident.detected = true;
+            accidentsDetected++;
+            detectionSecondsSum += accident.elapsed;
+            std::cout << "Accident on edge " << edgeId << " detected after "
+                << accident.elapsed << " seconds" << std::endl;
+        }
+        return false;
+    }
+
+    Accident incident;
+    incident.edgeId = edgeId;
+    incident.duration = duration;
+    incident.elapsed = 0.0f;
+    incident.isActive = true;
+    incident.isIncident = true;
+    incident.detected = true;
+
+    activeAccidents.push_back(incident);
+    incidentsRaised++;
+
+    std::cout << "Incident detected on edge " << edgeId << std::endl;
+    return true;
+}
+
 void AccidentSystem::clearAccident(int edgeId) {
     for (auto it = activeAccidents.begin(); it != activeAccidents.end(); ) {
         if (it->edgeId == edgeId) {
@@ -53,7 +93,9 @@ void AccidentSystem::update(float deltaTime) {
             it->elapsed += deltaTime;
 
             if (it->elapsed >= it->duration) {
-                std::cout << "Accident on edge " << it->edgeId << " has been cleared (time expired)" << std::endl;
+                if (!it->isIncident) {
+                    std::cout << "Accident on edge " << it->edgeId << " has been cleared (time expired)" << std::endl;
+                }
                 it = activeAccidents.erase(it);
                 continue;
             }
@@ -64,7 +106,7 @@ void AccidentSystem::update(float deltaTime) {
 
 bool AccidentSystem::hasAccidentOnEdge(int edgeId) const {
     for (const auto& accident : activeAccidents) {
-        if (accident.edgeId == edgeId && accident.isActive) {
+        if (accident.edgeId == edgeId && accident.isActive && !accident.isIncident) {
             return true;
         }
     }
@@ -74,7 +116,7 @@ bool AccidentSystem::hasAccidentOnEdge(int edgeId) const {
 std::vector<int> AccidentSystem::getAccidentEdges() const {
     std::vector<int> result;
     for (const auto& accident : activeAccidents) {
-        if (accident.isActive) {
+        if (accident.isActive && !accident.isIncident) {
             result.push_back(accident.edgeId);
         }
     }
@@ -84,32 +126,47 @@ std::vector<int> AccidentSystem::getAccidentEdges() const {
 int AccidentSystem::getActiveAccidentCount() const {
     int count = 0;
     for (const auto& accident : activeAccidents) {
-        if (accident.isActive) count++;
+        if (accident.isActive && !accident.isIncident) count++;
     }
     return count;
 }
 
-sf::Color AccidentSystem::getEdgeColorWithAccident(int edgeId, sf::Color originalColor) const {
-    if (!hasAccidentOnEdge(edgeId)) {
-        return originalColor;
+// Incidents block nothing, so their clearance changes no route
+float AccidentSystem::getSecondsToNextClearance() const {
+    float seconds = std::numeric_limits<float>::infinity();
+    for (const auto& accident : activeAccidents) {
+        if (accident.isActive && !accident.isIncident) {
+            seconds = std::min(seconds, accident.duration - accident.elapsed);
+        }
     }
+    return seconds;
+}
 
-    float time = 0.0f;
+bool AccidentSystem::hasIncidentOnEdge(int edgeId) const {
     for (const auto& accident : activeAccidents) {
-        if (accident.edgeId == edgeId) {
-            time = accident.clock.getElapsedTime().asSeconds();
-            break;
+        if (accident.edgeId == edgeId && accident.isActive && accident.isIncident) {
+            return true;
         }
     }
+    return false;
+}
 
-    bool isVisible = static_cast<int>(time * 2.0f) % 2 == 0;
-
-    if (isVisible) {
-        return sf::Color(255, 50, 50); // Bright red
+std::vector<int> AccidentSystem::getIncidentEdges() const {
+    std::vector<int> result;
+    for (const auto& accident : activeAccidents) {
+        if (accident.isActive && accident.isIncident) {
+            result.push_back(accident.edgeId);
+        }
     }
-    else {
-        return sf::Color(150, 0, 0);   // Dark red
+    return result;
+}
+
+int AccidentSystem::getIncidentCount() const {
+    int count = 0;
+    for (const auto& accident : activeAccidents) {
+        if (accident.isActive && accident.isIncident) count++;
     }
+    return count;
 }
 
 bool AccidentSystem::shouldBlink(int edgeId) const {
@@ -117,8 +174,8 @@ bool AccidentSystem::shouldBlink(int edgeId) const {
 
     float time = 0.0f;
     for (const auto& accident : activeAccidents) {
-        if (accident.edgeId == edgeId) {
-            time = accident.clock.getElapsedTime().asSeconds();
+        if (accident.edgeId == edgeId && !accident.isIncident) {
+            time = accident.elapsed;
             break;
         }
     }
@@ -150,10 +207,40 @@ void AccidentSystem::createRandomAccident() {
         return;
     }
 
-    int randomIndex = rand() % edgeIds.size();
+    int randomIndex = randomGen.nextInt(static_cast<std::uint32_t>(edgeIds.size()));
     int selectedEdgeId = edgeIds[randomIndex];
 
-    float duration = 60.0f + (rand() % 300);
+    float duration = 60.0f + randomGen.nextInt(300);
 
     createAccident(selectedEdgeId, duration);
-}
\ No newline at end of file
+}
+
+void AccidentSystem::saveState(BinaryWriter& writer) const {
+    writer.writeTag("ACCI");
+    writer.write(randomGen.getKey());
+    writer.write(randomGen.getCounter());
+    writer.writeArray(activeAccidents);
+    writer.write(incidentsRaised);
+    writer.write(accidentsDetected);
+    writer.write(detectionSecondsSum);
+}
+
+bool AccidentSystem::loadState(BinaryReader& reader) {
+    std::uint64_t rngKey, rngCounter;
+    std::vector<Accident> accidents;
+    int savedRaised, savedDetected;
+    float savedDetectionSeconds;
+
+    if (!reader.expectTag("ACCI") || !reader.read(rngKey) || !reader.read(rngCounter) ||
+        !reader.readArray(accidents) || !reader.read(savedRaised) || !reader.read(savedDetected) ||
+        !reader.read(savedDetectionSeconds)) {
+        return false;
+    }
+
+    activeAccidents = std::move(accidents);
+    incidentsRaised = savedRaised;
+    accidentsDetected = savedDetected;
+    detectionSecondsSum = savedDetectionSeconds;
+    randomGen.setState(rngKey, rngCounter);
+    return true;
+}
@@ -3,41 +3,71 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
-#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include "Random.h"
 
 class Graph; // Forward declaration
+class BinaryWriter;
+class BinaryReader;
 
 struct Accident {
     int edgeId;
     float duration;      // Total duration in seconds
     float elapsed;       // Time elapsed in seconds
     bool isActive;
-    sf::Clock clock;     // For visual effects
+    bool isIncident;     // Raised by the incident detector; the edge stays open
+    bool detected;       // An accident the incident detector has flagged
 };
 
 class AccidentSystem {
 private:
     std::vector<Accident> activeAccidents;
     Graph* graphRef;
+    CounterRng randomGen;
+
+    // Incident detection so far
+    int incidentsRaised;
+    int accidentsDetected;
+    float detectionSecondsSum;           // From each detected accident's start to its detection
 
 public:
-    AccidentSystem(Graph* graph);
+    AccidentSystem(Graph* graph, std::uint64_t seed = CounterRng::randomSeed());
 
     // Core functionality
     void createAccident(int edgeId, float duration = 300.0f); // 5 minutes default
+    // A candidate incident from a speed drop. It does not block the edge and
+    // gives way to an accident created on it. A raise on an edge that already
+    // has an incident renews it; on one with an accident it marks the
+    // accident detected. Returns true for a new incident.
+    bool raiseIncident(int edgeId, float duration);
     void clearAccident(int edgeId);
     void clearAllAccidents();
     void update(float deltaTime);
 
-    // Query methods
+    // Query methods; accidents exclude detected incidents
     bool hasAccidentOnEdge(int edgeId) const;
     std::vector<int> getAccidentEdges() const;
     int getActiveAccidentCount() const;
+    float getSecondsToNextClearance() const;     // Infinity without accidents
+    bool hasIncidentOnEdge(int edgeId) const;
+    std::vector<int> getIncidentEdges() const;
+    int getIncidentCount() const;
+
+    int getIncidentsRaised() const { return incidentsRaised; }
+    int getAccidentsDetected() const { return accidentsDetected; }
+    // Mean seconds from an accident's start to its detection, 0 before any
+    float getMeanDetectionSeconds() const {
+        return accidentsDetected > 0 ? detectionSecondsSum / accidentsDetected : 0.0f;
+    }
 
     // Visual effects
-    sf::Color getEdgeColorWithAccident(int edgeId, sf::Color originalColor) const;
-    bool shouldBlink(int edgeId) const; // For blinking effect
+    bool shouldBlink(int edgeId) const; // For blinking effect, follows simulation time
 
     // Random accident creation
     void createRandomAccident();
+
+    // Checkpointing
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+    void reseed(std::uint64_t seed) { randomGen = CounterRng(seed); }
 };
\ No newline at end of file
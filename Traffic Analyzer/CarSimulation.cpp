@@ -1,9 +1,13 @@
 ﻿#include "CarSimulation.h"
 #include "PredictionSystem.h"
+#include "SignalSystem.h"
+#include "TripRecorder.h"
+#include "Checkpoint.h"
+#include "Config.h"
 #include <iostream>
 #include <algorithm>
-#include <queue>
 #include <cmath>
+#include <bit>
 #include <unordered_map>
 
 #ifndef M_PI
@@ -11,20 +15,23 @@
 #endif
 
 // Car constructor
-CarSimulation::Car::Car(int id, int start, int dest)
+CarSimulation::Car::Car(int id, int start, int dest, std::uint32_t color)
     : id(id), currentPosition(start), destination(dest),
-    progress(0.0f), active(true) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(50, 255);
-    color = sf::Color(dist(gen), dist(gen), dist(gen));
+    progress(0.0f), previousPosition(start), previousProgress(0.0f), active(true),
+    queueSlot(-1), departureTime(0.0), color(color) {
 }
 
-CarSimulation::CarSimulation(const Graph& map, PredictionSystem* predSystem)
-    : cityMap(map), nextCarId(1), randomGen(std::random_device{}()),
-    predictionSystem(predSystem), trafficSimulationActive(false),
+CarSimulation::CarSimulation(Graph& map, PredictionSystem* predSystem, std::uint64_t seed)
+    : cityMap(map), nextCarId(1), randomGen(seed),
+    predictionSystem(predSystem), signalSystem(nullptr), tripRecorder(nullptr),
+    regionOfSlot(nullptr), region(-1), remoteVehicles(0), remoteCompletedTrips(0),
+    longestRoute(0), plannerVersion(std::numeric_limits<std::uint64_t>::max()),
+    fleetChanged(true), calmTicks(0), vehicleHorizon(0.0f), horizonBlockVersion(0),
+    arrivalEvents(false), nextArrivalTime(-1.0), nextArrivalIsTrip(false),
+    demand(std::make_shared<DemandModel>(map)),
+    timeOfDay(SimConfig::DAY_START_HOUR * 3600.0), elapsedTime(0.0), trafficSimulationActive(false),
     trafficSimulationTimer(0.0f), carSpawnInterval(2.0f),
-    simulationSpeed(1.0f) {
+    simulationSpeed(1.0f), completedTrips(0), spawnCount(0) {
 }
 
 void CarSimulation::toggleRunning() {
@@ -38,41 +45,126 @@ void CarSimulation::toggleRunning() {
     }
 }
 
+bool CarSimulation::spawnTrip(const DemandModel::Trip& trip) {
+    std::vector<int> route = acquireRoute();
+    if (!calculateRoute(trip.origin, trip.destination, route)) {
+        releaseRoute(route);
+        return false;
+    }
+
+    placeCar(trip.origin, trip.destination, route);
+    return true;
+}
+
 void CarSimulation::spawnTrafficCar() {
-    auto nodes = cityMap.getAllNodes();
-    if (nodes.size() < 2) return;
+    DemandModel::Trip trip;
+    if (!demand->sampleTrip(randomGen, timeOfDay, trip)) return;
 
-    std::vector<int> nodeIds;
-    for (const auto& pair : nodes) {
-        nodeIds.push_back(pair.first);
+    if (spawnTrip(trip) && ++spawnCount % 5 == 0) {
+        std::cout << "Traffic simulation: Added car #" << nextCarId - 1
+            << " (Total: " << cars.size() << ")" << std::endl;
     }
+}
 
-    std::uniform_int_distribution<> dist(0, static_cast<int>(nodeIds.size() - 1));
-    int startNode = nodeIds[dist(randomGen)];
-    int endNode = nodeIds[dist(randomGen)];
-
-    int attempts = 0;
-    while (endNode == startNode && nodeIds.size() > 1 && attempts < 10) {
-        endNode = nodeIds[dist(randomGen)];
-        attempts++;
+// OD matrix demand is not capped: the matrix rates decide the traffic volume
+void CarSimulation::spawnDemandTrips(float seconds) {
+    if (arrivalEvents) {
+        spawnArrivalEvents();
+        return;
     }
 
-    if (startNode == endNode) return;
+    pendingTrips.clear();
+    demand->sampleArrivals(randomGen, timeOfDay, seconds, pendingTrips);
 
-    auto route = calculateRoute(startNode, endNode);
-    if (!route.empty()) {
-        addCar(startNode, endNode, route);
+    for (const auto& trip : pendingTrips) {
+        if (spawnTrip(trip)) {
+            spawnCount++;
+        }
+    }
+}
 
-        static int spawnCount = 0;
-        if (++spawnCount % 5 == 0) {
-            std::cout << "Traffic simulation: Added car #" << nextCarId - 1
-                << " (Total: " << cars.size() << ")" << std::endl;
+void CarSimulation::spawnArrivalEvents() {
+    if (nextArrivalTime < 0.0) {
+        scheduleArrival(elapsedTime);
+    }
+
+    while (nextArrivalTime <= elapsedTime) {
+        double at = nextArrivalTime;
+        if (nextArrivalIsTrip) {
+            double arrivalTimeOfDay = std::fmod(timeOfDay - (elapsedTime - at) + 86400.0, 86400.0);
+            DemandModel::Trip trip;
+            if (demand->sampleTrip(randomGen, arrivalTimeOfDay, trip) && spawnTrip(trip)) {
+                spawnCount++;
+            }
         }
+        scheduleArrival(at);
+    }
+}
+
+// Gaps of a Poisson process are exponential and memoryless, so a gap that
+// would run past the end of the demand period is cut there and redrawn at
+// the new rate
+void CarSimulation::scheduleArrival(double from) {
+    constexpr double MIN_PERIOD_STEP = 1e-3;
+
+    double fromTimeOfDay = std::fmod(timeOfDay - (elapsedTime - from) + 86400.0, 86400.0);
+    double periodLeft = std::max(demand->getSecondsToNextPeriod(fromTimeOfDay), MIN_PERIOD_STEP);
+    float rate = demand->getTripRate(fromTimeOfDay);
+
+    double gap = std::numeric_limits<double>::infinity();
+    if (rate > 0.0f) {
+        std::exponential_distribution<double> interval(rate / 3600.0);
+        gap = interval(randomGen);
+    }
+
+    nextArrivalIsTrip = gap <= periodLeft;
+    nextArrivalTime = from + std::min(gap, periodLeft);
+}
+
+double CarSimulation::getQuietSeconds() const {
+    if (calmTicks < SimConfig::TIME_WARP_CALM_TICKS || horizonBlockVersion != cityMap.getBlockVersion()) {
+        return 0.0;
+    }
+
+    double quiet = vehicleHorizon;
+    if (trafficSimulationActive && demand->hasMatrix()) {
+        quiet = std::min(quiet, arrivalEvents && nextArrivalTime >= 0.0 ? nextArrivalTime - elapsedTime : 0.0);
     }
+    else if (trafficSimulationActive) {
+        quiet = std::min(quiet, static_cast<double>(carSpawnInterval - trafficSimulationTimer));
+    }
+    if (signalSystem) {
+        quiet = std::min(quiet, static_cast<double>(signalSystem->getSecondsToNextChange()));
+    }
+    if (tripRecorder) {
+        quiet = std::min(quiet, tripRecorder->getSecondsToTrajectory(elapsedTime));
+    }
+    return std::max(quiet, 0.0) / simulationSpeed;
 }
 
 void CarSimulation::update(float deltaTime) {
-    if (trafficSimulationActive) {
+    advanceClock(deltaTime);
+    spawnVehicles(deltaTime);
+    moveVehicles(deltaTime);
+}
+
+void CarSimulation::advanceClock(float deltaTime) {
+    float simulatedSeconds = deltaTime * simulationSpeed;
+    timeOfDay = std::fmod(timeOfDay + simulatedSeconds, 86400.0);
+    elapsedTime += simulatedSeconds;
+
+    if (signalSystem) {
+        signalSystem->update(simulatedSeconds);
+    }
+}
+
+void CarSimulation::spawnVehicles(float deltaTime) {
+    float simulatedSeconds = deltaTime * simulationSpeed;
+
+    if (trafficSimulationActive && demand->hasMatrix()) {
+        spawnDemandTrips(simulatedSeconds);
+    }
+    else if (trafficSimulationActive) {
         trafficSimulationTimer += deltaTime * simulationSpeed;
 
         if (trafficSimulationTimer >= carSpawnInterval) {
@@ -98,37 +190,75 @@ void CarSimulation::update(float deltaTime) {
             }
         }
     }
+}
 
-    std::unordered_map<int, int> carsOnEdge;
+void CarSimulation::moveVehicles(float deltaTime) {
+    bool changed = fleetChanged;
+    fleetChanged = false;
+    vehicleHorizon = std::numeric_limits<float>::infinity();
+
+    size_t edgeCount = static_cast<size_t>(cityMap.getEdgeCount());
+    carsOnEdge.assign(edgeCount, 0);
+    edgeSpeedSums.assign(edgeCount, 0.0f);
+    edgeSpeedSamples.assign(edgeCount, 0);
+    edgeQueues.assign(edgeCount * 2, 0);
+    carEdgeSlots.assign(cars.size(), -1);
+    carNextNodes.assign(cars.size(), -1);
+    carEdgeEnds.assign(cars.size(), -1);
+
+    // Find the edge every car is on once, by dense slot
+    for (size_t i = 0; i < cars.size(); i++) {
+        Car& car = cars[i];
+        car.previousPosition = car.currentPosition;
+        car.previousProgress = car.progress;
 
-    for (auto& car : cars) {
         if (!car.active || car.route.size() < 2) continue;
 
         auto it = std::find(car.route.begin(), car.route.end(), car.currentPosition);
         if (it == car.route.end() || it + 1 == car.route.end()) continue;
 
-        int nextNode = *(it + 1);
-        Edge edge = findEdge(car.currentPosition, nextNode);
-
-        if (edge.id != -1) {
-            carsOnEdge[edge.id]++;
+        int slot = cityMap.findEdgeSlot(car.currentPosition, *(it + 1));
+        if (slot != -1) {
+            int end = slot * 2 + (*(it + 1) == cityMap.getEdgeAt(slot).toNodeId ? 0 : 1);
+            carEdgeSlots[i] = slot;
+            carNextNodes[i] = *(it + 1);
+            carEdgeEnds[i] = end;
+            carsOnEdge[slot]++;
+            if (car.queueSlot >= 0) edgeQueues[end]++;
         }
     }
 
-    for (auto& car : cars) {
-        if (!car.active || car.route.size() < 2) continue;
-
-        auto it = std::find(car.route.begin(), car.route.end(), car.currentPosition);
-        if (it == car.route.end() || it + 1 == car.route.end()) continue;
-
-        int nextNode = *(it + 1);
-        Edge edge = findEdge(car.currentPosition, nextNode);
+    for (size_t i = 0; i < cars.size(); i++) {
+        int slot = carEdgeSlots[i];
+        if (slot == -1) continue;
+
+        Car& car = cars[i];
+        int nextNode = carNextNodes[i];
+        int end = carEdgeEnds[i];
+        const Edge& edge = cityMap.getEdgeAt(slot);
+
+        int approach = signalSystem ? signalSystem->getApproach(end) : -1;
+        bool red = false;
+        if (approach != -1) {
+            signalSystem->reportDemand(approach);
+            red = !signalSystem->isGreen(approach);
+            if (!red && car.queueSlot >= 0) {
+                car.queueSlot = -1;
+                changed = true;
+            }
+        }
 
-        if (edge.id == -1) continue;
+        // Queued cars wait for green; they still count towards the density
+        if (car.queueSlot >= 0) continue;
 
-        int carsOnThisEdge = carsOnEdge[edge.id];
+        int carsOnThisEdge = carsOnEdge[slot];
         float congestionFactor = 1.0f / (1.0f + carsOnThisEdge * 0.3f); 
 
+        // The measured speed leaves out the traffic level factor below, or a
+        // congested level would keep itself alive through its own slowdown
+        edgeSpeedSums[slot] += edge.speedLimit * congestionFactor;
+        edgeSpeedSamples[slot]++;
+
         float baseSpeed = 1.0f;
         switch (edge.trafficLevel) {
         case TrafficLevel::FREE_FLOW: baseSpeed = 1.0f; break;
@@ -139,175 +269,564 @@ void CarSimulation::update(float deltaTime) {
 
         float speed = baseSpeed * congestionFactor;
 
-        car.progress += deltaTime * 0.5f * speed * simulationSpeed;
+        float newProgress = car.progress +
+            deltaTime * SimConfig::FREE_FLOW_EDGES_PER_SECOND * speed * simulationSpeed;
+        float target = 1.0f;
+
+        // On red (or amber) the queue grows back from the end of the edge,
+        // one jam spacing per car; a car reaching its place stops there
+        if (red) {
+            float spacing = MesoConfig::JAM_SPACING_METERS /
+                std::max(edge.length, MesoConfig::JAM_SPACING_METERS);
+            float stopLine = std::max(0.0f, 1.0f - (edgeQueues[end] + 0.5f) * spacing);
+            target = stopLine;
+            if (newProgress >= stopLine) {
+                newProgress = std::max(car.progress, stopLine);
+                car.queueSlot = edgeQueues[end]++;
+                changed = true;
+            }
+        }
+        car.progress = newProgress;
+
+        if (car.queueSlot < 0 && car.progress < 1.0f && speed > 0.0f) {
+            vehicleHorizon = std::min(vehicleHorizon,
+                (target - car.progress) / (SimConfig::FREE_FLOW_EDGES_PER_SECOND * speed));
+        }
 
         if (car.progress >= 1.0f) {
+            changed = true;
             car.progress = 0.0f;
             car.currentPosition = nextNode;
 
             if (car.currentPosition == car.destination) {
                 car.active = false;
+                completedTrips++;
+                if (tripRecorder) {
+                    float freeFlowSeconds = (car.route.size() - 1) / SimConfig::FREE_FLOW_EDGES_PER_SECOND;
+                    tripRecorder->recordTrip(car.id, car.route, car.departureTime, elapsedTime, freeFlowSeconds);
+                }
                 if (cars.size() < 20) {
                     std::cout << "Car " << car.id << " reached destination!" << std::endl;
                 }
             }
+            else if (regionOfSlot) {
+                handOver(car);
+            }
+        }
+    }
+
+    updateEdgeTraffic();
+
+    if (tripRecorder && tripRecorder->trajectoryDue(elapsedTime)) {
+        recordTrajectories();
+    }
+
+    removeInactiveCars();
+
+    calmTicks = changed ? 0 : calmTicks + 1;
+    horizonBlockVersion = cityMap.getBlockVersion();
+}
+
+// Writes the mean vehicle speed of every occupied edge back to the graph in
+// one batch. Edges that emptied since the last tick return to free flow;
+// edges no car has used keep whatever the map or a scenario gave them, and
+// edges holding only a queue at a red light keep their last measurement.
+void CarSimulation::updateEdgeTraffic() {
+    size_t edgeCount = carsOnEdge.size();
+    occupiedEdges.resize(edgeCount, 0);
+    trafficSlots.clear();
+    trafficSpeeds.clear();
+
+    for (size_t slot = 0; slot < edgeCount; slot++) {
+        if (edgeSpeedSamples[slot] > 0) {
+            trafficSlots.push_back(static_cast<int>(slot));
+            trafficSpeeds.push_back(edgeSpeedSums[slot] / edgeSpeedSamples[slot]);
+            occupiedEdges[slot] = 1;
+        }
+        else if (carsOnEdge[slot] > 0) {
+            occupiedEdges[slot] = 1;
+        }
+        else if (occupiedEdges[slot]) {
+            trafficSlots.push_back(static_cast<int>(slot));
+            trafficSpeeds.push_back(static_cast<float>(cityMap.getEdgeAt(static_cast<int>(slot)).speedLimit));
+            occupiedEdges[slot] = 0;
         }
     }
 
-    cars.erase(std::remove_if(cars.begin(), cars.end(),
-        [](const Car& car) { return !car.active; }), cars.end());
+    cityMap.updateEdgeTrafficBatch(trafficSlots, trafficSpeeds);
+}
+
+// Region mode: a car whose next road belongs to another region leaves this
+// simulation and waits in emigrants until the caller passes it on
+void CarSimulation::handOver(Car& car) {
+    auto it = std::find(car.route.begin(), car.route.end(), car.currentPosition);
+    if (it == car.route.end() || it + 1 == car.route.end()) return;
+
+    int nextSlot = cityMap.findEdgeSlot(car.currentPosition, *(it + 1));
+    if (nextSlot != -1 && (*regionOfSlot)[nextSlot] != region) {
+        emigrants.push_back(std::move(car));
+        car.active = false;
+    }
+}
+
+void CarSimulation::takeCars(std::vector<Car>& out) {
+    out.clear();
+    out.swap(cars);
+}
+
+void CarSimulation::takeEmigrants(std::vector<Car>& out) {
+    out.clear();
+    out.swap(emigrants);
+}
+
+// The fleet stays sorted by id, the order a single simulation would hold it
+// in, so cars sharing a road queue in the same order whichever region
+// moves them
+void CarSimulation::insertCars(std::vector<Car>& incoming) {
+    if (incoming.empty()) return;
+
+    fleetChanged = true;
+    auto byId = [](const Car& a, const Car& b) { return a.id < b.id; };
+    std::sort(incoming.begin(), incoming.end(), byId);
+
+    size_t middle = cars.size();
+    cars.insert(cars.end(), std::make_move_iterator(incoming.begin()), std::make_move_iterator(incoming.end()));
+    std::inplace_merge(cars.begin(), cars.begin() + middle, cars.end(), byId);
+    incoming.clear();
+}
+
+void CarSimulation::recordTrajectories() {
+    for (const auto& car : cars) {
+        if (!car.active || !tripRecorder->wantsTrajectory(car.id)) continue;
+
+        float x, y, angle;
+        if (getCarLocation(car, car.currentPosition, car.progress, x, y, angle)) {
+            tripRecorder->recordPosition(elapsedTime, car.id, x, y);
+        }
+    }
 }
 
 void CarSimulation::addCar(int startNode, int endNode, const std::vector<int>& route) {
     if (route.size() < 2) return;
 
-    Car newCar(nextCarId++, startNode, endNode);
-    newCar.route = route;
-    cars.push_back(newCar);
+    std::vector<int> buffer = acquireRoute();
+    reserveRoute(buffer, route.size());
+    buffer.assign(route.begin(), route.end());
+    placeCar(startNode, endNode, buffer);
+}
+
+// Takes over the route buffer. The car is built in place at the end of the
+// fleet, which only reallocates while the fleet is bigger than ever before.
+void CarSimulation::placeCar(int startNode, int endNode, std::vector<int>& route) {
+    if (route.size() < 2) {
+        releaseRoute(route);
+        return;
+    }
+
+    size_t capacity = cars.capacity();
+    Car& car = cars.emplace_back(nextCarId++, startNode, endNode, randomColor());
+    fleetChanged = true;
+    if (cars.capacity() != capacity) {
+        // Every route buffer belongs to a car or waits in the free list
+        freeRoutes.reserve(cars.capacity());
+        poolStats.fleetAllocations++;
+    }
+    car.route = std::move(route);
+    car.departureTime = elapsedTime;
 
     if (nextCarId <= 10) {
-        std::cout << "Car " << newCar.id << " added on route: ";
-        for (int node : route) std::cout << node << " ";
+        std::cout << "Car " << car.id << " added on route: ";
+        for (int node : car.route) std::cout << node << " ";
         std::cout << std::endl;
     }
 }
 
-void CarSimulation::addRandomCar() {
-    auto nodes = cityMap.getAllNodes();
-    if (nodes.size() < 2) return;
+std::vector<int> CarSimulation::acquireRoute() {
+    if (freeRoutes.empty()) return std::vector<int>();
 
-    std::vector<int> nodeIds;
-    for (const auto& pair : nodes) {
-        nodeIds.push_back(pair.first);
+    std::vector<int> route = std::move(freeRoutes.back());
+    freeRoutes.pop_back();
+    poolStats.routeReuses++;
+    return route;
+}
+
+void CarSimulation::releaseRoute(std::vector<int>& route) {
+    if (route.capacity() == 0) return;
+
+    route.clear();
+    size_t capacity = freeRoutes.capacity();
+    freeRoutes.push_back(std::move(route));
+    if (freeRoutes.capacity() != capacity) {
+        poolStats.fleetAllocations++;
     }
+}
+
+void CarSimulation::reserveRoute(std::vector<int>& route, size_t length) {
+    if (route.capacity() >= length) return;
 
-    std::uniform_int_distribution<> dist(0, static_cast<int>(nodeIds.size() - 1));
-    int startNode = nodeIds[dist(randomGen)];
-    int endNode = nodeIds[dist(randomGen)];
+    // Rounding up to a power of two lets every buffer settle on one size
+    // long before the longest route in the map has been seen
+    longestRoute = std::max(longestRoute, std::bit_ceil(length));
+    route.reserve(longestRoute);
+    poolStats.routeAllocations++;
+}
 
-    while (endNode == startNode && nodeIds.size() > 1) {
-        endNode = nodeIds[dist(randomGen)];
+// Stable compaction that swaps finished cars to the tail instead of
+// overwriting them, so their route buffers survive for the free list
+void CarSimulation::removeInactiveCars() {
+    size_t kept = 0;
+    for (size_t i = 0; i < cars.size(); i++) {
+        if (!cars[i].active) continue;
+        if (i != kept) {
+            std::swap(cars[kept], cars[i]);
+        }
+        kept++;
     }
 
-    auto route = calculateRoute(startNode, endNode);
-    if (!route.empty()) {
-        addCar(startNode, endNode, route);
+    for (size_t i = kept; i < cars.size(); i++) {
+        releaseRoute(cars[i].route);
     }
+    cars.erase(cars.begin() + kept, cars.end());
 }
 
-void CarSimulation::draw(sf::RenderWindow& window, float zoom, sf::Vector2f offset) {
-    for (const auto& car : cars) {
-        if (!car.active || car.route.size() < 2) continue;
-
-        auto it = std::find(car.route.begin(), car.route.end(), car.currentPosition);
-        if (it == car.route.end() || it + 1 == car.route.end()) continue;
+CarSimulation::PoolStats CarSimulation::getPoolStats() const {
+    PoolStats stats = poolStats;
+    stats.fleetCapacity = cars.capacity();
+    stats.freeRoutes = freeRoutes.size();
+    return stats;
+}
 
-        int nextNode = *(it + 1);
-        Node from = cityMap.getNode(car.currentPosition);
-        Node to = cityMap.getNode(nextNode);
+// Random bright colour, RGBA
+std::uint32_t CarSimulation::randomColor() {
+    std::uint32_t r = 50 + randomGen.nextInt(206);
+    std::uint32_t g = 50 + randomGen.nextInt(206);
+    std::uint32_t b = 50 + randomGen.nextInt(206);
+    return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+}
 
-        if (from.id == -1 || to.id == -1) continue;
+void CarSimulation::addRandomCar() {
+    addRandomCars(1);
+}
 
-        float x = from.x + (to.x - from.x) * car.progress;
-        float y = from.y + (to.y - from.y) * car.progress;
+int CarSimulation::addRandomCars(int count) {
+    pendingTrips.clear();
+    demand->sampleTrips(randomGen, timeOfDay, count, pendingTrips);
 
-        float screenX = x * zoom + offset.x;
-        float screenY = y * zoom + offset.y;
+    int added = 0;
+    for (const auto& trip : pendingTrips) {
+        if (spawnTrip(trip)) {
+            added++;
+        }
+    }
+    return added;
+}
 
-        sf::ConvexShape triangle(3);
-        triangle.setPoint(0, sf::Vector2f(0, -8.0f * zoom));
-        triangle.setPoint(1, sf::Vector2f(-5.0f * zoom, 5.0f * zoom));
-        triangle.setPoint(2, sf::Vector2f(5.0f * zoom, 5.0f * zoom));
+bool CarSimulation::getCarLocation(const Car& car, int node, float progress,
+    float& x, float& y, float& angle) const {
+    auto it = std::find(car.route.begin(), car.route.end(), node);
+    if (it == car.route.end() || it + 1 == car.route.end()) return false;
 
-        triangle.setFillColor(car.color);
-        triangle.setOutlineColor(sf::Color::White);
-        triangle.setOutlineThickness(1.0f * zoom);
-        triangle.setPosition(screenX, screenY);
+    Node from = cityMap.getNode(node);
+    Node to = cityMap.getNode(*(it + 1));
+    if (from.id == -1 || to.id == -1) return false;
 
-        float dx = to.x - from.x;
-        float dy = to.y - from.y;
-        if (dx != 0 || dy != 0) {
-            float angle = std::atan2(dy, dx) * 180.0f / M_PI;
-            triangle.setRotation(angle);
-        }
+    x = from.x + (to.x - from.x) * progress;
+    y = from.y + (to.y - from.y) * progress;
 
-        window.draw(triangle);
-    }
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    angle = (dx != 0 || dy != 0) ? std::atan2(dy, dx) * 180.0f / static_cast<float>(M_PI) : 0.0f;
+    return true;
 }
 
 void CarSimulation::clearAllCars() {
     std::cout << "Clearing " << cars.size() << " cars" << std::endl;
+    fleetChanged = true;
+    for (auto& car : cars) {
+        releaseRoute(car.route);
+    }
     cars.clear();
     nextCarId = 1;
 }
 
-Edge CarSimulation::findEdge(int fromNode, int toNode) const {
-    // Use optimized cache lookup instead of linear search
-    return cityMap.findEdgeByNodes(fromNode, toNode);
-}
+// Dijkstra over the dense planner rows; the route is written into path,
+// which keeps its buffer
+bool CarSimulation::calculateRoute(int start, int end, std::vector<int>& path) {
+    path.clear();
+    if (start == end) {
+        reserveRoute(path, 1);
+        path.push_back(start);
+        return true;
+    }
 
-// Calculate route using Dijkstra's algorithm
-std::vector<int> CarSimulation::calculateRoute(int start, int end) {
-    struct ComparePair {
-        bool operator()(const std::pair<float, int>& a,
-            const std::pair<float, int>& b) const {
-            return a.first > b.first;
-        }
-    };
+    if (plannerVersion != cityMap.getTopologyVersion()) {
+        buildPlanner();
+    }
 
-    std::priority_queue<std::pair<float, int>,
-        std::vector<std::pair<float, int>>,
-        ComparePair> pq;
+    auto source = plannerIndex.find(start);
+    auto target = plannerIndex.find(end);
+    if (source == plannerIndex.end() || target == plannerIndex.end()) return false;
 
-    auto nodes = cityMap.getAllNodes();
-    std::unordered_map<int, float> dist;
-    std::unordered_map<int, int> prev;
+    // Same ordering as a std::priority_queue with this comparator, so equal
+    // distances resolve exactly as they always have
+    auto byDistance = [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+        return a.first > b.first;
+    };
 
-    for (const auto& pair : nodes) {
-        dist[pair.first] = std::numeric_limits<float>::max();
-    }
+    // Edge travel times are length / speedLimit * 60 with metres and km/h,
+    // which is seconds scaled by 60 / 3.6
+    constexpr float SECONDS_TO_TRAVEL_TIME = 60.0f / 3.6f;
 
-    dist[start] = 0.0f;
-    pq.push(std::make_pair(0.0f, start));
+    std::fill(plannerDistances.begin(), plannerDistances.end(), std::numeric_limits<float>::max());
+    size_t heapCapacity = plannerHeap.capacity();
+    plannerHeap.clear();
 
-    while (!pq.empty()) {
-        float currentDist = pq.top().first;
-        int currentNode = pq.top().second;
-        pq.pop();
+    plannerDistances[source->second] = 0.0f;
+    plannerHeap.emplace_back(0.0f, source->second);
 
-        if (currentDist > dist[currentNode]) continue;
-        if (currentNode == end) break;
+    while (!plannerHeap.empty()) {
+        float currentDist = plannerHeap.front().first;
+        int current = plannerHeap.front().second;
+        std::pop_heap(plannerHeap.begin(), plannerHeap.end(), byDistance);
+        plannerHeap.pop_back();
 
-        auto edges = cityMap.getEdgesFromNode(currentNode);
-        for (int edgeId : edges) {
-            Edge edge = cityMap.getEdge(edgeId);
-            int neighbor = (edge.fromNodeId == currentNode) ? edge.toNodeId : edge.fromNodeId;
+        if (currentDist > plannerDistances[current]) continue;
+        if (current == target->second) break;
 
-            float newDist = currentDist + edge.currentTravelTime;
+        for (int i = plannerOffsets[current]; i < plannerOffsets[current + 1]; i++) {
+            int neighbor = plannerNeighbors[i];
+            float newDist = currentDist + cityMap.getEdgeAt(plannerSlots[i]).currentTravelTime;
+            if (signalSystem && neighbor != target->second) {
+                newDist += signalSystem->getExpectedDelay(plannerNodeIds[neighbor]) *
+                    SignalConfig::ROUTE_DELAY_WEIGHT * SECONDS_TO_TRAVEL_TIME;
+            }
 
-            if (newDist < dist[neighbor]) {
-                dist[neighbor] = newDist;
-                prev[neighbor] = currentNode;
-                pq.push(std::make_pair(newDist, neighbor));
+            if (newDist < plannerDistances[neighbor]) {
+                plannerDistances[neighbor] = newDist;
+                plannerPrevious[neighbor] = current;
+                plannerHeap.emplace_back(newDist, neighbor);
+                std::push_heap(plannerHeap.begin(), plannerHeap.end(), byDistance);
             }
         }
     }
 
-    if (dist.find(end) == dist.end() || dist[end] == std::numeric_limits<float>::max()) {
-        return std::vector<int>();
+    if (plannerHeap.capacity() != heapCapacity) {
+        poolStats.plannerAllocations++;
+    }
+    if (plannerDistances[target->second] == std::numeric_limits<float>::max()) {
+        return false;
     }
 
-    std::vector<int> path;
-    for (int at = end; at != start; at = prev[at]) {
-        path.push_back(at);
+    size_t length = 1;
+    for (int at = target->second; at != source->second; at = plannerPrevious[at]) {
+        length++;
+    }
+    reserveRoute(path, length);
+    path.resize(length);
+    for (int at = target->second; ; at = plannerPrevious[at]) {
+        path[--length] = plannerNodeIds[at];
+        if (at == source->second) break;
+    }
+    return true;
+}
+
+void CarSimulation::buildPlanner() {
+    const auto& nodes = cityMap.getAllNodes();
+    plannerIndex.clear();
+    plannerNodeIds.clear();
+    for (const auto& pair : nodes) {
+        plannerIndex[pair.first] = static_cast<int>(plannerNodeIds.size());
+        plannerNodeIds.push_back(pair.first);
+    }
+
+    plannerOffsets.assign(1, 0);
+    plannerSlots.clear();
+    plannerNeighbors.clear();
+    for (int nodeId : plannerNodeIds) {
+        for (int edgeId : cityMap.getEdgesFromNode(nodeId)) {
+            int slot = cityMap.getEdgeSlot(edgeId);
+            if (slot == -1) continue;
+
+            const Edge& edge = cityMap.getEdgeAt(slot);
+            auto neighbor = plannerIndex.find(edge.fromNodeId == nodeId ? edge.toNodeId : edge.fromNodeId);
+            if (neighbor == plannerIndex.end()) continue;
+
+            plannerSlots.push_back(slot);
+            plannerNeighbors.push_back(neighbor->second);
+        }
+        plannerOffsets.push_back(static_cast<int>(plannerSlots.size()));
     }
-    path.push_back(start);
-    std::reverse(path.begin(), path.end());
 
-    return path;
+    plannerDistances.assign(plannerNodeIds.size(), std::numeric_limits<float>::max());
+    plannerPrevious.assign(plannerNodeIds.size(), -1);
+    plannerVersion = cityMap.getTopologyVersion();
+    poolStats.plannerAllocations++;
 }
 
 //void CarSimulation::rerouteIfNeeded(Vehicle& vehicle) {
 //    // TODO: Implement if needed, or remove this method
 //    std::cout << "Warning: CarSimulation::rerouteIfNeeded() not implemented" << std::endl;
-//}
\ No newline at end of file
+//}
+
+void CarSimulation::saveState(BinaryWriter& writer) const {
+    size_t count = cars.size();
+    std::vector<int> ids, positions, destinations, previousPositions;
+    std::vector<float> progress, previousProgress;
+    std::vector<std::uint8_t> active;
+    std::vector<int> queueSlots;
+    std::vector<double> departureTimes;
+    std::vector<std::uint32_t> colors;
+    std::vector<std::uint32_t> routeOffsets;
+    std::vector<int> routeNodes;
+
+    ids.reserve(count);
+    positions.reserve(count);
+    destinations.reserve(count);
+    previousPositions.reserve(count);
+    progress.reserve(count);
+    previousProgress.reserve(count);
+    active.reserve(count);
+    queueSlots.reserve(count);
+    departureTimes.reserve(count);
+    colors.reserve(count);
+    routeOffsets.reserve(count + 1);
+
+    routeOffsets.push_back(0);
+    for (const auto& car : cars) {
+        ids.push_back(car.id);
+        positions.push_back(car.currentPosition);
+        destinations.push_back(car.destination);
+        previousPositions.push_back(car.previousPosition);
+        progress.push_back(car.progress);
+        previousProgress.push_back(car.previousProgress);
+        active.push_back(car.active ? 1 : 0);
+        queueSlots.push_back(car.queueSlot);
+        departureTimes.push_back(car.departureTime);
+        colors.push_back(car.color);
+        routeNodes.insert(routeNodes.end(), car.route.begin(), car.route.end());
+        routeOffsets.push_back(static_cast<std::uint32_t>(routeNodes.size()));
+    }
+
+    writer.writeTag("CARS");
+    writer.write(nextCarId);
+    writer.write(trafficSimulationActive);
+    writer.write(trafficSimulationTimer);
+    writer.write(carSpawnInterval);
+    writer.write(simulationSpeed);
+    writer.write(completedTrips);
+    writer.write(spawnCount);
+    writer.write(timeOfDay);
+    writer.write(elapsedTime);
+    writer.write(nextArrivalTime);
+    writer.write(nextArrivalIsTrip);
+    writer.write(randomGen.getKey());
+    writer.write(randomGen.getCounter());
+
+    writer.writeArray(ids);
+    writer.writeArray(positions);
+    writer.writeArray(destinations);
+    writer.writeArray(previousPositions);
+    writer.writeArray(progress);
+    writer.writeArray(previousProgress);
+    writer.writeArray(active);
+    writer.writeArray(queueSlots);
+    writer.writeArray(departureTimes);
+    writer.writeArray(colors);
+    writer.writeArray(routeOffsets);
+    writer.writeArray(routeNodes);
+
+    std::vector<int> occupiedEdgeIds;
+    for (size_t slot = 0; slot < occupiedEdges.size(); slot++) {
+        if (occupiedEdges[slot]) {
+            occupiedEdgeIds.push_back(cityMap.getEdgeAt(static_cast<int>(slot)).id);
+        }
+    }
+    writer.writeArray(occupiedEdgeIds);
+}
+
+bool CarSimulation::loadState(BinaryReader& reader) {
+    int savedNextCarId;
+    bool savedActive;
+    float savedTimer, savedInterval, savedSpeed;
+    long long savedCompleted;
+    int savedSpawnCount;
+    double savedTimeOfDay, savedElapsedTime;
+    std::uint64_t rngKey, rngCounter;
+
+    std::vector<int> ids, positions, destinations, previousPositions;
+    std::vector<float> progress, previousProgress;
+    std::vector<std::uint8_t> active;
+    std::vector<int> queueSlots;
+    std::vector<double> departureTimes;
+    std::vector<std::uint32_t> colors;
+    std::vector<std::uint32_t> routeOffsets;
+    std::vector<int> routeNodes;
+    std::vector<int> occupiedEdgeIds;
+
+    if (!reader.expectTag("CARS") ||
+        !reader.read(savedNextCarId) || !reader.read(savedActive) ||
+        !reader.read(savedTimer) || !reader.read(savedInterval) || !reader.read(savedSpeed) ||
+        !reader.read(savedCompleted) || !reader.read(savedSpawnCount) || !reader.read(savedTimeOfDay) ||
+        !reader.read(savedElapsedTime) || !reader.read(nextArrivalTime) || !reader.read(nextArrivalIsTrip) ||
+        !reader.read(rngKey) || !reader.read(rngCounter) ||
+        !reader.readArray(ids) || !reader.readArray(positions) ||
+        !reader.readArray(destinations) || !reader.readArray(previousPositions) ||
+        !reader.readArray(progress) || !reader.readArray(previousProgress) ||
+        !reader.readArray(active) || !reader.readArray(queueSlots) ||
+        !reader.readArray(departureTimes) || !reader.readArray(colors) ||
+        !reader.readArray(routeOffsets) || !reader.readArray(routeNodes) ||
+        !reader.readArray(occupiedEdgeIds)) {
+        return false;
+    }
+
+    size_t count = ids.size();
+    bool consistent = positions.size() == count && destinations.size() == count &&
+        previousPositions.size() == count && progress.size() == count &&
+        previousProgress.size() == count && active.size() == count &&
+        queueSlots.size() == count && departureTimes.size() == count && colors.size() == count && routeOffsets.size() == count + 1 &&
+        routeOffsets.back() == routeNodes.size();
+    for (size_t i = 0; consistent && i < count; i++) {
+        consistent = routeOffsets[i] <= routeOffsets[i + 1];
+    }
+    for (size_t i = 0; consistent && i < occupiedEdgeIds.size(); i++) {
+        consistent = cityMap.getEdgeSlot(occupiedEdgeIds[i]) != -1;
+    }
+    if (!consistent) {
+        std::cerr << "Error: Corrupt vehicle section in checkpoint" << std::endl;
+        reader.fail();
+        return false;
+    }
+
+    occupiedEdges.assign(static_cast<size_t>(cityMap.getEdgeCount()), 0);
+    for (int edgeId : occupiedEdgeIds) {
+        occupiedEdges[cityMap.getEdgeSlot(edgeId)] = 1;
+    }
+
+    cars.clear();
+    cars.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        Car car(ids[i], positions[i], destinations[i], colors[i]);
+        car.progress = progress[i];
+        car.previousPosition = previousPositions[i];
+        car.previousProgress = previousProgress[i];
+        car.active = active[i] != 0;
+        car.queueSlot = queueSlots[i];
+        car.departureTime = departureTimes[i];
+        car.route.assign(routeNodes.begin() + routeOffsets[i], routeNodes.begin() + routeOffsets[i + 1]);
+        cars.push_back(std::move(car));
+    }
+
+    nextCarId = savedNextCarId;
+    trafficSimulationActive = savedActive;
+    trafficSimulationTimer = savedTimer;
+    carSpawnInterval = savedInterval;
+    simulationSpeed = savedSpeed;
+    completedTrips = savedCompleted;
+    spawnCount = savedSpawnCount;
+    timeOfDay = savedTimeOfDay;
+    elapsedTime = savedElapsedTime;
+    randomGen.setState(rngKey, rngCounter);
+    fleetChanged = true;
+    calmTicks = 0;
+    return true;
+}
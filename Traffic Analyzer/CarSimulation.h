@@ -1,12 +1,20 @@
 #pragma once
 #include "Graph.h"
-#include <SFML/Graphics.hpp>
+#include "Random.h"
+#include "DemandModel.h"
 #include <vector>
-#include <random>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 //#include "Vehicle.h"
 
 class PredictionSystem;
+class SignalSystem;
+class TripRecorder;
 struct TrafficPrediction;
+class BinaryWriter;
+class BinaryReader;
 
 class CarSimulation {
 public:
@@ -15,43 +23,197 @@ public:
         int currentPosition;
         int destination;
         float progress;
+        int previousPosition;    // State at the previous tick, for render interpolation
+        float previousProgress;
         bool active;
-        sf::Color color;
+        int queueSlot;           // Place in the queue at a red light, -1 while moving
+        double departureTime;    // Simulated seconds since the start of the run
+        std::uint32_t color;     // RGBA, 0xRRGGBBAA
         std::vector<int> route;
 
-        Car(int id, int start, int dest);
+        Car(int id, int start, int dest, std::uint32_t color);
+    };
+
+    // Heap traffic of the vehicle pool. Once the fleet size, the longest
+    // route and the map have been seen, spawning and despawning only reuse
+    // slots and buffers and none of the allocation counters grow.
+    struct PoolStats {
+        long long fleetAllocations = 0;      // Growth of the fleet or the free list
+        long long routeAllocations = 0;      // Route buffers allocated or grown
+        long long plannerAllocations = 0;    // Route planner rebuilt or its heap grown
+        long long routeReuses = 0;           // Routes built in a recycled buffer
+        size_t fleetCapacity = 0;
+        size_t freeRoutes = 0;
     };
 
 private:
-    const Graph& cityMap;
+    Graph& cityMap;                      // Vehicles write their speeds back to the edges
     std::vector<Car> cars;
     int nextCarId;
-    std::mt19937 randomGen;
+    CounterRng randomGen;
     PredictionSystem* predictionSystem;
+    SignalSystem* signalSystem;
+    TripRecorder* tripRecorder;
+
+    // Region mode, for simulations split over processes
+    const std::vector<int>* regionOfSlot;
+    int region;
+    std::vector<Car> emigrants;
+    int remoteVehicles;
+    long long remoteCompletedTrips;
+
+    // Vehicle pool: despawned cars leave their route buffers here for the
+    // next spawn; buffers are sized to the longest route seen, rounded up
+    std::vector<std::vector<int>> freeRoutes;
+    size_t longestRoute;                            // Power of two
+    PoolStats poolStats;
+
+    // Route planner scratch: the adjacency lists as dense rows, rebuilt when
+    // the map topology changes
+    std::uint64_t plannerVersion;
+    std::unordered_map<int, int> plannerIndex;       // Node id -> dense index
+    std::vector<int> plannerNodeIds;
+    std::vector<int> plannerOffsets;                 // Row of each node in the two below
+    std::vector<int> plannerSlots;                   // Edge slot per adjacency entry
+    std::vector<int> plannerNeighbors;               // Dense index of the far end
+    std::vector<float> plannerDistances;
+    std::vector<int> plannerPrevious;
+    std::vector<std::pair<float, int>> plannerHeap;
+
+    // Time warp. moveVehicles() records when the next car will reach a node
+    // or a stop line. The estimate holds once no car has changed road, queue
+    // or fleet for TIME_WARP_CALM_TICKS ticks and no road was blocked or
+    // reopened since, because road speeds then no longer change.
+    bool fleetChanged;
+    int calmTicks;
+    float vehicleHorizon;                // Simulated seconds
+    std::uint64_t horizonBlockVersion;
+
+    bool arrivalEvents;
+    double nextArrivalTime;              // elapsedTime of the next arrival event, < 0 = not drawn
+    bool nextArrivalIsTrip;              // Otherwise the demand period changes then
+
+    std::shared_ptr<const DemandModel> demand;
+    double timeOfDay;                    // Seconds since midnight, advances with simulation speed
+    double elapsedTime;                  // Simulated seconds since the start of the run
+    std::vector<DemandModel::Trip> pendingTrips;
+
+    // Per-tick scratch, indexed by dense edge slot or by car
+    std::vector<int> carsOnEdge;
+    std::vector<float> edgeSpeedSums;
+    std::vector<int> edgeSpeedSamples;       // Moving cars only: a red light is not congestion
+    std::vector<int> edgeQueues;             // Cars stopped at each edge end
+    std::vector<std::uint8_t> occupiedEdges;  // Had cars after the last tick
+    std::vector<int> carEdgeSlots;
+    std::vector<int> carNextNodes;
+    std::vector<int> carEdgeEnds;
+    std::vector<int> trafficSlots;
+    std::vector<float> trafficSpeeds;
 
     bool trafficSimulationActive;
     float trafficSimulationTimer;
     float carSpawnInterval;  
     float simulationSpeed;
+    long long completedTrips;
+    int spawnCount;
 
 public:
-    CarSimulation(const Graph& map, PredictionSystem* predSystem = nullptr);
+    CarSimulation(Graph& map, PredictionSystem* predSystem = nullptr,
+        std::uint64_t seed = CounterRng::randomSeed());
 
     void addCar(int startNode, int endNode, const std::vector<int>& route);
     void addRandomCar();
+    int addRandomCars(int count);        // Trips drawn from the demand model, returns cars added
     void update(float deltaTime);
-    void draw(sf::RenderWindow& window, float zoom, sf::Vector2f offset);
     void clearAllCars();
 
+    // The three stages of update(), for callers that split them: the clock
+    // with the signals, the traffic generator and vehicle movement
+    void advanceClock(float deltaTime);
+    void spawnVehicles(float deltaTime);
+    void moveVehicles(float deltaTime);
+
     void toggleRunning();
     bool getIsRunning() const { return trafficSimulationActive; }
     void setSimulationSpeed(float speed) { simulationSpeed = speed; }
 
-    int getVehicleCount() const { return static_cast<int>(cars.size()); }
+    int getVehicleCount() const { return static_cast<int>(cars.size()) + remoteVehicles; }
+    long long getCompletedTrips() const { return completedTrips + remoteCompletedTrips; }
+
+    // Demand is uniform between all nodes unless a model with an OD matrix is
+    // set, in which case automatic spawning follows the matrix trip rates
+    void setDemandModel(std::shared_ptr<const DemandModel> model) { demand = std::move(model); }
+    const DemandModel& getDemandModel() const { return *demand; }
+    void setTimeOfDay(double seconds) { timeOfDay = seconds; }
+    double getTimeOfDay() const { return timeOfDay; }
+    const std::vector<Car>& getCars() const { return cars; }
+
+    // Signals are advanced in simulated time by update(); cars stop at red
+    // lights and routes price in the expected wait at each signal
+    void setSignalSystem(SignalSystem* signals) { signalSystem = signals; }
+
+    // Completed trips, and position samples if the recorder asks for them,
+    // are handed to an open recorder as they happen
+    void setTripRecorder(TripRecorder* recorder) { tripRecorder = recorder; }
+
+    // Region mode: this simulation only moves cars on roads whose slot maps to
+    // region. A car about to enter another region's road is handed over
+    // through takeEmigrants(); insertCars() takes cars in. A coordinator that
+    // only spawns hands every new car out with takeCars() and learns the
+    // totals of the regions through setRemoteCounts().
+    void setRegion(const std::vector<int>* slotRegions, int ownRegion) {
+        regionOfSlot = slotRegions;
+        region = ownRegion;
+    }
+    void takeCars(std::vector<Car>& out);
+    void takeEmigrants(std::vector<Car>& out);
+    void insertCars(std::vector<Car>& incoming);
+    void setRemoteCounts(int vehicles, long long completed) {
+        remoteVehicles = vehicles;
+        remoteCompletedTrips = completed;
+    }
+    long long getLocalCompletedTrips() const { return completedTrips; }
+
+    PoolStats getPoolStats() const;
+
+    // Time warp: seconds, in update() units, before the next car event,
+    // spawn, signal change or trajectory sample. 0 while traffic settles.
+    double getQuietSeconds() const;
+
+    // OD matrix arrivals drawn as exponential gaps instead of a Poisson count
+    // per tick. The process is the same, but the next spawn is known ahead.
+    void setArrivalEvents(bool enabled) { arrivalEvents = enabled; }
+
+    // Speeds written to the graph by the last moveVehicles(), by slot
+    const std::vector<int>& getTrafficSlots() const { return trafficSlots; }
+    const std::vector<float>& getTrafficSpeeds() const { return trafficSpeeds; }
+
+    // Checkpointing: the fleet is written column by column
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+    void reseed(std::uint64_t seed) { randomGen = CounterRng(seed); }
+
+    // World position and heading of a car that is progress along the edge leaving node
+    bool getCarLocation(const Car& car, int node, float progress,
+        float& x, float& y, float& angle) const;
 
 private:
-    Edge findEdge(int fromNode, int toNode) const;
-    std::vector<int> calculateRoute(int start, int end);
+    bool calculateRoute(int start, int end, std::vector<int>& path);
+    void buildPlanner();
+
+    void placeCar(int startNode, int endNode, std::vector<int>& route);
+    std::vector<int> acquireRoute();
+    void releaseRoute(std::vector<int>& route);
+    void reserveRoute(std::vector<int>& route, size_t length);
+    void removeInactiveCars();
 
     void spawnTrafficCar();
+    void updateEdgeTraffic();
+    void recordTrajectories();
+    void handOver(Car& car);
+    void spawnDemandTrips(float seconds);
+    void spawnArrivalEvents();
+    void scheduleArrival(double from);
+    bool spawnTrip(const DemandModel::Trip& trip);
+    std::uint32_t randomColor();
 };
\ No newline at end of file
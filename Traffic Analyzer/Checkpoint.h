@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+// Binary checkpoint format. A file is a header followed by one tagged section
+// per system; each system writes its state as flat columns so a section is a
+// handful of bulk writes. Checkpoints are only portable between builds with
+// the same endianness and struct layout.
+namespace CheckpointFormat {
+    constexpr char MAGIC[4] = { 'T', 'A', 'C', 'P' };
+    constexpr std::uint32_t VERSION = 13;
+}
+
+class BinaryWriter {
+private:
+    std::ofstream out;
+
+public:
+    explicit BinaryWriter(const std::string& filename)
+        : out(filename, std::ios::binary | std::ios::trunc) {
+    }
+
+    bool isOpen() const { return out.is_open(); }
+    bool good() const { return out.good(); }
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "write() needs a trivially copyable type");
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "writeArray() needs a trivially copyable type");
+        std::uint64_t count = values.size();
+        write(count);
+        if (count > 0) {
+            out.write(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+        }
+    }
+
+    void writeTag(const char (&tag)[5]) {
+        out.write(tag, 4);
+    }
+};
+
+class BinaryReader {
+private:
+    std::ifstream in;
+    std::uint64_t remaining;
+    bool ok;
+
+public:
+    explicit BinaryReader(const std::string& filename)
+        : in(filename, std::ios::binary | std::ios::ate), remaining(0), ok(false) {
+        if (in.is_open()) {
+            remaining = static_cast<std::uint64_t>(in.tellg());
+            in.seekg(0);
+            ok = true;
+        }
+    }
+
+    bool isOpen() const { return in.is_open(); }
+    bool good() const { return ok; }
+
+    template <typename T>
+    bool read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "read() needs a trivially copyable type");
+        return readBytes(&value, sizeof(T));
+    }
+
+    // Rejects counts that would run past the end of the file, so a truncated
+    // or corrupt checkpoint cannot trigger a huge allocation
+    template <typename T>
+    bool readArray(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "readArray() needs a trivially copyable type");
+        std::uint64_t count = 0;
+        if (!read(count) || count > remaining / sizeof(T)) {
+            ok = false;
+            return false;
+        }
+        values.resize(static_cast<size_t>(count));
+        return count == 0 || readBytes(values.data(), static_cast<size_t>(count) * sizeof(T));
+    }
+
+    bool expectTag(const char (&tag)[5]) {
+        char found[4];
+        if (!readBytes(found, 4) || std::memcmp(found, tag, 4) != 0) {
+            ok = false;
+        }
+        return ok;
+    }
+
+    void fail() { ok = false; }
+
+private:
+    bool readBytes(void* data, size_t size) {
+        if (!ok || size > remaining) {
+            ok = false;
+            return false;
+        }
+        in.read(static_cast<char*>(data), size);
+        if (!in) {
+            ok = false;
+            return false;
+        }
+        remaining -= size;
+        return true;
+    }
+};
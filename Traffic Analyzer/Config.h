@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 // UI Layout Constants
 namespace UIConfig {
@@ -42,6 +43,55 @@ namespace SimConfig {
     constexpr float SPAWN_INTERVAL_LOW = 2.0f;
     constexpr float SPAWN_INTERVAL_MEDIUM = 3.0f;
     constexpr float SPAWN_INTERVAL_HIGH = 5.0f;
+
+    constexpr float TICK_RATE_HZ = 60.0f;         // Fixed simulation steps per second
+    constexpr int MAX_CATCH_UP_TICKS = 5;         // Ticks per frame before dropping time
+
+    constexpr float DAY_START_HOUR = 8.0f;        // Time of day a simulation starts at
+    constexpr float FREE_FLOW_EDGES_PER_SECOND = 0.5f;  // Progress rate of a car on an empty road
+    constexpr int TIME_WARP_CALM_TICKS = 2;       // Ticks without car events before warping
+}
+
+// Mesoscopic (queue-based) engine constants
+namespace MesoConfig {
+    constexpr float JAM_SPACING_METERS = 7.5f;       // Road length occupied by one stopped car
+    constexpr float SATURATION_HEADWAY = 2.0f;       // Seconds between departures (1800 veh/h)
+    constexpr float MIN_SPEED_FRACTION = 0.1f;       // Speed floor of a full link
+    constexpr float BLOCKED_RECHECK_INTERVAL = 5.0f; // Seconds before retrying a blocked edge
+    constexpr float DEMAND_STEP_SECONDS = 1.0f;      // Events run between demand samples in headless runs
+}
+
+// Microscopic (Intelligent Driver Model) engine constants
+namespace MicroConfig {
+    constexpr float MAX_ACCELERATION = 1.5f;         // a, m/s^2
+    constexpr float COMFORTABLE_DECELERATION = 2.0f; // b, m/s^2
+    constexpr float MINIMUM_GAP = 2.0f;              // s0, m
+    constexpr float TIME_HEADWAY = 1.5f;             // T, s
+    constexpr float VEHICLE_LENGTH = 5.0f;           // m
+    constexpr float FREE_ROAD_GAP = 1000.0f;         // Gap used when nothing is ahead
+
+    constexpr int MULTI_LANE_SPEED_LIMIT = 70;       // Roads this fast get two lanes
+    constexpr float TICK_SECONDS = 0.1f;             // 10 Hz integration step
+}
+
+// Static user-equilibrium traffic assignment
+namespace AssignmentConfig {
+    constexpr double BPR_ALPHA = 0.15;               // Delay at capacity is 1 + alpha times free flow
+    constexpr int BPR_BETA = 4;
+    constexpr double LANE_CAPACITY = 1800.0;         // veh/h, one departure per saturation headway
+    constexpr int MAX_ITERATIONS = 100;
+    constexpr double TARGET_RELATIVE_GAP = 1e-4;
+    constexpr int LINE_SEARCH_STEPS = 30;            // Bisection steps for the Frank-Wolfe step size
+}
+
+// Intersection signal control
+namespace SignalConfig {
+    constexpr int MIN_APPROACHES = 3;                // Roads meeting at a node before it gets a signal
+    constexpr float FIXED_GREEN_SECONDS = 15.0f;     // Mean green per group on a fixed-time plan
+    constexpr float MIN_GREEN_SECONDS = 5.0f;
+    constexpr float MAX_GREEN_SECONDS = 30.0f;
+    constexpr float AMBER_SECONDS = 2.0f;
+    constexpr float ROUTE_DELAY_WEIGHT = 0.5f;       // Share of the expected signal delay added to route costs
 }
 
 // Rendering Constants
@@ -68,6 +118,8 @@ namespace RenderConfig {
 
     constexpr unsigned char PREDICTION_ALPHA = 180;
     constexpr unsigned char PATH_ALPHA = 180;
+
+    constexpr int STATS_REFRESH_TICKS = 15;       // Prediction/route stats refresh in snapshots
 }
 
 // Traffic Level Constants
@@ -81,7 +133,7 @@ namespace TrafficConfig {
 
 // Prediction System Constants
 namespace PredictionConfig {
-    constexpr int MAX_HISTORY_SIZE = 120;         // 2 minutes at 1 sample/second
+    constexpr float SPEED_HISTORY_HOURS = 72.0f;  // Measured speeds kept in the compressed store
     constexpr float PREDICTION_INTERVAL = 5.0f;   // Update every 5 seconds
     constexpr float PREDICTION_ALPHA = 0.3f;      // Exponential smoothing alpha
     constexpr int MOVING_AVERAGE_WINDOW = 10;
@@ -91,6 +143,33 @@ namespace PredictionConfig {
 
     constexpr float MIN_PREDICTED_SPEED = 5.0f;
     constexpr float MIN_CONFIDENCE_THRESHOLD = 0.6f;
+
+    // Kalman filter, per prediction round; speeds in km/h
+    constexpr float KALMAN_LEVEL_NOISE = 0.25f;         // Variance the speed drifts by per round
+    constexpr float KALMAN_TREND_NOISE = 0.0025f;       // Variance the trend drifts by per round
+    constexpr float KALMAN_MEASUREMENT_NOISE = 16.0f;   // Variance of one measured speed
+    constexpr float KALMAN_INITIAL_TREND_VARIANCE = 1.0f;
+    constexpr float KALMAN_TREND_DAMPING = 0.9f;        // Share of the trend kept each round
+
+    // Spatial model, fitted once per step of SPATIAL_STEP_ROUNDS rounds
+    constexpr int SPATIAL_STEP_ROUNDS = 12;             // 1 minute, so 5 and 10 steps ahead
+    constexpr float SPATIAL_FORGETTING = 0.98f;         // Per step, about an hour of memory
+    constexpr float SPATIAL_INITIAL_VARIANCE = 10.0f;
+    constexpr float SPATIAL_MIN_STEPS = 5.0f;           // Steps fitted before the model is used
+    constexpr float SPATIAL_WEIGHT = 0.5f;              // Its share of the forecast once used
+
+    // Time-of-week profile, in 15-minute bins
+    constexpr int PROFILE_MAX_DAYS = 8;                 // Days averaged per bin before newer ones take over
+    constexpr int PROFILE_MIN_DAYS = 1;                 // Days a bin needs before it is used
+    constexpr float PROFILE_WEIGHT = 0.25f;             // Its share of the forecast once used
+
+    // Incident detector, a lower CUSUM per edge over residuals in baseline deviations
+    constexpr float INCIDENT_SMOOTHING = 0.02f;         // EWMA weight of a round in the baselines
+    constexpr float INCIDENT_SLACK = 1.5f;              // Deviations a round must fall by to count
+    constexpr float INCIDENT_THRESHOLD = 5.0f;          // Accumulated deviations that raise an incident
+    constexpr float INCIDENT_MIN_DEVIATION = 0.25f;     // Floor under a baseline's standard deviation, in shares
+    constexpr int INCIDENT_WARMUP_ROUNDS = 60;          // Rounds of baseline before an edge is judged
+    constexpr float INCIDENT_HOLD_SECONDS = 300.0f;     // How long a raised incident stays
 }
 
 // Color Configuration
@@ -145,8 +224,8 @@ namespace FileConfig {
 
 // Input Constants
 namespace InputConfig {
-    constexpr sf::Uint32 BACKSPACE_KEY = 8;
-    constexpr sf::Uint32 ENTER_KEY = 13;
-    constexpr sf::Uint32 DIGIT_START = 48;
-    constexpr sf::Uint32 DIGIT_END = 57;
+    constexpr std::uint32_t BACKSPACE_KEY = 8;
+    constexpr std::uint32_t ENTER_KEY = 13;
+    constexpr std::uint32_t DIGIT_START = 48;
+    constexpr std::uint32_t DIGIT_END = 57;
 }
@@ -0,0 +1,261 @@
+#include "DemandModel.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    constexpr double SECONDS_PER_DAY = 86400.0;
+}
+
+void AliasTable::build(const std::vector<float>& weights) {
+    size_t n = weights.size();
+    probability.assign(n, 0.0f);
+    alias.assign(n, 0);
+    if (n == 0) return;
+
+    double total = 0.0;
+    for (float w : weights) total += w;
+    if (total <= 0.0) {
+        probability.clear();
+        alias.clear();
+        return;
+    }
+
+    // Scale so the average bucket is 1, then pair each underfull bucket
+    // with an overfull one that donates the rest of its probability
+    std::vector<double> scaled(n);
+    std::vector<std::uint32_t> small, large;
+    for (size_t i = 0; i < n; i++) {
+        scaled[i] = weights[i] * n / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<std::uint32_t>(i));
+    }
+
+    while (!small.empty() && !large.empty()) {
+        std::uint32_t less = small.back();
+        small.pop_back();
+        std::uint32_t more = large.back();
+
+        probability[less] = static_cast<float>(scaled[less]);
+        alias[less] = more;
+
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+
+    // Leftovers are 1 up to rounding error
+    for (std::uint32_t i : large) probability[i] = 1.0f;
+    for (std::uint32_t i : small) probability[i] = 1.0f;
+}
+
+std::uint32_t AliasTable::sample(CounterRng& rng) const {
+    std::uint32_t bucket = rng.nextInt(static_cast<std::uint32_t>(probability.size()));
+    return rng.nextFloat() < probability[bucket] ? bucket : alias[bucket];
+}
+
+DemandModel::DemandModel(const Graph& map) {
+    const auto& nodes = map.getAllNodes();
+    nodeIds.reserve(nodes.size());
+    for (const auto& pair : nodes) {
+        nodeIds.push_back(pair.first);
+    }
+    // Hash map order is not stable across builds, sorted ids keep seeded runs reproducible
+    std::sort(nodeIds.begin(), nodeIds.end());
+}
+
+bool DemandModel::loadFromFile(const std::string& filename, const Graph& map) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    std::vector<Period> loaded;
+    int skipped = 0;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        if (line.rfind("[Period", 0) == 0) {
+            Period period;
+            try {
+                period.startHour = std::stof(line.substr(7));
+            }
+            catch (const std::exception&) {
+                std::cerr << "Error: Bad period header in " << filename << ": " << line << std::endl;
+                return false;
+            }
+            if (period.startHour < 0.0f || period.startHour >= 24.0f) {
+                std::cerr << "Error: Period start must be in [0, 24) in " << filename << ": " << line << std::endl;
+                return false;
+            }
+            period.tripsPerHour = 0.0f;
+            loaded.push_back(period);
+            continue;
+        }
+
+        // Pairs before the first header belong to a period starting at midnight
+        if (loaded.empty()) {
+            Period period;
+            period.startHour = 0.0f;
+            period.tripsPerHour = 0.0f;
+            loaded.push_back(period);
+        }
+
+        std::stringstream ss(line);
+        std::string token;
+        std::vector<std::string> tokens;
+        while (std::getline(ss, token, ',')) {
+            tokens.push_back(token);
+        }
+
+        Trip trip;
+        float rate = 0.0f;
+        try {
+            if (tokens.size() < 3) throw std::invalid_argument(line);
+            trip.origin = std::stoi(tokens[0]);
+            trip.destination = std::stoi(tokens[1]);
+            rate = std::stof(tokens[2]);
+        }
+        catch (const std::exception&) {
+            std::cerr << "Error: Bad demand line in " << filename << ": " << line << std::endl;
+            return false;
+        }
+
+        if (trip.origin == trip.destination || !(rate > 0.0f) ||
+            !map.hasNode(trip.origin) || !map.hasNode(trip.destination)) {
+            skipped++;
+            continue;
+        }
+
+        loaded.back().pairs.push_back(trip);
+        loaded.back().rates.push_back(rate);
+        loaded.back().tripsPerHour += rate;
+    }
+
+    for (auto& period : loaded) {
+        period.table.build(period.rates);
+    }
+
+    // Empty periods stay, they mean no demand until the next period starts
+    std::vector<size_t> order(loaded.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return loaded[a].startHour < loaded[b].startHour; });
+
+    periods.clear();
+    periods.reserve(loaded.size());
+    for (size_t i : order) {
+        periods.push_back(std::move(loaded[i]));
+    }
+
+    std::cout << "Demand loaded from " << filename << ": " << periods.size() << " periods, "
+        << getPairCount() << " OD pairs";
+    if (skipped > 0) std::cout << " (" << skipped << " invalid pairs skipped)";
+    std::cout << std::endl;
+    return true;
+}
+
+int DemandModel::getPairCount() const {
+    size_t count = 0;
+    for (const auto& period : periods) {
+        count += period.pairs.size();
+    }
+    return static_cast<int>(count);
+}
+
+const DemandModel::Period* DemandModel::findPeriod(double timeOfDay) const {
+    if (periods.empty()) return nullptr;
+
+    double seconds = std::fmod(timeOfDay, SECONDS_PER_DAY);
+    if (seconds < 0.0) seconds += SECONDS_PER_DAY;
+    float hour = static_cast<float>(seconds / 3600.0);
+
+    // Last period starting at or before the hour; before the first one the
+    // previous day's last period is still running
+    auto it = std::upper_bound(periods.begin(), periods.end(), hour,
+        [](float h, const Period& period) { return h < period.startHour; });
+    return it == periods.begin() ? &periods.back() : &*(it - 1);
+}
+
+float DemandModel::getTripRate(double timeOfDay) const {
+    const Period* period = findPeriod(timeOfDay);
+    return period ? period->tripsPerHour : 0.0f;
+}
+
+double DemandModel::getSecondsToNextPeriod(double timeOfDay) const {
+    if (periods.size() < 2) return SECONDS_PER_DAY;
+
+    double seconds = std::fmod(timeOfDay, SECONDS_PER_DAY);
+    if (seconds < 0.0) seconds += SECONDS_PER_DAY;
+    float hour = static_cast<float>(seconds / 3600.0);
+
+    auto it = std::upper_bound(periods.begin(), periods.end(), hour,
+        [](float h, const Period& period) { return h < period.startHour; });
+    double next = it == periods.end() ? periods.front().startHour * 3600.0 + SECONDS_PER_DAY : it->startHour * 3600.0;
+    return next - seconds;
+}
+
+std::vector<DemandModel::Flow> DemandModel::getFlows(double timeOfDay) const {
+    std::vector<Flow> flows;
+    const Period* period = findPeriod(timeOfDay);
+    if (!period) return flows;
+
+    flows.reserve(period->pairs.size());
+    for (size_t i = 0; i < period->pairs.size(); i++) {
+        flows.push_back({ period->pairs[i].origin, period->pairs[i].destination, period->rates[i] });
+    }
+    return flows;
+}
+
+bool DemandModel::sampleTrip(CounterRng& rng, double timeOfDay, Trip& trip) const {
+    if (hasMatrix()) {
+        const Period* period = findPeriod(timeOfDay);
+        if (period->table.empty()) return false;
+        trip = period->pairs[period->table.sample(rng)];
+        return true;
+    }
+
+    std::uint32_t n = static_cast<std::uint32_t>(nodeIds.size());
+    if (n < 2) return false;
+
+    // Draw the destination from the other n - 1 nodes, so no retries are needed
+    std::uint32_t origin = rng.nextInt(n);
+    std::uint32_t destination = rng.nextInt(n - 1);
+    if (destination >= origin) destination++;
+
+    trip.origin = nodeIds[origin];
+    trip.destination = nodeIds[destination];
+    return true;
+}
+
+void DemandModel::sampleTrips(CounterRng& rng, double timeOfDay, int count, std::vector<Trip>& out) const {
+    if (count <= 0) return;
+    out.reserve(out.size() + count);
+
+    Trip trip;
+    for (int i = 0; i < count; i++) {
+        if (!sampleTrip(rng, timeOfDay, trip)) return;
+        out.push_back(trip);
+    }
+}
+
+int DemandModel::sampleArrivals(CounterRng& rng, double timeOfDay, float seconds, std::vector<Trip>& out) const {
+    float rate = getTripRate(timeOfDay);
+    if (rate <= 0.0f || seconds <= 0.0f) return 0;
+
+    std::poisson_distribution<int> arrivals(rate * seconds / 3600.0);
+    int count = arrivals(rng);
+
+    size_t before = out.size();
+    sampleTrips(rng, timeOfDay, count, out);
+    return static_cast<int>(out.size() - before);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "Graph.h"
+#include "Random.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Walker/Vose alias table: O(n) build, O(1) weighted sampling
+class AliasTable {
+private:
+    std::vector<float> probability;
+    std::vector<std::uint32_t> alias;
+
+public:
+    void build(const std::vector<float>& weights);
+    std::uint32_t sample(CounterRng& rng) const;
+
+    bool empty() const { return probability.empty(); }
+    size_t size() const { return probability.size(); }
+};
+
+// Origin-destination travel demand. Without a matrix, trips connect two
+// distinct nodes chosen uniformly. A loaded matrix is a list of time-of-day
+// periods, each a sparse set of OD pairs with trip rates, sampled through
+// one alias table per period. The model copies the node ids it needs when it
+// is built, so it never touches the graph again and can be shared read-only
+// between simulations of the same map.
+//
+// Demand file format:
+//   # comment
+//   [Period 7]                   start hour of a period, runs to the next one
+//   origin,destination,tripsPerHour
+class DemandModel {
+public:
+    struct Trip {
+        int origin;
+        int destination;
+    };
+
+    struct Flow {
+        int origin;
+        int destination;
+        float tripsPerHour;
+    };
+
+private:
+    struct Period {
+        float startHour;
+        float tripsPerHour;              // Sum over all pairs
+        std::vector<Trip> pairs;
+        std::vector<float> rates;        // Trips per hour of each pair
+        AliasTable table;
+    };
+
+    std::vector<int> nodeIds;            // Dense node index for uniform trips
+    std::vector<Period> periods;         // Sorted by start hour, wraps around midnight
+
+public:
+    explicit DemandModel(const Graph& map);
+
+    // Pairs with unknown nodes, identical ends or non-positive rates are skipped
+    bool loadFromFile(const std::string& filename, const Graph& map);
+    void clearMatrix() { periods.clear(); }
+
+    bool hasMatrix() const { return !periods.empty(); }
+    int getPeriodCount() const { return static_cast<int>(periods.size()); }
+    int getPairCount() const;
+
+    // Total trips per hour at a time of day, 0 without a matrix
+    float getTripRate(double timeOfDay) const;
+
+    // Seconds until the next period starts, a whole day with one period or none
+    double getSecondsToNextPeriod(double timeOfDay) const;
+
+    // The OD pairs of the period running at a time of day, empty without a matrix
+    std::vector<Flow> getFlows(double timeOfDay) const;
+
+    // Times of day are seconds since midnight
+    bool sampleTrip(CounterRng& rng, double timeOfDay, Trip& trip) const;
+
+    // Append count trips to out
+    void sampleTrips(CounterRng& rng, double timeOfDay, int count, std::vector<Trip>& out) const;
+
+    // Append the trips starting within the next seconds (Poisson arrivals at
+    // the matrix rate); returns how many were added
+    int sampleArrivals(CounterRng& rng, double timeOfDay, float seconds, std::vector<Trip>& out) const;
+
+private:
+    const Period* findPeriod(double timeOfDay) const;
+};
@@ -0,0 +1,163 @@
+#include "EdgeHistoryMatrix.h"
+#include <algorithm>
+
+EdgeHistoryMatrix::EdgeHistoryMatrix(int capacity, int window, float alpha)
+    : capacity(static_cast<size_t>(std::max(1, capacity))),
+    window(static_cast<size_t>(std::max(1, window))), alpha(alpha), rowsInUse(0) {
+}
+
+EdgeHistoryMatrix::EdgeHistoryMatrix(int capacity)
+    : EdgeHistoryMatrix(capacity, capacity, 1.0f) {
+}
+
+void EdgeHistoryMatrix::resize(size_t rowCount) {
+    rows.assign(rowCount, RowState());
+    values.assign(rowCount * capacity, 0.0f);
+    rowsInUse = 0;
+}
+
+void EdgeHistoryMatrix::clearRow(size_t row) {
+    if (rows[row].count > 0) rowsInUse--;
+    rows[row] = RowState();
+}
+
+void EdgeHistoryMatrix::push(size_t row, float value) {
+    if (rows[row].count == 0) rowsInUse++;
+    pushValue(row, value);
+}
+
+void EdgeHistoryMatrix::pushAll(const float* rowValues) {
+    size_t rowCount = rows.size();
+    for (size_t row = 0; row < rowCount; row++) {
+        pushValue(row, rowValues[row]);
+    }
+    rowsInUse = rowCount;
+}
+
+void EdgeHistoryMatrix::pushValue(size_t row, float value) {
+    RowState& state = rows[row];
+    float* ring = &values[row * capacity];
+    size_t count = state.count;
+    size_t span = std::min(window, capacity);
+
+    state.smoothed = count == 0 ? value : alpha * value + (1 - alpha) * state.smoothed;
+
+    // The value leaving the moving-average window, read before it is overwritten
+    if (count >= span) {
+        state.windowSum -= at(row, static_cast<int>(count - span));
+    }
+    state.windowSum += value;
+
+    if (count == capacity) {
+        // Every weight drops by one, which removes the oldest value entirely
+        float oldest = ring[state.head];
+        state.weightedSum += capacity * static_cast<double>(value) - state.sum;
+        state.sum += static_cast<double>(value) - oldest;
+
+        double oldMean = state.mean;
+        state.mean += (static_cast<double>(value) - oldest) / count;
+        state.m2 += (static_cast<double>(value) - oldest) * (value - state.mean + oldest - oldMean);
+    }
+    else {
+        state.weightedSum += (count + 1) * static_cast<double>(value);
+        state.sum += value;
+
+        double delta = value - state.mean;
+        state.mean += delta / (count + 1);
+        state.m2 += delta * (value - state.mean);
+        state.count++;
+    }
+
+    ring[state.head] = value;
+    state.head = static_cast<std::uint32_t>((state.head + 1) % capacity);
+
+    if (state.count == capacity && state.head == 0) {
+        rebuild(row);
+    }
+}
+
+float EdgeHistoryMatrix::movingAverage(size_t row) const {
+    const RowState& state = rows[row];
+    if (state.count == 0) return 0.0f;
+    size_t span = std::min<size_t>(std::min(window, capacity), state.count);
+    return static_cast<float>(state.windowSum / span);
+}
+
+float EdgeHistoryMatrix::weightedAverage(size_t row) const {
+    const RowState& state = rows[row];
+    if (state.count == 0) return 0.0f;
+    double n = state.count;
+    return static_cast<float>(state.weightedSum / (n * (n + 1.0) / 2.0));
+}
+
+float EdgeHistoryMatrix::variance(size_t row) const {
+    const RowState& state = rows[row];
+    if (state.count == 0) return 0.0f;
+    return static_cast<float>(std::max(0.0, state.m2 / state.count));
+}
+
+void EdgeHistoryMatrix::linearFit(size_t row, float& slope, float& intercept) const {
+    const RowState& state = rows[row];
+    double n = state.count;
+    if (state.count < 2) {
+        slope = 0.0f;
+        intercept = static_cast<float>(state.mean);
+        return;
+    }
+
+    // The weights run 1..n, so sum(x * y) over x = 0..n-1 is weightedSum - sum
+    double sumX = n * (n - 1.0) / 2.0;
+    double sumX2 = (n - 1.0) * n * (2.0 * n - 1.0) / 6.0;
+    double sumXY = state.weightedSum - state.sum;
+    double m = (n * sumXY - sumX * state.sum) / (n * sumX2 - sumX * sumX);
+    slope = static_cast<float>(m);
+    intercept = static_cast<float>((state.sum - m * sumX) / n);
+}
+
+void EdgeHistoryMatrix::appendRow(size_t row, std::vector<float>& out) const {
+    for (int i = 0; i < size(row); i++) {
+        out.push_back(at(row, i));
+    }
+}
+
+void EdgeHistoryMatrix::assignRow(size_t row, const float* data, size_t count) {
+    RowState& state = rows[row];
+    if (state.count > 0) rowsInUse--;
+    state = RowState();
+
+    // Only the newest values fit
+    size_t skip = count > capacity ? count - capacity : 0;
+    float* ring = &values[row * capacity];
+    for (size_t i = skip; i < count; i++) {
+        ring[state.count] = data[i];
+        state.smoothed = state.count == 0 ? data[i] : alpha * data[i] + (1 - alpha) * state.smoothed;
+        state.count++;
+    }
+    state.head = static_cast<std::uint32_t>(state.count % capacity);
+    if (state.count > 0) rowsInUse++;
+    rebuild(row);
+}
+
+// Exact sums from the ring, oldest first
+void EdgeHistoryMatrix::rebuild(size_t row) {
+    RowState& state = rows[row];
+    size_t count = state.count;
+    size_t span = std::min(window, capacity);
+
+    state.sum = 0.0;
+    state.weightedSum = 0.0;
+    state.windowSum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double value = at(row, static_cast<int>(i));
+        state.sum += value;
+        state.weightedSum += (i + 1) * value;
+        if (i + span >= count) state.windowSum += value;
+    }
+
+    state.mean = count > 0 ? state.sum / count : 0.0;
+    state.m2 = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double deviation = at(row, static_cast<int>(i)) - state.mean;
+        state.m2 += deviation * deviation;
+    }
+}
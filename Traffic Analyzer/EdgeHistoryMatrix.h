@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-capacity history of one value per edge, stored as a single
+// [rows x capacity] float matrix with one ring buffer per row. Every push
+// updates the row's running sums, so the moving averages, the exponential
+// average, the variance and the least-squares trend are O(1) reads. Sums are
+// rebuilt from the ring each time it wraps, which keeps float drift bounded
+// at O(1) amortised cost.
+class EdgeHistoryMatrix {
+private:
+    struct RowState {
+        std::uint32_t head = 0;          // Slot the next value goes to
+        std::uint32_t count = 0;
+        double sum = 0.0;                // All values in the ring
+        double weightedSum = 0.0;        // Oldest value weighted 1, newest count
+        double windowSum = 0.0;          // Newest min(window, capacity) values
+        double mean = 0.0;               // Welford
+        double m2 = 0.0;
+        float smoothed = 0.0f;           // Exponential average since the first push
+    };
+
+    size_t capacity;
+    size_t window;
+    float alpha;
+    std::vector<float> values;
+    std::vector<RowState> rows;
+    size_t rowsInUse;
+
+public:
+    // window: length of movingAverage(); alpha: weight of the newest value in smoothed()
+    EdgeHistoryMatrix(int capacity, int window, float alpha);
+    // Averages over the whole ring; smoothed() is the newest value
+    explicit EdgeHistoryMatrix(int capacity);
+
+    // Drops all values
+    void resize(size_t rowCount);
+    size_t getRowCount() const { return rows.size(); }
+    int getCapacity() const { return static_cast<int>(capacity); }
+
+    size_t getRowsInUse() const { return rowsInUse; }   // Rows holding at least one value
+
+    void push(size_t row, float value);
+    void pushAll(const float* rowValues);                // One value per row
+    void clearRow(size_t row);
+
+    int size(size_t row) const { return static_cast<int>(rows[row].count); }
+    bool empty(size_t row) const { return rows[row].count == 0; }
+
+    // Chronological access, 0 = oldest
+    float at(size_t row, int index) const {
+        const RowState& state = rows[row];
+        size_t slot = (state.head + capacity - state.count + static_cast<size_t>(index)) % capacity;
+        return values[row * capacity + slot];
+    }
+    float back(size_t row) const { return at(row, size(row) - 1); }
+
+    // All statistics are 0 for an empty row
+    float movingAverage(size_t row) const;
+    float weightedAverage(size_t row) const;   // Linear weights, newest heaviest
+    float smoothed(size_t row) const { return rows[row].smoothed; }
+    float mean(size_t row) const { return static_cast<float>(rows[row].mean); }
+    float variance(size_t row) const;          // Population variance
+
+    // Least-squares line through the ring at x = 0 (oldest) .. size - 1;
+    // flat through the mean with fewer than two values
+    void linearFit(size_t row, float& slope, float& intercept) const;
+
+    // Checkpointing: values oldest first. The exponential average restarts
+    // from the restored values.
+    void appendRow(size_t row, std::vector<float>& out) const;
+    void assignRow(size_t row, const float* data, size_t count);
+
+private:
+    void pushValue(size_t row, float value);
+    void rebuild(size_t row);
+};
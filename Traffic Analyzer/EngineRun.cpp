@@ -0,0 +1,107 @@
+#include "EngineRun.h"
+#include "MesoscopicSimulation.h"
+#include "MicroscopicSimulation.h"
+#include "Config.h"
+#include <chrono>
+#include <cmath>
+
+EngineRun::EngineRun(const Graph& map, TrafficEngine engine, const HeadlessOptions& options)
+    : cityMap(map), engine(engine), options(options),
+    // Same derivation as HeadlessSimulation's car stream, so a seed means the same demand draw
+    randomGen(CounterRng(options.seed).split(options.stream).split(1)()) {
+}
+
+EngineMetrics EngineRun::run() {
+    switch (engine) {
+    case TrafficEngine::MESOSCOPIC:
+        return runMesoscopic();
+    case TrafficEngine::MICROSCOPIC:
+        return runMicroscopic();
+    default:
+        return EngineMetrics();
+    }
+}
+
+template <typename Simulation>
+void EngineRun::addDemandTrips(Simulation& simulation, double elapsedSeconds, float seconds,
+    EngineMetrics& metrics) {
+    double timeOfDay = std::fmod(options.startHour * 3600.0 + elapsedSeconds, 86400.0);
+
+    pendingTrips.clear();
+    options.demand->sampleArrivals(randomGen, timeOfDay, seconds, pendingTrips);
+
+    for (const auto& trip : pendingTrips) {
+        std::vector<int> route = cityMap.findShortestPath(trip.origin, trip.destination);
+        if (simulation.addTrip(trip.origin, trip.destination, route)) {
+            metrics.tripsStarted++;
+        }
+        else {
+            metrics.unroutedTrips++;
+        }
+    }
+}
+
+EngineMetrics EngineRun::runMesoscopic() {
+    EngineMetrics metrics;
+    MesoscopicSimulation simulation(cityMap);
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    const float step = MesoConfig::DEMAND_STEP_SECONDS;
+    long long totalSteps = std::llround(options.simulatedHours * 3600.0 / step);
+    for (long long i = 0; i < totalSteps; i++) {
+        double elapsed = static_cast<double>(i) * step;
+        addDemandTrips(simulation, elapsed, step, metrics);
+        simulation.runUntil(static_cast<float>(elapsed + step));
+    }
+
+    metrics.wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    metrics.simulatedSeconds = static_cast<double>(totalSteps) * step;
+    metrics.ticks = totalSteps;
+    metrics.transitions = simulation.getLinkTransitions();
+    metrics.completedTrips = simulation.getCompletedTrips();
+    metrics.finalVehicles = simulation.getVehicleCount();
+    metrics.averageTripTime = simulation.getAverageTripTime();
+    return metrics;
+}
+
+EngineMetrics EngineRun::runMicroscopic() {
+    EngineMetrics metrics;
+    MicroscopicSimulation simulation(cityMap);
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    const float step = MicroConfig::TICK_SECONDS;
+    long long totalSteps = std::llround(options.simulatedHours * 3600.0 / step);
+    for (long long i = 0; i < totalSteps; i++) {
+        addDemandTrips(simulation, static_cast<double>(i) * step, step, metrics);
+        simulation.step(step);
+    }
+
+    metrics.wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    metrics.simulatedSeconds = static_cast<double>(totalSteps) * step;
+    metrics.ticks = totalSteps;
+    metrics.transitions = simulation.getLinkTransitions();
+    metrics.completedTrips = simulation.getCompletedTrips();
+    metrics.finalVehicles = simulation.getVehicleCount();
+    metrics.averageTripTime = simulation.getAverageTripTime();
+    return metrics;
+}
+
+void EngineRun::writeMetrics(const EngineMetrics& metrics, std::ostream& out) {
+    out << "metric,value\n";
+    out << "simulated_seconds," << metrics.simulatedSeconds << "\n";
+    out << "wall_seconds," << metrics.wallSeconds << "\n";
+    out << "speedup," << metrics.getSpeedup() << "\n";
+    out << "ticks," << metrics.ticks << "\n";
+    out << "ticks_per_second," << metrics.getTicksPerSecond() << "\n";
+    out << "transitions," << metrics.transitions << "\n";
+    out << "transitions_per_second," << metrics.getTransitionsPerSecond() << "\n";
+    out << "trips_started," << metrics.tripsStarted << "\n";
+    out << "unrouted_trips," << metrics.unroutedTrips << "\n";
+    out << "completed_trips," << metrics.completedTrips << "\n";
+    out << "final_vehicles," << metrics.finalVehicles << "\n";
+    out << "average_trip_time," << metrics.averageTripTime << "\n";
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Graph.h"
+#include "HeadlessSimulation.h"
+#include "DemandModel.h"
+#include "Random.h"
+#include <ostream>
+#include <vector>
+
+// Traffic model behind a headless run. AGENT is CarSimulation, driven by
+// HeadlessSimulation with prediction, signals and accidents; the others only
+// move the demand's trips, so their rates measure the engine alone.
+enum class TrafficEngine {
+    AGENT,
+    MESOSCOPIC,
+    MICROSCOPIC
+};
+
+struct EngineMetrics {
+    double simulatedSeconds = 0.0;
+    double wallSeconds = 0.0;
+    long long ticks = 0;                 // Demand steps, one per engine timestep
+    long long transitions = 0;           // Vehicles entering a link, including the first one
+    long long tripsStarted = 0;
+    long long unroutedTrips = 0;         // Demand trips without a path
+    long long completedTrips = 0;
+    int finalVehicles = 0;
+    float averageTripTime = 0.0f;
+
+    double getSpeedup() const { return wallSeconds > 0.0 ? simulatedSeconds / wallSeconds : 0.0; }
+    double getTicksPerSecond() const { return wallSeconds > 0.0 ? ticks / wallSeconds : 0.0; }
+    double getTransitionsPerSecond() const { return wallSeconds > 0.0 ? transitions / wallSeconds : 0.0; }
+};
+
+// Runs the OD demand of options.demand through MesoscopicSimulation or
+// MicroscopicSimulation for options.simulatedHours. Every step samples the
+// arrivals of its interval and routes each trip on the shortest path, as
+// CarSimulation would.
+class EngineRun {
+private:
+    const Graph& cityMap;
+    TrafficEngine engine;
+    HeadlessOptions options;
+
+    CounterRng randomGen;
+    std::vector<DemandModel::Trip> pendingTrips;
+
+public:
+    EngineRun(const Graph& map, TrafficEngine engine, const HeadlessOptions& options);
+
+    EngineMetrics run();
+
+    // Key/value CSV, one metric per line
+    static void writeMetrics(const EngineMetrics& metrics, std::ostream& out);
+
+private:
+    template <typename Simulation>
+    void addDemandTrips(Simulation& simulation, double elapsedSeconds, float seconds, EngineMetrics& metrics);
+
+    EngineMetrics runMesoscopic();
+    EngineMetrics runMicroscopic();
+};
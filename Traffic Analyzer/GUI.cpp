@@ -11,33 +11,39 @@
 #include <cstdlib>
 #include <iomanip>
 #include <ctime>
+#include <unordered_map>
 
 // Constructor
 GUI::GUI(Graph& map)
-    : cityMap(map),
-    window(sf::VideoMode(
+    : window(sf::VideoMode(
         static_cast<unsigned int>(UIConfig::WINDOW_WIDTH),
         static_cast<unsigned int>(UIConfig::WINDOW_HEIGHT)
     ), "Traffic Analysis System"),
+    cityMap(map),
+    sourceActive(false),
+    destActive(false),
+    carSim(nullptr),
+    showPredictions(false),
+    predictedCongestionColor(ColorConfig::PREDICTED_CONGESTION_R, 
+                            ColorConfig::PREDICTED_CONGESTION_G, 
+                            ColorConfig::PREDICTED_CONGESTION_B),
     zoomLevel(1.0f),
     viewOffset(0.0f, 0.0f),
     isDragging(false),
     selectedStartNode(-1),
     selectedEndNode(-1),
-    sourceActive(false),
-    destActive(false),
-    carSim(nullptr),
-    showCars(true),
-    simulationSpeed(SimConfig::DEFAULT_SIMULATION_SPEED),
-    totalCarsSpawned(0),
     freeFlowColor(ColorConfig::FREE_FLOW_R, ColorConfig::FREE_FLOW_G, ColorConfig::FREE_FLOW_B),
     slowColor(ColorConfig::SLOW_R, ColorConfig::SLOW_G, ColorConfig::SLOW_B),
     congestedColor(ColorConfig::CONGESTED_R, ColorConfig::CONGESTED_G, ColorConfig::CONGESTED_B),
     blockedColor(ColorConfig::BLOCKED_R, ColorConfig::BLOCKED_G, ColorConfig::BLOCKED_B),
-    showPredictions(false),
-    predictedCongestionColor(ColorConfig::PREDICTED_CONGESTION_R, 
-                            ColorConfig::PREDICTED_CONGESTION_G, 
-                            ColorConfig::PREDICTED_CONGESTION_B)
+    showCars(true),
+    simulationSpeed(SimConfig::DEFAULT_SIMULATION_SPEED),
+    totalCarsSpawned(0),
+    simulationRunning(false),
+    statsRefreshCountdown(0),
+    cachedRouteStart(-1),
+    cachedRouteEnd(-1),
+    cachedRouteTime(-1.0f)
 {
     std::cout << "Initializing GUI..." << std::endl;
 
@@ -46,22 +52,28 @@ GUI::GUI(Graph& map)
     initializeSystems();
     initializeUI();
 
+    // First frame comes from here, the simulation thread takes over afterwards
+    publishSnapshot();
+    snapshots.acquire();
+    updateStatistics(snapshots.front());
+    startSimulationThread();
+
     std::cout << "GUI initialization complete!" << std::endl;
 }
 
 GUI::~GUI() {
+    stopSimulationThread();
+
     delete carSim;
+    delete signalSystem;
     delete accidentSystem;
     delete predictionSystem;
 }
 
 void GUI::run() {
-    sf::Clock clock;
     bool needsForceRedraw = false;  
 
     while (window.isOpen()) {
-        float deltaTime = clock.restart().asSeconds();
-
         handleEvents();
         update();
         render();
@@ -74,17 +86,77 @@ void GUI::run() {
     }
 }
 
+void GUI::startSimulationThread() {
+    simulationRunning = true;
+    simulationThread = std::thread(&GUI::simulationLoop, this);
+}
+
+void GUI::stopSimulationThread() {
+    simulationRunning = false;
+    if (simulationThread.joinable()) {
+        simulationThread.join();
+    }
+}
+
+void GUI::simulationLoop() {
+    auto lastTime = std::chrono::steady_clock::now();
+
+    while (simulationRunning) {
+        auto now = std::chrono::steady_clock::now();
+        float frameTime = std::chrono::duration<float>(now - lastTime).count();
+        lastTime = now;
+
+        bool changed = runPendingCommands();
+
+        // Fixed-rate simulation ticks, independent of the render frame rate
+        int ticks = simulationClock.advance(frameTime);
+        for (int i = 0; i < ticks; i++) {
+            updateSimulation(simulationClock.getTickDuration());
+        }
+
+        if (ticks > 0 || changed) {
+            publishSnapshot();
+        }
+
+        // Sleep until the next tick is due
+        float untilNextTick = (1.0f - simulationClock.getInterpolationAlpha()) *
+            simulationClock.getTickDuration();
+        std::this_thread::sleep_for(std::chrono::duration<float>(untilNextTick));
+    }
+}
+
+// Runs on the simulation thread
 void GUI::updateSimulation(float deltaTime) {
     if (carSim) {
         carSim->update(deltaTime);
     }
+    if (accidentSystem) {
+        accidentSystem->update(deltaTime);
+    }
+    if (predictionSystem) {
+        predictionSystem->update(deltaTime);
+    }
+    cityMap.updateAccidents(deltaTime);
+}
+
+void GUI::enqueueCommand(std::function<void()> command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pendingCommands.push_back(std::move(command));
+}
 
-    updateStatistics(
-        cityMap.getNodeCount(),
-        cityMap.getEdgeCount(),
-        carSim ? carSim->getVehicleCount() : 0,
-        45.5f * simulationSpeed
-    );
+bool GUI::runPendingCommands() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        executingCommands.swap(pendingCommands);
+    }
+
+    if (executingCommands.empty()) return false;
+
+    for (auto& command : executingCommands) {
+        command();
+    }
+    executingCommands.clear();
+    return true;
 }
 
 void GUI::handleEvents() {
@@ -150,18 +222,11 @@ void GUI::handleEvents() {
 }
 
 void GUI::update() {
-    updateSimulation(1.0f / 60.0f);
-
-
-    if (accidentSystem) {
-        accidentSystem->update(1.0f / 60.0f);
+    if (snapshots.acquire()) {
+        updateStatistics(snapshots.front());
     }
-    if (predictionSystem) {
-        predictionSystem->update(1.0f / 60.0f);
-    }
-    cityMap.updateAccidents(1.0f / 60.0f); 
 
-    updateAccidentVisuals();
+    updateAccidentVisuals(snapshots.front());
 
     // Update button states
     sf::Vector2f mousePos = window.mapPixelToCoords(sf::Mouse::getPosition(window));
@@ -199,7 +264,7 @@ void GUI::render() {
         400.0f / zoomLevel + viewOffset.y));
     window.setView(mapView);
 
-    drawMap();
+    drawMap(snapshots.front());
 
     window.setView(window.getDefaultView());
     drawControlPanel();
@@ -309,35 +374,98 @@ void GUI::drawControlPanel() {
 }
 
 
-void GUI::drawMap() {
-    auto edges = cityMap.getAllEdges();
-    for (const auto& pair : edges) {
-        drawEdge(pair.second);
+void GUI::drawMap(const SimulationSnapshot& snapshot) {
+    for (const auto& edge : snapshot.edges) {
+        drawEdge(edge);
     }
 
-    drawPredictions();
-    drawPath();
+    drawPredictions(snapshot);
+    drawPath(snapshot);
 
     for (const auto& icon : accidentIcons) {
         window.draw(icon);
     }
 
-    auto nodes = cityMap.getAllNodes();
-    for (const auto& pair : nodes) {
-        bool isSelected = (pair.first == selectedStartNode || pair.first == selectedEndNode);
-        drawNode(pair.second, isSelected);
+    for (const auto& node : snapshot.nodes) {
+        bool isSelected = (node.id == selectedStartNode || node.id == selectedEndNode);
+        drawNode(node, isSelected);
     }
 
-    drawCars();
+    drawSignals(snapshot);
+    drawCars(snapshot);
 }
 
-void GUI::drawCars() {
-    if (carSim && showCars) {
-        carSim->draw(window, zoomLevel, viewOffset);
+void GUI::drawCars(const SimulationSnapshot& snapshot) {
+    if (!showCars) return;
+
+    // Blend between the last two ticks by how far we are into the next one
+    float alpha = 1.0f;
+    if (snapshot.tickDuration > 0.0f) {
+        float sincePublish = std::chrono::duration<float>(
+            std::chrono::steady_clock::now() - snapshot.publishedAt).count();
+        alpha = std::clamp(sincePublish / snapshot.tickDuration, 0.0f, 1.0f);
+    }
+
+    for (const auto& car : snapshot.cars) {
+        float x = car.prevX + (car.x - car.prevX) * alpha;
+        float y = car.prevY + (car.y - car.prevY) * alpha;
+
+        float screenX = x * zoomLevel + viewOffset.x;
+        float screenY = y * zoomLevel + viewOffset.y;
+
+        sf::ConvexShape triangle(3);
+        triangle.setPoint(0, sf::Vector2f(0, -8.0f * zoomLevel));
+        triangle.setPoint(1, sf::Vector2f(-5.0f * zoomLevel, 5.0f * zoomLevel));
+        triangle.setPoint(2, sf::Vector2f(5.0f * zoomLevel, 5.0f * zoomLevel));
+
+        triangle.setFillColor(sf::Color(car.color));
+        triangle.setOutlineColor(sf::Color::White);
+        triangle.setOutlineThickness(1.0f * zoomLevel);
+        triangle.setPosition(screenX, screenY);
+        triangle.setRotation(car.angle);
+
+        window.draw(triangle);
+    }
+}
+
+// One lamp per approach group beside the node: group A left and right of it,
+// group B above and below
+void GUI::drawSignals(const SimulationSnapshot& snapshot) {
+    auto lightColor = [this](SimulationSnapshot::Light light) {
+        switch (light) {
+        case SimulationSnapshot::Light::GREEN: return freeFlowColor;
+        case SimulationSnapshot::Light::AMBER: return slowColor;
+        default: return congestedColor;
+        }
+    };
+
+    float size = 4.0f * zoomLevel;
+    float offset = 11.0f * zoomLevel;
+
+    sf::RectangleShape lamp(sf::Vector2f(size, size));
+    lamp.setOrigin(size / 2, size / 2);
+    lamp.setOutlineColor(sf::Color::Black);
+    lamp.setOutlineThickness(0.5f * zoomLevel);
+
+    for (const auto& signal : snapshot.signals) {
+        float screenX = signal.x * zoomLevel + viewOffset.x;
+        float screenY = signal.y * zoomLevel + viewOffset.y;
+
+        lamp.setFillColor(lightColor(signal.groupA));
+        lamp.setPosition(screenX - offset, screenY);
+        window.draw(lamp);
+        lamp.setPosition(screenX + offset, screenY);
+        window.draw(lamp);
+
+        lamp.setFillColor(lightColor(signal.groupB));
+        lamp.setPosition(screenX, screenY - offset);
+        window.draw(lamp);
+        lamp.setPosition(screenX, screenY + offset);
+        window.draw(lamp);
     }
 }
 
-void GUI::drawNode(const Node& node, bool isSelected) {
+void GUI::drawNode(const SimulationSnapshot::NodeState& node, bool isSelected) {
     float screenX = node.x * zoomLevel + viewOffset.x;
     float screenY = node.y * zoomLevel + viewOffset.y;
 
@@ -372,16 +500,11 @@ void GUI::drawNode(const Node& node, bool isSelected) {
     window.draw(idText);
 }
 
-void GUI::drawEdge(const Edge& edge) {
-    Node fromNode = cityMap.getNode(edge.fromNodeId);
-    Node toNode = cityMap.getNode(edge.toNodeId);
-
-    if (fromNode.id == -1 || toNode.id == -1) return;
-
-    float fromX = fromNode.x * zoomLevel + viewOffset.x;
-    float fromY = fromNode.y * zoomLevel + viewOffset.y;
-    float toX = toNode.x * zoomLevel + viewOffset.x;
-    float toY = toNode.y * zoomLevel + viewOffset.y;
+void GUI::drawEdge(const SimulationSnapshot::EdgeState& edge) {
+    float fromX = edge.fromX * zoomLevel + viewOffset.x;
+    float fromY = edge.fromY * zoomLevel + viewOffset.y;
+    float toX = edge.toX * zoomLevel + viewOffset.x;
+    float toY = edge.toY * zoomLevel + viewOffset.y;
 
     sf::Color roadColor;
     float roadWidth = 3.0f * zoomLevel; 
@@ -394,8 +517,10 @@ void GUI::drawEdge(const Edge& edge) {
     default: roadColor = sf::Color::White;
     }
 
-    if (edge.isBlocked && accidentSystem) {
-        roadColor = accidentSystem->getEdgeColorWithAccident(edge.id, roadColor);
+    if (edge.isBlocked) {
+        if (edge.hasAccident) {
+            roadColor = edge.accidentBlinkOn ? sf::Color(255, 50, 50) : sf::Color(150, 0, 0);
+        }
 
         roadWidth = 5.0f * zoomLevel;
     }
@@ -417,14 +542,13 @@ void GUI::drawEdge(const Edge& edge) {
     window.draw(road);
 }
 
-void GUI::drawPath() {
-    if (currentPath.size() < 2) return;
-
-    for (size_t i = 0; i < currentPath.size() - 1; i++) {
-        Node fromNode = cityMap.getNode(currentPath[i]);
-        Node toNode = cityMap.getNode(currentPath[i + 1]);
+void GUI::drawPath(const SimulationSnapshot& snapshot) {
+    const auto& path = snapshot.path;
+    if (path.size() < 2) return;
 
-        if (fromNode.id == -1 || toNode.id == -1) continue;
+    for (size_t i = 0; i < path.size() - 1; i++) {
+        const auto& fromNode = path[i];
+        const auto& toNode = path[i + 1];
 
         float fromX = fromNode.x * zoomLevel + viewOffset.x;
         float fromY = fromNode.y * zoomLevel + viewOffset.y;
@@ -449,24 +573,16 @@ void GUI::drawPath() {
 }
 
 
-void GUI::drawPredictions() {
-    if (!predictionSystem || !showPredictions) return;
+void GUI::drawPredictions(const SimulationSnapshot& snapshot) {
+    if (!showPredictions) return;
 
-    auto congestedEdges = predictionSystem->getEdgesLikelyToCongest(5);
+    for (int edgeIndex : snapshot.predictedCongestion) {
+        const auto& edge = snapshot.edges[edgeIndex];
 
-    for (int edgeId : congestedEdges) {
-        Edge edge = cityMap.getEdge(edgeId);
-        if (edge.id == -1) continue;
-
-        Node fromNode = cityMap.getNode(edge.fromNodeId);
-        Node toNode = cityMap.getNode(edge.toNodeId);
-
-        if (fromNode.id == -1 || toNode.id == -1) continue;
-
-        float fromX = fromNode.x * zoomLevel + viewOffset.x;
-        float fromY = fromNode.y * zoomLevel + viewOffset.y;
-        float toX = toNode.x * zoomLevel + viewOffset.x;
-        float toY = toNode.y * zoomLevel + viewOffset.y;
+        float fromX = edge.fromX * zoomLevel + viewOffset.x;
+        float fromY = edge.fromY * zoomLevel + viewOffset.y;
+        float toX = edge.toX * zoomLevel + viewOffset.x;
+        float toY = edge.toY * zoomLevel + viewOffset.y;
 
         // Draw prediction overlay
         sf::Vector2f direction(toX - fromX, toY - fromY);
@@ -497,30 +613,35 @@ void GUI::handleMouseClick(int x, int y) {
 }
 
 void GUI::handleButtonClick(const sf::Vector2f& screenPos) {
+    int start = selectedStartNode;
+    int end = selectedEndNode;
+
     // Find Path button
     if (findRouteBtn.shape.getGlobalBounds().contains(screenPos)) {
-        std::cout << "Find Path clicked - Finding route from " << selectedStartNode
-            << " to " << selectedEndNode << std::endl;
-
-        if (selectedStartNode != -1 && selectedEndNode != -1) {
-            currentPath = cityMap.findShortestPath(selectedStartNode, selectedEndNode);
-
-            if (!currentPath.empty()) {
-                std::cout << "Path found with " << currentPath.size() << " nodes" << std::endl;
-
-                // Calculate and display travel time
-                float totalTime = 0.0f;
-                for (size_t i = 0; i < currentPath.size() - 1; i++) {
-                    int edgeId = cityMap.findEdgeId(currentPath[i], currentPath[i + 1]);
-                    if (edgeId != -1) {
-                        totalTime += cityMap.getEdge(edgeId).currentTravelTime;
+        std::cout << "Find Path clicked - Finding route from " << start
+            << " to " << end << std::endl;
+
+        if (start != -1 && end != -1) {
+            enqueueCommand([this, start, end]() {
+                currentPath = cityMap.findShortestPath(start, end);
+
+                if (!currentPath.empty()) {
+                    std::cout << "Path found with " << currentPath.size() << " nodes" << std::endl;
+
+                    // Calculate and display travel time
+                    float totalTime = 0.0f;
+                    for (size_t i = 0; i < currentPath.size() - 1; i++) {
+                        int edgeId = cityMap.findEdgeId(currentPath[i], currentPath[i + 1]);
+                        if (edgeId != -1) {
+                            totalTime += cityMap.getEdge(edgeId).currentTravelTime;
+                        }
                     }
+                    std::cout << "Estimated travel time: " << totalTime << " minutes" << std::endl;
                 }
-                std::cout << "Estimated travel time: " << totalTime << " minutes" << std::endl;
-            }
-            else {
-                std::cout << "No path found between nodes!" << std::endl;
-            }
+                else {
+                    std::cout << "No path found between nodes!" << std::endl;
+                }
+            });
         }
         else {
             std::cout << "Please select both source and destination nodes first!" << std::endl;
@@ -531,13 +652,15 @@ void GUI::handleButtonClick(const sf::Vector2f& screenPos) {
     else if (addCarBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Add Car clicked" << std::endl;
 
-        if (selectedStartNode != -1 && selectedEndNode != -1) {
-            std::vector<int> path = cityMap.findShortestPath(selectedStartNode, selectedEndNode);
-            if (!path.empty() && carSim) {
-                carSim->addCar(selectedStartNode, selectedEndNode, path);
-                totalCarsSpawned++;
-                std::cout << "Car added! Total cars: " << carSim->getVehicleCount() << std::endl;
-            }
+        if (start != -1 && end != -1) {
+            enqueueCommand([this, start, end]() {
+                std::vector<int> path = cityMap.findShortestPath(start, end);
+                if (!path.empty() && carSim) {
+                    carSim->addCar(start, end, path);
+                    totalCarsSpawned++;
+                    std::cout << "Car added! Total cars: " << carSim->getVehicleCount() << std::endl;
+                }
+            });
         }
         else {
             std::cout << "Please select both source and destination nodes first!" << std::endl;
@@ -548,222 +671,161 @@ void GUI::handleButtonClick(const sf::Vector2f& screenPos) {
     else if (clearCarsBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Clear Cars clicked" << std::endl;
 
-        if (carSim) {
-            carSim->clearAllCars();
-            std::cout << "All vehicles removed" << std::endl;
-        }
+        enqueueCommand([this]() {
+            if (carSim) {
+                carSim->clearAllCars();
+                std::cout << "All vehicles removed" << std::endl;
+            }
+        });
     }
 
-    // Traffic Sim button (toggle auto-spawning)
+    // Traffic Sim button (pause / resume car movement)
     else if (trafficBtn.shape.getGlobalBounds().contains(screenPos)) {
-        std::cout << "Traffic Sim clicked - Toggling auto-spawn" << std::endl;
+        std::cout << "Traffic Sim clicked - Toggling simulation" << std::endl;
 
-        static bool autoSpawnEnabled = false;
-        autoSpawnEnabled = !autoSpawnEnabled;
+        static bool paused = false;
+        paused = !paused;
 
-        if (carSim) {
-            // You would need to add an auto-spawn toggle in CarSimulation
-            std::cout << "Auto-spawn " << (autoSpawnEnabled ? "enabled" : "disabled") << std::endl;
+        enqueueCommand([this]() {
+            if (carSim) {
+                carSim->toggleRunning();
+            }
+        });
 
-            // Change button color to indicate state
-            trafficBtn.shape.setFillColor(autoSpawnEnabled ?
-                sf::Color(100, 200, 100) : sf::Color(70, 130, 180));
-        }
+        // Change button color to indicate state
+        trafficBtn.shape.setFillColor(paused ?
+            sf::Color(100, 200, 100) : sf::Color(70, 130, 180));
     }
 
     // Peak Hour button - spawn 30 cars
     else if (peakHourBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Peak Hour clicked - Spawning 30 cars" << std::endl;
 
-        if (carSim && cityMap.getNodeCount() > 0) {
-            auto nodes = cityMap.getAllNodes();
-            if (nodes.size() >= 2) {
-                std::vector<int> nodeIds;
-                for (const auto& pair : nodes) {
-                    nodeIds.push_back(pair.first);
-                }
-
-                int spawned = 0;
-                for (int i = 0; i < 30; i++) {
-                    int startIdx = rand() % nodeIds.size();
-                    int endIdx = rand() % nodeIds.size();
-
-                    if (startIdx != endIdx) {
-                        int start = nodeIds[startIdx];
-                        int end = nodeIds[endIdx];
-
-                        std::vector<int> path = cityMap.findShortestPath(start, end);
-                        if (!path.empty()) {
-                            carSim->addCar(start, end, path);
-                            spawned++;
-                        }
-                    }
-                }
-                totalCarsSpawned += spawned;
-                std::cout << "Spawned " << spawned << " cars. Total: "
-                    << carSim->getVehicleCount() << std::endl;
-            }
-        }
+        enqueueCommand([this]() {
+            spawnRandomCars(30);
+        });
     }
 
     // Accident button - create random accident
     else if (accidentBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Accident clicked - Creating random accident" << std::endl;
 
-        if (accidentSystem && cityMap.getEdgeCount() > 0) {
-            accidentSystem->createRandomAccident();
-            std::cout << "Random accident created. Active accidents: "
-                << accidentSystem->getActiveAccidentCount() << std::endl;
-        }
+        enqueueCommand([this]() {
+            if (accidentSystem && cityMap.getEdgeCount() > 0) {
+                accidentSystem->createRandomAccident();
+                std::cout << "Random accident created. Active accidents: "
+                    << accidentSystem->getActiveAccidentCount() << std::endl;
+            }
+        });
     }
 
     // Generate City button
     else if (generateCityBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Generate City clicked" << std::endl;
 
-        cityMap = MapGenerator::generateCity();
+        enqueueCommand([this]() {
+            cityMap = MapGenerator::generateCity();
 
-        // Reset systems with new map
-        delete carSim;
-        delete accidentSystem;
-        delete predictionSystem;
+            // Reset systems with new map
+            delete carSim;
+            delete signalSystem;
+            delete accidentSystem;
+            delete predictionSystem;
+
+            initializeSystems();
+            currentPath.clear();
 
-        initializeSystems();
+            std::cout << "New city generated with " << cityMap.getNodeCount()
+                << " nodes and " << cityMap.getEdgeCount() << " edges" << std::endl;
+        });
 
         // Clear selections
         selectedStartNode = -1;
         selectedEndNode = -1;
         sourceText = "";
         destText = "";
-        currentPath.clear();
-
-        std::cout << "New city generated with " << cityMap.getNodeCount()
-            << " nodes and " << cityMap.getEdgeCount() << " edges" << std::endl;
     }
 
     // 20 Cars button
     else if (spawnManyCarsBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "20 Cars clicked - Spawning 20 random cars" << std::endl;
 
-        if (carSim && cityMap.getNodeCount() > 0) {
-            auto nodes = cityMap.getAllNodes();
-            if (nodes.size() >= 2) {
-                std::vector<int> nodeIds;
-                for (const auto& pair : nodes) {
-                    nodeIds.push_back(pair.first);
-                }
-
-                int spawned = 0;
-                for (int i = 0; i < 20; i++) {
-                    int startIdx = rand() % nodeIds.size();
-                    int endIdx = rand() % nodeIds.size();
-
-                    if (startIdx != endIdx) {
-                        int start = nodeIds[startIdx];
-                        int end = nodeIds[endIdx];
-
-                        std::vector<int> path = cityMap.findShortestPath(start, end);
-                        if (!path.empty()) {
-                            carSim->addCar(start, end, path);
-                            spawned++;
-                        }
-                    }
-                }
-                totalCarsSpawned += spawned;
-                std::cout << "Spawned " << spawned << " cars" << std::endl;
-            }
-        }
+        enqueueCommand([this]() {
+            spawnRandomCars(20);
+        });
     }
 
     // Rush Hour button - heavy traffic
     else if (rushHourBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Rush Hour clicked - Creating heavy traffic" << std::endl;
 
-        if (carSim && cityMap.getNodeCount() > 0) {
-            auto nodes = cityMap.getAllNodes();
-            if (nodes.size() >= 2) {
-                std::vector<int> nodeIds;
-                for (const auto& pair : nodes) {
-                    nodeIds.push_back(pair.first);
-                }
-
-                // Spawn 50 cars
-                int spawned = 0;
-                for (int i = 0; i < 50; i++) {
-                    int startIdx = rand() % nodeIds.size();
-                    int endIdx = rand() % nodeIds.size();
+        enqueueCommand([this]() {
+            if (!carSim || cityMap.getNodeCount() < 2) return;
 
-                    if (startIdx != endIdx) {
-                        int start = nodeIds[startIdx];
-                        int end = nodeIds[endIdx];
+            // Spawn 50 cars
+            int spawned = spawnRandomCars(50);
 
-                        std::vector<int> path = cityMap.findShortestPath(start, end);
-                        if (!path.empty()) {
-                            carSim->addCar(start, end, path);
-                            spawned++;
-                        }
-                    }
+            // Increase congestion on all edges
+            auto edges = cityMap.getAllEdges();
+            for (auto& pair : edges) {
+                Edge& edge = pair.second;
+                if (rand() % 100 < 70) { // 70% chance of congestion
+                    edge.trafficLevel = TrafficLevel::CONGESTED;
+                    edge.currentTravelTime = edge.baseTravelTime * 2.5f;
                 }
-                totalCarsSpawned += spawned;
-
-                // Increase congestion on all edges
-                auto edges = cityMap.getAllEdges();
-                for (auto& pair : edges) {
-                    Edge& edge = pair.second;
-                    if (rand() % 100 < 70) { // 70% chance of congestion
-                        edge.trafficLevel = TrafficLevel::CONGESTED;
-                        edge.currentTravelTime = edge.baseTravelTime * 2.5f;
-                    }
-                    else if (rand() % 100 < 30) { // 30% chance of slow traffic
-                        edge.trafficLevel = TrafficLevel::SLOW;
-                        edge.currentTravelTime = edge.baseTravelTime * 1.5f;
-                    }
+                else if (rand() % 100 < 30) { // 30% chance of slow traffic
+                    edge.trafficLevel = TrafficLevel::SLOW;
+                    edge.currentTravelTime = edge.baseTravelTime * 1.5f;
                 }
-
-                std::cout << "Rush hour created with " << spawned << " cars and heavy congestion" << std::endl;
             }
-        }
+
+            std::cout << "Rush hour created with " << spawned << " cars and heavy congestion" << std::endl;
+        });
     }
 
     // Clear All button
     else if (clearTrafficBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Clear All clicked - Resetting everything" << std::endl;
 
-        if (carSim) {
-            carSim->clearAllCars();
-        }
+        enqueueCommand([this]() {
+            if (carSim) {
+                carSim->clearAllCars();
+            }
 
-        if (accidentSystem) {
-            accidentSystem->clearAllAccidents();
-        }
+            if (accidentSystem) {
+                accidentSystem->clearAllAccidents();
+            }
 
-        // Reset all edges to free flow
-        auto edges = cityMap.getAllEdges();
-        for (auto& pair : edges) {
-            Edge& edge = pair.second;
-            edge.trafficLevel = TrafficLevel::FREE_FLOW;
-            edge.currentTravelTime = edge.baseTravelTime;
-            edge.isBlocked = false;
-        }
+            // Reset all edges to free flow
+            auto edges = cityMap.getAllEdges();
+            for (auto& pair : edges) {
+                Edge& edge = pair.second;
+                edge.trafficLevel = TrafficLevel::FREE_FLOW;
+                edge.currentTravelTime = edge.baseTravelTime;
+                edge.isBlocked = false;
+            }
+
+            currentPath.clear();
+            std::cout << "All cleared" << std::endl;
+        });
 
         // Clear selections
         selectedStartNode = -1;
         selectedEndNode = -1;
         sourceText = "";
         destText = "";
-        currentPath.clear();
-
-        std::cout << "All cleared" << std::endl;
     }
 
     // Clear Accidents button
     else if (clearAccidentsBtn.shape.getGlobalBounds().contains(screenPos)) {
         std::cout << "Clear Accidents clicked" << std::endl;
 
-        if (accidentSystem) {
-            accidentSystem->clearAllAccidents();
-            std::cout << "All accidents cleared" << std::endl;
-        }
+        enqueueCommand([this]() {
+            if (accidentSystem) {
+                accidentSystem->clearAllAccidents();
+                std::cout << "All accidents cleared" << std::endl;
+            }
+        });
     }
 
     // Toggle Predictions button
@@ -780,6 +842,17 @@ void GUI::handleButtonClick(const sf::Vector2f& screenPos) {
     }
 }
 
+// Runs on the simulation thread
+int GUI::spawnRandomCars(int count) {
+    if (!carSim || cityMap.getNodeCount() < 2) return 0;
+
+    int spawned = carSim->addRandomCars(count);
+    totalCarsSpawned += spawned;
+    std::cout << "Spawned " << spawned << " cars. Total: "
+        << carSim->getVehicleCount() << std::endl;
+    return spawned;
+}
+
 void GUI::handleControlPanelClick(const sf::Vector2f& screenPos) {
     handleButtonClick(screenPos);
 
@@ -815,9 +888,7 @@ int GUI::findNodeAtPosition(const sf::Vector2f& worldPos) const {
     int nodeId = -1;
     float minDist = RenderConfig::NODE_SELECTION_RADIUS * zoomLevel;
 
-    auto nodes = cityMap.getAllNodes();
-    for (const auto& pair : nodes) {
-        const Node& node = pair.second;
+    for (const auto& node : snapshots.front().nodes) {
         float nodeX = node.x * zoomLevel + viewOffset.x;
         float nodeY = node.y * zoomLevel + viewOffset.y;
 
@@ -858,7 +929,7 @@ void GUI::handleNodeSelection(int nodeId) {
             selectedEndNode = -1;
             sourceText = std::to_string(nodeId);
             destText = "";
-            currentPath.clear();
+            enqueueCommand([this]() { currentPath.clear(); });
         }
     }
     std::cout << "Node " << nodeId << " selected" << std::endl;
@@ -922,12 +993,19 @@ void GUI::initializeSystems() {
         std::cout << "  CarSimulation initialized" << std::endl;
     }
 
+    signalSystem = new SignalSystem(cityMap);
+    carSim->setSignalSystem(signalSystem);
+    std::cout << "  SignalSystem initialized (" << signalSystem->getSignalCount() << " signals)" << std::endl;
+
     accidentSystem = new AccidentSystem(&cityMap);
     if (!accidentSystem) {
         std::cerr << "ERROR: Failed to create AccidentSystem!" << std::endl;
     } else {
         std::cout << "  AccidentSystem initialized" << std::endl;
     }
+    if (predictionSystem) {
+        predictionSystem->setAccidentSystem(accidentSystem);
+    }
 }
 
 void GUI::initializeUI() {
@@ -1008,7 +1086,6 @@ void GUI::initializeStatistics() {
     statsText.setFillColor(sf::Color::White);
     statsText.setLineSpacing(0.8f);
     statsText.setPosition(920.0f, statsStartY);
-    updateStatistics(0, 0, 0, 0.0f);
 }
 
 void GUI::handleTextInput(sf::Uint32 unicode) {
@@ -1092,25 +1169,163 @@ void GUI::drawButton(const Button& btn) {
 }
 
 void GUI::setCurrentPath(const std::vector<int>& path) {
-    currentPath = path;
+    enqueueCommand([this, path]() { currentPath = path; });
 }
 
-void GUI::updateAccidentVisuals() {
-    accidentIcons.clear();
+// Runs on the simulation thread. Copies everything the renderer needs into the
+// back buffer and publishes it; the render thread never sees a half-updated tick.
+void GUI::publishSnapshot() {
+    SimulationSnapshot& snapshot = snapshots.back();
+    const auto& nodes = cityMap.getAllNodes();
 
-    if (!accidentSystem) return;
+    snapshot.nodes.clear();
+    for (const auto& pair : nodes) {
+        snapshot.nodes.push_back({ pair.first, pair.second.x, pair.second.y });
+    }
 
-    auto accidentEdges = accidentSystem->getAccidentEdges();
+    snapshot.edges.clear();
+    snapshot.congestedRoads = 0;
+    for (const auto& pair : cityMap.getAllEdges()) {
+        const Edge& edge = pair.second;
+        auto fromIt = nodes.find(edge.fromNodeId);
+        auto toIt = nodes.find(edge.toNodeId);
+        if (fromIt == nodes.end() || toIt == nodes.end()) continue;
+
+        bool hasAccident = edge.isBlocked && accidentSystem && accidentSystem->hasAccidentOnEdge(edge.id);
+
+        snapshot.edges.push_back({
+            edge.id,
+            fromIt->second.x, fromIt->second.y,
+            toIt->second.x, toIt->second.y,
+            edge.trafficLevel,
+            edge.isBlocked,
+            hasAccident,
+            hasAccident && accidentSystem->shouldBlink(edge.id)
+        });
+
+        if (edge.trafficLevel == TrafficLevel::CONGESTED ||
+            edge.trafficLevel == TrafficLevel::BLOCKED) {
+            snapshot.congestedRoads++;
+        }
+    }
 
-    for (int edgeId : accidentEdges) {
-        Edge edge = cityMap.getEdge(edgeId);
-        if (edge.id == -1) continue;
+    snapshot.cars.clear();
+    if (carSim) {
+        for (const auto& car : carSim->getCars()) {
+            if (!car.active || car.route.size() < 2) continue;
+
+            float x, y, angle;
+            if (!carSim->getCarLocation(car, car.currentPosition, car.progress, x, y, angle)) continue;
 
-        Node fromNode = cityMap.getNode(edge.fromNodeId);
-        Node toNode = cityMap.getNode(edge.toNodeId);
+            float prevX = x, prevY = y, prevAngle;
+            carSim->getCarLocation(car, car.previousPosition, car.previousProgress, prevX, prevY, prevAngle);
 
-        float midX = (fromNode.x + toNode.x) / 2.0f;
-        float midY = (fromNode.y + toNode.y) / 2.0f;
+            snapshot.cars.push_back({ x, y, prevX, prevY, angle, car.color });
+        }
+    }
+    snapshot.carCount = carSim ? carSim->getVehicleCount() : 0;
+
+    snapshot.signals.clear();
+    if (signalSystem) {
+        using Light = SimulationSnapshot::Light;
+        for (int i = 0; i < signalSystem->getSignalCount(); i++) {
+            auto it = nodes.find(signalSystem->getSignalNode(i));
+            if (it == nodes.end()) continue;
+
+            SignalSystem::Phase phase = signalSystem->getPhase(i);
+            Light groupA = phase == SignalSystem::Phase::GREEN_A ? Light::GREEN :
+                phase == SignalSystem::Phase::AMBER_A ? Light::AMBER : Light::RED;
+            Light groupB = phase == SignalSystem::Phase::GREEN_B ? Light::GREEN :
+                phase == SignalSystem::Phase::AMBER_B ? Light::AMBER : Light::RED;
+            snapshot.signals.push_back({ it->second.x, it->second.y, groupA, groupB });
+        }
+    }
+
+    snapshot.accidentEdges.clear();
+    snapshot.incidentEdges.clear();
+    if (accidentSystem) {
+        snapshot.accidentEdges = accidentSystem->getAccidentEdges();
+        snapshot.incidentEdges = accidentSystem->getIncidentEdges();
+    }
+
+    snapshot.path.clear();
+    for (int nodeId : currentPath) {
+        auto it = nodes.find(nodeId);
+        if (it != nodes.end()) {
+            snapshot.path.push_back({ nodeId, it->second.x, it->second.y });
+        }
+    }
+
+    // Predictions are only recomputed once per prediction round, so taking
+    // the latest snapshot is free; the route estimate is still refreshed slowly
+    if (predictionSystem) {
+        cachedPredictions = predictionSystem->getSnapshot();
+    }
+
+    int start = selectedStartNode;
+    int end = selectedEndNode;
+    bool refresh = --statsRefreshCountdown <= 0;
+
+    if (refresh) {
+        statsRefreshCountdown = RenderConfig::STATS_REFRESH_TICKS;
+    }
+
+    if (refresh || start != cachedRouteStart || end != cachedRouteEnd) {
+        cachedRouteStart = start;
+        cachedRouteEnd = end;
+        cachedRouteTime = -1.0f;
+
+        if (start != -1 && end != -1) {
+            auto path = cityMap.findShortestPath(start, end);
+            if (!path.empty()) {
+                cachedRouteTime = 0.0f;
+                for (size_t i = 0; i < path.size() - 1; i++) {
+                    int edgeId = cityMap.findEdgeId(path[i], path[i + 1]);
+                    if (edgeId != -1) {
+                        cachedRouteTime += cityMap.getEdge(edgeId).currentTravelTime;
+                    }
+                }
+            }
+        }
+    }
+
+    snapshot.predictedCongestion.clear();
+    snapshot.predictedCongestionCount = 0;
+    snapshot.predictionAccuracy = 0.0f;
+    if (cachedPredictions) {
+        if (showPredictions && !cachedPredictions->likelyCongested5.empty()) {
+            std::unordered_map<int, int> edgeIndex;
+            for (size_t i = 0; i < snapshot.edges.size(); i++) {
+                edgeIndex[snapshot.edges[i].id] = static_cast<int>(i);
+            }
+            for (int edgeId : cachedPredictions->likelyCongested5) {
+                auto it = edgeIndex.find(edgeId);
+                if (it != edgeIndex.end()) {
+                    snapshot.predictedCongestion.push_back(it->second);
+                }
+            }
+        }
+
+        snapshot.predictedCongestionCount = cachedPredictions->predictedCongestionCount;
+        snapshot.predictionAccuracy = cachedPredictions->averageAccuracy;
+    }
+    snapshot.routeTravelTime = cachedRouteTime;
+
+    snapshot.tick = simulationClock.getTickCount();
+    snapshot.tickDuration = simulationClock.getTickDuration();
+    snapshot.publishedAt = std::chrono::steady_clock::now();
+
+    snapshots.publish();
+}
+
+void GUI::updateAccidentVisuals(const SimulationSnapshot& snapshot) {
+    accidentIcons.clear();
+
+    for (const auto& edge : snapshot.edges) {
+        if (!edge.hasAccident) continue;
+
+        float midX = (edge.fromX + edge.toX) / 2.0f;
+        float midY = (edge.fromY + edge.toY) / 2.0f;
 
         float screenX = midX * zoomLevel + viewOffset.x;
         float screenY = midY * zoomLevel + viewOffset.y - 20.0f; 
@@ -1126,77 +1341,41 @@ void GUI::updateAccidentVisuals() {
     }
 }
 
-void GUI::updateStatistics(int nodeCount, int edgeCount, int carCount, float avgSpeed) {
+void GUI::updateStatistics(const SimulationSnapshot& snapshot) {
     std::stringstream ss;
 
+    int edgeCount = static_cast<int>(snapshot.edges.size());
+
     // Current stats
     ss << "=== LIVE STATISTICS ===\n";
-    ss << "Nodes:      " << std::setw(4) << nodeCount << "\n";
+    ss << "Nodes:      " << std::setw(4) << snapshot.nodes.size() << "\n";
     ss << "Roads:      " << std::setw(4) << edgeCount << "\n";
-    ss << "Active Cars:" << std::setw(4) << carCount << "\n";
+    ss << "Active Cars:" << std::setw(4) << snapshot.carCount << "\n";
     ss << "Avg Speed:  " << std::setw(4) << std::fixed << std::setprecision(1)
-        << avgSpeed << " km/h\n";
-
-    int congestedRoads = 0;
-    auto edges = cityMap.getAllEdges();
-    for (const auto& pair : edges) {
-        if (pair.second.trafficLevel == TrafficLevel::CONGESTED ||
-            pair.second.trafficLevel == TrafficLevel::BLOCKED) {
-            congestedRoads++;
-        }
-    }
+        << 45.5f * simulationSpeed << " km/h\n";
 
-    float congestionPercent = (edges.size() > 0) ?
-        (congestedRoads * 100.0f / edges.size()) : 0.0f;
+    float congestionPercent = (edgeCount > 0) ?
+        (snapshot.congestedRoads * 100.0f / edgeCount) : 0.0f;
 
     ss << "Congestion: " << std::setw(4) << std::fixed << std::setprecision(1)
         << congestionPercent << "%\n";
 
-    if (selectedStartNode != -1 && selectedEndNode != -1) {
-        auto path = cityMap.findShortestPath(selectedStartNode, selectedEndNode);
-        if (!path.empty()) {
-            float travelTime = 0.0f;
-            for (size_t i = 0; i < path.size() - 1; i++) {
-                int fromNode = path[i];
-                int toNode = path[i + 1];
-
-                int edgeId = cityMap.findEdgeId(fromNode, toNode);
-                if (edgeId != -1) {
-                    Edge edge = cityMap.getEdge(edgeId);
-                    travelTime += edge.currentTravelTime;
-                }
-            }
-            ss << "Est. Time:  " << std::setw(4) << std::fixed << std::setprecision(1)
-                << travelTime << " min\n";
-        }
+    if (snapshot.routeTravelTime >= 0.0f) {
+        ss << "Est. Time:  " << std::setw(4) << std::fixed << std::setprecision(1)
+            << snapshot.routeTravelTime << " min\n";
     }
 
 
-    int accidentCount = 0;
-    std::vector<int> accidentEdges;
-
-    if (accidentSystem) {
-        accidentCount = accidentSystem->getActiveAccidentCount();
-        accidentEdges = accidentSystem->getAccidentEdges();
-    }
+    const auto& accidentEdges = snapshot.accidentEdges;
+    int accidentCount = static_cast<int>(accidentEdges.size());
 
     ss << "Accidents:  " << std::setw(4) << accidentCount << "\n";
+    ss << "Incidents:  " << std::setw(4) << snapshot.incidentEdges.size() << "\n";
 
 
-    int predictedCongestion = 0;
-    float predictionAccuracy = 0.0f;
-
-    if (predictionSystem) {
-        predictedCongestion = predictionSystem->getPredictedCongestionCount();
-        predictionAccuracy = predictionSystem->getAveragePredictionAccuracy();
-    }
-    else {
-        std::cout << "ERROR: predictionSystem is NULL in updateStatistics!" << std::endl;
-    }
-
-    ss << "Pred. Cong: " << std::setw(4) << predictedCongestion << "\n";
+    ss << "Pred. Cong: " << std::setw(4) << snapshot.predictedCongestionCount << "\n";
     ss << "Pred. Acc:  " << std::setw(4) << std::fixed << std::setprecision(1)
-        << (predictionAccuracy * 100.0f) << "%\n";
+        << (snapshot.predictionAccuracy * 100.0f) << "%\n";
 
 
     if (accidentCount > 0) {
@@ -1224,11 +1403,13 @@ void GUI::updateStatistics(int nodeCount, int edgeCount, int carCount, float avg
 void GUI::addCar(int startNode, int endNode) {
     std::cout << "Adding car from " << startNode << " to " << endNode << std::endl;
 
-    if (carSim && startNode != endNode) {
-        std::vector<int> path = cityMap.findShortestPath(startNode, endNode);
-        if (!path.empty()) {
-            carSim->addCar(startNode, endNode, path);
-            totalCarsSpawned++;
+    enqueueCommand([this, startNode, endNode]() {
+        if (carSim && startNode != endNode) {
+            std::vector<int> path = cityMap.findShortestPath(startNode, endNode);
+            if (!path.empty()) {
+                carSim->addCar(startNode, endNode, path);
+                totalCarsSpawned++;
+            }
         }
-    }
-}
\ No newline at end of file
+    });
+}
@@ -2,9 +2,17 @@
 #include <SFML/Graphics.hpp>
 #include <string>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include "Graph.h"
 #include "AccidentSystem.h"
 #include "PredictionSystem.h"
+#include "SignalSystem.h"
+#include "SimulationClock.h"
+#include "SimulationSnapshot.h"
+#include "TripleBuffer.h"
 
 // Forward declarations
 class Graph;
@@ -36,10 +44,11 @@ private:
     // Systems
     AccidentSystem* accidentSystem;
     PredictionSystem* predictionSystem;
+    SignalSystem* signalSystem;
     CarSimulation* carSim;
     
     // Prediction settings
-    bool showPredictions;
+    std::atomic<bool> showPredictions;
     sf::Color predictedCongestionColor;
 
     // Buttons
@@ -70,10 +79,9 @@ private:
     bool isDragging;
     sf::Vector2i lastMousePos;
 
-    // Selection
-    int selectedStartNode;
-    int selectedEndNode;
-    std::vector<int> currentPath;
+    // Selection (written by the UI thread, read by the simulation thread)
+    std::atomic<int> selectedStartNode;
+    std::atomic<int> selectedEndNode;
 
     // Colors
     sf::Color freeFlowColor;
@@ -88,6 +96,22 @@ private:
 
     sf::Clock guiClock;
 
+    // Simulation thread. Everything below is owned by it, the UI thread only
+    // reads published snapshots and hands over work through enqueueCommand().
+    std::thread simulationThread;
+    std::atomic<bool> simulationRunning;
+    SimulationClock simulationClock;
+    std::mutex commandMutex;
+    std::vector<std::function<void()>> pendingCommands;
+    std::vector<std::function<void()>> executingCommands;
+    TripleBuffer<SimulationSnapshot> snapshots;
+
+    std::vector<int> currentPath;
+    int statsRefreshCountdown;
+    std::shared_ptr<const PredictionSnapshot> cachedPredictions;
+    int cachedRouteStart, cachedRouteEnd;
+    float cachedRouteTime;
+
 public:
     GUI(Graph& map);
     ~GUI();
@@ -95,7 +119,6 @@ public:
     void run();
     void addCar(int startNode, int endNode);
     void setCurrentPath(const std::vector<int>& path);
-    void updateStatistics(int nodeCount, int edgeCount, int carCount, float avgSpeed);
     PredictionSystem* getPredictionSystem() { return predictionSystem; }
 
 private:
@@ -121,20 +144,31 @@ private:
     void handleEnterKey();
     void handleButtonClick(const sf::Vector2f& mousePos);
 
+    // Simulation thread
+    void startSimulationThread();
+    void stopSimulationThread();
+    void simulationLoop();
+    void enqueueCommand(std::function<void()> command);
+    bool runPendingCommands();
+    int spawnRandomCars(int count);
+    void publishSnapshot();
+
     // Update methods
     void update();
     void updateSimulation(float deltaTime);
-    void updateAccidentVisuals();
+    void updateStatistics(const SimulationSnapshot& snapshot);
+    void updateAccidentVisuals(const SimulationSnapshot& snapshot);
 
     // Rendering methods
     void render();
     void drawControlPanel();
-    void drawMap();
-    void drawNode(const Node& node, bool isSelected);
-    void drawEdge(const Edge& edge);
-    void drawPath();
-    void drawCars();
-    void drawPredictions();
+    void drawMap(const SimulationSnapshot& snapshot);
+    void drawNode(const SimulationSnapshot::NodeState& node, bool isSelected);
+    void drawEdge(const SimulationSnapshot::EdgeState& edge);
+    void drawPath(const SimulationSnapshot& snapshot);
+    void drawCars(const SimulationSnapshot& snapshot);
+    void drawSignals(const SimulationSnapshot& snapshot);
+    void drawPredictions(const SimulationSnapshot& snapshot);
 
     // Helper methods
     void createButton(Button& btn, float x, float y, float w, float h, const std::string& text);
@@ -1,4 +1,12 @@
 #include "Graph.h"
+#include "Checkpoint.h"
+#include <atomic>
+
+namespace {
+    // Versions are unique across all graphs, so assigning one graph to
+    // another always changes the version
+    std::atomic<std::uint64_t> topologyVersions{ 0 };
+}
 
 void Edge::updateTraffic(float currentSpeed) {
     if (currentSpeed <= 0) {
@@ -19,19 +27,47 @@ void Edge::updateTraffic(float currentSpeed) {
     }
 }
 
+Graph::Graph(const Graph& other)
+    : nodes(other.nodes), edges(other.edges), adjacencyList(other.adjacencyList),
+    edgeCache(other.edgeCache), edgeSlotById(other.edgeSlotById),
+    topologyVersion(other.topologyVersion) {
+    edgeSlots.reserve(other.edgeSlots.size());
+    for (const Edge* edge : other.edgeSlots) {
+        edgeSlots.push_back(&edges.at(edge->id));
+    }
+}
+
+Graph& Graph::operator=(const Graph& other) {
+    if (this != &other) {
+        Graph copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+void Graph::touchTopology() {
+    topologyVersion = topologyVersions.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 void Graph::addNode(int id, float x, float y, const std::string& name) {
     nodes[id] = Node(id, x, y, name);
     adjacencyList[id] = std::vector<int>();
+    touchTopology();
 }
 
 void Graph::addEdge(int id, int from, int to, float length,
     int speedLimit, const std::string& name) {
-    edges[id] = Edge(id, from, to, length, speedLimit, name);
+    auto result = edges.insert_or_assign(id, Edge(id, from, to, length, speedLimit, name));
+    if (result.second) {
+        edgeSlotById[id] = static_cast<int>(edgeSlots.size());
+        edgeSlots.push_back(&result.first->second);
+    }
     adjacencyList[from].push_back(id);
     adjacencyList[to].push_back(id);
     
     // Add to cache for fast lookup
     edgeCache.addEdge(from, to, id);
+    touchTopology();
 }
 
 Node Graph::getNode(int id) const {
@@ -81,6 +117,9 @@ void Graph::clearGraph() {
     edges.clear();
     adjacencyList.clear();
     edgeCache.clear();
+    edgeSlots.clear();
+    edgeSlotById.clear();
+    touchTopology();
 }
 
 const std::unordered_map<int, Node>& Graph::getAllNodes() const {
@@ -112,10 +151,31 @@ void Graph::updateEdgeTraffic(int edgeId, float currentSpeed) {
     }
 }
 
+int Graph::getEdgeSlot(int edgeId) const {
+    auto it = edgeSlotById.find(edgeId);
+    return it != edgeSlotById.end() ? it->second : -1;
+}
+
+int Graph::findEdgeSlot(int fromNode, int toNode) const {
+    int edgeId = edgeCache.findEdge(fromNode, toNode);
+    return edgeId != -1 ? getEdgeSlot(edgeId) : -1;
+}
+
+void Graph::updateEdgeTrafficBatch(const std::vector<int>& slots, const std::vector<float>& speeds) {
+    size_t count = std::min(slots.size(), speeds.size());
+    for (size_t i = 0; i < count; i++) {
+        Edge& edge = *edgeSlots[slots[i]];
+        if (!edge.isBlocked) {
+            edge.updateTraffic(speeds[i]);
+        }
+    }
+}
+
 void Graph::blockEdge(int edgeId, float duration) {
     auto it = edges.find(edgeId);
     if (it != edges.end()) {
         it->second.setBlocked(true, duration);
+        blockVersion++;
     }
 }
 
@@ -123,6 +183,7 @@ void Graph::unblockEdge(int edgeId) {
     auto it = edges.find(edgeId);
     if (it != edges.end()) {
         it->second.setBlocked(false);
+        blockVersion++;
     }
 }
 
@@ -136,10 +197,24 @@ bool Graph::isEdgeBlocked(int edgeId) const {
 
 void Graph::updateAccidents(float deltaTime) {
     for (auto& pair : edges) {
+        bool wasBlocked = pair.second.isBlocked;
         pair.second.updateAccidentTimer(deltaTime);
+        if (wasBlocked != pair.second.isBlocked) {
+            blockVersion++;
+        }
     }
 }
 
+float Graph::getSecondsToNextUnblock() const {
+    float seconds = std::numeric_limits<float>::infinity();
+    for (const Edge* edge : edgeSlots) {
+        if (edge->isBlocked && edge->accidentTimer > 0.0f) {
+            seconds = std::min(seconds, edge->accidentTimer);
+        }
+    }
+    return seconds;
+}
+
 std::vector<int> Graph::findShortestPath(int start, int end) const {
     if (!hasNode(start) || !hasNode(end)) {
         return std::vector<int>();
@@ -246,6 +321,9 @@ void Graph::loadFromFile(const std::string& filename) {
     nodes.clear();
     edges.clear();
     adjacencyList.clear();
+    edgeSlots.clear();
+    edgeSlotById.clear();
+    touchTopology();
 
     std::string line;
     std::string section = "";
@@ -300,3 +378,73 @@ void Graph::loadFromFile(const std::string& filename) {
     file.close();
     rebuildEdgeCache();
 }
+
+void Graph::saveState(BinaryWriter& writer) const {
+    std::vector<int> ids;
+    ids.reserve(edges.size());
+    for (const auto& pair : edges) {
+        ids.push_back(pair.first);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<float> travelTimes, accidentTimers;
+    std::vector<std::uint8_t> levels, blocked;
+    travelTimes.reserve(ids.size());
+    accidentTimers.reserve(ids.size());
+    levels.reserve(ids.size());
+    blocked.reserve(ids.size());
+
+    for (int id : ids) {
+        const Edge& edge = edges.at(id);
+        travelTimes.push_back(edge.currentTravelTime);
+        accidentTimers.push_back(edge.accidentTimer);
+        levels.push_back(static_cast<std::uint8_t>(edge.trafficLevel));
+        blocked.push_back(edge.isBlocked ? 1 : 0);
+    }
+
+    writer.writeTag("EDGE");
+    writer.writeArray(ids);
+    writer.writeArray(travelTimes);
+    writer.writeArray(accidentTimers);
+    writer.writeArray(levels);
+    writer.writeArray(blocked);
+}
+
+bool Graph::loadState(BinaryReader& reader) {
+    std::vector<int> ids;
+    std::vector<float> travelTimes, accidentTimers;
+    std::vector<std::uint8_t> levels, blocked;
+
+    if (!reader.expectTag("EDGE") ||
+        !reader.readArray(ids) || !reader.readArray(travelTimes) ||
+        !reader.readArray(accidentTimers) || !reader.readArray(levels) ||
+        !reader.readArray(blocked)) {
+        return false;
+    }
+
+    size_t count = ids.size();
+    if (count != edges.size() || travelTimes.size() != count || accidentTimers.size() != count ||
+        levels.size() != count || blocked.size() != count) {
+        std::cerr << "Error: Checkpoint edge state does not match this map" << std::endl;
+        reader.fail();
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!hasEdge(ids[i]) || levels[i] > static_cast<std::uint8_t>(TrafficLevel::BLOCKED)) {
+            std::cerr << "Error: Checkpoint edge state does not match this map" << std::endl;
+            reader.fail();
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Edge& edge = edges.at(ids[i]);
+        edge.currentTravelTime = travelTimes[i];
+        edge.accidentTimer = accidentTimers[i];
+        edge.trafficLevel = static_cast<TrafficLevel>(levels[i]);
+        edge.isBlocked = blocked[i] != 0;
+    }
+    blockVersion++;
+    return true;
+}
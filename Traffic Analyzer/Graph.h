@@ -8,8 +8,12 @@
 #include <queue>
 #include <limits>
 #include <algorithm>
+#include <cstdint>
 #include "EdgeCache.h"
 
+class BinaryWriter;
+class BinaryReader;
+
 enum class TrafficLevel {
     FREE_FLOW = 0,
     SLOW = 1,
@@ -87,8 +91,25 @@ private:
     std::unordered_map<int, std::vector<int>> adjacencyList;
     EdgeCache edgeCache;
 
+    // Dense edge slots in insertion order. Map nodes never move, so the
+    // pointers stay valid until the edge map is copied or cleared.
+    std::vector<Edge*> edgeSlots;
+    std::unordered_map<int, int> edgeSlotById;
+
+    // Changes whenever nodes or roads are added or removed; copies share it
+    std::uint64_t topologyVersion = 0;
+
+    // Counts roads being blocked or reopened
+    std::uint64_t blockVersion = 0;
+
+    void touchTopology();
+
 public:
     Graph() = default;
+    Graph(const Graph& other);
+    Graph& operator=(const Graph& other);
+    Graph(Graph&&) = default;
+    Graph& operator=(Graph&&) = default;
 
     // Node operations
     void addNode(int id, float x, float y, const std::string& name = "");
@@ -113,17 +134,38 @@ public:
     int getNodeCount() const;
     int getEdgeCount() const;
 
+    // Dense edge slots: 0..getEdgeCount()-1, kept by copies of the graph
+    int getEdgeSlot(int edgeId) const;
+    int findEdgeSlot(int fromNode, int toNode) const;
+    const Edge& getEdgeAt(int slot) const { return *edgeSlots[slot]; }
+
+    // Lets callers cache structures derived from the topology
+    std::uint64_t getTopologyVersion() const { return topologyVersion; }
+
     // Utility
     void updateEdgeTraffic(int edgeId, float currentSpeed);
+
+    // Batched updateEdgeTraffic: speeds[i] applies to slots[i]. Blocked
+    // edges are skipped, an accident decides their state until it clears.
+    void updateEdgeTrafficBatch(const std::vector<int>& slots, const std::vector<float>& speeds);
     void saveToFile(const std::string& filename);
     void loadFromFile(const std::string& filename);
 
+    // Checkpoint of the dynamic edge state only; the topology must already match
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+
     // Accident management
     void blockEdge(int edgeId, float duration = 300.0f);
     void unblockEdge(int edgeId);
     bool isEdgeBlocked(int edgeId) const;
     void updateAccidents(float deltaTime);
 
+    // Time warp support: changes whenever a road is blocked or reopened, and
+    // the seconds until the next timed block runs out (infinity if none)
+    std::uint64_t getBlockVersion() const { return blockVersion; }
+    float getSecondsToNextUnblock() const;
+
     // Cache management
     void rebuildEdgeCache();
     void clearGraph();
@@ -0,0 +1,169 @@
+#include "GraphPartitioner.h"
+#include <algorithm>
+#include <cmath>
+
+GraphPartitioner::Partition GraphPartitioner::partition(const Graph& map, int regions) {
+    Partition result;
+    result.regions = std::max(1, regions);
+
+    std::vector<int> nodeIds;
+    for (const auto& pair : map.getAllNodes()) {
+        nodeIds.push_back(pair.first);
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+
+    std::unordered_map<int, int> indexOf;
+    std::vector<Vertex> vertices;
+    vertices.reserve(nodeIds.size());
+    for (int id : nodeIds) {
+        const Node node = map.getNode(id);
+        indexOf[id] = static_cast<int>(vertices.size());
+        vertices.push_back({ id, node.x, node.y, 0, {} });
+    }
+
+    int edgeCount = map.getEdgeCount();
+    for (int slot = 0; slot < edgeCount; slot++) {
+        const Edge& edge = map.getEdgeAt(slot);
+        auto from = indexOf.find(edge.fromNodeId);
+        auto to = indexOf.find(edge.toNodeId);
+        if (from == indexOf.end() || to == indexOf.end()) continue;
+
+        vertices[from->second].weight++;
+        if (from->second != to->second) {
+            vertices[from->second].neighbors.push_back(to->second);
+            vertices[to->second].neighbors.push_back(from->second);
+        }
+    }
+
+    std::vector<int> region(vertices.size(), 0);
+    std::vector<int> members(vertices.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        members[i] = static_cast<int>(i);
+    }
+    bisect(vertices, members, 0, result.regions, region);
+    refine(vertices, result.regions, region);
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        result.regionOfNode[vertices[i].id] = region[i];
+    }
+
+    result.regionOfSlot.assign(static_cast<size_t>(edgeCount), 0);
+    result.roadsPerRegion.assign(static_cast<size_t>(result.regions), 0);
+    for (int slot = 0; slot < edgeCount; slot++) {
+        const Edge& edge = map.getEdgeAt(slot);
+        auto from = indexOf.find(edge.fromNodeId);
+        auto to = indexOf.find(edge.toNodeId);
+        if (from == indexOf.end() || to == indexOf.end()) continue;
+
+        int owner = region[from->second];
+        result.regionOfSlot[slot] = owner;
+        result.roadsPerRegion[owner]++;
+        if (owner != region[to->second]) {
+            result.cutRoads++;
+        }
+    }
+    return result;
+}
+
+// Splits members across the longer side of their bounding box so that the
+// two halves own road counts in proportion to the regions they will hold
+void GraphPartitioner::bisect(std::vector<Vertex>& vertices, std::vector<int>& members,
+    int firstRegion, int regionCount, std::vector<int>& region) {
+    if (regionCount <= 1 || members.size() <= 1) {
+        for (int v : members) {
+            region[v] = firstRegion;
+        }
+        return;
+    }
+
+    float minX = vertices[members[0]].x, maxX = minX;
+    float minY = vertices[members[0]].y, maxY = minY;
+    long long totalWeight = 0;
+    for (int v : members) {
+        minX = std::min(minX, vertices[v].x);
+        maxX = std::max(maxX, vertices[v].x);
+        minY = std::min(minY, vertices[v].y);
+        maxY = std::max(maxY, vertices[v].y);
+        totalWeight += vertices[v].weight;
+    }
+
+    bool splitX = maxX - minX >= maxY - minY;
+    std::sort(members.begin(), members.end(), [&](int a, int b) {
+        float ca = splitX ? vertices[a].x : vertices[a].y;
+        float cb = splitX ? vertices[b].x : vertices[b].y;
+        return ca != cb ? ca < cb : vertices[a].id < vertices[b].id;
+    });
+
+    int leftRegions = regionCount / 2;
+    double leftTarget = static_cast<double>(totalWeight) * leftRegions / regionCount;
+
+    size_t split = 0;
+    long long leftWeight = 0;
+    while (split < members.size() - 1 && leftWeight + vertices[members[split]].weight / 2.0 < leftTarget) {
+        leftWeight += vertices[members[split]].weight;
+        split++;
+    }
+    split = std::max<size_t>(split, 1);
+
+    std::vector<int> left(members.begin(), members.begin() + split);
+    std::vector<int> right(members.begin() + split, members.end());
+    bisect(vertices, left, firstRegion, leftRegions, region);
+    bisect(vertices, right, firstRegion + leftRegions, regionCount - leftRegions, region);
+}
+
+// Greedy boundary refinement: a node moves to the neighbouring region that
+// holds most of its roads when that cuts fewer roads and keeps both regions
+// within the tolerance
+void GraphPartitioner::refine(const std::vector<Vertex>& vertices, int regions, std::vector<int>& region) {
+    if (regions <= 1) return;
+
+    std::vector<long long> regionWeight(static_cast<size_t>(regions), 0);
+    long long totalWeight = 0;
+    for (size_t v = 0; v < vertices.size(); v++) {
+        regionWeight[region[v]] += vertices[v].weight;
+        totalWeight += vertices[v].weight;
+    }
+
+    double average = static_cast<double>(totalWeight) / regions;
+    double maxWeight = std::ceil(average * IMBALANCE_TOLERANCE);
+    double minWeight = std::floor(average * (2.0f - IMBALANCE_TOLERANCE));
+
+    std::vector<int> links(static_cast<size_t>(regions), 0);
+    std::vector<int> touched;
+
+    for (int pass = 0; pass < REFINEMENT_PASSES; pass++) {
+        int moved = 0;
+
+        for (size_t v = 0; v < vertices.size(); v++) {
+            int own = region[v];
+            touched.clear();
+            for (int neighbor : vertices[v].neighbors) {
+                int r = region[neighbor];
+                if (links[r]++ == 0) touched.push_back(r);
+            }
+
+            int best = own;
+            for (int r : touched) {
+                if (r != own && (best == own || links[r] > links[best] || (links[r] == links[best] && r < best))) {
+                    best = r;
+                }
+            }
+
+            int weight = vertices[v].weight;
+            bool improves = best != own && links[best] > links[own];
+            bool balanced = regionWeight[best] + weight <= maxWeight && regionWeight[own] - weight >= minWeight;
+            if (improves && balanced) {
+                region[v] = best;
+                regionWeight[own] -= weight;
+                regionWeight[best] += weight;
+                moved++;
+            }
+
+            for (int r : touched) {
+                links[r] = 0;
+            }
+        }
+
+        if (moved == 0) break;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <unordered_map>
+
+// Splits a map into regions of roughly equal road count with few roads
+// between regions. Nodes are first split by recursive coordinate bisection,
+// then boundary nodes move to the neighbouring region that cuts fewer roads
+// as long as no region grows past the imbalance tolerance. Every road is
+// owned by the region of its fromNode. The result depends only on the map.
+class GraphPartitioner {
+public:
+    struct Partition {
+        int regions = 0;
+        std::unordered_map<int, int> regionOfNode;
+        std::vector<int> regionOfSlot;       // Owner of each dense edge slot
+        std::vector<int> roadsPerRegion;
+        int cutRoads = 0;                    // Roads whose ends lie in different regions
+    };
+
+    static constexpr float IMBALANCE_TOLERANCE = 1.05f;  // Largest region vs the average
+    static constexpr int REFINEMENT_PASSES = 8;
+
+    static Partition partition(const Graph& map, int regions);
+
+private:
+    struct Vertex {
+        int id;
+        float x, y;
+        int weight;                          // Roads this node owns
+        std::vector<int> neighbors;          // Vertex indices, one entry per road
+    };
+
+    static void bisect(std::vector<Vertex>& vertices, std::vector<int>& members,
+        int firstRegion, int regionCount, std::vector<int>& region);
+    static void refine(const std::vector<Vertex>& vertices, int regions, std::vector<int>& region);
+};
@@ -0,0 +1,631 @@
+#include "HeadlessSimulation.h"
+#include "Checkpoint.h"
+#include "ProcessExchange.h"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+HeadlessSimulation::HeadlessSimulation(Graph& map, const HeadlessOptions& options)
+    : cityMap(map), options(options),
+    predictionSystem(&map),
+    carSim(map, &predictionSystem, subsystemSeed(options, 1)),
+    accidentSystem(&map, subsystemSeed(options, 2)),
+    signalSystem(map, options.signalPlan),
+    clock(options.tickRate, 1),
+    randomGen(subsystemSeed(options, 3)),
+    nextAccidentTime(0.0),
+    nextSampleTime(0.0),
+    vehicleSampleSum(0.0),
+    congestionSampleSum(0.0),
+    sampleCount(0),
+    started(false),
+    failed(false) {
+    if (options.demand) {
+        carSim.setDemandModel(options.demand);
+    }
+    carSim.setArrivalEvents(options.timeWarp);
+    carSim.setTimeOfDay(options.startHour * 3600.0);
+    predictionSystem.setTimeOfWeek(options.startDay * 86400.0 + options.startHour * 3600.0);
+    predictionSystem.setAccidentSystem(&accidentSystem);
+    if (options.profile) {
+        predictionSystem.setProfile(*options.profile);
+    }
+    if (options.signals) {
+        carSim.setSignalSystem(&signalSystem);
+    }
+    if (!options.tripFile.empty()) {
+        tripRecorder = std::make_unique<TripRecorder>(options.tripRecording);
+        if (tripRecorder->open(options.tripFile)) {
+            carSim.setTripRecorder(tripRecorder.get());
+        }
+        else {
+            tripRecorder.reset();
+        }
+    }
+    if (!options.speedFile.empty()) {
+        speedRecorder = std::make_unique<SpeedRecorder>();
+        if (!speedRecorder->open(options.speedFile, map, predictionSystem.getUpdateInterval())) {
+            speedRecorder.reset();
+        }
+    }
+    if (!options.speedFeed.empty()) {
+        speedFeed = std::make_unique<SpeedFeed>();
+        if (!speedFeed->open(options.speedFeed)) {
+            speedFeed.reset();
+        }
+    }
+}
+
+// Every subsystem draws from its own stream of the replica's stream, so adding
+// draws in one system never shifts the random sequence of another
+std::uint64_t HeadlessSimulation::subsystemSeed(const HeadlessOptions& options, std::uint64_t subsystem) {
+    return CounterRng(options.seed).split(options.stream).split(subsystem)();
+}
+
+HeadlessMetrics HeadlessSimulation::run() {
+    if (options.processes > 1) {
+        return runDistributed();
+    }
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    // A loaded checkpoint already carries its fleet, accident schedule and samples
+    if (!started) {
+        spawnInitialCars();
+        if (options.autoSpawn && !carSim.getIsRunning()) {
+            carSim.toggleRunning();
+        }
+        scheduleNextAccident();
+        sampleMetrics();
+        started = true;
+    }
+    applyWhatIfEvents();
+
+    long long totalTicks = std::llround(options.simulatedHours * 3600.0 * options.tickRate);
+    for (long long i = 0; i < totalTicks; ) {
+        long long ticks = options.timeWarp ? quietTicks(totalTicks - i) : 1;
+        advance(ticks);
+        i += ticks;
+    }
+
+    // Accumulates across checkpoint resumes, like simulatedSeconds
+    metrics.wallSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    finalizeMetrics();
+    return metrics;
+}
+
+void HeadlessSimulation::step() {
+    advance(1);
+}
+
+void HeadlessSimulation::advance(long long ticks) {
+    float dt = clock.getTickDuration() * static_cast<float>(ticks);
+
+    carSim.update(dt);
+    accidentSystem.update(dt);
+    feedSpeeds(dt);
+    predictionSystem.update(dt);
+    cityMap.updateAccidents(dt);
+    clock.tick(ticks);
+    if (ticks > 1) {
+        metrics.warpedTicks += ticks;
+    }
+    recordSpeeds();
+
+    double now = clock.getSimulationTime();
+
+    if (options.accidentsPerHour > 0.0f && now >= nextAccidentTime) {
+        int before = accidentSystem.getActiveAccidentCount();
+        accidentSystem.createRandomAccident();
+        if (accidentSystem.getActiveAccidentCount() > before) {
+            metrics.accidentsCreated++;
+        }
+        scheduleNextAccident();
+    }
+
+    if (now >= nextSampleTime) {
+        sampleMetrics();
+    }
+}
+
+// Whole ticks that can run as one step. The last tick before the earliest
+// event stays a single step, so every event happens on the tick it would
+// have without warp, give or take float rounding.
+long long HeadlessSimulation::quietTicks(long long remaining) const {
+    double now = clock.getSimulationTime();
+
+    double quiet = carSim.getQuietSeconds();
+    quiet = std::min(quiet, nextSampleTime - now);
+    if (options.accidentsPerHour > 0.0f) {
+        quiet = std::min(quiet, nextAccidentTime - now);
+    }
+    quiet = std::min(quiet, static_cast<double>(predictionSystem.getSecondsToNextUpdate()));
+    quiet = std::min(quiet, static_cast<double>(accidentSystem.getSecondsToNextClearance()));
+    quiet = std::min(quiet, static_cast<double>(cityMap.getSecondsToNextUnblock()));
+
+    double ticks = std::floor(quiet / clock.getTickDuration()) - 1.0;
+    if (!(ticks > 1.0)) return 1;
+    return std::min(static_cast<long long>(std::min(ticks, static_cast<double>(remaining))), remaining);
+}
+
+namespace {
+    using Car = CarSimulation::Car;
+
+    // Fixed part of a car in a mailbox; its route follows as an array
+    struct CarRecord {
+        int id;
+        int currentPosition;
+        int destination;
+        int previousPosition;
+        int queueSlot;
+        float progress;
+        float previousProgress;
+        std::uint32_t color;
+        double departureTime;
+    };
+
+    bool writeCar(ProcessExchange::Writer& writer, const Car& car) {
+        CarRecord record{ car.id, car.currentPosition, car.destination, car.previousPosition,
+            car.queueSlot, car.progress, car.previousProgress, car.color, car.departureTime };
+        return writer.put(record) && writer.putArray(car.route.data(), car.route.size());
+    }
+
+    bool readCars(ProcessExchange::Reader reader, std::vector<Car>& cars) {
+        while (!reader.atEnd()) {
+            CarRecord record;
+            if (!reader.get(record)) return false;
+
+            Car car(record.id, record.currentPosition, record.destination, record.color);
+            car.previousPosition = record.previousPosition;
+            car.queueSlot = record.queueSlot;
+            car.progress = record.progress;
+            car.previousProgress = record.previousProgress;
+            car.departureTime = record.departureTime;
+            if (!reader.getArray(car.route)) return false;
+            cars.push_back(std::move(car));
+        }
+        return true;
+    }
+
+    // Region owning the road a car is about to drive; cars without one stay
+    // in region 0, as a single process would keep them
+    int regionOfCar(const Graph& map, const std::vector<int>& regionOfSlot, const Car& car) {
+        auto it = std::find(car.route.begin(), car.route.end(), car.currentPosition);
+        if (it == car.route.end() || it + 1 == car.route.end()) return 0;
+
+        int slot = map.findEdgeSlot(car.currentPosition, *(it + 1));
+        return slot == -1 ? 0 : regionOfSlot[slot];
+    }
+
+    // Sum of the detector counts every region reported for tick; false on a
+    // malformed mailbox. Leaves pooled empty before the first report.
+    bool poolDemand(const ProcessExchange& exchange, long long tick,
+        std::vector<int>& counts, std::vector<int>& pooled) {
+        pooled.clear();
+        for (int worker = 0; worker < exchange.getWorkerCount(); worker++) {
+            ProcessExchange::Reader reader = exchange.demandReader(worker, tick);
+            if (reader.atEnd()) continue;
+            if (!reader.getArray(counts)) return false;
+
+            if (pooled.empty()) {
+                pooled = counts;
+            }
+            else if (pooled.size() == counts.size()) {
+                for (size_t i = 0; i < counts.size(); i++) {
+                    pooled[i] += counts[i];
+                }
+            }
+        }
+        return true;
+    }
+}
+
+// Every tick runs in two phases separated by barriers. The coordinator
+// advances the clock, spawns and routes the new cars and posts each to the
+// region of its first road. Then every worker takes in its new cars and the
+// cars that crossed into its region last tick, moves its cars and reports
+// its edge speeds, which the coordinator applies to its own map before
+// prediction and sampling. Signals run in every process on detector counts
+// pooled from all regions, so all copies switch in step. Since the fleet of
+// each region stays ordered by car id, every process sees exactly the state
+// a single process would.
+HeadlessMetrics HeadlessSimulation::runDistributed() {
+    auto wallStart = std::chrono::steady_clock::now();
+
+    if (!ProcessExchange::isSupported()) {
+        std::cerr << "Error: Multi-process simulation needs Linux" << std::endl;
+        failed = true;
+        return metrics;
+    }
+
+    int workers = options.processes;
+    partition = GraphPartitioner::partition(cityMap, workers);
+
+    size_t reportBytes = static_cast<size_t>(cityMap.getEdgeCount()) * (sizeof(int) + sizeof(float)) + 64;
+    ProcessExchange exchange(workers, std::max(options.mailboxBytes, reportBytes));
+    if (!exchange.isValid()) {
+        failed = true;
+        return metrics;
+    }
+
+    if (!started) {
+        spawnInitialCars();
+        if (options.autoSpawn && !carSim.getIsRunning()) {
+            carSim.toggleRunning();
+        }
+        scheduleNextAccident();
+        sampleMetrics();
+        started = true;
+    }
+    applyWhatIfEvents();
+
+    // The workers inherit the initial fleet with the rest of the state
+    std::vector<Car> initialCars;
+    carSim.takeCars(initialCars);
+    carSim.setRemoteCounts(static_cast<int>(initialCars.size()), 0);
+
+    if (!exchange.startWorkers([&](int region) { return runRegion(exchange, region, initialCars); })) {
+        failed = true;
+        return metrics;
+    }
+
+    float dt = clock.getTickDuration();
+    long long totalTicks = std::llround(options.simulatedHours * 3600.0 * options.tickRate);
+
+    std::vector<Car> spawned;
+    std::vector<ProcessExchange::Writer> spawnWriters;
+    std::vector<int> counts, pooled;
+    std::vector<int> slots;
+    std::vector<float> speeds;
+
+    for (long long tick = 0; tick < totalTicks && !failed; tick++) {
+        if (options.signals) {
+            poolDemand(exchange, tick - 1, counts, pooled);
+            signalSystem.setDemandCounts(pooled);
+        }
+        carSim.advanceClock(dt);
+        carSim.spawnVehicles(dt);
+
+        carSim.takeCars(spawned);
+        spawnWriters.clear();
+        for (int worker = 0; worker < workers; worker++) {
+            spawnWriters.push_back(exchange.spawnWriter(worker, tick));
+        }
+        for (const Car& car : spawned) {
+            if (!writeCar(spawnWriters[regionOfCar(cityMap, partition.regionOfSlot, car)], car)) {
+                std::cerr << "Error: New cars overflowed a " << exchange.getMailboxBytes()
+                    << " byte mailbox" << std::endl;
+                exchange.abort();
+                failed = true;
+                break;
+            }
+        }
+
+        if (failed || !exchange.barrier() || !exchange.barrier()) {
+            failed = true;
+            break;
+        }
+
+        int vehicles = 0;
+        long long completed = 0;
+        for (int worker = 0; worker < workers; worker++) {
+            ProcessExchange::Reader reader = exchange.reportReader(worker, tick);
+            long long workerCompleted = 0;
+            int workerVehicles = 0;
+            if (!reader.get(workerCompleted) || !reader.get(workerVehicles) ||
+                !reader.getArray(slots) || !reader.getArray(speeds)) {
+                std::cerr << "Error: Region " << worker << " sent a malformed report" << std::endl;
+                exchange.abort();
+                failed = true;
+                break;
+            }
+
+            cityMap.updateEdgeTrafficBatch(slots, speeds);
+            completed += workerCompleted;
+            vehicles += workerVehicles;
+        }
+        if (failed) break;
+
+        carSim.setRemoteCounts(vehicles, completed);
+        accidentSystem.update(dt);
+        feedSpeeds(dt);
+        predictionSystem.update(dt);
+        cityMap.updateAccidents(dt);
+        clock.tick();
+        recordSpeeds();
+
+        if (clock.getSimulationTime() >= nextSampleTime) {
+            sampleMetrics();
+        }
+    }
+
+    if (!exchange.stopWorkers()) {
+        failed = true;
+    }
+
+    metrics.wallSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    finalizeMetrics();
+    return metrics;
+}
+
+// Worker process body: the second phase of every tick for one region
+int HeadlessSimulation::runRegion(ProcessExchange& exchange, int region, const std::vector<Car>& initialCars) {
+    int workers = exchange.getWorkerCount();
+    float dt = clock.getTickDuration();
+
+    carSim.setRegion(&partition.regionOfSlot, region);
+    carSim.setRemoteCounts(0, 0);
+
+    std::vector<Car> incoming;
+    for (const Car& car : initialCars) {
+        if (regionOfCar(cityMap, partition.regionOfSlot, car) == region) {
+            incoming.push_back(car);
+        }
+    }
+    carSim.insertCars(incoming);
+
+    std::vector<Car> emigrants;
+    std::vector<ProcessExchange::Writer> migrantWriters;
+    std::vector<int> counts, pooled;
+
+    for (long long tick = 0; ; tick++) {
+        if (!exchange.barrier()) return 1;
+        if (exchange.isStopping()) return 0;
+
+        bool ok = readCars(exchange.spawnReader(region, tick), incoming);
+        for (int from = 0; from < workers; from++) {
+            if (from != region) {
+                ok = readCars(exchange.migrantReader(from, region, tick - 1), incoming) && ok;
+            }
+        }
+        carSim.insertCars(incoming);
+
+        if (options.signals) {
+            ok = poolDemand(exchange, tick - 1, counts, pooled) && ok;
+            signalSystem.setDemandCounts(pooled);
+        }
+        carSim.advanceClock(dt);
+        carSim.moveVehicles(dt);
+        cityMap.updateAccidents(dt);
+
+        carSim.takeEmigrants(emigrants);
+        migrantWriters.clear();
+        for (int to = 0; to < workers; to++) {
+            migrantWriters.push_back(exchange.migrantWriter(region, to, tick));
+        }
+        for (const Car& car : emigrants) {
+            ok = ok && writeCar(migrantWriters[regionOfCar(cityMap, partition.regionOfSlot, car)], car);
+        }
+
+        ProcessExchange::Writer demandWriter = exchange.demandWriter(region, tick);
+        if (options.signals) {
+            signalSystem.getDemandCounts(counts);
+            ok = ok && demandWriter.putArray(counts.data(), counts.size());
+        }
+
+        // Emigrants are still on the road this tick, as in a single process
+        ProcessExchange::Writer reportWriter = exchange.reportWriter(region, tick);
+        const auto& slots = carSim.getTrafficSlots();
+        const auto& speeds = carSim.getTrafficSpeeds();
+        ok = ok && reportWriter.put(carSim.getLocalCompletedTrips()) &&
+            reportWriter.put(carSim.getVehicleCount() + static_cast<int>(emigrants.size())) &&
+            reportWriter.putArray(slots.data(), slots.size()) &&
+            reportWriter.putArray(speeds.data(), speeds.size());
+
+        if (!ok) {
+            std::cerr << "Error: Region " << region << " overflowed a " << exchange.getMailboxBytes()
+                << " byte mailbox" << std::endl;
+            exchange.abort();
+            return 1;
+        }
+
+        if (!exchange.barrier()) return 1;
+    }
+}
+
+void HeadlessSimulation::spawnInitialCars() {
+    carSim.addRandomCars(options.initialCars);
+}
+
+void HeadlessSimulation::applyWhatIfEvents() {
+    for (int edgeId : options.accidentEdges) {
+        if (!cityMap.hasEdge(edgeId)) {
+            std::cerr << "Warning: No road " << edgeId << " for the accident" << std::endl;
+            continue;
+        }
+        int before = accidentSystem.getActiveAccidentCount();
+        accidentSystem.createAccident(edgeId);
+        if (accidentSystem.getActiveAccidentCount() > before) {
+            metrics.accidentsCreated++;
+        }
+    }
+
+    float runSeconds = static_cast<float>(options.simulatedHours * 3600.0);
+    for (int edgeId : options.closedEdges) {
+        if (!cityMap.hasEdge(edgeId)) {
+            std::cerr << "Warning: No road " << edgeId << " to close" << std::endl;
+            continue;
+        }
+        cityMap.blockEdge(edgeId, runSeconds);
+    }
+}
+
+// Exponential inter-arrival times give a Poisson process of accidents
+void HeadlessSimulation::scheduleNextAccident() {
+    if (options.accidentsPerHour <= 0.0f) return;
+
+    std::exponential_distribution<double> interval(options.accidentsPerHour / 3600.0);
+    nextAccidentTime = clock.getSimulationTime() + interval(randomGen);
+}
+
+// At most one frame per prediction round, however many ticks a step covered
+void HeadlessSimulation::recordSpeeds() {
+    if (speedRecorder) {
+        speedRecorder->record(*predictionSystem.getSnapshot(), cityMap, clock.getSimulationTime());
+    }
+}
+
+// Observations up to the end of the step reach the round it may close
+void HeadlessSimulation::feedSpeeds(float dt) {
+    if (speedFeed) {
+        speedFeed->pump(clock.getSimulationTime() + dt, predictionSystem);
+    }
+}
+
+void HeadlessSimulation::sampleMetrics() {
+    int vehicles = carSim.getVehicleCount();
+    metrics.peakVehicles = std::max(metrics.peakVehicles, vehicles);
+    vehicleSampleSum += vehicles;
+
+    const auto& edges = cityMap.getAllEdges();
+    int congested = 0;
+    for (const auto& pair : edges) {
+        if (pair.second.trafficLevel == TrafficLevel::CONGESTED ||
+            pair.second.trafficLevel == TrafficLevel::BLOCKED) {
+            congested++;
+        }
+    }
+
+    float congestion = edges.empty() ? 0.0f : static_cast<float>(congested) / edges.size();
+    metrics.peakCongestion = std::max(metrics.peakCongestion, congestion);
+    congestionSampleSum += congestion;
+
+    sampleCount++;
+    nextSampleTime = clock.getSimulationTime() + options.sampleInterval;
+}
+
+void HeadlessSimulation::finalizeMetrics() {
+    metrics.simulatedSeconds = clock.getSimulationTime();
+    metrics.ticks = clock.getTickCount();
+    metrics.completedTrips = carSim.getCompletedTrips();
+    metrics.finalVehicles = carSim.getVehicleCount();
+
+    if (sampleCount > 0) {
+        metrics.averageVehicles = static_cast<float>(vehicleSampleSum / sampleCount);
+        metrics.averageCongestion = static_cast<float>(congestionSampleSum / sampleCount);
+    }
+
+    metrics.predictedCongestion = predictionSystem.getPredictedCongestionCount();
+    metrics.predictionAccuracy = predictionSystem.getAveragePredictionAccuracy();
+
+    metrics.incidentsRaised = accidentSystem.getIncidentsRaised();
+    metrics.accidentsDetected = accidentSystem.getAccidentsDetected();
+    metrics.meanDetectionSeconds = accidentSystem.getMeanDetectionSeconds();
+}
+
+void HeadlessSimulation::writeMetrics(const HeadlessMetrics& metrics, std::ostream& out) {
+    out << "metric,value\n";
+    out << "simulated_seconds," << metrics.simulatedSeconds << "\n";
+    out << "wall_seconds," << metrics.wallSeconds << "\n";
+    out << "speedup," << metrics.getSpeedup() << "\n";
+    out << "ticks," << metrics.ticks << "\n";
+    out << "completed_trips," << metrics.completedTrips << "\n";
+    out << "final_vehicles," << metrics.finalVehicles << "\n";
+    out << "peak_vehicles," << metrics.peakVehicles << "\n";
+    out << "average_vehicles," << metrics.averageVehicles << "\n";
+    out << "accidents_created," << metrics.accidentsCreated << "\n";
+    out << "average_congestion," << metrics.averageCongestion << "\n";
+    out << "peak_congestion," << metrics.peakCongestion << "\n";
+    out << "predicted_congestion," << metrics.predictedCongestion << "\n";
+    out << "prediction_accuracy," << metrics.predictionAccuracy << "\n";
+    out << "incidents_raised," << metrics.incidentsRaised << "\n";
+    out << "accidents_detected," << metrics.accidentsDetected << "\n";
+    out << "mean_detection_seconds," << metrics.meanDetectionSeconds << "\n";
+}
+
+void HeadlessSimulation::reseed() {
+    carSim.reseed(subsystemSeed(options, 1));
+    accidentSystem.reseed(subsystemSeed(options, 2));
+    randomGen = CounterRng(subsystemSeed(options, 3));
+    scheduleNextAccident();
+}
+
+bool HeadlessSimulation::saveProfile(const std::string& filename) const {
+    return predictionSystem.saveProfile(filename);
+}
+
+bool HeadlessSimulation::saveCheckpoint(const std::string& filename) const {
+    BinaryWriter writer(filename);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    writer.write(CheckpointFormat::MAGIC);
+    writer.write(CheckpointFormat::VERSION);
+
+    writer.writeTag("HDLS");
+    writer.write(options.tickRate);
+    writer.write(clock.getTickCount());
+    writer.write(clock.getAccumulator());
+    writer.write(randomGen.getKey());
+    writer.write(randomGen.getCounter());
+    writer.write(nextAccidentTime);
+    writer.write(nextSampleTime);
+    writer.write(metrics);
+    writer.write(vehicleSampleSum);
+    writer.write(congestionSampleSum);
+    writer.write(sampleCount);
+
+    cityMap.saveState(writer);
+    carSim.saveState(writer);
+    signalSystem.saveState(writer);
+    accidentSystem.saveState(writer);
+    predictionSystem.saveState(writer);
+
+    if (!writer.good()) {
+        std::cerr << "Error: Failed writing checkpoint " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessSimulation::loadCheckpoint(const std::string& filename) {
+    BinaryReader reader(filename);
+    if (!reader.isOpen()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    if (!reader.read(magic) || std::memcmp(magic, CheckpointFormat::MAGIC, 4) != 0 ||
+        !reader.read(version) || version != CheckpointFormat::VERSION) {
+        std::cerr << "Error: " << filename << " is not a version "
+            << CheckpointFormat::VERSION << " checkpoint" << std::endl;
+        return false;
+    }
+
+    float savedTickRate;
+    long long savedTicks;
+    float savedAccumulator;
+    std::uint64_t rngKey, rngCounter;
+    if (!reader.expectTag("HDLS") || !reader.read(savedTickRate) || !reader.read(savedTicks) ||
+        !reader.read(savedAccumulator) || !reader.read(rngKey) || !reader.read(rngCounter) ||
+        !reader.read(nextAccidentTime) || !reader.read(nextSampleTime) || !reader.read(metrics) ||
+        !reader.read(vehicleSampleSum) || !reader.read(congestionSampleSum) || !reader.read(sampleCount)) {
+        std::cerr << "Error: Corrupt checkpoint header in " << filename << std::endl;
+        return false;
+    }
+
+    if (savedTickRate != options.tickRate) {
+        std::cerr << "Error: Checkpoint was saved at " << savedTickRate << " Hz, this run uses "
+            << options.tickRate << " Hz" << std::endl;
+        return false;
+    }
+
+    if (!cityMap.loadState(reader) || !carSim.loadState(reader) || !signalSystem.loadState(reader) ||
+        !accidentSystem.loadState(reader) || !predictionSystem.loadState(reader)) {
+        std::cerr << "Error: Could not restore simulation state from " << filename << std::endl;
+        return false;
+    }
+
+    clock.restore(savedTicks, savedAccumulator);
+    randomGen.setState(rngKey, rngCounter);
+    started = true;
+    return true;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include "Graph.h"
+#include "CarSimulation.h"
+#include "AccidentSystem.h"
+#include "PredictionSystem.h"
+#include "SignalSystem.h"
+#include "TripRecorder.h"
+#include "SpeedRecorder.h"
+#include "SpeedFeed.h"
+#include "SimulationClock.h"
+#include "GraphPartitioner.h"
+#include "Config.h"
+#include "Random.h"
+#include <ostream>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+class ProcessExchange;
+
+struct HeadlessOptions {
+    double simulatedHours = 1.0;
+    float tickRate = SimConfig::TICK_RATE_HZ;
+    int initialCars = 50;
+    bool autoSpawn = true;               // CarSimulation's built-in traffic generator
+    float accidentsPerHour = 2.0f;       // Poisson rate of random accidents
+    float sampleInterval = 60.0f;        // Seconds of simulated time between metric samples
+    std::uint64_t seed = 1;              // Master seed
+    std::uint64_t stream = 0;            // Replica index, selects an independent RNG stream
+
+    float startHour = SimConfig::DAY_START_HOUR;
+    int startDay = 0;                    // Day of the week, 0 = Monday
+    std::shared_ptr<const DemandModel> demand;  // OD matrix shared by all replicas, null = uniform
+
+    bool signals = true;                 // Traffic lights at intersections of MIN_APPROACHES roads
+    SignalPlan signalPlan = SignalPlan::FIXED_TIME;
+
+    std::string tripFile;                // Binary trip records, empty = not recorded
+    TripRecorderOptions tripRecording;
+    std::string speedFile;               // Edge speeds once per prediction round, empty = not recorded
+    std::shared_ptr<const SpeedProfile> profile;    // Time-of-week profile to start from, null = empty
+    std::string speedFeed;               // External speed observations (see SpeedFeed), empty = none
+
+    // Split the map into this many regions, each simulated by its own process
+    // (Linux only). Results match a single process exactly.
+    int processes = 1;
+    size_t mailboxBytes = 4u << 20;      // Per mailbox; grown to fit a full edge report
+
+    // Skip ahead over ticks in which nothing can happen: no car reaches a
+    // node or a queue, no car spawns, no signal, accident or prediction is
+    // due. Ticks still have options.tickRate resolution; results are
+    // statistically, not bit-for-bit, equal to a run without warp.
+    bool timeWarp = false;
+
+    // What-if events applied when the run starts, typically after loading a checkpoint
+    std::vector<int> accidentEdges;      // Accident of the default duration on each edge
+    std::vector<int> closedEdges;        // Closed for the whole run
+};
+
+struct HeadlessMetrics {
+    double simulatedSeconds = 0.0;
+    double wallSeconds = 0.0;
+    long long ticks = 0;
+    long long warpedTicks = 0;           // Ticks covered by time warp steps of more than one tick
+
+    long long completedTrips = 0;
+    int finalVehicles = 0;
+    int peakVehicles = 0;
+    float averageVehicles = 0.0f;
+
+    int accidentsCreated = 0;
+    float averageCongestion = 0.0f;      // Fraction of roads CONGESTED or BLOCKED
+    float peakCongestion = 0.0f;
+
+    int predictedCongestion = 0;
+    float predictionAccuracy = 0.0f;
+
+    int incidentsRaised = 0;             // Candidate incidents from speed drops, on roads without an accident
+    int accidentsDetected = 0;           // Accidents the incident detector flagged
+    float meanDetectionSeconds = 0.0f;   // From an accident's start to its detection
+
+    double getSpeedup() const { return wallSeconds > 0.0 ? simulatedSeconds / wallSeconds : 0.0; }
+};
+
+// Runs CarSimulation, SignalSystem, AccidentSystem and PredictionSystem on a fixed timestep
+// as fast as the CPU allows, without any window. Used by the headless runner.
+//
+// With options.processes > 1 the map is partitioned and every region's cars
+// move in a forked worker process. The coordinator (this process) keeps the
+// clock, spawns and routes new cars, and runs prediction and metrics on the
+// speeds the workers report. Cars cross regions through shared-memory
+// mailboxes between two barriers per tick. Accidents are not supported.
+class HeadlessSimulation {
+private:
+    Graph& cityMap;
+    HeadlessOptions options;
+
+    PredictionSystem predictionSystem;
+    CarSimulation carSim;
+    AccidentSystem accidentSystem;
+    SignalSystem signalSystem;
+    SimulationClock clock;
+    std::unique_ptr<TripRecorder> tripRecorder;
+    std::unique_ptr<SpeedRecorder> speedRecorder;
+    std::unique_ptr<SpeedFeed> speedFeed;
+
+    CounterRng randomGen;
+    double nextAccidentTime;
+    double nextSampleTime;
+
+    HeadlessMetrics metrics;
+    double vehicleSampleSum;
+    double congestionSampleSum;
+    int sampleCount;
+    bool started;                        // Set once initial cars exist, either spawned or loaded
+    bool failed;                         // A multi-process run lost a worker or a mailbox overflowed
+    GraphPartitioner::Partition partition;
+
+public:
+    HeadlessSimulation(Graph& map, const HeadlessOptions& options = HeadlessOptions());
+
+    // Run for options.simulatedHours and return the aggregate metrics
+    HeadlessMetrics run();
+
+    // False if a multi-process run stopped early; its metrics are incomplete
+    bool hasFailed() const { return failed; }
+    const GraphPartitioner::Partition& getPartition() const { return partition; }
+    CarSimulation::PoolStats getPoolStats() const { return carSim.getPoolStats(); }
+
+    // Advance a single tick
+    void step();
+
+    // Advance ticks ticks in one step; only safe up to quietTicks()
+    void advance(long long ticks);
+
+    // Full simulation state: clock, fleet, edge traffic, signals, accidents,
+    // prediction histories and every RNG. A loaded checkpoint continues exactly where the
+    // saved run stopped; call reseed() afterwards to fork a different future.
+    bool saveCheckpoint(const std::string& filename) const;
+    bool loadCheckpoint(const std::string& filename);
+
+    // Re-derive all RNG streams from options.seed and options.stream
+    void reseed();
+
+    // Null unless options.tripFile was given and could be opened
+    TripRecorder* getTripRecorder() { return tripRecorder.get(); }
+    // Null unless options.speedFile was given and could be opened
+    SpeedRecorder* getSpeedRecorder() { return speedRecorder.get(); }
+    // Null unless options.speedFeed was given and could be opened
+    SpeedFeed* getSpeedFeed() { return speedFeed.get(); }
+
+    // The time-of-week profile as learned so far, including the current bin
+    bool saveProfile(const std::string& filename) const;
+    const SpeedProfile& getProfile() const { return predictionSystem.getProfile(); }
+
+    const HeadlessMetrics& getMetrics() const { return metrics; }
+    double getSimulationTime() const { return clock.getSimulationTime(); }
+
+    // Key/value CSV, one metric per line
+    static void writeMetrics(const HeadlessMetrics& metrics, std::ostream& out);
+
+private:
+    static std::uint64_t subsystemSeed(const HeadlessOptions& options, std::uint64_t subsystem);
+
+    HeadlessMetrics runDistributed();
+    int runRegion(ProcessExchange& exchange, int region, const std::vector<CarSimulation::Car>& initialCars);
+
+    long long quietTicks(long long remaining) const;
+
+    void spawnInitialCars();
+    void applyWhatIfEvents();
+    void scheduleNextAccident();
+    void sampleMetrics();
+    void recordSpeeds();
+    void feedSpeeds(float dt);
+    void finalizeMetrics();
+};
@@ -0,0 +1,69 @@
+#include "IncidentDetector.h"
+#include "Config.h"
+#include <algorithm>
+#include <cmath>
+
+IncidentDetector::IncidentDetector()
+    : IncidentDetector(PredictionConfig::INCIDENT_SMOOTHING, PredictionConfig::INCIDENT_SLACK,
+        PredictionConfig::INCIDENT_THRESHOLD, PredictionConfig::INCIDENT_MIN_DEVIATION,
+        PredictionConfig::INCIDENT_WARMUP_ROUNDS) {
+}
+
+IncidentDetector::IncidentDetector(float smoothing, float slack, float threshold, float minDeviation,
+    int warmupRounds)
+    : smoothing(smoothing), slack(slack), threshold(threshold), minDeviation(minDeviation),
+    warmupRounds(static_cast<float>(warmupRounds)) {
+}
+
+void IncidentDetector::resize(size_t rowCount) {
+    states.assign(rowCount, State());
+}
+
+// Exponentially weighted mean and variance; the first residual sets the mean
+void IncidentDetector::track(float residual, float& mean, float& variance, float& samples) const {
+    if (samples == 0.0f) {
+        mean = residual;
+        variance = 0.0f;
+    }
+    else {
+        float difference = residual - mean;
+        mean += smoothing * difference;
+        variance = (1.0f - smoothing) * (variance + smoothing * difference * difference);
+    }
+    samples++;
+}
+
+float IncidentDetector::deviation(float residual, float mean, float variance) const {
+    return (residual - mean) / std::max(std::sqrt(variance), minDeviation);
+}
+
+void IncidentDetector::update(const float* shares, const float* neighborShares, const float* profileShares,
+    std::vector<int>& alarms) {
+    int rows = static_cast<int>(states.size());
+    for (int row = 0; row < rows; row++) {
+        State& s = states[row];
+        float neighborResidual = shares[row] - neighborShares[row];
+        bool profiled = profileShares[row] >= 0.0f;
+        float profileResidual = profiled ? shares[row] - profileShares[row] : 0.0f;
+
+        if (s.samples >= warmupRounds) {
+            float z = deviation(neighborResidual, s.neighborMean, s.neighborVariance);
+            if (profiled && s.profileSamples >= warmupRounds) {
+                z = std::max(z, deviation(profileResidual, s.profileMean, s.profileVariance));
+            }
+
+            s.cusum = std::max(0.0f, s.cusum - z - slack);
+            if (s.cusum > threshold) {
+                alarms.push_back(row);
+                s.cusum = 0.0f;
+            }
+        }
+
+        if (s.cusum == 0.0f) {
+            track(neighborResidual, s.neighborMean, s.neighborVariance, s.samples);
+            if (profiled) {
+                track(profileResidual, s.profileMean, s.profileVariance, s.profileSamples);
+            }
+        }
+    }
+}
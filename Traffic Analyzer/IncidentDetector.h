@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Watches each edge's speed, as a share of its limit, for a drop that
+// neighbouring roads and the time-of-week profile do not explain. Every
+// round gives two residuals per edge:
+//
+//   share - mean share of the roads meeting it
+//   share - profile share at this time of week
+//
+// Each has an EWMA baseline of its mean and variance, so an edge that is
+// always slower than its neighbours is normal for that edge. The larger of
+// the two standardised residuals feeds a lower CUSUM, so a drop only counts
+// while the edge is below both references:
+//
+//   S = max(0, S - z - slack),  alarm when S > threshold
+//
+// Baselines only learn while S is 0, so a drop in progress is not absorbed
+// before it is flagged. An alarm resets S. Every update is O(1) per edge.
+class IncidentDetector {
+public:
+    // One edge's baselines and statistic, copied when rows move and written
+    // to checkpoints
+    struct State {
+        float neighborMean = 0.0f;
+        float neighborVariance = 0.0f;
+        float profileMean = 0.0f;
+        float profileVariance = 0.0f;
+        float cusum = 0.0f;
+        float samples = 0.0f;            // Rounds in the neighbour baseline
+        float profileSamples = 0.0f;     // Rounds in the profile baseline
+    };
+
+private:
+    float smoothing;                     // EWMA weight of a new round
+    float slack;                         // Deviations a round must fall by to add to S
+    float threshold;
+    float minDeviation;                  // Floor under a baseline's standard deviation
+    float warmupRounds;                  // Rounds of baseline before a residual is judged
+
+    std::vector<State> states;
+
+    void track(float residual, float& mean, float& variance, float& samples) const;
+    float deviation(float residual, float mean, float variance) const;
+
+public:
+    // With the parameters in PredictionConfig
+    IncidentDetector();
+    IncidentDetector(float smoothing, float slack, float threshold, float minDeviation, int warmupRounds);
+
+    // Empties every row
+    void resize(size_t rowCount);
+    size_t getRowCount() const { return states.size(); }
+
+    // One round. profileShares is negative for rows without a profile;
+    // rows that alarm are appended to alarms
+    void update(const float* shares, const float* neighborShares, const float* profileShares,
+        std::vector<int>& alarms);
+
+    float getStatistic(size_t row) const { return states[row].cusum; }
+    const State& getState(size_t row) const { return states[row]; }
+    void setState(size_t row, const State& state) { states[row] = state; }
+};
@@ -0,0 +1,286 @@
+#include "MesoscopicSimulation.h"
+#include "Config.h"
+#include <algorithm>
+#include <iostream>
+
+MesoscopicSimulation::MesoscopicSimulation(const Graph& map)
+    : cityMap(map), nextSequence(0), nextVehicleId(1), currentTime(0.0f),
+    simulationSpeed(1.0f), activeVehicles(0), completedTrips(0),
+    totalTripTime(0.0), processedEvents(0), linkTransitions(0) {
+    rebuildNetwork();
+}
+
+long long MesoscopicSimulation::linkKey(int fromNode, int toNode) {
+    return (static_cast<long long>(fromNode) << 32) | static_cast<unsigned int>(toNode);
+}
+
+void MesoscopicSimulation::rebuildNetwork() {
+    clearAllVehicles();
+    links.clear();
+    linkLookup.clear();
+    edgeToFirstLink.clear();
+
+    // Sort by id so link indices do not depend on hash map iteration order
+    std::vector<const Edge*> sortedEdges;
+    for (const auto& pair : cityMap.getAllEdges()) {
+        sortedEdges.push_back(&pair.second);
+    }
+    std::sort(sortedEdges.begin(), sortedEdges.end(),
+        [](const Edge* a, const Edge* b) { return a->id < b->id; });
+
+    links.reserve(sortedEdges.size() * 2);
+    for (const Edge* edge : sortedEdges) {
+        float speedMs = std::max(edge->speedLimit, 1) / 3.6f;
+        float freeFlowTime = std::max(edge->length, 1.0f) / speedMs;
+        int capacity = std::max(1, static_cast<int>(edge->length / MesoConfig::JAM_SPACING_METERS));
+
+        edgeToFirstLink[edge->id] = static_cast<int>(links.size());
+
+        // Roads are two-way, so every edge carries one queue per direction
+        for (int direction = 0; direction < 2; direction++) {
+            Link link;
+            link.edgeId = edge->id;
+            link.fromNode = direction == 0 ? edge->fromNodeId : edge->toNodeId;
+            link.toNode = direction == 0 ? edge->toNodeId : edge->fromNodeId;
+            link.edge = edge;
+            link.freeFlowTime = freeFlowTime;
+            link.capacity = capacity;
+            link.lastExitTime = -MesoConfig::SATURATION_HEADWAY;
+
+            linkLookup[linkKey(link.fromNode, link.toNode)] = static_cast<int>(links.size());
+            links.push_back(link);
+        }
+    }
+}
+
+int MesoscopicSimulation::findLink(int fromNode, int toNode) const {
+    auto it = linkLookup.find(linkKey(fromNode, toNode));
+    return it != linkLookup.end() ? it->second : -1;
+}
+
+bool MesoscopicSimulation::addTrip(int startNode, int endNode, const std::vector<int>& route) {
+    return addTrip(startNode, endNode, route, currentTime);
+}
+
+bool MesoscopicSimulation::addTrip(int startNode, int endNode,
+    const std::vector<int>& route, float departureTime) {
+    if (route.size() < 2) return false;
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<int>(vehicles.size());
+        vehicles.emplace_back();
+    }
+
+    Vehicle& vehicle = vehicles[slot];
+    vehicle.links.clear();
+    for (size_t i = 0; i + 1 < route.size(); i++) {
+        int link = findLink(route[i], route[i + 1]);
+        if (link == -1) {
+            freeSlots.push_back(slot);
+            return false;
+        }
+        vehicle.links.push_back(link);
+    }
+
+    vehicle.id = nextVehicleId++;
+    vehicle.startNode = startNode;
+    vehicle.destination = endNode;
+    vehicle.linkPosition = -1;
+    vehicle.departureTime = std::max(departureTime, currentTime);
+    vehicle.linkEntryTime = vehicle.departureTime;
+    vehicle.linkExitTime = vehicle.departureTime;
+    vehicle.state = VehicleState::PENDING_DEPARTURE;
+
+    activeVehicles++;
+    schedule(slot, vehicle.departureTime);
+    return true;
+}
+
+void MesoscopicSimulation::update(float deltaTime) {
+    runUntil(currentTime + deltaTime * simulationSpeed);
+}
+
+void MesoscopicSimulation::runUntil(float endTime) {
+    while (!events.empty() && events.top().time <= endTime) {
+        Event event = events.top();
+        events.pop();
+
+        currentTime = event.time;
+        processEvent(event);
+        processedEvents++;
+    }
+
+    currentTime = std::max(currentTime, endTime);
+}
+
+void MesoscopicSimulation::clearAllVehicles() {
+    vehicles.clear();
+    freeSlots.clear();
+    events = std::priority_queue<Event, std::vector<Event>, CompareEvent>();
+
+    for (auto& link : links) {
+        link.queue.clear();
+        link.waiting.clear();
+        link.lastExitTime = -MesoConfig::SATURATION_HEADWAY;
+    }
+
+    activeVehicles = 0;
+}
+
+void MesoscopicSimulation::schedule(int vehicle, float time) {
+    events.push(Event{ time, nextSequence++, vehicle });
+}
+
+float MesoscopicSimulation::linkTravelTime(const Link& link) const {
+    // Speed falls linearly with occupancy; current traffic level (rush hour,
+    // hotspots, accidents) scales the free-flow time on top of that.
+    float occupancy = static_cast<float>(link.queue.size()) / link.capacity;
+    float speedFraction = std::max(MesoConfig::MIN_SPEED_FRACTION, 1.0f - occupancy);
+
+    float trafficFactor = 1.0f;
+    if (link.edge->baseTravelTime > 0.0f) {
+        trafficFactor = std::max(1.0f, link.edge->currentTravelTime / link.edge->baseTravelTime);
+    }
+
+    return link.freeFlowTime * trafficFactor / speedFraction;
+}
+
+void MesoscopicSimulation::processEvent(const Event& event) {
+    Vehicle& vehicle = vehicles[event.vehicle];
+    float time = event.time;
+
+    // Departure: try to enter the first link of the route
+    if (vehicle.linkPosition < 0) {
+        Link& first = links[vehicle.links[0]];
+        bool wasWaiting = vehicle.state == VehicleState::WAITING_TO_ENTER;
+        bool hasRoom = static_cast<int>(first.queue.size()) < first.capacity;
+
+        if (hasRoom && (wasWaiting || first.waiting.empty())) {
+            enterLink(event.vehicle, vehicle.links[0], time);
+        }
+        else {
+            vehicle.state = VehicleState::WAITING_TO_ENTER;
+            if (wasWaiting) first.waiting.push_front(event.vehicle);
+            else first.waiting.push_back(event.vehicle);
+        }
+        return;
+    }
+
+    int currentLink = vehicle.links[vehicle.linkPosition];
+    Link& link = links[currentLink];
+
+    // FIFO: only the queue head may leave, the others are woken in order
+    if (link.queue.front() != event.vehicle) {
+        vehicle.state = VehicleState::QUEUED;
+        return;
+    }
+
+    float earliestExit = link.lastExitTime + MesoConfig::SATURATION_HEADWAY;
+    if (time < earliestExit) {
+        vehicle.state = VehicleState::TRAVELLING;
+        schedule(event.vehicle, earliestExit);
+        return;
+    }
+
+    if (link.edge->isBlocked) {
+        vehicle.state = VehicleState::TRAVELLING;
+        schedule(event.vehicle, time + MesoConfig::BLOCKED_RECHECK_INTERVAL);
+        return;
+    }
+
+    if (vehicle.linkPosition + 1 == static_cast<int>(vehicle.links.size())) {
+        leaveLink(currentLink, time);
+        finishTrip(event.vehicle, time);
+        return;
+    }
+
+    int nextLink = vehicle.links[vehicle.linkPosition + 1];
+    Link& next = links[nextLink];
+    if (static_cast<int>(next.queue.size()) >= next.capacity) {
+        // Spillback: hold the head of this link until the next one frees a slot
+        bool wasBlocked = vehicle.state == VehicleState::BLOCKED;
+        vehicle.state = VehicleState::BLOCKED;
+        if (wasBlocked) next.waiting.push_front(event.vehicle);
+        else next.waiting.push_back(event.vehicle);
+        return;
+    }
+
+    leaveLink(currentLink, time);
+    enterLink(event.vehicle, nextLink, time);
+}
+
+void MesoscopicSimulation::enterLink(int vehicleIndex, int linkIndex, float time) {
+    Vehicle& vehicle = vehicles[vehicleIndex];
+    Link& link = links[linkIndex];
+
+    link.queue.push_back(vehicleIndex);
+    linkTransitions++;
+    vehicle.linkPosition++;
+    vehicle.linkEntryTime = time;
+    vehicle.linkExitTime = time + linkTravelTime(link);
+    vehicle.state = VehicleState::TRAVELLING;
+
+    schedule(vehicleIndex, vehicle.linkExitTime);
+}
+
+void MesoscopicSimulation::leaveLink(int linkIndex, float time) {
+    Link& link = links[linkIndex];
+    link.queue.pop_front();
+    link.lastExitTime = time;
+
+    // Wake the new head if it already reached the end of the link
+    if (!link.queue.empty()) {
+        Vehicle& head = vehicles[link.queue.front()];
+        if (head.state == VehicleState::QUEUED) {
+            head.state = VehicleState::TRAVELLING;
+            schedule(link.queue.front(),
+                std::max(head.linkExitTime, time + MesoConfig::SATURATION_HEADWAY));
+        }
+    }
+
+    // A slot opened up: let the first upstream vehicle in
+    if (!link.waiting.empty()) {
+        int waiting = link.waiting.front();
+        link.waiting.pop_front();
+        schedule(waiting, time);
+    }
+}
+
+void MesoscopicSimulation::finishTrip(int vehicleIndex, float time) {
+    Vehicle& vehicle = vehicles[vehicleIndex];
+    vehicle.state = VehicleState::FINISHED;
+
+    completedTrips++;
+    totalTripTime += time - vehicle.departureTime;
+    activeVehicles--;
+    freeSlots.push_back(vehicleIndex);
+}
+
+float MesoscopicSimulation::getAverageTripTime() const {
+    return completedTrips > 0 ? static_cast<float>(totalTripTime / completedTrips) : 0.0f;
+}
+
+int MesoscopicSimulation::getVehiclesOnEdge(int edgeId) const {
+    auto it = edgeToFirstLink.find(edgeId);
+    if (it == edgeToFirstLink.end()) return 0;
+
+    return static_cast<int>(links[it->second].queue.size() +
+        links[it->second + 1].queue.size());
+}
+
+float MesoscopicSimulation::getVehicleProgress(const Vehicle& vehicle) const {
+    if (vehicle.linkPosition < 0) return 0.0f;
+    if (vehicle.state == VehicleState::QUEUED || vehicle.state == VehicleState::BLOCKED) {
+        return 1.0f;
+    }
+
+    float duration = vehicle.linkExitTime - vehicle.linkEntryTime;
+    if (duration <= 0.0f) return 1.0f;
+
+    return std::min(1.0f, (currentTime - vehicle.linkEntryTime) / duration);
+}
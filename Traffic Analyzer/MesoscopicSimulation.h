@@ -0,0 +1,120 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+
+// Discrete-event, queue-based alternative to CarSimulation.
+// Every directed edge is a FIFO whose storage capacity comes from Edge::length.
+// Vehicles are only touched when they enter or leave an edge, so the cost of a
+// run is proportional to the number of edge transitions, not cars x frames.
+class MesoscopicSimulation {
+public:
+    enum class VehicleState {
+        PENDING_DEPARTURE,  // Departure event scheduled
+        WAITING_TO_ENTER,   // First edge full, waiting at the origin
+        TRAVELLING,         // Exit event scheduled on current edge
+        QUEUED,             // Exit time passed, waiting behind the queue head
+        BLOCKED,            // Queue head, next edge full (spillback)
+        FINISHED
+    };
+
+    struct Vehicle {
+        int id;
+        int startNode;
+        int destination;
+        std::vector<int> links;  // Directed link indices along the route
+        int linkPosition;        // Index into links, -1 before departure
+        float departureTime;
+        float linkEntryTime;
+        float linkExitTime;      // Projected exit time of the current link
+        VehicleState state;
+    };
+
+    struct Link {
+        int edgeId;
+        int fromNode;
+        int toNode;
+        const Edge* edge;        // Points into the graph's edge map
+        float freeFlowTime;      // Seconds
+        int capacity;            // Cars that fit on the link
+        float lastExitTime;
+        std::deque<int> queue;   // Vehicles on the link, head first
+        std::deque<int> waiting; // Vehicles waiting to enter the link
+    };
+
+private:
+    struct Event {
+        float time;
+        long long sequence;  // Tie breaker keeps same-time events in FIFO order
+        int vehicle;
+    };
+
+    struct CompareEvent {
+        bool operator()(const Event& a, const Event& b) const {
+            if (a.time != b.time) return a.time > b.time; // Min-heap
+            return a.sequence > b.sequence;
+        }
+    };
+
+    const Graph& cityMap;
+    std::vector<Link> links;
+    std::unordered_map<long long, int> linkLookup;   // (from, to) -> link index
+    std::unordered_map<int, int> edgeToFirstLink;    // edgeId -> first of its two links
+
+    std::vector<Vehicle> vehicles;
+    std::vector<int> freeSlots;
+    std::priority_queue<Event, std::vector<Event>, CompareEvent> events;
+    long long nextSequence;
+    int nextVehicleId;
+
+    float currentTime;
+    float simulationSpeed;
+
+    // Statistics
+    int activeVehicles;
+    long long completedTrips;
+    double totalTripTime;
+    long long processedEvents;
+    long long linkTransitions;
+
+public:
+    MesoscopicSimulation(const Graph& map);
+
+    // Rebuild link queues after the graph topology changed (clears all vehicles)
+    void rebuildNetwork();
+
+    bool addTrip(int startNode, int endNode, const std::vector<int>& route, float departureTime);
+    bool addTrip(int startNode, int endNode, const std::vector<int>& route);
+    void update(float deltaTime);
+    void runUntil(float endTime);
+    void clearAllVehicles();
+
+    void setSimulationSpeed(float speed) { simulationSpeed = speed; }
+    float getCurrentTime() const { return currentTime; }
+
+    // Statistics
+    int getVehicleCount() const { return activeVehicles; }
+    long long getCompletedTrips() const { return completedTrips; }
+    float getAverageTripTime() const;
+    long long getProcessedEvents() const { return processedEvents; }
+    long long getLinkTransitions() const { return linkTransitions; }
+    int getVehiclesOnEdge(int edgeId) const;
+
+    // Position along the current link, interpolated from entry/exit times (0..1)
+    float getVehicleProgress(const Vehicle& vehicle) const;
+    const std::vector<Vehicle>& getVehicles() const { return vehicles; }
+    const std::vector<Link>& getLinks() const { return links; }
+
+private:
+    static long long linkKey(int fromNode, int toNode);
+    int findLink(int fromNode, int toNode) const;
+
+    void schedule(int vehicle, float time);
+    void processEvent(const Event& event);
+    void enterLink(int vehicle, int link, float time);
+    void leaveLink(int link, float time);
+    void finishTrip(int vehicle, float time);
+    float linkTravelTime(const Link& link) const;
+};
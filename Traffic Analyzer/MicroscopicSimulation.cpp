@@ -0,0 +1,475 @@
+#include "MicroscopicSimulation.h"
+#include "Config.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+IdmParameters::IdmParameters()
+    : maxAcceleration(MicroConfig::MAX_ACCELERATION),
+    comfortableDeceleration(MicroConfig::COMFORTABLE_DECELERATION),
+    minimumGap(MicroConfig::MINIMUM_GAP),
+    timeHeadway(MicroConfig::TIME_HEADWAY),
+    vehicleLength(MicroConfig::VEHICLE_LENGTH) {
+}
+
+// ================== IDM KERNEL ==================
+// dv/dt = a * (1 - (v/v0)^4 - (s*/s)^2)
+// s*    = s0 + max(0, v*T + v*dv / (2*sqrt(a*b)))
+
+void computeIdmAccelerations(int n, const float* velocity, const float* desiredSpeed,
+    const float* gap, const float* approachRate, float* acceleration,
+    const IdmParameters& params) {
+    const float a = params.maxAcceleration;
+    const float s0 = params.minimumGap;
+    const float T = params.timeHeadway;
+    const float invTwoSqrtAb = 1.0f / (2.0f * std::sqrt(params.maxAcceleration * params.comfortableDeceleration));
+
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256 vA = _mm256_set1_ps(a);
+    const __m256 vS0 = _mm256_set1_ps(s0);
+    const __m256 vT = _mm256_set1_ps(T);
+    const __m256 vInv = _mm256_set1_ps(invTwoSqrtAb);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vZero = _mm256_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(velocity + i);
+        __m256 ratio = _mm256_div_ps(v, _mm256_loadu_ps(desiredSpeed + i));
+        __m256 ratio2 = _mm256_mul_ps(ratio, ratio);
+        __m256 ratio4 = _mm256_mul_ps(ratio2, ratio2);
+
+        __m256 interaction = _mm256_mul_ps(_mm256_mul_ps(v, _mm256_loadu_ps(approachRate + i)), vInv);
+        __m256 dynamicGap = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(v, vT), interaction), vZero);
+        __m256 desiredGap = _mm256_add_ps(vS0, dynamicGap);
+
+        __m256 q = _mm256_div_ps(desiredGap, _mm256_loadu_ps(gap + i));
+        __m256 brake = _mm256_add_ps(ratio4, _mm256_mul_ps(q, q));
+        _mm256_storeu_ps(acceleration + i, _mm256_mul_ps(vA, _mm256_sub_ps(vOne, brake)));
+    }
+#endif
+
+    // Scalar path (and AVX2 remainder); branch-free so it auto-vectorizes too
+    for (; i < n; i++) {
+        float v = velocity[i];
+        float ratio = v / desiredSpeed[i];
+        float ratio2 = ratio * ratio;
+
+        float dynamicGap = std::max(0.0f, v * T + v * approachRate[i] * invTwoSqrtAb);
+        float q = (s0 + dynamicGap) / gap[i];
+
+        acceleration[i] = a * (1.0f - ratio2 * ratio2 - q * q);
+    }
+}
+
+// ================== SIMULATION ==================
+
+MicroscopicSimulation::MicroscopicSimulation(const Graph& map)
+    : cityMap(map), nextVehicleId(1), currentTime(0.0), accumulator(0.0f),
+    simulationSpeed(1.0f), activeVehicles(0), completedTrips(0), totalTripTime(0.0),
+    linkTransitions(0) {
+    rebuildNetwork();
+}
+
+long long MicroscopicSimulation::linkKey(int fromNode, int toNode) {
+    return (static_cast<long long>(fromNode) << 32) | static_cast<unsigned int>(toNode);
+}
+
+int MicroscopicSimulation::findLink(int fromNode, int toNode) const {
+    auto it = linkLookup.find(linkKey(fromNode, toNode));
+    return it != linkLookup.end() ? it->second : -1;
+}
+
+void MicroscopicSimulation::rebuildNetwork() {
+    links.clear();
+    laneLink.clear();
+    linkLookup.clear();
+
+    std::vector<const Edge*> sortedEdges;
+    for (const auto& pair : cityMap.getAllEdges()) {
+        sortedEdges.push_back(&pair.second);
+    }
+    std::sort(sortedEdges.begin(), sortedEdges.end(),
+        [](const Edge* a, const Edge* b) { return a->id < b->id; });
+
+    for (const Edge* edge : sortedEdges) {
+        int laneCount = edge->speedLimit >= MicroConfig::MULTI_LANE_SPEED_LIMIT ? 2 : 1;
+
+        for (int direction = 0; direction < 2; direction++) {
+            Link link;
+            link.edgeId = edge->id;
+            link.fromNode = direction == 0 ? edge->fromNodeId : edge->toNodeId;
+            link.toNode = direction == 0 ? edge->toNodeId : edge->fromNodeId;
+            link.edge = edge;
+            link.length = std::max(edge->length, params.vehicleLength);
+            link.speedLimit = std::max(edge->speedLimit, 1) / 3.6f;
+            link.firstLane = static_cast<int>(laneLink.size());
+            link.laneCount = laneCount;
+
+            int linkIndex = static_cast<int>(links.size());
+            for (int lane = 0; lane < laneCount; lane++) {
+                laneLink.push_back(linkIndex);
+            }
+
+            linkLookup[linkKey(link.fromNode, link.toNode)] = linkIndex;
+            links.push_back(link);
+        }
+    }
+
+    clearAllVehicles();
+}
+
+void MicroscopicSimulation::clearAllVehicles() {
+    position.clear();
+    velocity.clear();
+    desiredSpeed.clear();
+    gap.clear();
+    approachRate.clear();
+    acceleration.clear();
+    vehicleIndex.clear();
+    laneOffset.assign(laneLink.size() + 1, 0);
+    laneTail.assign(laneLink.size(), MicroConfig::FREE_ROAD_GAP);
+
+    vehicles.clear();
+    freeSlots.clear();
+    departureQueues.assign(links.size(), std::deque<int>());
+    departureLinks.clear();
+
+    activeVehicles = 0;
+}
+
+bool MicroscopicSimulation::addTrip(int startNode, int endNode, const std::vector<int>& route) {
+    if (route.size() < 2) return false;
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<int>(vehicles.size());
+        vehicles.emplace_back();
+    }
+
+    Vehicle& vehicle = vehicles[slot];
+    vehicle.links.clear();
+    for (size_t i = 0; i + 1 < route.size(); i++) {
+        int link = findLink(route[i], route[i + 1]);
+        if (link == -1) {
+            freeSlots.push_back(slot);
+            return false;
+        }
+        vehicle.links.push_back(link);
+    }
+
+    vehicle.id = nextVehicleId++;
+    vehicle.startNode = startNode;
+    vehicle.destination = endNode;
+    vehicle.linkPosition = -1;
+    vehicle.departureTime = currentTime;
+    vehicle.active = true;
+
+    int firstLink = vehicle.links[0];
+    if (departureQueues[firstLink].empty()) {
+        departureLinks.push_back(firstLink);
+    }
+    departureQueues[firstLink].push_back(slot);
+
+    activeVehicles++;
+    return true;
+}
+
+void MicroscopicSimulation::update(float deltaTime) {
+    accumulator += deltaTime * simulationSpeed;
+    while (accumulator >= MicroConfig::TICK_SECONDS) {
+        step(MicroConfig::TICK_SECONDS);
+        accumulator -= MicroConfig::TICK_SECONDS;
+    }
+}
+
+void MicroscopicSimulation::step(float dt) {
+    int n = static_cast<int>(position.size());
+    gap.resize(n);
+    approachRate.resize(n);
+    acceleration.resize(n);
+
+    refreshLaneTails();
+    computeGaps();
+    computeIdmAccelerations(n, velocity.data(), desiredSpeed.data(), gap.data(),
+        approachRate.data(), acceleration.data(), params);
+    integrate(dt);
+
+    // Transfers below move each lane's tail as they insert vehicles, so two
+    // arrivals in one tick never claim the same spot
+    refreshLaneTails();
+
+    // Default every vehicle to its current lane, then apply transfers
+    targetLane.resize(n);
+    arrived.assign(n, 0);
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        for (int i = laneOffset[lane]; i < laneOffset[lane + 1]; i++) {
+            targetLane[i] = lane;
+        }
+    }
+
+    bool changed = processLinkExits();
+    changed = insertDepartures() || changed;
+    if (changed) {
+        regroupLanes();
+    }
+
+    currentTime += dt;
+}
+
+float MicroscopicSimulation::laneTailPosition(int lane) const {
+    if (laneOffset[lane] == laneOffset[lane + 1]) {
+        return MicroConfig::FREE_ROAD_GAP;
+    }
+    return position[laneOffset[lane + 1] - 1];
+}
+
+void MicroscopicSimulation::refreshLaneTails() {
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        laneTail[lane] = laneTailPosition(lane);
+    }
+}
+
+int MicroscopicSimulation::laneWithMostRoom(int link) const {
+    const Link& l = links[link];
+    int best = l.firstLane;
+    for (int lane = l.firstLane + 1; lane < l.firstLane + l.laneCount; lane++) {
+        if (laneTail[lane] > laneTail[best]) {
+            best = lane;
+        }
+    }
+    return best;
+}
+
+float MicroscopicSimulation::gapBeyondLinkEnd(int lane, int slot, float& leaderVelocity) const {
+    const Link& link = links[laneLink[lane]];
+    float remaining = link.length - position[slot];
+
+    // Accident on this road: stop at the end of the link
+    if (link.edge->isBlocked) {
+        leaderVelocity = 0.0f;
+        return remaining;
+    }
+
+    const Vehicle& vehicle = vehicles[vehicleIndex[slot]];
+    if (vehicle.linkPosition + 1 >= static_cast<int>(vehicle.links.size())) {
+        leaderVelocity = velocity[slot];
+        return MicroConfig::FREE_ROAD_GAP;
+    }
+
+    int nextLink = vehicle.links[vehicle.linkPosition + 1];
+    if (links[nextLink].edge->isBlocked) {
+        leaderVelocity = 0.0f;
+        return remaining;
+    }
+
+    // Follow the last car of the emptiest lane on the next link
+    int nextLane = laneWithMostRoom(nextLink);
+    if (laneOffset[nextLane] == laneOffset[nextLane + 1]) {
+        leaderVelocity = velocity[slot];
+        return MicroConfig::FREE_ROAD_GAP;
+    }
+
+    int tail = laneOffset[nextLane + 1] - 1;
+    leaderVelocity = velocity[tail];
+    return remaining + position[tail] - params.vehicleLength;
+}
+
+void MicroscopicSimulation::computeGaps() {
+    const float minGap = 0.1f;
+
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        int begin = laneOffset[lane];
+        int end = laneOffset[lane + 1];
+        if (begin == end) continue;
+
+        float leaderVelocity;
+        gap[begin] = std::max(minGap, gapBeyondLinkEnd(lane, begin, leaderVelocity));
+        approachRate[begin] = velocity[begin] - leaderVelocity;
+
+        for (int i = begin + 1; i < end; i++) {
+            gap[i] = std::max(minGap, position[i - 1] - position[i] - params.vehicleLength);
+            approachRate[i] = velocity[i] - velocity[i - 1];
+        }
+    }
+}
+
+void MicroscopicSimulation::integrate(float dt) {
+    const int n = static_cast<int>(position.size());
+    float* pos = position.data();
+    float* vel = velocity.data();
+    const float* acc = acceleration.data();
+
+    // Ballistic update; velocities never go negative
+    for (int i = 0; i < n; i++) {
+        float newVelocity = std::max(0.0f, vel[i] + acc[i] * dt);
+        pos[i] += 0.5f * (vel[i] + newVelocity) * dt;
+        vel[i] = newVelocity;
+    }
+}
+
+bool MicroscopicSimulation::processLinkExits() {
+    bool changed = false;
+
+    for (int lane = 0; lane < getLaneCount(); lane++) {
+        const Link& link = links[laneLink[lane]];
+
+        for (int i = laneOffset[lane]; i < laneOffset[lane + 1]; i++) {
+            if (position[i] < link.length) break; // Leader first: the rest are behind
+
+            Vehicle& vehicle = vehicles[vehicleIndex[i]];
+            if (vehicle.linkPosition + 1 == static_cast<int>(vehicle.links.size())) {
+                targetLane[i] = -1;
+                finishTrip(vehicleIndex[i]);
+                changed = true;
+                continue;
+            }
+
+            const Link& next = links[vehicle.links[vehicle.linkPosition + 1]];
+            int nextLane = laneWithMostRoom(vehicle.links[vehicle.linkPosition + 1]);
+            float newPosition = std::min(position[i] - link.length, laneTail[nextLane] - params.vehicleLength);
+
+            if (link.edge->isBlocked || next.edge->isBlocked || newPosition < 0.0f) {
+                // No room downstream: hold at the stop line
+                position[i] = link.length;
+                velocity[i] = 0.0f;
+                break;
+            }
+
+            float trafficFactor = 1.0f;
+            if (next.edge->baseTravelTime > 0.0f) {
+                trafficFactor = std::max(1.0f, next.edge->currentTravelTime / next.edge->baseTravelTime);
+            }
+
+            position[i] = newPosition;
+            desiredSpeed[i] = next.speedLimit / trafficFactor;
+            targetLane[i] = nextLane;
+            arrived[i] = 1;
+            laneTail[nextLane] = newPosition;
+            vehicle.linkPosition++;
+            linkTransitions++;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool MicroscopicSimulation::insertDepartures() {
+    bool inserted = false;
+    size_t keep = 0;
+
+    for (size_t k = 0; k < departureLinks.size(); k++) {
+        int link = departureLinks[k];
+        auto& queue = departureQueues[link];
+
+        int lane = laneWithMostRoom(link);
+        if (laneTail[lane] >= params.vehicleLength + params.minimumGap) {
+            int slot = queue.front();
+            queue.pop_front();
+
+            Vehicle& vehicle = vehicles[slot];
+            vehicle.linkPosition = 0;
+
+            const Link& l = links[link];
+            float trafficFactor = 1.0f;
+            if (l.edge->baseTravelTime > 0.0f) {
+                trafficFactor = std::max(1.0f, l.edge->currentTravelTime / l.edge->baseTravelTime);
+            }
+
+            position.push_back(0.0f);
+            velocity.push_back(0.0f);
+            desiredSpeed.push_back(l.speedLimit / trafficFactor);
+            vehicleIndex.push_back(slot);
+            targetLane.push_back(lane);
+            arrived.push_back(1);
+            laneTail[lane] = 0.0f;
+            linkTransitions++;
+            inserted = true;
+        }
+
+        if (!queue.empty()) {
+            departureLinks[keep++] = link;
+        }
+    }
+    departureLinks.resize(keep);
+
+    return inserted;
+}
+
+void MicroscopicSimulation::regroupLanes() {
+    const int laneCount = getLaneCount();
+    const int n = static_cast<int>(targetLane.size());
+
+    // Counting sort by lane: vehicles that stayed keep their order, arrivals
+    // join the tail sorted leader first
+    laneCursor.assign(laneCount + 1, 0);
+    for (int i = 0; i < n; i++) {
+        if (targetLane[i] >= 0) laneCursor[targetLane[i] + 1]++;
+    }
+    for (int lane = 0; lane < laneCount; lane++) {
+        laneCursor[lane + 1] += laneCursor[lane];
+    }
+    laneOffset = laneCursor;
+
+    int total = laneOffset[laneCount];
+    scratchInt.resize(total);
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) arrivalBegin.assign(laneCursor.begin(), laneCursor.end() - 1);
+        for (int i = 0; i < n; i++) {
+            if (targetLane[i] < 0 || arrived[i] != pass) continue;
+            scratchInt[laneCursor[targetLane[i]]++] = i;
+        }
+    }
+    for (int lane = 0; lane < laneCount; lane++) {
+        if (laneOffset[lane + 1] - arrivalBegin[lane] < 2) continue;
+        std::stable_sort(scratchInt.begin() + arrivalBegin[lane], scratchInt.begin() + laneOffset[lane + 1],
+            [&](int a, int b) { return position[a] > position[b]; });
+    }
+
+    auto permute = [&](std::vector<float>& values) {
+        scratchFloat.resize(total);
+        for (int k = 0; k < total; k++) scratchFloat[k] = values[scratchInt[k]];
+        values.swap(scratchFloat);
+    };
+    permute(position);
+    permute(velocity);
+    permute(desiredSpeed);
+
+    laneCursor.resize(total);
+    for (int k = 0; k < total; k++) laneCursor[k] = vehicleIndex[scratchInt[k]];
+    vehicleIndex.swap(laneCursor);
+
+    gap.resize(total);
+    approachRate.resize(total);
+    acceleration.resize(total);
+}
+
+void MicroscopicSimulation::finishTrip(int vehicle) {
+    vehicles[vehicle].active = false;
+    completedTrips++;
+    totalTripTime += currentTime - vehicles[vehicle].departureTime;
+    activeVehicles--;
+    freeSlots.push_back(vehicle);
+}
+
+float MicroscopicSimulation::getAverageTripTime() const {
+    return completedTrips > 0 ? static_cast<float>(totalTripTime / completedTrips) : 0.0f;
+}
+
+float MicroscopicSimulation::getAverageSpeed() const {
+    if (velocity.empty()) return 0.0f;
+
+    double sum = 0.0;
+    for (float v : velocity) sum += v;
+    return static_cast<float>(sum / velocity.size());
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+struct IdmParameters {
+    float maxAcceleration;
+    float comfortableDeceleration;
+    float minimumGap;
+    float timeHeadway;
+    float vehicleLength;
+
+    IdmParameters();
+};
+
+// Intelligent Driver Model acceleration for n vehicles stored as SoA arrays.
+// gap is the bumper-to-bumper distance to the leader, approachRate is
+// v - v_leader. Uses AVX2 when the compiler targets it, scalar otherwise.
+void computeIdmAccelerations(int n, const float* velocity, const float* desiredSpeed,
+    const float* gap, const float* approachRate, float* acceleration,
+    const IdmParameters& params);
+
+// Car-following alternative to CarSimulation with per-edge lanes and
+// continuous positions in metres. All vehicles live in one set of SoA arrays,
+// grouped by lane and ordered leader first inside each lane, so the
+// acceleration kernel runs over the whole fleet in a single pass.
+class MicroscopicSimulation {
+public:
+    struct Vehicle {
+        int id;
+        int startNode;
+        int destination;
+        std::vector<int> links;  // Directed link indices along the route
+        int linkPosition;        // Index into links, -1 while waiting to enter
+        double departureTime;
+        bool active;
+    };
+
+    struct Link {
+        int edgeId;
+        int fromNode;
+        int toNode;
+        const Edge* edge;    // Points into the graph's edge map
+        float length;        // m
+        float speedLimit;    // m/s
+        int firstLane;
+        int laneCount;
+    };
+
+private:
+    const Graph& cityMap;
+    IdmParameters params;
+
+    std::vector<Link> links;
+    std::vector<int> laneLink;  // Lane -> link
+    std::unordered_map<long long, int> linkLookup;
+
+    // Fleet state (SoA), lane segments are [laneOffset[l], laneOffset[l + 1])
+    std::vector<float> position;
+    std::vector<float> velocity;
+    std::vector<float> desiredSpeed;
+    std::vector<float> gap;
+    std::vector<float> approachRate;
+    std::vector<float> acceleration;
+    std::vector<int> vehicleIndex;
+    std::vector<int> laneOffset;
+
+    // Scratch buffers for re-grouping vehicles after lane transfers
+    std::vector<int> targetLane;      // Lane after this tick, -1 = trip finished
+    std::vector<unsigned char> arrived; // Entered targetLane this tick (goes to the tail)
+    std::vector<int> laneCursor;
+    std::vector<int> arrivalBegin;    // Per lane, first regrouped slot of this tick's arrivals
+    std::vector<float> laneTail;      // Per lane, position of the last vehicle including this tick's arrivals
+    std::vector<float> scratchFloat;
+    std::vector<int> scratchInt;
+
+    std::vector<Vehicle> vehicles;
+    std::vector<int> freeSlots;
+    std::vector<std::deque<int>> departureQueues; // Per link, vehicles waiting at the origin
+    std::vector<int> departureLinks;              // Links with a non-empty departure queue
+
+    int nextVehicleId;
+    double currentTime;                // Sum of 0.1 s ticks, too many for float over a day
+    float accumulator;
+    float simulationSpeed;
+
+    int activeVehicles;
+    long long completedTrips;
+    double totalTripTime;
+    long long linkTransitions;
+
+public:
+    MicroscopicSimulation(const Graph& map);
+
+    // Rebuild links and lanes after the graph topology changed (clears all vehicles)
+    void rebuildNetwork();
+
+    bool addTrip(int startNode, int endNode, const std::vector<int>& route);
+    void update(float deltaTime);
+    void step(float dt);
+    void clearAllVehicles();
+
+    void setSimulationSpeed(float speed) { simulationSpeed = speed; }
+    void setParameters(const IdmParameters& p) { params = p; }
+    double getCurrentTime() const { return currentTime; }
+
+    // Statistics
+    int getVehicleCount() const { return activeVehicles; }
+    int getVehiclesInNetwork() const { return static_cast<int>(position.size()); }
+    long long getCompletedTrips() const { return completedTrips; }
+    float getAverageTripTime() const;
+    float getAverageSpeed() const;
+    // Vehicles entering a link, including their first one
+    long long getLinkTransitions() const { return linkTransitions; }
+
+    // Read access for rendering; fleet slots of a lane are [getLaneBegin, getLaneEnd)
+    const std::vector<float>& getPositions() const { return position; }
+    const std::vector<float>& getVelocities() const { return velocity; }
+    const std::vector<int>& getVehicleIndices() const { return vehicleIndex; }
+    const std::vector<Vehicle>& getVehicles() const { return vehicles; }
+    const std::vector<Link>& getLinks() const { return links; }
+    int getLinkOfLane(int lane) const { return laneLink[lane]; }
+    int getLaneCount() const { return static_cast<int>(laneLink.size()); }
+    int getLaneBegin(int lane) const { return laneOffset[lane]; }
+    int getLaneEnd(int lane) const { return laneOffset[lane + 1]; }
+
+private:
+    static long long linkKey(int fromNode, int toNode);
+    int findLink(int fromNode, int toNode) const;
+
+    int laneWithMostRoom(int link) const;
+    float laneTailPosition(int lane) const;
+    void refreshLaneTails();
+    float gapBeyondLinkEnd(int lane, int slot, float& leaderVelocity) const;
+
+    void computeGaps();
+    void integrate(float dt);
+    bool processLinkExits();
+    bool insertDepartures();
+    void regroupLanes();
+    void finishTrip(int vehicle);
+};
@@ -0,0 +1,420 @@
+#include "PredictionBacktest.h"
+#include "PredictionSystem.h"
+#include "EdgeHistoryMatrix.h"
+#include "SpeedKalmanFilter.h"
+#include "SpatialSpeedModel.h"
+#include "SpeedProfile.h"
+#include "Config.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+enum Predictor {
+    PERSISTENCE,
+    SMA,
+    WMA,
+    EMA,
+    LINEAR_REGRESSION,
+    KALMAN,
+    PROFILE,
+    SPATIAL,
+    PRODUCTION,
+    PREDICTOR_COUNT
+};
+
+const char* const PREDICTOR_NAMES[PREDICTOR_COUNT] = {
+    "persistence", "sma", "wma", "ema", "linear_regression", "kalman", "profile", "spatial", "production"
+};
+
+struct ErrorSum {
+    double absolute = 0.0;
+    double relative = 0.0;
+    long long samples = 0;
+
+    void add(float forecast, float actual) {
+        float error = std::fabs(forecast - actual);
+        absolute += error;
+        relative += actual > 0.0f ? error / actual : 0.0;
+        samples++;
+    }
+
+    void merge(const ErrorSum& other) {
+        absolute += other.absolute;
+        relative += other.relative;
+        samples += other.samples;
+    }
+};
+
+// What one task measured; errors are [predictor][horizon]
+struct Tally {
+    std::vector<ErrorSum> errors;
+    double seconds[PREDICTOR_COUNT] = {};
+    long long updates[PREDICTOR_COUNT] = {};
+
+    explicit Tally(size_t horizons) : errors(PREDICTOR_COUNT * horizons) {}
+};
+
+// Forecasts waiting for the frame they are for: with one pushed per frame,
+// the oldest of a full queue was made `steps` frames before the current one.
+// Every row is pushed at once, so the rows share one ring of [steps x rows]
+// planes and need none of EdgeHistoryMatrix's per-row statistics.
+class ForecastQueue {
+private:
+    std::vector<float> pending;
+    size_t rows;
+    int steps;
+    int head;                            // Plane the next push goes to, the oldest once full
+    int count;
+
+public:
+    ForecastQueue(int steps, size_t rows)
+        : pending(static_cast<size_t>(steps) * rows), rows(rows), steps(steps), head(0), count(0) {
+    }
+
+    void score(const float* actual, ErrorSum& sum) const {
+        if (rows == 0 || count < steps) return;
+        const float* oldest = pending.data() + static_cast<size_t>(head) * rows;
+        for (size_t row = 0; row < rows; row++) {
+            sum.add(oldest[row], actual[row]);
+        }
+    }
+
+    void push(const float* forecasts) {
+        std::copy(forecasts, forecasts + rows, pending.data() + static_cast<size_t>(head) * rows);
+        head = head + 1 == steps ? 0 : head + 1;
+        count = std::min(count + 1, steps);
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+PredictionBacktest::PredictionBacktest(const SpeedSeries& series, const BacktestOptions& options)
+    : series(series), options(options) {
+    this->options.edgesPerTask = std::max(1, options.edgesPerTask);
+}
+
+BacktestResult PredictionBacktest::run() {
+    BacktestResult result;
+    result.edges = series.getEdgeCount();
+    result.frames = series.getFrameCount();
+
+    const std::vector<int>& minutes = options.horizonMinutes;
+    size_t horizons = minutes.size();
+    size_t edgeCount = static_cast<size_t>(result.edges);
+    size_t frames = result.frames;
+
+    // Horizons in frames; one too short for a frame is not scored
+    std::vector<int> steps(horizons);
+    for (size_t h = 0; h < horizons; h++) {
+        steps[h] = std::max(1, static_cast<int>(std::lround(minutes[h] * 60.0 / series.roundSeconds)));
+    }
+
+    std::vector<float> limits(edgeCount);
+    for (size_t slot = 0; slot < edgeCount; slot++) {
+        limits[slot] = static_cast<float>(series.map.getEdgeAt(static_cast<int>(slot)).speedLimit);
+    }
+
+    SpeedKalmanFilter filterModel;
+    std::vector<SpeedKalmanFilter::Horizon> filterHorizons(horizons);
+    for (size_t h = 0; h < horizons; h++) {
+        filterHorizons[h] = filterModel.horizon(steps[h]);
+    }
+
+    std::vector<int> edgeIds(edgeCount);
+    for (size_t slot = 0; slot < edgeCount; slot++) {
+        edgeIds[slot] = series.map.getEdgeAt(static_cast<int>(slot)).id;
+    }
+
+    // Every edge range for the per-edge predictors
+    auto replayRange = [&](size_t first, size_t count, Tally& tally) {
+        const int window = PredictionConfig::MOVING_AVERAGE_WINDOW;
+        const float alpha = PredictionConfig::PREDICTION_ALPHA;
+        const float* rangeLimits = limits.data() + first;
+
+        EdgeHistoryMatrix history(window, window, alpha);
+        history.resize(count);
+        SpeedKalmanFilter filter;
+        filter.resize(count);
+        std::vector<float> noWeight(count, 0.0f), confidence(count), spare(count);
+        SpeedProfile profile(PredictionConfig::PROFILE_MAX_DAYS);
+        profile.remap(std::vector<int>(edgeIds.begin() + first, edgeIds.begin() + first + count));
+        std::vector<float> shares(count), profileWeights(count);
+
+        std::vector<ForecastQueue> queues;
+        std::vector<std::vector<float>> forecasts(PREDICTOR_COUNT * horizons, std::vector<float>(count));
+        for (int p = 0; p < PREDICTOR_COUNT; p++) {
+            for (size_t h = 0; h < horizons; h++) {
+                queues.emplace_back(steps[h], p == SPATIAL || p == PRODUCTION ? 0 : count);
+            }
+        }
+        auto out = [&](int predictor, size_t h) { return forecasts[predictor * horizons + h].data(); };
+
+        for (size_t frame = 0; frame < frames; frame++) {
+            const float* speeds = series.frame(frame) + first;
+            for (size_t q = 0; q < queues.size(); q++) {
+                queues[q].score(speeds, tally.errors[q]);
+            }
+
+            Clock::time_point start = Clock::now();
+            for (size_t h = 0; h < horizons; h++) {
+                std::copy(speeds, speeds + count, out(PERSISTENCE, h));
+            }
+            tally.seconds[PERSISTENCE] += secondsSince(start);
+
+            // The window and its running sums are shared by the four
+            // predictors that read them
+            start = Clock::now();
+            history.pushAll(speeds);
+            double windowSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t row = 0; row < count; row++) {
+                out(SMA, 0)[row] = history.movingAverage(row);
+            }
+            for (size_t h = 1; h < horizons; h++) {
+                std::copy(out(SMA, 0), out(SMA, 0) + count, out(SMA, h));
+            }
+            tally.seconds[SMA] += windowSeconds + secondsSince(start);
+
+            start = Clock::now();
+            for (size_t row = 0; row < count; row++) {
+                out(WMA, 0)[row] = history.weightedAverage(row);
+            }
+            for (size_t h = 1; h < horizons; h++) {
+                std::copy(out(WMA, 0), out(WMA, 0) + count, out(WMA, h));
+            }
+            tally.seconds[WMA] += windowSeconds + secondsSince(start);
+
+            start = Clock::now();
+            for (size_t row = 0; row < count; row++) {
+                out(EMA, 0)[row] = history.smoothed(row);
+            }
+            for (size_t h = 1; h < horizons; h++) {
+                std::copy(out(EMA, 0), out(EMA, 0) + count, out(EMA, h));
+            }
+            tally.seconds[EMA] += windowSeconds + secondsSince(start);
+
+            // Least squares over x = 0..n-1, extrapolated to x = n - 1 + steps
+            start = Clock::now();
+            for (size_t row = 0; row < count; row++) {
+                int n = history.size(row);
+                float m = 0.0f, b = history.mean(row);
+                if (n >= 3) history.linearFit(row, m, b);
+
+                for (size_t h = 0; h < horizons; h++) {
+                    float predicted = m * (n - 1 + steps[h]) + b;
+                    out(LINEAR_REGRESSION, h)[row] = std::max(PredictionConfig::MIN_PREDICTED_SPEED,
+                        std::min(predicted, rangeLimits[row]));
+                }
+            }
+            tally.seconds[LINEAR_REGRESSION] += windowSeconds + secondsSince(start);
+
+            // Horizons go through the kernel in pairs, as 5 and 10 minutes do
+            // in PredictionSystem
+            start = Clock::now();
+            filter.updateAll(speeds);
+            for (size_t h = 0; h < horizons; h += 2) {
+                size_t far = std::min(h + 1, horizons - 1);
+                computeEdgeForecasts(static_cast<int>(count), filter.getColumns(), filterHorizons[h],
+                    filterHorizons[far], rangeLimits, rangeLimits, noWeight.data(), rangeLimits,
+                    out(KALMAN, h), far == h ? spare.data() : out(KALMAN, far), confidence.data());
+            }
+            tally.seconds[KALMAN] += secondsSince(start);
+
+            // Learned as the series goes; a bin with too few days forecasts
+            // the current speed
+            start = Clock::now();
+            for (size_t row = 0; row < count; row++) {
+                shares[row] = std::min(speeds[row] / rangeLimits[row], 1.0f);
+            }
+            profile.observe(series.weekTimes[frame], shares.data());
+            for (size_t h = 0; h < horizons; h++) {
+                float* forecast = out(PROFILE, h);
+                profile.forecast(series.weekTimes[frame] + minutes[h] * 60.0, rangeLimits,
+                    PredictionConfig::PROFILE_MIN_DAYS, 1.0f, forecast, profileWeights.data());
+                for (size_t row = 0; row < count; row++) {
+                    if (profileWeights[row] == 0.0f) forecast[row] = speeds[row];
+                }
+            }
+            tally.seconds[PROFILE] += secondsSince(start);
+
+            for (int p = PERSISTENCE; p <= PROFILE; p++) {
+                tally.updates[p] += static_cast<long long>(count);
+                for (size_t h = 0; h < horizons; h++) {
+                    queues[p * horizons + h].push(out(p, h));
+                }
+            }
+        }
+    };
+
+    // The whole network for one pair of horizons, stepping the spatial model
+    // every SPATIAL_STEP_ROUNDS frames and adding the profile like
+    // PredictionSystem does
+    auto replayNetwork = [&](size_t near, size_t far, Tally& tally) {
+        int stepFrames = PredictionConfig::SPATIAL_STEP_ROUNDS;
+        int nearSteps = std::max(1, steps[near] / stepFrames);
+        int farSteps = std::max(1, steps[far] / stepFrames);
+        SpatialSpeedModel spatial(PredictionConfig::SPATIAL_FORGETTING, PredictionConfig::SPATIAL_INITIAL_VARIANCE,
+            nearSteps, farSteps);
+        spatial.build(series.map);
+        SpeedKalmanFilter filter;
+        filter.resize(edgeCount);
+        SpeedProfile profile(PredictionConfig::PROFILE_MAX_DAYS);
+        profile.remap(edgeIds);
+
+        std::vector<float> shares(edgeCount), spatialNear(edgeCount), spatialFar(edgeCount);
+        std::vector<float> anchorNear(edgeCount), anchorFar(edgeCount), anchorWeights(edgeCount);
+        std::vector<float> profileNear(edgeCount), profileFar(edgeCount), profileWeights(edgeCount);
+        std::vector<float> weights(edgeCount), blendNear(edgeCount), blendFar(edgeCount), confidence(edgeCount);
+        ForecastQueue spatialQueues[2] = { { steps[near], edgeCount }, { steps[far], edgeCount } };
+        ForecastQueue productionQueues[2] = { { steps[near], edgeCount }, { steps[far], edgeCount } };
+        size_t horizon[2] = { near, far };
+        int pairs = far == near ? 1 : 2;
+
+        int round = 0;
+        for (size_t frame = 0; frame < frames; frame++) {
+            const float* speeds = series.frame(frame);
+            for (int i = 0; i < pairs; i++) {
+                spatialQueues[i].score(speeds, tally.errors[SPATIAL * horizons + horizon[i]]);
+                productionQueues[i].score(speeds, tally.errors[PRODUCTION * horizons + horizon[i]]);
+            }
+
+            Clock::time_point start = Clock::now();
+            for (size_t row = 0; row < edgeCount; row++) {
+                shares[row] = std::min(speeds[row] / limits[row], 1.0f);
+            }
+            if (++round >= stepFrames) {
+                round = 0;
+                spatial.observe(shares.data());
+            }
+            spatial.forecast(shares.data(), spatialNear.data(), spatialFar.data());
+            for (size_t row = 0; row < edgeCount; row++) {
+                spatialNear[row] *= limits[row];
+                spatialFar[row] *= limits[row];
+                weights[row] = spatial.getSamples(row) >= PredictionConfig::SPATIAL_MIN_STEPS ?
+                    PredictionConfig::SPATIAL_WEIGHT : 0.0f;
+            }
+            double spatialSeconds = secondsSince(start);
+
+            start = Clock::now();
+            double weekTime = series.weekTimes[frame];
+            profile.observe(weekTime, shares.data());
+            profile.forecast(weekTime + minutes[near] * 60.0, limits.data(), PredictionConfig::PROFILE_MIN_DAYS,
+                PredictionConfig::PROFILE_WEIGHT, profileNear.data(), profileWeights.data());
+            profile.forecast(weekTime + minutes[far] * 60.0, limits.data(), PredictionConfig::PROFILE_MIN_DAYS,
+                PredictionConfig::PROFILE_WEIGHT, profileFar.data(), profileWeights.data());
+            anchorNear = spatialNear;
+            anchorFar = spatialFar;
+            anchorWeights = weights;
+            addForecastAnchor(static_cast<int>(edgeCount), profileNear.data(), profileFar.data(),
+                profileWeights.data(), anchorNear.data(), anchorFar.data(), anchorWeights.data());
+
+            filter.updateAll(speeds);
+            computeEdgeForecasts(static_cast<int>(edgeCount), filter.getColumns(), filterHorizons[near],
+                filterHorizons[far], anchorNear.data(), anchorFar.data(), anchorWeights.data(), limits.data(),
+                blendNear.data(), blendFar.data(), confidence.data());
+            tally.seconds[SPATIAL] += spatialSeconds;
+            tally.seconds[PRODUCTION] += spatialSeconds + secondsSince(start);
+            tally.updates[SPATIAL] += static_cast<long long>(edgeCount);
+            tally.updates[PRODUCTION] += static_cast<long long>(edgeCount);
+
+            spatialQueues[0].push(spatialNear.data());
+            productionQueues[0].push(blendNear.data());
+            if (pairs == 2) {
+                spatialQueues[1].push(spatialFar.data());
+                productionQueues[1].push(blendFar.data());
+            }
+        }
+    };
+
+    // Network tasks are the longest, so they are handed out first
+    struct Task {
+        bool network;
+        size_t first;                    // Edge or horizon
+        size_t second;                   // Edge count or horizon
+    };
+    std::vector<Task> tasks;
+    for (size_t h = 0; h < horizons; h += 2) {
+        tasks.push_back({ true, h, std::min(h + 1, horizons - 1) });
+    }
+    size_t range = static_cast<size_t>(options.edgesPerTask);
+    for (size_t first = 0; first < edgeCount; first += range) {
+        tasks.push_back({ false, first, std::min(range, edgeCount - first) });
+    }
+    std::vector<Tally> tallies(tasks.size(), Tally(horizons));
+
+    int taskCount = static_cast<int>(tasks.size());
+    int threadCount = options.threads > 0 ? options.threads
+        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threadCount = std::max(1, std::min(threadCount, taskCount));
+    result.threadsUsed = threadCount;
+
+    Clock::time_point wallStart = Clock::now();
+
+    std::atomic<int> nextTask(0);
+    auto worker = [&]() {
+        for (int i = nextTask++; i < taskCount; i = nextTask++) {
+            const Task& task = tasks[i];
+            if (task.network) replayNetwork(task.first, task.second, tallies[i]);
+            else replayRange(task.first, task.second, tallies[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    result.wallSeconds = secondsSince(wallStart);
+
+    Tally total(horizons);
+    for (const Tally& tally : tallies) {
+        for (size_t i = 0; i < total.errors.size(); i++) {
+            total.errors[i].merge(tally.errors[i]);
+        }
+        for (int p = 0; p < PREDICTOR_COUNT; p++) {
+            total.seconds[p] += tally.seconds[p];
+            total.updates[p] += tally.updates[p];
+        }
+    }
+
+    // The network tasks step the spatial model once per pair of horizons
+    for (int p = 0; p < PREDICTOR_COUNT; p++) {
+        if (p == SPATIAL || p == PRODUCTION) {
+            total.updates[p] /= static_cast<long long>((horizons + 1) / 2);
+        }
+        for (size_t h = 0; h < horizons; h++) {
+            const ErrorSum& sum = total.errors[p * horizons + h];
+            BacktestScore score;
+            score.predictor = PREDICTOR_NAMES[p];
+            score.horizonMinutes = minutes[h];
+            score.samples = sum.samples;
+            score.mae = sum.samples > 0 ? sum.absolute / sum.samples : 0.0;
+            score.mape = sum.samples > 0 ? 100.0 * sum.relative / sum.samples : 0.0;
+            score.edgesPerSecond = total.seconds[p] > 0.0 ? total.updates[p] / total.seconds[p] : 0.0;
+            result.scores.push_back(score);
+        }
+    }
+    return result;
+}
+
+void PredictionBacktest::writeScores(const BacktestResult& result, std::ostream& out) {
+    out << "predictor,horizon_minutes,samples,mae_kmh,mape_percent,edges_per_second\n";
+    for (const auto& score : result.scores) {
+        out << score.predictor << "," << score.horizonMinutes << "," << score.samples << ","
+            << score.mae << "," << score.mape << "," << score.edgesPerSecond << "\n";
+    }
+}
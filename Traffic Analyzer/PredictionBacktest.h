@@ -0,0 +1,60 @@
+#pragma once
+#include "SpeedRecorder.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+struct BacktestOptions {
+    int threads = 0;                     // 0 = one per hardware thread
+    std::vector<int> horizonMinutes = { 1, 5, 10 };
+    int edgesPerTask = 4096;             // Edge range each per-edge task replays
+};
+
+struct BacktestScore {
+    std::string predictor;
+    int horizonMinutes = 0;
+    long long samples = 0;               // Forecasts that reached their target frame
+    double mae = 0.0;                    // km/h
+    double mape = 0.0;                   // Percent of the measured speed
+    double edgesPerSecond = 0.0;         // Edge updates per thread-second, all horizons at once
+};
+
+struct BacktestResult {
+    std::vector<BacktestScore> scores;   // Predictor-major, horizons in option order
+    int edges = 0;
+    size_t frames = 0;
+    double wallSeconds = 0.0;
+    int threadsUsed = 0;
+};
+
+// Replays a recorded speed series through every predictor and scores its
+// forecasts against the speeds the series went on to record:
+//
+//   persistence        the current speed
+//   sma, wma, ema      moving averages over PredictionConfig's window and alpha
+//   linear_regression  least squares over the window, extrapolated
+//   kalman             the per-edge filters alone
+//   profile            the time-of-week profile, learned as the series
+//                      goes, or the current speed before a bin has data
+//   spatial            the spatial model alone
+//   production         filters blended with the spatial model and the
+//                      profile, as PredictionSystem forecasts
+//
+// Per-edge predictors replay ranges of edges as independent tasks; the
+// spatial model needs every edge at once, so it and the production blend
+// run as one task per pair of horizons. Workers pull tasks like
+// ScenarioSweep's replicas, and every task's tallies are merged in task
+// order, so the scores do not depend on the thread count.
+class PredictionBacktest {
+private:
+    const SpeedSeries& series;
+    BacktestOptions options;
+
+public:
+    PredictionBacktest(const SpeedSeries& series, const BacktestOptions& options);
+
+    BacktestResult run();
+
+    // One CSV row per predictor and horizon
+    static void writeScores(const BacktestResult& result, std::ostream& out);
+};
@@ -1,43 +1,296 @@
 #include "PredictionSystem.h"
+#include "Checkpoint.h"
+#include "Config.h"
+#include "AccidentSystem.h"
+#include <limits>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    SpeedKalmanFilter::Columns rowColumns(const SpeedKalmanFilter::Columns& columns, int row) {
+        return { columns.level + row, columns.trend + row, columns.levelVariance + row,
+            columns.covariance + row, columns.trendVariance + row, columns.samples + row };
+    }
+}
 
 PredictionSystem::PredictionSystem(Graph* graph)
-    : graph(graph), predictionTimer(0.0f) {
+    : graph(graph),
+    speedHistory(MAX_HISTORY_SIZE),
+    predictionHistory(PREDICTION_HISTORY_SIZE),
+    speedStore(static_cast<long long>(PredictionConfig::SPEED_HISTORY_HOURS * 3600.0f / PREDICTION_INTERVAL)),
+    speedProfile(PredictionConfig::PROFILE_MAX_DAYS),
+    weekSeconds(SimConfig::DAY_START_HOUR * 3600.0),
+    speedFilter(),
+    horizon5(speedFilter.horizon(static_cast<int>(300.0f / PREDICTION_INTERVAL))),
+    horizon10(speedFilter.horizon(static_cast<int>(600.0f / PREDICTION_INTERVAL))),
+    spatialModel(PREDICTION_INTERVAL),
+    spatialRound(0),
+    accidentSystem(nullptr),
+    rowsVersion(std::numeric_limits<std::uint64_t>::max()),
+    snapshot(std::make_shared<const PredictionSnapshot>()),
+    predictionTimer(0.0f) {
+    syncRows();
 }
 
-// ================== MISSING METHOD ADDED ==================
-void PredictionSystem::addSpeedData(int edgeId, float speed) {
-    auto& history = edgeHistories[edgeId];
-    history.speeds.push_back(speed);
+// Rows follow the dense edge slots; histories of edges that survive a map
+// edit move to their new slot
+void PredictionSystem::syncRows() {
+    if (rowsVersion == graph->getTopologyVersion()) return;
+
+    int edgeCount = graph->getEdgeCount();
+    EdgeHistoryMatrix speeds(MAX_HISTORY_SIZE);
+    EdgeHistoryMatrix predictions(PREDICTION_HISTORY_SIZE);
+    SpeedKalmanFilter filters;
+    IncidentDetector detector;
+    speeds.resize(static_cast<size_t>(edgeCount));
+    predictions.resize(static_cast<size_t>(edgeCount));
+    filters.resize(static_cast<size_t>(edgeCount));
+    detector.resize(static_cast<size_t>(edgeCount));
+    SpatialSpeedModel spatial(PREDICTION_INTERVAL);
+    spatial.build(*graph);
+
+    std::unordered_map<int, int> oldRows;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        oldRows[rowEdgeIds[row]] = static_cast<int>(row);
+    }
 
-    if (history.speeds.size() > MAX_HISTORY_SIZE) {
-        history.speeds.pop_front();
+    std::vector<int> edgeIds(static_cast<size_t>(edgeCount));
+    std::vector<float> values;
+    rowSpeedLimits.resize(static_cast<size_t>(edgeCount));
+    for (int slot = 0; slot < edgeCount; slot++) {
+        edgeIds[slot] = graph->getEdgeAt(slot).id;
+        rowSpeedLimits[slot] = static_cast<float>(graph->getEdgeAt(slot).speedLimit);
+
+        auto old = oldRows.find(edgeIds[slot]);
+        if (old == oldRows.end()) continue;
+
+        values.clear();
+        speedHistory.appendRow(old->second, values);
+        speeds.assignRow(slot, values.data(), values.size());
+        values.clear();
+        predictionHistory.appendRow(old->second, values);
+        predictions.assignRow(slot, values.data(), values.size());
+        filters.setState(slot, speedFilter.getState(old->second));
+        spatial.setState(slot, spatialModel.getState(old->second));
+        detector.setState(slot, incidentDetector.getState(old->second));
+        values.clear();
+        spatialModel.appendHistory(old->second, values);
+        spatial.assignHistory(slot, values.data(), values.size());
+    }
+
+    speedHistory = std::move(speeds);
+    predictionHistory = std::move(predictions);
+    speedFilter = std::move(filters);
+    spatialModel = std::move(spatial);
+    incidentDetector = std::move(detector);
+    speedStore.remap(edgeIds);
+    speedProfile.remap(edgeIds);
+
+    // Until the next round, forecasts come from the filters alone
+    anchorForecast5 = rowSpeedLimits;
+    anchorForecast10 = rowSpeedLimits;
+    anchorWeights.assign(static_cast<size_t>(edgeCount), 0.0f);
+    profileForecast5.resize(static_cast<size_t>(edgeCount));
+    profileForecast10.resize(static_cast<size_t>(edgeCount));
+    profileWeights.resize(static_cast<size_t>(edgeCount));
+    profileShares.resize(static_cast<size_t>(edgeCount));
+    observedSums.assign(static_cast<size_t>(edgeCount), 0.0f);
+    observedCounts.assign(static_cast<size_t>(edgeCount), 0);
+
+    // Observations look edges up by id; map edge ids are usually dense
+    int maxId = -1;
+    bool negative = false;
+    for (int id : edgeIds) {
+        maxId = std::max(maxId, id);
+        negative = negative || id < 0;
+    }
+    rowByEdgeId.clear();
+    if (!negative && maxId < 4 * edgeCount + 1024) {
+        rowByEdgeId.assign(static_cast<size_t>(maxId + 1), -1);
+        for (int slot = 0; slot < edgeCount; slot++) {
+            rowByEdgeId[edgeIds[slot]] = slot;
+        }
     }
+    rowEdgeIds = std::move(edgeIds);
+    rowsVersion = graph->getTopologyVersion();
+}
+
+int PredictionSystem::findRow(int edgeId) const {
+    if (rowsVersion != graph->getTopologyVersion()) return -1;
+    return graph->getEdgeSlot(edgeId);
+}
+
+void PredictionSystem::setTimeOfWeek(double seconds) {
+    weekSeconds = std::fmod(seconds, SpeedProfile::WEEK_SECONDS);
+    if (weekSeconds < 0.0) weekSeconds += SpeedProfile::WEEK_SECONDS;
+}
+
+void PredictionSystem::setProfile(const SpeedProfile& profile) {
+    speedProfile = profile;
+    speedProfile.remap(rowEdgeIds);
+}
+
+// A copy takes the fold, so the bin in progress keeps collecting rounds
+bool PredictionSystem::saveProfile(const std::string& filename) const {
+    SpeedProfile folded = speedProfile;
+    folded.foldCurrentBin();
+    return folded.saveToFile(filename);
 }
 
 void PredictionSystem::update(float deltaTime) {
     predictionTimer += deltaTime;
+    setTimeOfWeek(weekSeconds + deltaTime);
 
     if (predictionTimer >= PREDICTION_INTERVAL) {
         predictionTimer = 0.0f;
+        syncRows();
 
-        auto edges = graph->getAllEdges();
-        for (const auto& pair : edges) {
-            const Edge& edge = pair.second;
+        int edgeCount = graph->getEdgeCount();
+        measuredSpeeds.resize(edgeCount);
+        measuredShares.resize(edgeCount);
+        for (int slot = 0; slot < edgeCount; slot++) {
+            const Edge& edge = graph->getEdgeAt(slot);
 
             // Calculate current speed from travel time
-            float currentSpeed = (edge.length / edge.currentTravelTime) * 60.0f;
+            measuredSpeeds[slot] = (edge.length / edge.currentTravelTime) * 60.0f;
+            if (observedCounts[slot] > 0) {
+                measuredSpeeds[slot] = observedSums[slot] / observedCounts[slot];
+                observedSums[slot] = 0.0f;
+                observedCounts[slot] = 0;
+            }
+            rowSpeedLimits[slot] = static_cast<float>(edge.speedLimit);
+            measuredShares[slot] = std::min(measuredSpeeds[slot] / rowSpeedLimits[slot], 1.0f);
+        }
+
+        speedHistory.pushAll(measuredSpeeds.data());
+        speedStore.appendRound(measuredSpeeds.data());
+        speedFilter.updateAll(measuredSpeeds.data());
+        speedProfile.observe(weekSeconds, measuredShares.data());
+        updateAnchorForecasts();
+        detectIncidents();
+        publishRound();
+    }
+}
+
+// Spatial steps are a minute long, far enough apart for congestion to move
+// between neighbouring roads; the forecast itself starts from this round. The
+// profile adds what the same time of week usually looks like 5 and 10
+// minutes from now.
+void PredictionSystem::updateAnchorForecasts() {
+    if (++spatialRound >= PredictionConfig::SPATIAL_STEP_ROUNDS) {
+        spatialRound = 0;
+        spatialModel.observe(measuredShares.data());
+    }
+
+    int rows = static_cast<int>(measuredShares.size());
+    spatialModel.forecast(measuredShares.data(), anchorForecast5.data(), anchorForecast10.data());
+
+    for (int row = 0; row < rows; row++) {
+        anchorForecast5[row] *= rowSpeedLimits[row];
+        anchorForecast10[row] *= rowSpeedLimits[row];
+        anchorWeights[row] = spatialModel.getSamples(row) >= PredictionConfig::SPATIAL_MIN_STEPS ?
+            PredictionConfig::SPATIAL_WEIGHT : 0.0f;
+    }
+
+    speedProfile.forecast(weekSeconds + 300.0, rowSpeedLimits.data(), PredictionConfig::PROFILE_MIN_DAYS,
+        PredictionConfig::PROFILE_WEIGHT, profileForecast5.data(), profileWeights.data());
+    speedProfile.forecast(weekSeconds + 600.0, rowSpeedLimits.data(), PredictionConfig::PROFILE_MIN_DAYS,
+        PredictionConfig::PROFILE_WEIGHT, profileForecast10.data(), profileWeights.data());
+    addForecastAnchor(rows, profileForecast5.data(), profileForecast10.data(), profileWeights.data(),
+        anchorForecast5.data(), anchorForecast10.data(), anchorWeights.data());
+}
+
+// Judged against the neighbour means of this round's spatial forecast and
+// the profile at this time of week
+void PredictionSystem::detectIncidents() {
+    int rows = static_cast<int>(measuredShares.size());
+    for (int row = 0; row < rows; row++) {
+        int dayCount = 0;
+        float share = speedProfile.getShare(row, weekSeconds, dayCount);
+        profileShares[row] = dayCount >= PredictionConfig::PROFILE_MIN_DAYS ? share : -1.0f;
+    }
+
+    incidentAlarms.clear();
+    incidentDetector.update(measuredShares.data(), spatialModel.getNeighborMeans(), profileShares.data(),
+        incidentAlarms);
+
+    if (!accidentSystem) return;
+    for (int row : incidentAlarms) {
+        accidentSystem->raiseIncident(rowEdgeIds[row], PredictionConfig::INCIDENT_HOLD_SECONDS);
+    }
+}
 
-            addSpeedData(edge.id, currentSpeed);  // NOW THIS WILL WORK
+// The only place predictions enter the history: one per edge per round, so
+// the history grows with the samples however often readers ask
+void PredictionSystem::publishRound() {
+    auto next = std::make_shared<PredictionSnapshot>();
+    std::shared_ptr<const PredictionSnapshot> previous = getSnapshot();
+    next->version = previous->version + 1;
+    next->topologyVersion = rowsVersion;
+    next->timeOfWeek = weekSeconds;
+
+    predictAllEdges(next->predictions);
+    predictionHistory.pushAll(forecast5.data());
+
+    std::vector<std::pair<float, int>> ranked5, ranked10;
+    for (size_t row = 0; row < next->predictions.size(); row++) {
+        const TrafficPrediction& pred = next->predictions[row];
+        if (pred.willBeCongested && pred.confidence > 0.6f) {
+            next->predictedCongestionCount++;
+        }
+        if (pred.confidence <= 0.6f) continue;
+
+        float probability5 = 1.0f - pred.predictedSpeed5min / rowSpeedLimits[row];
+        float probability10 = 1.0f - pred.predictedSpeed10min / rowSpeedLimits[row];
+        if (probability5 > 0.5f) ranked5.push_back({ probability5, pred.edgeId });
+        if (probability10 > 0.5f) ranked10.push_back({ probability10, pred.edgeId });
+    }
+
+    // Most likely first; ties keep edge id order so rankings are reproducible
+    auto rank = [](std::vector<std::pair<float, int>>& ranked, std::vector<int>& out) {
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        out.reserve(ranked.size());
+        for (const auto& entry : ranked) {
+            out.push_back(entry.second);
         }
+    };
+    rank(ranked5, next->likelyCongested5);
+    rank(ranked10, next->likelyCongested10);
+
+    next->averageAccuracy = computeAccuracy();
+    snapshot.store(std::move(next), std::memory_order_release);
+}
+
+size_t PredictionSystem::addObservations(const SpeedObservation* observations, size_t count) {
+    syncRows();
+
+    int tableSize = static_cast<int>(rowByEdgeId.size());
+    bool table = tableSize > 0;
+    size_t matched = 0;
+    for (size_t i = 0; i < count; i++) {
+        int edgeId = observations[i].edgeId;
+        int row = table ? (edgeId >= 0 && edgeId < tableSize ? rowByEdgeId[edgeId] : -1)
+            : graph->getEdgeSlot(edgeId);
+        if (row == -1) continue;
+
+        observedSums[row] += observations[i].speed;
+        observedCounts[row]++;
+        matched++;
     }
+    return matched;
 }
 
-TrafficPrediction PredictionSystem::predictEdgeInternal(int edgeId, bool updateHistory) const {
+TrafficPrediction PredictionSystem::predictEdgeInternal(int edgeId) const {
     TrafficPrediction prediction;
     prediction.edgeId = edgeId;
 
-    auto it = edgeHistories.find(edgeId);
-    if (it == edgeHistories.end() || it->second.speeds.empty()) {
+    int row = findRow(edgeId);
+    if (row == -1 || speedFilter.empty(row)) {
         Edge edge = graph->getEdge(edgeId);
         prediction.currentSpeed = edge.speedLimit;
         prediction.predictedSpeed5min = edge.speedLimit;
@@ -47,98 +300,78 @@ TrafficPrediction PredictionSystem::predictEdgeInternal(int edgeId, bool updateH
         return prediction;
     }
 
-    const auto& speeds = it->second.speeds;
-    float currentSpeed = speeds.back();
-    prediction.currentSpeed = currentSpeed;
-
-    // Use multiple algorithms
-    float pred1 = exponentialSmoothing(speeds);
-    float pred2 = weightedMovingAverage(speeds);
-    float pred3 = simpleMovingAverage(speeds);
+    prediction.currentSpeed = speedHistory.back(row);
 
-    prediction.predictedSpeed5min = (pred1 + pred2 + pred3) / 3.0f;
-
-    float trend = prediction.predictedSpeed5min - currentSpeed;
-    prediction.predictedSpeed10min = prediction.predictedSpeed5min + (trend * 0.5f);
-
-    if (isPeakHour()) {
-        prediction.predictedSpeed5min *= 0.7f;
-        prediction.predictedSpeed10min *= 0.6f;
-    }
-
-    Edge edge = graph->getEdge(edgeId);
-    prediction.predictedSpeed5min = std::max(5.0f,
-        std::min(prediction.predictedSpeed5min, (float)edge.speedLimit));
-    prediction.predictedSpeed10min = std::max(5.0f,
-        std::min(prediction.predictedSpeed10min, (float)edge.speedLimit));
-
-    prediction.confidence = calculateConfidence(speeds);
+    computeEdgeForecasts(1, rowColumns(speedFilter.getColumns(), row), horizon5, horizon10,
+        &anchorForecast5[row], &anchorForecast10[row], &anchorWeights[row], &rowSpeedLimits[row],
+        &prediction.predictedSpeed5min, &prediction.predictedSpeed10min, &prediction.confidence);
     prediction.willBeCongested = prediction.predictedSpeed5min < 20.0f;
 
     return prediction;
 }
 
 TrafficPrediction PredictionSystem::predictEdge(int edgeId) {
-    TrafficPrediction prediction = predictEdgeInternal(edgeId, false);
-
-    // Update history for non-const version only
-    edgeHistories[edgeId].predictions.push_back(prediction.predictedSpeed5min);
-    if (edgeHistories[edgeId].predictions.size() > 20) {
-        edgeHistories[edgeId].predictions.pop_front();
-    }
-
-    return prediction;
+    return predictEdgeInternal(edgeId);
 }
 
 TrafficPrediction PredictionSystem::predictEdgeConst(int edgeId) const {
-    return predictEdgeInternal(edgeId, false);
+    return predictEdgeInternal(edgeId);
 }
 
 std::vector<TrafficPrediction> PredictionSystem::predictAllEdges() {
     std::vector<TrafficPrediction> predictions;
-    auto edges = graph->getAllEdges();
-
-    predictions.reserve(edges.size());
-    for (const auto& pair : edges) {
-        predictions.push_back(predictEdge(pair.first));
-    }
-
+    predictAllEdges(predictions);
     return predictions;
 }
 
-std::vector<int> PredictionSystem::getEdgesLikelyToCongest(int minutesAhead) {
-    std::vector<std::pair<int, float>> edgeCongestion;
-
-    auto predictions = predictAllEdges();
-    for (const auto& pred : predictions) {
-        float predictedSpeed = (minutesAhead <= 5) ?
-            pred.predictedSpeed5min : pred.predictedSpeed10min;
-
-        Edge edge = graph->getEdge(pred.edgeId);
-        float congestionProb = 1.0f - (predictedSpeed / edge.speedLimit);
-
-        if (congestionProb > 0.5f && pred.confidence > 0.6f) {
-            edgeCongestion.push_back({ pred.edgeId, congestionProb });
-        }
+// Every edge in one pass of the kernel over the filter columns
+void PredictionSystem::predictAllEdges(std::vector<TrafficPrediction>& out) {
+    syncRows();
+
+    int rows = static_cast<int>(speedFilter.getRowCount());
+    forecast5.resize(rows);
+    forecast10.resize(rows);
+    forecastConfidence.resize(rows);
+
+    computeEdgeForecasts(rows, speedFilter.getColumns(), horizon5, horizon10, anchorForecast5.data(),
+        anchorForecast10.data(), anchorWeights.data(), rowSpeedLimits.data(),
+        forecast5.data(), forecast10.data(), forecastConfidence.data());
+
+    out.resize(rows);
+    for (int row = 0; row < rows; row++) {
+        bool known = !speedHistory.empty(row);
+        TrafficPrediction& prediction = out[row];
+        prediction.edgeId = rowEdgeIds[row];
+        prediction.currentSpeed = known ? speedHistory.back(row) : rowSpeedLimits[row];
+        prediction.predictedSpeed5min = forecast5[row];
+        prediction.predictedSpeed10min = forecast10[row];
+        prediction.confidence = forecastConfidence[row];
+        prediction.willBeCongested = known && forecast5[row] < 20.0f;
     }
+}
 
-    std::sort(edgeCongestion.begin(), edgeCongestion.end(),
-        [](const auto& a, const auto& b) {
-            return a.second > b.second;
-        });
+int PredictionSystem::getSpeedHistory(int edgeId, float minutes, std::vector<float>& out) const {
+    int row = findRow(edgeId);
+    if (row == -1) return 0;
 
-    std::vector<int> result;
-    result.reserve(edgeCongestion.size());
-    for (const auto& pair : edgeCongestion) {
-        result.push_back(pair.first);
-    }
+    long long last = speedStore.getRoundCount();
+    long long first = last - static_cast<long long>(minutes * 60.0f / PREDICTION_INTERVAL);
+    return speedStore.decode(row, first, last, out);
+}
 
-    return result;
+std::vector<int> PredictionSystem::getEdgesLikelyToCongest(int minutesAhead) const {
+    std::shared_ptr<const PredictionSnapshot> current = getSnapshot();
+    return minutesAhead <= 5 ? current->likelyCongested5 : current->likelyCongested10;
 }
 
-float PredictionSystem::getRoutePredictedTime(const std::vector<int>& path, int minutesAhead) {
+// Edges the snapshot knows are looked up by slot; anything newer than the
+// last round is predicted on the spot
+float PredictionSystem::getRoutePredictedTime(const std::vector<int>& path, int minutesAhead) const {
     if (path.size() < 2) return 0.0f;
 
+    std::shared_ptr<const PredictionSnapshot> current = getSnapshot();
+    bool sameLayout = current->topologyVersion == graph->getTopologyVersion() &&
+        current->predictions.size() == static_cast<size_t>(graph->getEdgeCount());
     float totalTime = 0.0f;
 
     for (size_t i = 0; i < path.size() - 1; i++) {
@@ -149,11 +382,13 @@ float PredictionSystem::getRoutePredictedTime(const std::vector<int>& path, int
         int edgeId = graph->findEdgeId(fromNode, toNode);
 
         if (edgeId != -1) {
-            TrafficPrediction pred = predictEdge(edgeId);
+            int slot = graph->getEdgeSlot(edgeId);
+            TrafficPrediction pred = sameLayout && slot != -1 ?
+                current->predictions[slot] : predictEdgeConst(edgeId);
             float predictedSpeed = (minutesAhead <= 5) ?
                 pred.predictedSpeed5min : pred.predictedSpeed10min;
 
-            Edge edge = graph->getEdge(edgeId);
+            const Edge& edge = graph->getEdgeAt(slot);
             float predictedTravelTime = (edge.length / predictedSpeed) * 60.0f;
 
             totalTime += predictedTravelTime;
@@ -164,135 +399,243 @@ float PredictionSystem::getRoutePredictedTime(const std::vector<int>& path, int
 }
 
 // ================== PREDICTION ALGORITHMS ==================
-
-float PredictionSystem::simpleMovingAverage(const std::deque<float>& data, int window) const {
-    if (data.empty()) return 0.0f;
-
-    int actualWindow = std::min(window, (int)data.size());
-    float sum = 0.0f;
-
-    for (int i = data.size() - actualWindow; i < data.size(); i++) {
-        sum += data[i];
+// Forecast h rounds ahead: level + g(h) * trend, with the damped trend gain g,
+// then moved towards the anchor forecast by its weight
+// Variance: P00 + 2 g P01 + g^2 P11 plus the process noise of the h rounds
+// Confidence: 1 - min(2 * sqrt(variance5) / speedLimit, 1)
+
+void computeEdgeForecasts(int n, const SpeedKalmanFilter::Columns& filters,
+    const SpeedKalmanFilter::Horizon& near, const SpeedKalmanFilter::Horizon& far,
+    const float* anchor5, const float* anchor10, const float* anchorWeight,
+    const float* speedLimit, float* predicted5, float* predicted10, float* confidence) {
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256 vGain5 = _mm256_set1_ps(near.trendGain);
+    const __m256 vGain10 = _mm256_set1_ps(far.trendGain);
+    const __m256 vGain5Squared = _mm256_set1_ps(near.trendGain * near.trendGain);
+    const __m256 vTwoGain5 = _mm256_set1_ps(2.0f * near.trendGain);
+    const __m256 vNoise5 = _mm256_set1_ps(near.noiseVariance);
+    const __m256 vMinSpeed = _mm256_set1_ps(5.0f);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vTwo = _mm256_set1_ps(2.0f);
+    const __m256 vZero = _mm256_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 level = _mm256_loadu_ps(filters.level + i);
+        __m256 trend = _mm256_loadu_ps(filters.trend + i);
+        __m256 limit = _mm256_loadu_ps(speedLimit + i);
+
+        __m256 weight = _mm256_loadu_ps(anchorWeight + i);
+        __m256 p5 = _mm256_add_ps(level, _mm256_mul_ps(vGain5, trend));
+        __m256 p10 = _mm256_add_ps(level, _mm256_mul_ps(vGain10, trend));
+        p5 = _mm256_add_ps(p5, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_loadu_ps(anchor5 + i), p5)));
+        p10 = _mm256_add_ps(p10, _mm256_mul_ps(weight, _mm256_sub_ps(_mm256_loadu_ps(anchor10 + i), p10)));
+        p5 = _mm256_max_ps(_mm256_min_ps(limit, p5), vMinSpeed);
+        p10 = _mm256_max_ps(_mm256_min_ps(limit, p10), vMinSpeed);
+
+        __m256 variance = _mm256_add_ps(
+            _mm256_add_ps(_mm256_loadu_ps(filters.levelVariance + i),
+                _mm256_mul_ps(vTwoGain5, _mm256_loadu_ps(filters.covariance + i))),
+            _mm256_add_ps(_mm256_mul_ps(vGain5Squared, _mm256_loadu_ps(filters.trendVariance + i)), vNoise5));
+        __m256 spread = _mm256_div_ps(_mm256_mul_ps(vTwo, _mm256_sqrt_ps(variance)), limit);
+        __m256 conf = _mm256_sub_ps(vOne, _mm256_min_ps(vOne, spread));
+
+        __m256 empty = _mm256_cmp_ps(_mm256_loadu_ps(filters.samples + i), vZero, _CMP_EQ_OQ);
+        _mm256_storeu_ps(predicted5 + i, _mm256_blendv_ps(p5, limit, empty));
+        _mm256_storeu_ps(predicted10 + i, _mm256_blendv_ps(p10, limit, empty));
+        _mm256_storeu_ps(confidence + i, _mm256_blendv_ps(conf, vZero, empty));
     }
+#endif
+
+    // Scalar path (and AVX2 remainder)
+    for (; i < n; i++) {
+        float limit = speedLimit[i];
+        if (filters.samples[i] == 0.0f) {
+            predicted5[i] = limit;
+            predicted10[i] = limit;
+            confidence[i] = 0.0f;
+            continue;
+        }
 
-    return sum / actualWindow;
-}
-
-float PredictionSystem::weightedMovingAverage(const std::deque<float>& data) const {
-    if (data.empty()) return 0.0f;
-
-    float sum = 0.0f;
-    float weightSum = 0.0f;
-
-    for (size_t i = 0; i < data.size(); i++) {
-        float weight = (i + 1.0f) / data.size();
-        sum += data[i] * weight;
-        weightSum += weight;
+        float level = filters.level[i];
+        float trend = filters.trend[i];
+        float p5 = level + near.trendGain * trend;
+        float p10 = level + far.trendGain * trend;
+        p5 += anchorWeight[i] * (anchor5[i] - p5);
+        p10 += anchorWeight[i] * (anchor10[i] - p10);
+        predicted5[i] = std::max(5.0f, std::min(p5, limit));
+        predicted10[i] = std::max(5.0f, std::min(p10, limit));
+
+        float variance = filters.levelVariance[i] + 2.0f * near.trendGain * filters.covariance[i] +
+            near.trendGain * near.trendGain * filters.trendVariance[i] + near.noiseVariance;
+        confidence[i] = 1.0f - std::min(2.0f * std::sqrt(variance) / limit, 1.0f);
     }
-
-    return sum / weightSum;
 }
 
-float PredictionSystem::exponentialSmoothing(const std::deque<float>& data, float alpha) const {
-    if (data.empty()) return 0.0f;
+void addForecastAnchor(int n, const float* forecast5, const float* forecast10, const float* weight,
+    float* anchor5, float* anchor10, float* anchorWeight) {
+    for (int i = 0; i < n; i++) {
+        float total = anchorWeight[i] + weight[i];
+        if (weight[i] <= 0.0f || total <= 0.0f) continue;
 
-    float result = data[0];
-    for (size_t i = 1; i < data.size(); i++) {
-        result = alpha * data[i] + (1 - alpha) * result;
+        float share = weight[i] / total;
+        anchor5[i] += share * (forecast5[i] - anchor5[i]);
+        anchor10[i] += share * (forecast10[i] - anchor10[i]);
+        anchorWeight[i] = std::min(total, 1.0f);
     }
-
-    return result;
 }
 
-float PredictionSystem::linearRegressionPrediction(const std::deque<float>& data) const {
-    if (data.size() < 3) return data.empty() ? 0.0f : data.back();
-
-    float sumX = 0.0f, sumY = 0.0f, sumXY = 0.0f, sumX2 = 0.0f;
-    int n = data.size();
+// The prediction made in a round is for the speed sampled in the next one, so
+// the newest prediction has nothing to compare against yet
+float PredictionSystem::computeAccuracy() const {
+    float totalAccuracy = 0.0f;
+    int count = 0;
 
-    for (int i = 0; i < n; i++) {
-        float x = i;
-        float y = data[i];
-        sumX += x;
-        sumY += y;
-        sumXY += x * y;
-        sumX2 += x * x;
+    for (size_t row = 0; row < predictionHistory.getRowCount(); row++) {
+        int speeds = speedHistory.size(row);
+        int pairs = std::min(speeds, predictionHistory.size(row) - 1);
+        if (pairs < 1) continue;
+
+        float errorSum = 0.0f;
+        for (int k = 0; k < pairs; k++) {
+            float actual = speedHistory.at(row, speeds - 1 - k);
+            float predicted = predictionHistory.at(row, predictionHistory.size(row) - 2 - k);
+            float error = fabs(actual - predicted) / actual;
+            errorSum += std::min(error, 1.0f);
+        }
+        totalAccuracy += 1.0f - (errorSum / pairs);
+        count++;
     }
 
-    float m = (n * sumXY - sumX * sumY) / (n * sumX2 - sumX * sumX);
-    float b = (sumY - m * sumX) / n;
+    return count > 0 ? totalAccuracy / count : 0.0f;
+}
 
-    return m * n + b;
+float PredictionSystem::getAveragePredictionAccuracy() const {
+    return getSnapshot()->averageAccuracy;
 }
 
-float PredictionSystem::calculateConfidence(const std::deque<float>& history) const {
-    if (history.size() < 10) return 0.3f;
+int PredictionSystem::getPredictedCongestionCount() const {
+    return getSnapshot()->predictedCongestionCount;
+}
 
-    float mean = 0.0f;
-    for (float speed : history) {
-        mean += speed;
+// Histories are stored as flat value columns plus per-edge lengths, and
+// filters, spatial fits and incident detectors as one State per edge, keyed
+// by edge id
+void PredictionSystem::saveState(BinaryWriter& writer) const {
+    std::vector<std::pair<int, int>> rows;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        if (!speedHistory.empty(row) || !predictionHistory.empty(row)) {
+            rows.push_back({ rowEdgeIds[row], static_cast<int>(row) });
+        }
     }
-    mean /= history.size();
-
-    float variance = 0.0f;
-    for (float speed : history) {
-        variance += (speed - mean) * (speed - mean);
+    std::sort(rows.begin(), rows.end());
+
+    std::vector<int> ids;
+    std::vector<std::uint32_t> speedCounts, predictionCounts;
+    std::vector<float> speeds, predictions;
+    std::vector<SpeedKalmanFilter::State> filters;
+    std::vector<SpatialSpeedModel::State> spatialStates;
+    std::vector<IncidentDetector::State> detectorStates;
+    std::vector<std::uint32_t> shareCounts;
+    std::vector<float> shares;
+    ids.reserve(rows.size());
+    speedCounts.reserve(rows.size());
+    predictionCounts.reserve(rows.size());
+
+    for (const auto& [id, row] : rows) {
+        ids.push_back(id);
+        speedCounts.push_back(static_cast<std::uint32_t>(speedHistory.size(row)));
+        speedHistory.appendRow(row, speeds);
+        filters.push_back(speedFilter.getState(row));
+        spatialStates.push_back(spatialModel.getState(row));
+        detectorStates.push_back(incidentDetector.getState(row));
+        shareCounts.push_back(static_cast<std::uint32_t>(spatialModel.getHistorySize(row)));
+        spatialModel.appendHistory(row, shares);
+        predictionCounts.push_back(static_cast<std::uint32_t>(predictionHistory.size(row)));
+        predictionHistory.appendRow(row, predictions);
     }
-    variance /= history.size();
 
-    float stdDev = sqrt(variance);
-    float coefficientOfVariation = stdDev / mean;
-
-    float confidence = 1.0f - std::min(coefficientOfVariation, 1.0f);
-    float dataConfidence = std::min(history.size() / 30.0f, 1.0f);
-
-    return (confidence * 0.7f + dataConfidence * 0.3f);
-}
-
-bool PredictionSystem::isPeakHour() const {
-    // Simple simulation - returns true 50% of the time
-    static int counter = 0;
-    counter++;
-    return (counter / 60) % 2 == 0; // Toggle every 60 calls
+    writer.writeTag("PRED");
+    writer.write(predictionTimer);
+    writer.write(spatialRound);
+    writer.write(weekSeconds);
+    writer.writeArray(ids);
+    writer.writeArray(speedCounts);
+    writer.writeArray(speeds);
+    writer.writeArray(filters);
+    writer.writeArray(spatialStates);
+    writer.writeArray(detectorStates);
+    writer.writeArray(shareCounts);
+    writer.writeArray(shares);
+    writer.writeArray(predictionCounts);
+    writer.writeArray(predictions);
+    speedStore.saveState(writer);
+    speedProfile.saveState(writer);
 }
 
-float PredictionSystem::getAveragePredictionAccuracy() const {
-    if (edgeHistories.empty()) return 0.0f;
+bool PredictionSystem::loadState(BinaryReader& reader) {
+    float savedTimer;
+    int savedSpatialRound;
+    double savedWeekSeconds;
+    std::vector<int> ids;
+    std::vector<std::uint32_t> speedCounts, predictionCounts;
+    std::vector<float> speeds, predictions;
+    std::vector<SpeedKalmanFilter::State> filters;
+    std::vector<SpatialSpeedModel::State> spatialStates;
+    std::vector<IncidentDetector::State> detectorStates;
+    std::vector<std::uint32_t> shareCounts;
+    std::vector<float> shares;
+
+    if (!reader.expectTag("PRED") || !reader.read(savedTimer) || !reader.read(savedSpatialRound) ||
+        !reader.read(savedWeekSeconds) ||
+        !reader.readArray(ids) || !reader.readArray(speedCounts) || !reader.readArray(speeds) ||
+        !reader.readArray(filters) || !reader.readArray(spatialStates) ||
+        !reader.readArray(detectorStates) || !reader.readArray(shareCounts) || !reader.readArray(shares) ||
+        !reader.readArray(predictionCounts) || !reader.readArray(predictions)) {
+        return false;
+    }
 
-    float totalAccuracy = 0.0f;
-    int count = 0;
+    std::uint64_t speedTotal = 0, predictionTotal = 0, shareTotal = 0;
+    for (size_t i = 0; i < speedCounts.size(); i++) speedTotal += speedCounts[i];
+    for (size_t i = 0; i < predictionCounts.size(); i++) predictionTotal += predictionCounts[i];
+    for (size_t i = 0; i < shareCounts.size(); i++) shareTotal += shareCounts[i];
+
+    if (speedCounts.size() != ids.size() || predictionCounts.size() != ids.size() ||
+        filters.size() != ids.size() || spatialStates.size() != ids.size() ||
+        detectorStates.size() != ids.size() || shareCounts.size() != ids.size() || speedTotal != speeds.size() ||
+        predictionTotal != predictions.size() || shareTotal != shares.size()) {
+        std::cerr << "Error: Corrupt prediction section in checkpoint" << std::endl;
+        reader.fail();
+        return false;
+    }
 
-    for (const auto& pair : edgeHistories) {
-        if (pair.second.predictions.size() >= 2) {
-            const auto& preds = pair.second.predictions;
-            const auto& speeds = pair.second.speeds;
-
-            if (preds.size() >= 2 && speeds.size() >= preds.size() + 1) {
-                float errorSum = 0.0f;
-                for (size_t i = 0; i < preds.size() - 1; i++) {
-                    float actual = speeds[i + 1];
-                    float predicted = preds[i];
-                    float error = fabs(actual - predicted) / actual;
-                    errorSum += std::min(error, 1.0f);
-                }
-                totalAccuracy += 1.0f - (errorSum / (preds.size() - 1));
-                count++;
-            }
+    rowsVersion = std::numeric_limits<std::uint64_t>::max();
+    rowEdgeIds.clear();
+    syncRows();
+
+    size_t speedPos = 0, predictionPos = 0, sharePos = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        int row = findRow(ids[i]);
+        if (row != -1) {
+            speedHistory.assignRow(row, speeds.data() + speedPos, speedCounts[i]);
+            predictionHistory.assignRow(row, predictions.data() + predictionPos, predictionCounts[i]);
+            speedFilter.setState(row, filters[i]);
+            spatialModel.setState(row, spatialStates[i]);
+            incidentDetector.setState(row, detectorStates[i]);
+            spatialModel.assignHistory(row, shares.data() + sharePos, shareCounts[i]);
         }
+        speedPos += speedCounts[i];
+        predictionPos += predictionCounts[i];
+        sharePos += shareCounts[i];
     }
 
-    return count > 0 ? totalAccuracy / count : 0.0f;
-}
-
-int PredictionSystem::getPredictedCongestionCount() {
-    int count = 0;
-    auto predictions = predictAllEdges();
-
-    for (const auto& pred : predictions) {
-        if (pred.willBeCongested && pred.confidence > 0.6f) {
-            count++;
-        }
+    if (!speedStore.loadState(reader) || !speedProfile.loadState(reader)) {
+        return false;
     }
 
-    return count;
-}
\ No newline at end of file
+    predictionTimer = savedTimer;
+    spatialRound = savedSpatialRound;
+    setTimeOfWeek(savedWeekSeconds);
+    return true;
+}
@@ -1,12 +1,22 @@
-// PredictionSystem.h - FIXED VERSION
 #pragma once
 #include <vector>
-#include <deque>
-#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+#include <memory>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include "Graph.h"
+#include "EdgeHistoryMatrix.h"
+#include "SpeedKalmanFilter.h"
+#include "SpatialSpeedModel.h"
+#include "SpeedHistoryStore.h"
+#include "SpeedProfile.h"
+#include "IncidentDetector.h"
+
+class BinaryWriter;
+class BinaryReader;
+class AccidentSystem;
 
 struct TrafficPrediction {
     int edgeId;
@@ -28,22 +38,92 @@ struct TrafficPrediction {
     }
 };
 
+// A speed measured on a road outside the simulation, by a probe vehicle or
+// a loop detector
+struct SpeedObservation {
+    double time;                              // Simulated seconds
+    int edgeId;
+    float speed;                              // km/h
+};
+
+// Everything one prediction round produced. Published once per
+// PREDICTION_INTERVAL and never modified afterwards, so any thread may keep
+// and read one while the next round is computed.
+struct PredictionSnapshot {
+    std::uint64_t version = 0;                // Prediction rounds so far, 0 = none yet
+    std::uint64_t topologyVersion = 0;        // Graph layout the slots refer to
+    double timeOfWeek = 0.0;                  // Seconds since Monday 00:00 the round ran at
+    std::vector<TrafficPrediction> predictions;   // Dense edge slot order
+    std::vector<int> likelyCongested5;        // Edge ids, most likely to congest first
+    std::vector<int> likelyCongested10;
+    int predictedCongestionCount = 0;
+    float averageAccuracy = 0.0f;
+};
+
+// 5- and 10-minute forecasts for n edges from their Kalman filters, moved
+// towards the anchor forecasts by anchorWeight and clamped to
+// [5, speedLimit]. Confidence falls from 1 to 0 as the standard deviation of
+// the 5-minute Kalman forecast grows to half the speed limit. An edge without
+// measurements forecasts its speed limit with zero confidence. Uses AVX2 when
+// the compiler targets it, scalar otherwise.
+void computeEdgeForecasts(int n, const SpeedKalmanFilter::Columns& filters,
+    const SpeedKalmanFilter::Horizon& near, const SpeedKalmanFilter::Horizon& far,
+    const float* anchor5, const float* anchor10, const float* anchorWeight,
+    const float* speedLimit, float* predicted5, float* predicted10, float* confidence);
+
+// Folds another forecast into the anchors computeEdgeForecasts moves
+// towards: each anchor becomes the weighted mean of the two and its weight
+// their sum
+void addForecastAnchor(int n, const float* forecast5, const float* forecast10, const float* weight,
+    float* anchor5, float* anchor10, float* anchorWeight);
+
 class PredictionSystem {
 private:
     Graph* graph;
 
-    // Store historical data for each edge
-    struct EdgeHistory {
-        std::deque<float> speeds;     // Last hour of speed data (60 samples if 1/min)
-        std::deque<float> predictions; // Previous predictions for accuracy calculation
-    };
-
-    std::unordered_map<int, EdgeHistory> edgeHistories;
-
     // Configuration
-    const int MAX_HISTORY_SIZE = 2;   // 2 minutes of data
+    const int MAX_HISTORY_SIZE = 2;   // Last two rounds; the long history is in speedStore
+    const int PREDICTION_HISTORY_SIZE = 20;
     const float PREDICTION_INTERVAL = 5.0f; // Predict every 5 seconds
 
+    // Historical data, one row per dense edge slot; the filter and spatial
+    // model parameters are in PredictionConfig
+    EdgeHistoryMatrix speedHistory;       // Measured speeds
+    EdgeHistoryMatrix predictionHistory;  // Previous predictions for accuracy calculation
+    SpeedHistoryStore speedStore;         // Every measured speed for SPEED_HISTORY_HOURS, compressed
+    SpeedProfile speedProfile;            // Typical share of the speed limit by time of week
+    double weekSeconds;                   // Seconds since Monday 00:00, advanced by update()
+    SpeedKalmanFilter speedFilter;
+    SpeedKalmanFilter::Horizon horizon5;
+    SpeedKalmanFilter::Horizon horizon10;
+    SpatialSpeedModel spatialModel;
+    int spatialRound;                     // Rounds since the last spatial step
+    IncidentDetector incidentDetector;
+    AccidentSystem* accidentSystem;       // Receives detected incidents, may be null
+    std::vector<int> rowEdgeIds;
+    std::vector<int> rowByEdgeId;         // Row of each edge id, empty when ids are too sparse for a table
+    std::vector<float> rowSpeedLimits;
+    std::uint64_t rowsVersion;            // Graph topology the rows were laid out for
+
+    // Batch forecast output, one entry per row
+    std::vector<float> measuredSpeeds;
+    std::vector<float> measuredShares;    // Speed / speed limit
+    std::vector<float> observedSums;      // External observations since the last round
+    std::vector<std::uint32_t> observedCounts;
+    std::vector<float> anchorForecast5;   // km/h: spatial and profile forecasts, refreshed every round
+    std::vector<float> anchorForecast10;
+    std::vector<float> anchorWeights;
+    std::vector<float> profileForecast5;
+    std::vector<float> profileForecast10;
+    std::vector<float> profileWeights;
+    std::vector<float> profileShares;     // Profile share now, -1 without one, for the incident detector
+    std::vector<int> incidentAlarms;
+    std::vector<float> forecast5;
+    std::vector<float> forecast10;
+    std::vector<float> forecastConfidence;
+
+    std::atomic<std::shared_ptr<const PredictionSnapshot>> snapshot;
+
     // Performance tracking
     float predictionTimer;
 
@@ -52,30 +132,71 @@ public:
 
     // Main methods
     void update(float deltaTime);
+    float getSecondsToNextUpdate() const { return PREDICTION_INTERVAL - predictionTimer; }
+    float getUpdateInterval() const { return PREDICTION_INTERVAL; }
+    // Time of week in seconds since Monday 00:00, which the profile is binned by
+    void setTimeOfWeek(double seconds);
+    double getTimeOfWeek() const { return weekSeconds; }
+    // Latest published round; never null
+    std::shared_ptr<const PredictionSnapshot> getSnapshot() const {
+        return snapshot.load(std::memory_order_acquire);
+    }
+
+    // Speeds measured outside the simulation. An edge's observations since
+    // the last round replace the speed derived from its travel time in the
+    // next one. They are not checkpointed; a feed resumes from its source.
+    // Returns how many were on an edge of the map.
+    size_t addObservations(const SpeedObservation* observations, size_t count);
+
+    // Fresh forecasts from the current history. They do not enter the
+    // prediction history; only update() records one prediction per round.
     TrafficPrediction predictEdge(int edgeId);
-    TrafficPrediction predictEdgeConst(int edgeId) const;  // ADDED const version
+    TrafficPrediction predictEdgeConst(int edgeId) const;
     std::vector<TrafficPrediction> predictAllEdges();
 
-    // Advanced predictions
-    std::vector<int> getEdgesLikelyToCongest(int minutesAhead = 5);
-    float getRoutePredictedTime(const std::vector<int>& path, int minutesAhead = 5);
+    // Every edge in one pass over the history columns, in dense slot order;
+    // out is resized to the edge count and its storage reused
+    void predictAllEdges(std::vector<TrafficPrediction>& out);
+
+    // Advanced predictions, read from the latest snapshot
+    std::vector<int> getEdgesLikelyToCongest(int minutesAhead = 5) const;
+    float getRoutePredictedTime(const std::vector<int>& path, int minutesAhead = 5) const;
 
-    // Statistics
+    // Measured speeds of the edge over the last `minutes`, oldest first,
+    // appended to out; returns how many
+    int getSpeedHistory(int edgeId, float minutes, std::vector<float>& out) const;
+    const SpeedHistoryStore& getSpeedStore() const { return speedStore; }
+
+    // Replaces the time-of-week profile, matched to the map by edge id; it
+    // keeps learning from every round
+    void setProfile(const SpeedProfile& profile);
+    const SpeedProfile& getProfile() const { return speedProfile; }
+    // Saves the profile including the bin in progress
+    bool saveProfile(const std::string& filename) const;
+
+    // Every round, edges whose speed drops well below both their
+    // neighbours' and their profile's are raised as candidate incidents in
+    // this system for INCIDENT_HOLD_SECONDS
+    void setAccidentSystem(AccidentSystem* accidents) { accidentSystem = accidents; }
+    const IncidentDetector& getIncidentDetector() const { return incidentDetector; }
+
+    // Statistics, read from the latest snapshot
     float getAveragePredictionAccuracy() const;
-    int getPredictedCongestionCount();
+    int getPredictedCongestionCount() const;
 
-private:
-    // Prediction algorithms - FIXED: remove duplicate declarations
-    float simpleMovingAverage(const std::deque<float>& data, int window = 10) const;
-    float weightedMovingAverage(const std::deque<float>& data) const;
-    float exponentialSmoothing(const std::deque<float>& data, float alpha = 0.3f) const;
-    float linearRegressionPrediction(const std::deque<float>& data) const;
-    float calculateConfidence(const std::deque<float>& history) const;  // ONLY ONE DECLARATION
-    bool isPeakHour() const;  // ONLY ONE DECLARATION
+    // Checkpointing of the histories and filters
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
 
+private:
     // Helper methods
-    void addSpeedData(int edgeId, float speed);
+    void updateAnchorForecasts();     // Spatial and profile forecasts for this round
+    void detectIncidents();           // Raise this round's incident alarms
+    void publishRound();              // Predict every edge and publish a new snapshot
+    float computeAccuracy() const;
+    void syncRows();                  // Lay the rows out again after the map changed
+    int findRow(int edgeId) const;    // -1 until the rows match the map
 
-    // Internal prediction method
-    TrafficPrediction predictEdgeInternal(int edgeId, bool updateHistory = false) const;
+    // Shared by predictEdge and predictEdgeConst
+    TrafficPrediction predictEdgeInternal(int edgeId) const;
 };
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "ProcessExchange.h"
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+// Lives at the start of the mapping. The barrier is a generation counter the
+// waiters sleep on with process-shared futexes.
+struct ProcessExchange::Header {
+    std::atomic<int> arrived;
+    std::atomic<int> generation;
+    std::atomic<int> aborted;
+    std::atomic<int> stopping;
+    int parties;
+};
+
+namespace {
+    constexpr size_t MAILBOX_ALIGNMENT = 64;
+    constexpr long FUTEX_TIMEOUT_NANOSECONDS = 50 * 1000 * 1000;
+
+#ifdef __linux__
+    int* futexWord(std::atomic<int>& value) {
+        static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain int");
+        return reinterpret_cast<int*>(&value);
+    }
+
+    void futexWait(std::atomic<int>& value, int expected) {
+        timespec timeout{ 0, FUTEX_TIMEOUT_NANOSECONDS };
+        syscall(SYS_futex, futexWord(value), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    }
+
+    void futexWakeAll(std::atomic<int>& value) {
+        syscall(SYS_futex, futexWord(value), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+#endif
+}
+
+bool ProcessExchange::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+ProcessExchange::ProcessExchange(int workers, size_t mailboxBytes)
+    : workers(workers), mailboxBytes(mailboxBytes), stride(0), mappingBytes(0),
+    mapping(nullptr), header(nullptr), self(-1) {
+#ifdef __linux__
+    stride = (sizeof(std::uint64_t) + mailboxBytes + MAILBOX_ALIGNMENT - 1) / MAILBOX_ALIGNMENT * MAILBOX_ALIGNMENT;
+    size_t headerBytes = (sizeof(Header) + MAILBOX_ALIGNMENT - 1) / MAILBOX_ALIGNMENT * MAILBOX_ALIGNMENT;
+    mappingBytes = headerBytes + 2 * mailboxCount() * stride;
+
+    void* memory = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << mappingBytes << " bytes of shared memory" << std::endl;
+        return;
+    }
+
+    mapping = static_cast<unsigned char*>(memory);
+    header = new (mapping) Header();
+    header->parties = workers + 1;
+#else
+    std::cerr << "Error: Multi-process simulation needs Linux" << std::endl;
+#endif
+}
+
+ProcessExchange::~ProcessExchange() {
+#ifdef __linux__
+    if (self == -1 && !workerPids.empty()) {
+        abort();
+        stopWorkers();
+    }
+    if (mapping) {
+        munmap(mapping, mappingBytes);
+    }
+#endif
+}
+
+unsigned char* ProcessExchange::mailbox(size_t index, long long tick) const {
+    size_t headerBytes = (sizeof(Header) + MAILBOX_ALIGNMENT - 1) / MAILBOX_ALIGNMENT * MAILBOX_ALIGNMENT;
+    size_t parity = static_cast<size_t>(tick & 1);
+    return mapping + headerBytes + (parity * mailboxCount() + index) * stride;
+}
+
+ProcessExchange::Writer ProcessExchange::writer(size_t index, long long tick) {
+    unsigned char* box = mailbox(index, tick);
+    Writer result(reinterpret_cast<std::uint64_t*>(box), box + sizeof(std::uint64_t), mailboxBytes);
+    result.clear();
+    return result;
+}
+
+ProcessExchange::Reader ProcessExchange::reader(size_t index, long long tick) const {
+    const unsigned char* box = mailbox(index, tick);
+    std::uint64_t used;
+    std::memcpy(&used, box, sizeof(used));
+    return Reader(box + sizeof(std::uint64_t), static_cast<size_t>(std::min<std::uint64_t>(used, mailboxBytes)));
+}
+
+bool ProcessExchange::startWorkers(const std::function<int(int)>& body) {
+#ifdef __linux__
+    if (!mapping || !workerPids.empty()) return false;
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    pid_t coordinator = getpid();
+    for (int worker = 0; worker < workers; worker++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "Error: Could not start worker process " << worker << std::endl;
+            abort();
+            stopWorkers();
+            return false;
+        }
+
+        if (pid == 0) {
+            // A worker never outlives its coordinator
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != coordinator) _exit(1);
+
+            self = worker;
+            workerPids.clear();
+            int status = body(worker);
+            _exit(status);
+        }
+        workerPids.push_back(pid);
+    }
+    return true;
+#else
+    (void)body;
+    return false;
+#endif
+}
+
+bool ProcessExchange::stopWorkers() {
+#ifdef __linux__
+    if (!header) return false;
+
+    header->stopping.store(1, std::memory_order_release);
+    if (!header->aborted.load(std::memory_order_acquire)) {
+        barrier();
+    }
+
+    bool ok = !header->aborted.load(std::memory_order_acquire);
+    for (pid_t pid : workerPids) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = false;
+        }
+    }
+    workerPids.clear();
+    return ok;
+#else
+    return false;
+#endif
+}
+
+bool ProcessExchange::isStopping() const {
+    return header && header->stopping.load(std::memory_order_acquire) != 0;
+}
+
+void ProcessExchange::abort() {
+#ifdef __linux__
+    if (!header) return;
+    header->aborted.store(1, std::memory_order_release);
+    header->generation.fetch_add(1, std::memory_order_acq_rel);
+    futexWakeAll(header->generation);
+#endif
+}
+
+// Coordinator only: a worker that exits before it was told to stop has
+// failed, and nobody would ever arrive at the barrier for it
+bool ProcessExchange::checkWorkers() {
+#ifdef __linux__
+    if (isStopping()) return true;
+
+    for (pid_t pid : workerPids) {
+        int status = 0;
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            std::cerr << "Error: Worker process " << pid << " exited during the run" << std::endl;
+            abort();
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool ProcessExchange::barrier() {
+#ifdef __linux__
+    if (!header || header->aborted.load(std::memory_order_acquire)) return false;
+
+    int generation = header->generation.load(std::memory_order_acquire);
+    if (header->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == header->parties) {
+        header->arrived.store(0, std::memory_order_relaxed);
+        header->generation.fetch_add(1, std::memory_order_acq_rel);
+        futexWakeAll(header->generation);
+    }
+    else {
+        while (header->generation.load(std::memory_order_acquire) == generation) {
+            futexWait(header->generation, generation);
+            if (self == -1 && !checkWorkers()) return false;
+        }
+    }
+    return !header->aborted.load(std::memory_order_acquire);
+#else
+    return false;
+#endif
+}
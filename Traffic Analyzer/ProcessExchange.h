@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <type_traits>
+
+// Shared-memory plumbing for a coordinator process and worker processes
+// forked from it, Linux only. One anonymous shared mapping holds a barrier
+// and a set of mailboxes. Every mailbox has one writer and is read only
+// after the next barrier; each kind exists twice, indexed by tick parity, so
+// a process can fill this tick's box while its peers still read the last.
+//
+// Mailboxes:
+//   spawn(worker)          coordinator -> worker, new vehicles
+//   migrants(from, to)     worker -> worker, vehicles crossing a region boundary
+//   report(worker)         worker -> coordinator, edge speeds and counters
+//   demand(worker)         worker -> all workers, signal detector counts
+class ProcessExchange {
+public:
+    // Append-only writer over one mailbox
+    class Writer {
+    private:
+        std::uint64_t* used;
+        unsigned char* data;
+        size_t capacity;
+
+    public:
+        Writer(std::uint64_t* used, unsigned char* data, size_t capacity)
+            : used(used), data(data), capacity(capacity) {
+        }
+
+        void clear() { *used = 0; }
+
+        bool append(const void* bytes, size_t size) {
+            if (*used + size > capacity) return false;
+            std::memcpy(data + *used, bytes, size);
+            *used += size;
+            return true;
+        }
+
+        template <typename T>
+        bool put(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "put() needs a trivially copyable type");
+            return append(&value, sizeof(T));
+        }
+
+        template <typename T>
+        bool putArray(const T* values, size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "putArray() needs a trivially copyable type");
+            return put(static_cast<std::uint64_t>(count)) && append(values, count * sizeof(T));
+        }
+    };
+
+    class Reader {
+    private:
+        const unsigned char* data;
+        size_t size;
+        size_t offset;
+
+    public:
+        Reader(const unsigned char* data, size_t size) : data(data), size(size), offset(0) {}
+
+        bool atEnd() const { return offset >= size; }
+
+        template <typename T>
+        bool get(T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "get() needs a trivially copyable type");
+            if (offset + sizeof(T) > size) return false;
+            std::memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        template <typename T>
+        bool getArray(std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T>, "getArray() needs a trivially copyable type");
+            std::uint64_t count = 0;
+            if (!get(count) || count > (size - offset) / sizeof(T)) return false;
+            values.resize(static_cast<size_t>(count));
+            if (count > 0) {
+                std::memcpy(values.data(), data + offset, static_cast<size_t>(count) * sizeof(T));
+                offset += static_cast<size_t>(count) * sizeof(T);
+            }
+            return true;
+        }
+    };
+
+private:
+    struct Header;
+
+    int workers;
+    size_t mailboxBytes;
+    size_t stride;                       // Mailbox size including its length word
+    size_t mappingBytes;
+    unsigned char* mapping;
+    Header* header;
+    std::vector<int> workerPids;
+    int self;                            // -1 in the coordinator, else the worker index
+
+public:
+    // Mappings are reserved lazily, so generous mailboxes only cost the pages used
+    ProcessExchange(int workers, size_t mailboxBytes);
+    ~ProcessExchange();
+
+    ProcessExchange(const ProcessExchange&) = delete;
+    ProcessExchange& operator=(const ProcessExchange&) = delete;
+
+    static bool isSupported();
+    bool isValid() const { return mapping != nullptr; }
+    int getWorkerCount() const { return workers; }
+    size_t getMailboxBytes() const { return mailboxBytes; }
+
+    // Coordinator: fork one process per worker running body(worker); the
+    // child exits with body's return value and never returns from here
+    bool startWorkers(const std::function<int(int)>& body);
+
+    // Coordinator: release the workers from their next barrier and reap them;
+    // returns false if any worker failed
+    bool stopWorkers();
+
+    // All processes; returns false once the run has been aborted
+    bool barrier();
+    void abort();
+    bool isStopping() const;
+
+    Writer spawnWriter(int worker, long long tick) { return writer(spawnIndex(worker), tick); }
+    Reader spawnReader(int worker, long long tick) const { return reader(spawnIndex(worker), tick); }
+    Writer migrantWriter(int from, int to, long long tick) { return writer(migrantIndex(from, to), tick); }
+    Reader migrantReader(int from, int to, long long tick) const { return reader(migrantIndex(from, to), tick); }
+    Writer reportWriter(int worker, long long tick) { return writer(reportIndex(worker), tick); }
+    Reader reportReader(int worker, long long tick) const { return reader(reportIndex(worker), tick); }
+    Writer demandWriter(int worker, long long tick) { return writer(demandIndex(worker), tick); }
+    Reader demandReader(int worker, long long tick) const { return reader(demandIndex(worker), tick); }
+
+private:
+    size_t spawnIndex(int worker) const { return static_cast<size_t>(worker); }
+    size_t migrantIndex(int from, int to) const { return static_cast<size_t>(workers + from * workers + to); }
+    size_t reportIndex(int worker) const { return static_cast<size_t>(workers + workers * workers + worker); }
+    size_t demandIndex(int worker) const { return static_cast<size_t>(2 * workers + workers * workers + worker); }
+    size_t mailboxCount() const { return static_cast<size_t>(3 * workers + workers * workers); }
+
+    unsigned char* mailbox(size_t index, long long tick) const;
+    Writer writer(size_t index, long long tick);
+    Reader reader(size_t index, long long tick) const;
+
+    bool checkWorkers();
+};
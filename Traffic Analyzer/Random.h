@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <random>
+
+// Counter-based random number generator. Output n is a SplitMix64 hash of
+// (key, n), so a stream is fully described by its key and position: there is
+// no hidden state to share between threads, and split() derives independent
+// child streams (per replica, per subsystem) from a single master seed.
+// Satisfies UniformRandomBitGenerator, so it works with <random> distributions.
+class CounterRng {
+public:
+    using result_type = std::uint64_t;
+
+private:
+    std::uint64_t key;
+    std::uint64_t counter;
+
+    static constexpr std::uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ull;
+
+public:
+    static std::uint64_t mix(std::uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    explicit CounterRng(std::uint64_t seed = 0) : key(mix(seed)), counter(0) {}
+
+    // Independent child stream, e.g. split(replicaIndex) then split(subsystemId)
+    CounterRng split(std::uint64_t streamId) const {
+        CounterRng child(0);
+        child.key = mix(key ^ mix(streamId + GOLDEN_GAMMA));
+        return child;
+    }
+
+    result_type operator()() {
+        return mix(key + (++counter) * GOLDEN_GAMMA);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    // Uniform integer in [0, n)
+    std::uint32_t nextInt(std::uint32_t n) {
+        return static_cast<std::uint32_t>(((*this)() >> 32) * n >> 32);
+    }
+
+    // Uniform float in [0, 1)
+    float nextFloat() {
+        return static_cast<float>((*this)() >> 40) * (1.0f / 16777216.0f);
+    }
+
+    // The whole generator state, for checkpoints
+    std::uint64_t getKey() const { return key; }
+    std::uint64_t getCounter() const { return counter; }
+    void setState(std::uint64_t newKey, std::uint64_t newCounter) { key = newKey; counter = newCounter; }
+
+    // Nondeterministic seed for interactive runs
+    static std::uint64_t randomSeed() {
+        std::random_device rd;
+        return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+    }
+};
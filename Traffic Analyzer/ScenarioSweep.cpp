@@ -0,0 +1,152 @@
+#include "ScenarioSweep.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+struct MetricField {
+    const char* name;
+    double (*get)(const HeadlessMetrics&);
+};
+
+const MetricField METRIC_FIELDS[] = {
+    { "completed_trips",      [](const HeadlessMetrics& m) { return static_cast<double>(m.completedTrips); } },
+    { "final_vehicles",       [](const HeadlessMetrics& m) { return static_cast<double>(m.finalVehicles); } },
+    { "peak_vehicles",        [](const HeadlessMetrics& m) { return static_cast<double>(m.peakVehicles); } },
+    { "average_vehicles",     [](const HeadlessMetrics& m) { return static_cast<double>(m.averageVehicles); } },
+    { "accidents_created",    [](const HeadlessMetrics& m) { return static_cast<double>(m.accidentsCreated); } },
+    { "average_congestion",   [](const HeadlessMetrics& m) { return static_cast<double>(m.averageCongestion); } },
+    { "peak_congestion",      [](const HeadlessMetrics& m) { return static_cast<double>(m.peakCongestion); } },
+    { "predicted_congestion", [](const HeadlessMetrics& m) { return static_cast<double>(m.predictedCongestion); } },
+    { "prediction_accuracy",  [](const HeadlessMetrics& m) { return static_cast<double>(m.predictionAccuracy); } },
+    { "incidents_raised",     [](const HeadlessMetrics& m) { return static_cast<double>(m.incidentsRaised); } },
+    { "accidents_detected",   [](const HeadlessMetrics& m) { return static_cast<double>(m.accidentsDetected); } },
+    { "speedup",              [](const HeadlessMetrics& m) { return m.getSpeedup(); } },
+};
+
+// Two-sided 95% Student t critical values for 1..30 degrees of freedom
+double tCritical95(int degreesOfFreedom) {
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degreesOfFreedom < 1) return 0.0;
+    if (degreesOfFreedom <= 30) return table[degreesOfFreedom - 1];
+    return 1.960;
+}
+
+}
+
+ScenarioSweep::ScenarioSweep(const Graph& map, const SweepOptions& options)
+    : baseMap(map), options(options) {
+}
+
+SweepResult ScenarioSweep::run() {
+    SweepResult result;
+    int replicaCount = std::max(options.replicas, 0);
+    result.replicas.resize(replicaCount);
+
+    int threadCount = options.threads > 0 ? options.threads
+        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    threadCount = std::max(1, std::min(threadCount, replicaCount));
+    result.threadsUsed = threadCount;
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    // Workers pull the next replica index until none are left, so a slow
+    // replica never leaves other cores idle
+    std::atomic<int> nextReplica(0);
+    auto worker = [&]() {
+        for (int i = nextReplica++; i < replicaCount; i = nextReplica++) {
+            result.replicas[i] = runReplica(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    result.wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    result.summaries = summarize(result.replicas);
+    return result;
+}
+
+HeadlessMetrics ScenarioSweep::runReplica(int replica) const {
+    Graph map = baseMap;  // Accidents and traffic levels mutate the graph
+
+    HeadlessOptions scenario = options.scenario;
+    scenario.stream = static_cast<std::uint64_t>(replica);
+
+    HeadlessSimulation simulation(map, scenario);
+    if (!options.checkpointFile.empty()) {
+        if (!simulation.loadCheckpoint(options.checkpointFile)) {
+            return HeadlessMetrics();
+        }
+        simulation.reseed();
+    }
+    return simulation.run();
+}
+
+std::vector<MetricSummary> ScenarioSweep::summarize(const std::vector<HeadlessMetrics>& replicas) {
+    std::vector<MetricSummary> summaries;
+    int n = static_cast<int>(replicas.size());
+    if (n == 0) return summaries;
+
+    for (const auto& field : METRIC_FIELDS) {
+        MetricSummary summary;
+        summary.name = field.name;
+
+        // Welford's online mean/variance
+        double mean = 0.0, m2 = 0.0;
+        for (int i = 0; i < n; i++) {
+            double x = field.get(replicas[i]);
+            double delta = x - mean;
+            mean += delta / (i + 1);
+            m2 += delta * (x - mean);
+        }
+
+        summary.mean = mean;
+        summary.stddev = n > 1 ? std::sqrt(m2 / (n - 1)) : 0.0;
+
+        double halfWidth = tCritical95(n - 1) * summary.stddev / std::sqrt(static_cast<double>(n));
+        summary.ciLow = mean - halfWidth;
+        summary.ciHigh = mean + halfWidth;
+
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+void ScenarioSweep::writeSummary(const SweepResult& result, std::ostream& out) {
+    out << "metric,mean,stddev,ci95_low,ci95_high,replicas\n";
+    for (const auto& summary : result.summaries) {
+        out << summary.name << "," << summary.mean << "," << summary.stddev << ","
+            << summary.ciLow << "," << summary.ciHigh << "," << result.replicas.size() << "\n";
+    }
+}
+
+void ScenarioSweep::writeReplicas(const SweepResult& result, std::ostream& out) {
+    out << "replica";
+    for (const auto& field : METRIC_FIELDS) {
+        out << "," << field.name;
+    }
+    out << "\n";
+
+    for (size_t i = 0; i < result.replicas.size(); i++) {
+        out << i;
+        for (const auto& field : METRIC_FIELDS) {
+            out << "," << field.get(result.replicas[i]);
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Graph.h"
+#include "HeadlessSimulation.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+struct SweepOptions {
+    int replicas = 32;
+    int threads = 0;                     // 0 = one per hardware thread
+    HeadlessOptions scenario;            // scenario.seed is the master seed
+    std::string checkpointFile;          // Optional common starting state for every replica
+};
+
+struct MetricSummary {
+    std::string name;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double ciLow = 0.0;                  // 95% confidence interval of the mean
+    double ciHigh = 0.0;
+};
+
+struct SweepResult {
+    std::vector<HeadlessMetrics> replicas;  // Indexed by replica, independent of thread scheduling
+    std::vector<MetricSummary> summaries;
+    double wallSeconds = 0.0;
+    int threadsUsed = 0;
+};
+
+// Monte Carlo sweep: runs independent HeadlessSimulation replicas of one
+// scenario on a pool of worker threads. Replica i uses RNG stream i of the
+// master seed and its own copy of the map, so results are reproducible no
+// matter how many threads run them or in which order they finish. With a
+// checkpoint, every replica forks from the same saved state and only its
+// random future differs.
+class ScenarioSweep {
+private:
+    const Graph& baseMap;
+    SweepOptions options;
+
+public:
+    ScenarioSweep(const Graph& map, const SweepOptions& options);
+
+    SweepResult run();
+
+    static std::vector<MetricSummary> summarize(const std::vector<HeadlessMetrics>& replicas);
+    static void writeSummary(const SweepResult& result, std::ostream& out);
+    static void writeReplicas(const SweepResult& result, std::ostream& out);
+
+private:
+    HeadlessMetrics runReplica(int replica) const;
+};
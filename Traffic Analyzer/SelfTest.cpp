@@ -0,0 +1,396 @@
+#include "SelfTest.h"
+#include "Graph.h"
+#include "MapGenerator.h"
+#include "HeadlessSimulation.h"
+#include "SpeedHistoryStore.h"
+#include "Checkpoint.h"
+#include "PredictionSystem.h"
+#include "SpeedFeed.h"
+#include "IncidentDetector.h"
+#include "Config.h"
+#include "Random.h"
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+namespace {
+
+std::string tempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::vector<char> readFile(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Empty when both files hold the same bytes
+std::string compareFiles(const std::string& expected, const std::string& actual) {
+    std::vector<char> a = readFile(expected);
+    std::vector<char> b = readFile(actual);
+    if (a.empty()) return expected + " is empty";
+    if (a == b) return "";
+
+    size_t common = std::min(a.size(), b.size());
+    size_t offset = std::mismatch(a.begin(), a.begin() + common, b.begin()).first - a.begin();
+    return std::to_string(a.size()) + " vs " + std::to_string(b.size()) + " bytes, first difference at byte " +
+        std::to_string(offset);
+}
+
+// Save, load into a fresh simulation and save again: the two files must be
+// identical. Both simulations then run on, and their next saves must match
+// too, so nothing the run depends on is left out of the checkpoint.
+SelfTestResult checkpointRoundTrip() {
+    SelfTestResult result;
+    result.name = "checkpoint_round_trip";
+
+    Graph baseMap;
+    MapGenerator::generateSimpleGrid(baseMap, 8);
+
+    HeadlessOptions options;
+    options.simulatedHours = 0.05;
+    options.accidentsPerHour = 20.0f;    // Keep accident timers in the state
+
+    std::string saved = tempPath("traffic_selftest_saved.tacp");
+    std::string resaved = tempPath("traffic_selftest_resaved.tacp");
+    std::string continued = tempPath("traffic_selftest_continued.tacp");
+    std::string resumed = tempPath("traffic_selftest_resumed.tacp");
+
+    Graph originalMap = baseMap;
+    HeadlessSimulation original(originalMap, options);
+    original.run();
+
+    Graph loadedMap = baseMap;
+    HeadlessSimulation loaded(loadedMap, options);
+
+    if (!original.saveCheckpoint(saved) || !loaded.loadCheckpoint(saved) || !loaded.saveCheckpoint(resaved)) {
+        result.detail = "could not write or read back " + saved;
+    }
+    else if (std::string difference = compareFiles(saved, resaved); !difference.empty()) {
+        result.detail = "save after load: " + difference;
+    }
+    else {
+        // A minute of ticks; run() would add wall time to the saved metrics
+        for (int i = 0; i < 3600; i++) {
+            original.step();
+            loaded.step();
+        }
+        if (!original.saveCheckpoint(continued) || !loaded.saveCheckpoint(resumed)) {
+            result.detail = "could not write " + continued;
+        }
+        else if (std::string difference = compareFiles(continued, resumed); !difference.empty()) {
+            result.detail = "after a minute from the loaded state: " + difference;
+        }
+        else {
+            result.passed = true;
+        }
+    }
+
+    std::error_code ignored;
+    for (const std::string& file : { saved, resaved, continued, resumed }) {
+        std::filesystem::remove(file, ignored);
+    }
+    return result;
+}
+
+// Sample of an edge in a round; the edge id picks the kind of series so
+// every encoder case is exercised
+float historySample(int edgeId, long long round) {
+    std::uint64_t held = CounterRng::mix(static_cast<std::uint64_t>(edgeId) * 1000003u +
+        static_cast<std::uint64_t>(round / 8));
+    std::uint64_t fresh = CounterRng::mix((static_cast<std::uint64_t>(edgeId) << 32) ^
+        static_cast<std::uint64_t>(round));
+    switch (edgeId % 4) {
+    case 0: return static_cast<float>(held % 13) * 5.0f;                    // Quantised speeds held for 8 rounds
+    case 1: return std::bit_cast<float>(static_cast<std::uint32_t>(fresh)); // Any bit pattern, NaNs included
+    case 2: return 40.0f + static_cast<float>(round % 97) * 0.173f;         // Low mantissa bits moving
+    default: return (fresh & 15) == 0 ? -0.0f : (fresh & 15) == 1 ? 1e-42f : 0.0f; // Signed zero, denormals
+    }
+}
+
+// Every row decodes to its generated samples bit for bit, both whole and
+// from a window starting mid-block; empty when it does
+std::string compareHistory(const SpeedHistoryStore& store, const std::vector<int>& edgeIds,
+    long long retentionRounds, long long remapRound) {
+    long long rounds = store.getRoundCount();
+    std::vector<float> decoded;
+
+    for (size_t row = 0; row < edgeIds.size(); row++) {
+        long long first = store.getFirstRound(row);
+        long long expectedFirst = std::max<long long>(0, rounds - retentionRounds);
+        bool retained = first <= expectedFirst && first >= expectedFirst - SpeedHistoryStore::BLOCK_ROUNDS;
+        if (!retained || (first < remapRound && edgeIds[row] >= 1000)) {
+            return "edge " + std::to_string(edgeIds[row]) + " keeps rounds from " + std::to_string(first);
+        }
+
+        for (long long windowStart : { first, std::max(first, rounds - 700) }) {
+            decoded.clear();
+            int count = store.decode(row, windowStart, rounds, decoded);
+            if (count != rounds - windowStart) {
+                return "edge " + std::to_string(edgeIds[row]) + " decoded " + std::to_string(count) + " of " +
+                    std::to_string(rounds - windowStart) + " samples";
+            }
+            for (int i = 0; i < count; i++) {
+                float expected = historySample(edgeIds[row], windowStart + i);
+                if (std::bit_cast<std::uint32_t>(decoded[i]) != std::bit_cast<std::uint32_t>(expected)) {
+                    return "edge " + std::to_string(edgeIds[row]) + " round " + std::to_string(windowStart + i) +
+                        " decodes to a different value";
+                }
+            }
+        }
+    }
+    return "";
+}
+
+// Encode a few retention periods of samples, with a remap part way through
+// that drops, adds and reorders edges. Every row must decode exactly, and so
+// must a store loaded from the saved state, including after both append
+// more rounds from their restored encoder state.
+SelfTestResult speedHistoryRoundTrip() {
+    SelfTestResult result;
+    result.name = "speed_history_round_trip";
+
+    const long long retention = SpeedHistoryStore::BLOCK_ROUNDS * 2;
+    const long long remapRound = 1000;
+    std::vector<int> edgeIds;
+    for (int id = 0; id < 48; id++) edgeIds.push_back(id);
+
+    SpeedHistoryStore store(retention);
+    store.remap(edgeIds);
+    std::vector<float> speeds;
+
+    auto appendRounds = [&](SpeedHistoryStore& target, long long count) {
+        for (long long i = 0; i < count; i++) {
+            long long round = target.getRoundCount();
+            speeds.resize(edgeIds.size());
+            for (size_t row = 0; row < edgeIds.size(); row++) {
+                speeds[row] = historySample(edgeIds[row], round);
+            }
+            target.appendRound(speeds.data());
+        }
+    };
+
+    appendRounds(store, remapRound);
+
+    // Even ids survive in reverse order, odd ones are replaced by new edges
+    std::vector<int> remapped;
+    for (int id = 46; id >= 0; id -= 2) remapped.push_back(id);
+    for (int id = 1000; id < 1024; id++) remapped.push_back(id);
+    edgeIds = remapped;
+    store.remap(edgeIds);
+
+    appendRounds(store, retention * 2 + 123);
+    if (std::string difference = compareHistory(store, edgeIds, retention, remapRound); !difference.empty()) {
+        result.detail = "after encoding: " + difference;
+        return result;
+    }
+
+    std::string file = tempPath("traffic_selftest_history.bin");
+    {
+        BinaryWriter writer(file);
+        store.saveState(writer);
+    }
+
+    SpeedHistoryStore loaded(retention);
+    std::vector<int> loadedIds(edgeIds.rbegin(), edgeIds.rend());
+    loaded.remap(loadedIds);
+    BinaryReader reader(file);
+    bool read = reader.isOpen() && loaded.loadState(reader);
+    std::error_code ignored;
+    std::filesystem::remove(file, ignored);
+    if (!read) {
+        result.detail = "could not load the saved state";
+        return result;
+    }
+
+    appendRounds(store, 500);
+    edgeIds = loadedIds;
+    appendRounds(loaded, 500);
+    if (std::string difference = compareHistory(loaded, edgeIds, retention, remapRound); !difference.empty()) {
+        result.detail = "after loading: " + difference;
+        return result;
+    }
+    if (store.getCompressedBytes() != loaded.getCompressedBytes()) {
+        result.detail = "loaded store compresses to " + std::to_string(loaded.getCompressedBytes()) +
+            " bytes instead of " + std::to_string(store.getCompressedBytes());
+        return result;
+    }
+
+    result.passed = true;
+    return result;
+}
+
+// A feed with comments, blank lines, CRLF endings, bad readings, an edge off
+// the map and no final newline, followed by enough lines to cross the read
+// buffer and the batch several times. Every count must come out exact, and a
+// pump must stop at the first line later than its time.
+SelfTestResult speedFeedParsing() {
+    SelfTestResult result;
+    result.name = "speed_feed_parsing";
+
+    Graph map;
+    MapGenerator::generateSimpleGrid(map, 8);
+    std::vector<int> edgeIds;
+    for (const auto& [id, edge] : map.getAllEdges()) edgeIds.push_back(id);
+    std::sort(edgeIds.begin(), edgeIds.end());
+    int unknownId = edgeIds.back() + 1;
+
+    const int bulkLines = 30000;
+    std::string file = tempPath("traffic_selftest_feed.txt");
+    {
+        std::ofstream out(file, std::ios::binary);
+        out << "# time,edgeId,speed\n"
+            << "0," << edgeIds[0] << ",50\n"
+            << "\n"
+            << "1.5," << edgeIds[1] << ",30.5\r\n"
+            << "2," << edgeIds[0] << ",fast\n"            // Malformed
+            << "2," << edgeIds[0] << ",-5\n"              // Malformed: negative speed
+            << "2," << edgeIds[0] << ",50,1\n"            // Malformed: extra field
+            << "3," << unknownId << ",40\n"               // Not on the map
+            << "10," << edgeIds[1] << ",20\n";
+        for (int i = 0; i < bulkLines; i++) {
+            out << 20 + i * 0.01 << "," << edgeIds[i % edgeIds.size()] << "," << i % 120 << "\n";
+        }
+        out << "1000," << edgeIds[2] << ",25";
+    }
+
+    PredictionSystem predictions(&map);
+    SpeedFeed feed;
+    auto counts = [&]() {
+        return std::to_string(feed.getObservationCount()) + " observations, " +
+            std::to_string(feed.getUnknownCount()) + " unknown, " +
+            std::to_string(feed.getMalformedCount()) + " malformed";
+    };
+
+    if (!feed.open(file)) {
+        result.detail = "could not open " + file;
+    }
+    else if (size_t read = feed.pump(5.0, predictions); read != 3 || feed.getObservationCount() != 2 ||
+        feed.getUnknownCount() != 1 || feed.getMalformedCount() != 3) {
+        result.detail = "first pump read " + std::to_string(read) + ": " + counts();
+    }
+    else if (size_t read = feed.pump(999.0, predictions); read != bulkLines + 1 || feed.isFinished() ||
+        feed.getObservationCount() != bulkLines + 3) {
+        result.detail = "second pump read " + std::to_string(read) + ": " + counts();
+    }
+    else if (size_t read = feed.pump(1000.0, predictions); read != 1 || !feed.isFinished() ||
+        feed.getObservationCount() != bulkLines + 4 || feed.getMalformedCount() != 3) {
+        result.detail = "last pump read " + std::to_string(read) + ": " + counts();
+    }
+    else {
+        result.passed = true;
+    }
+
+    feed.close();
+    std::error_code ignored;
+    std::filesystem::remove(file, ignored);
+    return result;
+}
+
+// Three edges with noisy steady shares. From dropRound edge 1 slows down on
+// its own and must alarm within a few rounds, while edge 2 slows down with
+// its neighbours, below its profile, and must not. Edge 0 never changes. A
+// second detector takes over the states half way and must raise the same
+// alarms from then on.
+SelfTestResult incidentDetection() {
+    SelfTestResult result;
+    result.name = "incident_detection";
+
+    const int rounds = 300;
+    const int dropRound = 200;
+    const int copyRound = 150;
+    const size_t rowCount = 3;
+
+    IncidentDetector detector;
+    IncidentDetector restored;
+    detector.resize(rowCount);
+    restored.resize(rowCount);
+
+    float shares[rowCount];
+    float neighborShares[rowCount];
+    float profileShares[rowCount];
+    std::vector<int> alarms;
+    std::vector<int> restoredAlarms;
+    int firstAlarm = -1;
+
+    for (int round = 0; round < rounds; round++) {
+        bool dropped = round >= dropRound;
+        for (size_t row = 0; row < rowCount; row++) {
+            std::uint64_t noise = CounterRng::mix((static_cast<std::uint64_t>(row) << 32) ^
+                static_cast<std::uint64_t>(round));
+            float jitter = static_cast<float>(noise % 101) * 0.001f - 0.05f;
+            neighborShares[row] = 0.9f;
+            profileShares[row] = -1.0f;
+            shares[row] = 0.9f + jitter;
+        }
+        if (dropped) shares[1] = 0.2f;
+        profileShares[2] = 0.9f;
+        if (dropped) {
+            shares[2] -= 0.7f;
+            neighborShares[2] -= 0.7f;
+        }
+
+        if (round == copyRound) {
+            for (size_t row = 0; row < rowCount; row++) {
+                restored.setState(row, detector.getState(row));
+            }
+        }
+
+        alarms.clear();
+        detector.update(shares, neighborShares, profileShares, alarms);
+        for (int row : alarms) {
+            if (row != 1 || !dropped) {
+                result.detail = "edge " + std::to_string(row) + " alarmed in round " + std::to_string(round);
+                return result;
+            }
+            if (firstAlarm == -1) firstAlarm = round;
+        }
+
+        if (round >= copyRound) {
+            restoredAlarms.clear();
+            restored.update(shares, neighborShares, profileShares, restoredAlarms);
+            if (restoredAlarms != alarms || restored.getStatistic(1) != detector.getStatistic(1)) {
+                result.detail = "restored detector differs in round " + std::to_string(round);
+                return result;
+            }
+        }
+    }
+
+    // Each round of the drop adds about (0.7 / 0.25 - slack) to the statistic
+    int expectedRounds = static_cast<int>(PredictionConfig::INCIDENT_THRESHOLD /
+        (0.7f / PredictionConfig::INCIDENT_MIN_DEVIATION - PredictionConfig::INCIDENT_SLACK)) + 2;
+    if (firstAlarm == -1 || firstAlarm > dropRound + expectedRounds) {
+        result.detail = "edge 1 first alarmed in round " + std::to_string(firstAlarm) + ", expected by " +
+            std::to_string(dropRound + expectedRounds);
+        return result;
+    }
+
+    result.passed = true;
+    return result;
+}
+
+}
+
+std::vector<SelfTestResult> SelfTest::runAll() {
+    std::vector<SelfTestResult> results;
+    results.push_back(checkpointRoundTrip());
+    results.push_back(speedHistoryRoundTrip());
+    results.push_back(speedFeedParsing());
+    results.push_back(incidentDetection());
+    return results;
+}
+
+bool SelfTest::allPassed(const std::vector<SelfTestResult>& results) {
+    return std::all_of(results.begin(), results.end(),
+        [](const SelfTestResult& result) { return result.passed; });
+}
+
+void SelfTest::writeResults(const std::vector<SelfTestResult>& results, std::ostream& out) {
+    out << "check,result,detail\n";
+    for (const auto& result : results) {
+        out << result.name << "," << (result.passed ? "pass" : "FAIL") << "," << result.detail << "\n";
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+
+struct SelfTestResult {
+    std::string name;
+    bool passed = false;
+    std::string detail;                  // What differed; empty when passed
+};
+
+// Round-trip checks of the saved and streamed formats, run by the headless
+// runner's --self-test. Every check builds its own map and data, so none
+// needs an input file. Temporary files go to the system temp directory and
+// are removed afterwards.
+class SelfTest {
+public:
+    static std::vector<SelfTestResult> runAll();
+    static bool allPassed(const std::vector<SelfTestResult>& results);
+
+    // name,result,detail CSV, one check per line
+    static void writeResults(const std::vector<SelfTestResult>& results, std::ostream& out);
+};
@@ -0,0 +1,188 @@
+#include "SignalSystem.h"
+#include "Checkpoint.h"
+#include "Config.h"
+#include <algorithm>
+#include <cmath>
+
+SignalSystem::SignalSystem(const Graph& map, SignalPlan plan)
+    : cityMap(map) {
+    build(plan);
+}
+
+void SignalSystem::build(SignalPlan plan) {
+    std::vector<int> sortedNodes;
+    for (const auto& pair : cityMap.getAllNodes()) {
+        sortedNodes.push_back(pair.first);
+    }
+    std::sort(sortedNodes.begin(), sortedNodes.end());
+
+    approaches.assign(static_cast<size_t>(cityMap.getEdgeCount()) * 2, -1);
+
+    for (int nodeId : sortedNodes) {
+        std::vector<int> edgeIds = cityMap.getEdgesFromNode(nodeId);
+        if (static_cast<int>(edgeIds.size()) < SignalConfig::MIN_APPROACHES) continue;
+
+        Node node = cityMap.getNode(nodeId);
+        std::vector<std::pair<int, int>> groupedEnds;  // (edge end, group)
+        float weightA = 0.0f, weightB = 0.0f;
+
+        for (int edgeId : edgeIds) {
+            const Edge& edge = cityMap.getEdgeAt(cityMap.getEdgeSlot(edgeId));
+            if (edge.fromNodeId == edge.toNodeId) continue;
+
+            bool arrivesAtTo = edge.toNodeId == nodeId;
+            Node other = cityMap.getNode(arrivesAtTo ? edge.fromNodeId : edge.toNodeId);
+            int group = std::abs(other.x - node.x) >= std::abs(other.y - node.y) ? 0 : 1;
+
+            groupedEnds.push_back({ cityMap.getEdgeSlot(edgeId) * 2 + (arrivesAtTo ? 0 : 1), group });
+            (group == 0 ? weightA : weightB) += static_cast<float>(edge.speedLimit);
+        }
+
+        // Every road on one axis: nothing conflicts, no signal needed
+        if (weightA == 0.0f || weightB == 0.0f) continue;
+
+        int signal = static_cast<int>(nodeIds.size());
+        for (const auto& end : groupedEnds) {
+            approaches[end.first] = signal * 2 + end.second;
+        }
+
+        // Faster roads get the longer share of the cycle
+        float totalGreen = 2.0f * SignalConfig::FIXED_GREEN_SECONDS;
+        float splitA = std::clamp(totalGreen * weightA / (weightA + weightB),
+            SignalConfig::MIN_GREEN_SECONDS, SignalConfig::MAX_GREEN_SECONDS);
+        float splitB = std::clamp(totalGreen - splitA,
+            SignalConfig::MIN_GREEN_SECONDS, SignalConfig::MAX_GREEN_SECONDS);
+
+        signalByNode[nodeId] = signal;
+        nodeIds.push_back(nodeId);
+        plans.push_back(static_cast<std::uint8_t>(plan));
+        phases.push_back(static_cast<std::uint8_t>(Phase::GREEN_A));
+        greenA.push_back(splitA);
+        greenB.push_back(splitB);
+        // Stagger the start so neighbouring signals do not all switch together
+        elapsed.push_back((nodeId % 4) * splitA / 4.0f);
+        demandA.push_back(0);
+        demandB.push_back(0);
+    }
+}
+
+void SignalSystem::setPlan(SignalPlan plan) {
+    std::fill(plans.begin(), plans.end(), static_cast<std::uint8_t>(plan));
+}
+
+void SignalSystem::update(float deltaTime) {
+    size_t count = nodeIds.size();
+
+    for (size_t i = 0; i < count; i++) {
+        elapsed[i] += deltaTime;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        std::uint8_t phase = phases[i];
+        bool green = (phase & 1) == 0;
+        bool groupB = phase >= static_cast<std::uint8_t>(Phase::GREEN_B);
+        int own = groupB ? demandB[i] : demandA[i];
+        int other = groupB ? demandA[i] : demandB[i];
+
+        float fixedLength = green ? (groupB ? greenB[i] : greenA[i]) : SignalConfig::AMBER_SECONDS;
+        bool fixedChange = elapsed[i] >= fixedLength;
+
+        // Actuated greens end when the approach empties (gap-out) or after the
+        // max green, but only if someone is waiting on red; otherwise they rest
+        bool actuatedChange = elapsed[i] >= SignalConfig::MIN_GREEN_SECONDS && other > 0 &&
+            (own == 0 || elapsed[i] >= SignalConfig::MAX_GREEN_SECONDS);
+
+        bool actuatedGreen = green && plans[i] == static_cast<std::uint8_t>(SignalPlan::ACTUATED);
+        bool change = actuatedGreen ? actuatedChange : fixedChange;
+
+        phases[i] = change ? static_cast<std::uint8_t>((phase + 1) & 3) : phase;
+        elapsed[i] = change ? 0.0f : elapsed[i];
+    }
+
+    std::fill(demandA.begin(), demandA.end(), 0);
+    std::fill(demandB.begin(), demandB.end(), 0);
+}
+
+// Mirrors the switching rules of update()
+float SignalSystem::getSecondsToNextChange() const {
+    float seconds = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < nodeIds.size(); i++) {
+        std::uint8_t phase = phases[i];
+        bool green = (phase & 1) == 0;
+        bool groupB = phase >= static_cast<std::uint8_t>(Phase::GREEN_B);
+
+        float length = green ? (groupB ? greenB[i] : greenA[i]) : SignalConfig::AMBER_SECONDS;
+        if (green && plans[i] == static_cast<std::uint8_t>(SignalPlan::ACTUATED)) {
+            int own = groupB ? demandB[i] : demandA[i];
+            int other = groupB ? demandA[i] : demandB[i];
+            if (other == 0) continue;
+            length = own == 0 ? SignalConfig::MIN_GREEN_SECONDS : SignalConfig::MAX_GREEN_SECONDS;
+        }
+        seconds = std::min(seconds, length - elapsed[i]);
+    }
+    return seconds;
+}
+
+void SignalSystem::getDemandCounts(std::vector<int>& counts) const {
+    counts.assign(demandA.begin(), demandA.end());
+    counts.insert(counts.end(), demandB.begin(), demandB.end());
+}
+
+void SignalSystem::setDemandCounts(const std::vector<int>& counts) {
+    if (counts.size() != demandA.size() + demandB.size()) return;
+
+    std::copy(counts.begin(), counts.begin() + demandA.size(), demandA.begin());
+    std::copy(counts.begin() + demandA.size(), counts.end(), demandB.begin());
+}
+
+// Uniform delay of a pre-timed signal, red^2 / (2 * cycle), averaged over both groups
+float SignalSystem::getExpectedDelay(int nodeId) const {
+    auto it = signalByNode.find(nodeId);
+    if (it == signalByNode.end()) return 0.0f;
+
+    int signal = it->second;
+    float cycle = greenA[signal] + greenB[signal] + 2.0f * SignalConfig::AMBER_SECONDS;
+    float redA = cycle - greenA[signal];
+    float redB = cycle - greenB[signal];
+    return (redA * redA + redB * redB) / (4.0f * cycle);
+}
+
+void SignalSystem::saveState(BinaryWriter& writer) const {
+    writer.writeTag("SIGN");
+    writer.writeArray(plans);
+    writer.writeArray(phases);
+    writer.writeArray(elapsed);
+    writer.writeArray(demandA);
+    writer.writeArray(demandB);
+}
+
+bool SignalSystem::loadState(BinaryReader& reader) {
+    std::vector<std::uint8_t> savedPlans, savedPhases;
+    std::vector<float> savedElapsed;
+    std::vector<int> savedDemandA, savedDemandB;
+
+    if (!reader.expectTag("SIGN") || !reader.readArray(savedPlans) || !reader.readArray(savedPhases) ||
+        !reader.readArray(savedElapsed) || !reader.readArray(savedDemandA) || !reader.readArray(savedDemandB)) {
+        return false;
+    }
+
+    size_t count = nodeIds.size();
+    bool consistent = savedPlans.size() == count && savedPhases.size() == count &&
+        savedElapsed.size() == count && savedDemandA.size() == count && savedDemandB.size() == count;
+    for (size_t i = 0; consistent && i < count; i++) {
+        consistent = savedPhases[i] <= static_cast<std::uint8_t>(Phase::AMBER_B) &&
+            savedPlans[i] <= static_cast<std::uint8_t>(SignalPlan::ACTUATED);
+    }
+    if (!consistent) {
+        std::cerr << "Error: Signal section does not match this map" << std::endl;
+        reader.fail();
+        return false;
+    }
+
+    plans = std::move(savedPlans);
+    phases = std::move(savedPhases);
+    elapsed = std::move(savedElapsed);
+    demandA = std::move(savedDemandA);
+    demandB = std::move(savedDemandB);
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+class BinaryWriter;
+class BinaryReader;
+
+enum class SignalPlan : std::uint8_t {
+    FIXED_TIME = 0,     // Greens of fixed length, split by approach speed limits
+    ACTUATED = 1        // Green extends while cars arrive, rests if nobody waits on red
+};
+
+// Two-phase traffic signals at every node where MIN_APPROACHES or more roads
+// meet. Approaches are grouped by axis: group A gets the roads that arrive
+// closer to horizontal, group B the rest. Signals are stored as parallel
+// arrays so update() is one branch-light sweep over all of them.
+//
+// Approaches are addressed by edge end: slot * 2 for traffic arriving at the
+// edge's toNode, slot * 2 + 1 for traffic arriving at its fromNode, where
+// slot is the graph's dense edge slot.
+class SignalSystem {
+public:
+    enum class Phase : std::uint8_t {
+        GREEN_A = 0,
+        AMBER_A = 1,
+        GREEN_B = 2,
+        AMBER_B = 3
+    };
+
+private:
+    const Graph& cityMap;
+
+    // One entry per signalized node
+    std::vector<int> nodeIds;
+    std::vector<std::uint8_t> plans;
+    std::vector<std::uint8_t> phases;
+    std::vector<float> elapsed;          // Seconds in the current phase
+    std::vector<float> greenA;           // Fixed green, or max green when actuated
+    std::vector<float> greenB;
+    std::vector<int> demandA;            // Cars seen on each group since the last update
+    std::vector<int> demandB;
+    std::unordered_map<int, int> signalByNode;
+
+    std::vector<int> approaches;         // Edge end -> signal * 2 + group, -1 without a signal
+
+public:
+    SignalSystem(const Graph& map, SignalPlan plan = SignalPlan::FIXED_TIME);
+
+    // Advance every signal by one tick and consume the detector counts
+    void update(float deltaTime);
+
+    void setPlan(SignalPlan plan);
+
+    // Approach of the end of an edge, -1 when that node has no signal
+    int getApproach(int edgeEnd) const {
+        return edgeEnd >= 0 && edgeEnd < static_cast<int>(approaches.size()) ? approaches[edgeEnd] : -1;
+    }
+    bool isGreen(int approach) const {
+        std::uint8_t phase = phases[approach >> 1];
+        return phase == ((approach & 1) ? static_cast<std::uint8_t>(Phase::GREEN_B) : static_cast<std::uint8_t>(Phase::GREEN_A));
+    }
+
+    // Detector input: a car is on the approach this tick
+    void reportDemand(int approach) {
+        (approach & 1 ? demandB : demandA)[approach >> 1]++;
+    }
+
+    // Seconds until the next phase change of any signal, assuming the
+    // detector counts of this tick repeat; infinity if every signal rests
+    float getSecondsToNextChange() const;
+
+    // Detector counts of every group, A groups then B groups, so that
+    // simulations sharing the signals can pool them before update()
+    void getDemandCounts(std::vector<int>& counts) const;
+    void setDemandCounts(const std::vector<int>& counts);
+
+    // Average wait of a car arriving at random, for route costs (seconds)
+    float getExpectedDelay(int nodeId) const;
+
+    // Renderer access
+    int getSignalCount() const { return static_cast<int>(nodeIds.size()); }
+    int getSignalNode(int signal) const { return nodeIds[signal]; }
+    Phase getPhase(int signal) const { return static_cast<Phase>(phases[signal]); }
+    bool hasSignal(int nodeId) const { return signalByNode.count(nodeId) > 0; }
+
+    // Checkpointing of phases, timers and pending detector counts
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+
+private:
+    void build(SignalPlan plan);
+};
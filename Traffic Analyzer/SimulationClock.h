@@ -0,0 +1,58 @@
+#pragma once
+#include "Config.h"
+#include <algorithm>
+
+// Fixed-timestep simulation clock. Frame time goes into an accumulator that is
+// drained in whole ticks, so simulation results do not depend on the frame rate.
+// The leftover fraction of a tick is the render interpolation factor.
+class SimulationClock {
+private:
+    float tickDuration;
+    int maxCatchUpTicks;
+    float accumulator;
+    long long tickCount;
+    float droppedTime;
+
+public:
+    SimulationClock(float tickRate = SimConfig::TICK_RATE_HZ,
+        int maxCatchUp = SimConfig::MAX_CATCH_UP_TICKS)
+        : tickDuration(1.0f / tickRate), maxCatchUpTicks(maxCatchUp),
+        accumulator(0.0f), tickCount(0), droppedTime(0.0f) {
+    }
+
+    // Add elapsed wall time and return how many ticks to run this frame.
+    // Anything beyond maxCatchUpTicks is dropped so a stall cannot snowball.
+    int advance(float frameTime) {
+        accumulator += std::max(frameTime, 0.0f);
+
+        int ticks = static_cast<int>(accumulator / tickDuration);
+        accumulator -= ticks * tickDuration;
+
+        if (ticks > maxCatchUpTicks) {
+            droppedTime += (ticks - maxCatchUpTicks) * tickDuration;
+            ticks = maxCatchUpTicks;
+        }
+
+        tickCount += ticks;
+        return ticks;
+    }
+
+    // Count ticks without wall-clock pacing (headless, faster than real time)
+    void tick(long long ticks = 1) { tickCount += ticks; }
+
+    void setTickRate(float tickRate) { tickDuration = 1.0f / tickRate; }
+    void setMaxCatchUpTicks(int ticks) { maxCatchUpTicks = ticks; }
+    void reset() { accumulator = 0.0f; tickCount = 0; droppedTime = 0.0f; }
+
+    // Resume from a checkpoint
+    void restore(long long ticks, float leftover) { tickCount = ticks; accumulator = leftover; droppedTime = 0.0f; }
+    float getAccumulator() const { return accumulator; }
+
+    float getTickDuration() const { return tickDuration; }
+    long long getTickCount() const { return tickCount; }
+    double getSimulationTime() const { return static_cast<double>(tickCount) * tickDuration; }
+    float getDroppedTime() const { return droppedTime; }
+
+    // 0..1 position between the previous and the current tick
+    float getInterpolationAlpha() const { return accumulator / tickDuration; }
+};
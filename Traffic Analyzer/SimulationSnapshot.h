@@ -0,0 +1,60 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+// Everything the renderer needs from one simulation tick. Built by the
+// simulation thread and handed to GUI::render through a TripleBuffer, so the
+// render thread never touches Graph or the simulation systems directly.
+struct SimulationSnapshot {
+    struct NodeState {
+        int id;
+        float x, y;
+    };
+
+    struct EdgeState {
+        int id;
+        float fromX, fromY;
+        float toX, toY;
+        TrafficLevel trafficLevel;
+        bool isBlocked;
+        bool hasAccident;
+        bool accidentBlinkOn;
+    };
+
+    enum class Light : std::uint8_t { RED, AMBER, GREEN };
+
+    struct SignalState {
+        float x, y;
+        Light groupA;         // Roads arriving closer to horizontal
+        Light groupB;
+    };
+
+    struct CarState {
+        float x, y;           // Position at this tick
+        float prevX, prevY;   // Position at the previous tick
+        float angle;          // Degrees
+        std::uint32_t color;  // RGBA, 0xRRGGBBAA like CarSimulation::Car::color
+    };
+
+    std::vector<NodeState> nodes;
+    std::vector<EdgeState> edges;
+    std::vector<CarState> cars;
+    std::vector<SignalState> signals;
+    std::vector<int> accidentEdges;
+    std::vector<int> incidentEdges;        // Raised by the incident detector
+    std::vector<int> predictedCongestion;  // Indices into edges
+    std::vector<NodeState> path;           // Current route, in order
+
+    // Statistics
+    int carCount = 0;
+    int congestedRoads = 0;
+    int predictedCongestionCount = 0;
+    float predictionAccuracy = 0.0f;
+    float routeTravelTime = -1.0f;         // < 0 when no route is selected
+
+    long long tick = 0;
+    float tickDuration = 0.0f;
+    std::chrono::steady_clock::time_point publishedAt;
+};
@@ -0,0 +1,142 @@
+#include "SpatialSpeedModel.h"
+#include "Graph.h"
+#include "Config.h"
+#include <algorithm>
+
+namespace {
+    int stepsIn(float minutes, float roundSeconds) {
+        return static_cast<int>(minutes * 60.0f / (PredictionConfig::SPATIAL_STEP_ROUNDS * roundSeconds));
+    }
+}
+
+SpatialSpeedModel::SpatialSpeedModel(float roundSeconds)
+    : SpatialSpeedModel(PredictionConfig::SPATIAL_FORGETTING, PredictionConfig::SPATIAL_INITIAL_VARIANCE,
+        stepsIn(5.0f, roundSeconds), stepsIn(10.0f, roundSeconds)) {
+}
+
+SpatialSpeedModel::SpatialSpeedModel(float forgetting, float initialVariance, int nearSteps, int farSteps)
+    : forgetting(forgetting), initialVariance(initialVariance), nearSteps(nearSteps), farSteps(farSteps),
+    shareHistory(farSteps) {
+}
+
+SpatialSpeedModel::State SpatialSpeedModel::initialState() const {
+    State state;
+    for (Fit* fit : { &state.near, &state.far }) {
+        fit->covariance[0] = fit->covariance[3] = fit->covariance[5] = initialVariance;
+    }
+    return state;
+}
+
+void SpatialSpeedModel::build(const Graph& graph) {
+    int edgeCount = graph.getEdgeCount();
+    neighborOffsets.assign(1, 0);
+    neighborSlots.clear();
+
+    for (int slot = 0; slot < edgeCount; slot++) {
+        const Edge& edge = graph.getEdgeAt(slot);
+        for (int nodeId : { edge.fromNodeId, edge.toNodeId }) {
+            // Node adjacency lists hold the roads ending there as well
+            for (int nextId : graph.getEdgesFromNode(nodeId)) {
+                int nextSlot = graph.getEdgeSlot(nextId);
+                if (nextSlot == -1) continue;
+
+                const Edge& next = graph.getEdgeAt(nextSlot);
+                bool sameRoad = (next.fromNodeId == edge.fromNodeId && next.toNodeId == edge.toNodeId) ||
+                    (next.fromNodeId == edge.toNodeId && next.toNodeId == edge.fromNodeId);
+                if (!sameRoad) {
+                    neighborSlots.push_back(nextSlot);
+                }
+            }
+        }
+        neighborOffsets.push_back(static_cast<int>(neighborSlots.size()));
+    }
+
+    states.assign(static_cast<size_t>(edgeCount), initialState());
+    shareHistory.resize(static_cast<size_t>(edgeCount));
+    laggedShares.resize(static_cast<size_t>(edgeCount));
+    neighborMeans.resize(static_cast<size_t>(edgeCount));
+}
+
+// Row-normalised SpMV; an edge without neighbours sees its own share
+void SpatialSpeedModel::computeNeighborMeans(const float* shares) {
+    size_t rows = states.size();
+    for (size_t row = 0; row < rows; row++) {
+        int first = neighborOffsets[row];
+        int last = neighborOffsets[row + 1];
+        if (first == last) {
+            neighborMeans[row] = shares[row];
+            continue;
+        }
+
+        float sum = 0.0f;
+        for (int i = first; i < last; i++) {
+            sum += shares[neighborSlots[i]];
+        }
+        neighborMeans[row] = sum / (last - first);
+    }
+}
+
+void SpatialSpeedModel::fitLag(int steps, Fit State::* member, const float* shares) {
+    size_t rows = states.size();
+
+    // Edges seen for fewer steps are not fitted; their neighbours see them
+    // as they are now
+    for (size_t row = 0; row < rows; row++) {
+        int size = shareHistory.size(row);
+        laggedShares[row] = size >= steps ? shareHistory.at(row, size - steps) : shares[row];
+    }
+    computeNeighborMeans(laggedShares.data());
+
+    for (size_t row = 0; row < rows; row++) {
+        if (shareHistory.size(row) < steps) continue;
+
+        Fit& fit = states[row].*member;
+        float f0 = laggedShares[row], f1 = neighborMeans[row], f2 = 1.0f;
+        float* p = fit.covariance;
+        float* w = fit.weights;
+
+        // P * features
+        float a0 = p[0] * f0 + p[1] * f1 + p[2] * f2;
+        float a1 = p[1] * f0 + p[3] * f1 + p[4] * f2;
+        float a2 = p[2] * f0 + p[4] * f1 + p[5] * f2;
+
+        // Old steps are only forgotten while the covariance stays below
+        // where it started, so a quiet road cannot wind it up
+        float lambda = p[0] + p[3] + p[5] < 3.0f * initialVariance ? forgetting : 1.0f;
+        float inverse = 1.0f / (lambda + f0 * a0 + f1 * a1 + f2 * a2);
+        float k0 = a0 * inverse, k1 = a1 * inverse, k2 = a2 * inverse;
+
+        float error = shares[row] - (w[0] * f0 + w[1] * f1 + w[2] * f2);
+        w[0] += k0 * error;
+        w[1] += k1 * error;
+        w[2] += k2 * error;
+
+        p[0] = (p[0] - k0 * a0) / lambda;
+        p[1] = (p[1] - k0 * a1) / lambda;
+        p[2] = (p[2] - k0 * a2) / lambda;
+        p[3] = (p[3] - k1 * a1) / lambda;
+        p[4] = (p[4] - k1 * a2) / lambda;
+        p[5] = (p[5] - k2 * a2) / lambda;
+        fit.samples += 1.0f;
+    }
+}
+
+void SpatialSpeedModel::observe(const float* shares) {
+    fitLag(nearSteps, &State::near, shares);
+    fitLag(farSteps, &State::far, shares);
+    shareHistory.pushAll(shares);
+}
+
+void SpatialSpeedModel::forecast(const float* shares, float* nearOut, float* farOut) {
+    computeNeighborMeans(shares);
+
+    size_t rows = states.size();
+    for (size_t row = 0; row < rows; row++) {
+        const float* near = states[row].near.weights;
+        const float* far = states[row].far.weights;
+        float share = shares[row];
+        float neighbors = neighborMeans[row];
+        nearOut[row] = std::max(0.0f, std::min(near[0] * share + near[1] * neighbors + near[2], 1.0f));
+        farOut[row] = std::max(0.0f, std::min(far[0] * share + far[1] * neighbors + far[2], 1.0f));
+    }
+}
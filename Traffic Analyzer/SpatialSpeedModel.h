@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "EdgeHistoryMatrix.h"
+
+class Graph;
+
+// Predicts each edge's speed, as a share of its limit, a fixed number of
+// steps ahead from its own share and the mean share of the roads meeting it
+// at either end (cars drive roads both ways), so congestion next door pulls
+// the forecast down before it arrives:
+//
+//   share(t + h) = a * share(t) + b * mean(neighbour shares at t) + c
+//
+// Each horizon h has its own a, b and c per edge, fitted directly on shares
+// seen h steps apart by recursive least squares with forgetting. The
+// neighbour mean is a sparse matrix-vector product over the edge adjacency
+// in CSR form, so a step over the whole network is linear in the number of
+// edges.
+class SpatialSpeedModel {
+public:
+    struct Fit {
+        float weights[3] = { 1.0f, 0.0f, 0.0f };   // a, b, c; starts as persistence
+        float covariance[6] = {};                  // Upper triangle: 00 01 02 11 12 22
+        float samples = 0.0f;                      // Steps fitted
+    };
+
+    // One edge's fits, copied when rows move and written to checkpoints
+    struct State {
+        Fit near;
+        Fit far;
+    };
+
+private:
+    float forgetting;                    // Weight kept by old steps at each new one
+    float initialVariance;
+    int nearSteps;
+    int farSteps;
+
+    // Edge slot -> slots of the roads sharing a node with it, in CSR form;
+    // the road itself and its reverse direction are left out
+    std::vector<int> neighborOffsets;
+    std::vector<int> neighborSlots;
+
+    std::vector<State> states;
+    EdgeHistoryMatrix shareHistory;      // The last farSteps steps
+    std::vector<float> laggedShares;
+    std::vector<float> neighborMeans;
+
+    void computeNeighborMeans(const float* shares);
+    void fitLag(int steps, Fit State::* fit, const float* shares);
+    State initialState() const;
+
+public:
+    // With the parameters in PredictionConfig, for rounds of roundSeconds
+    // and horizons of 5 and 10 minutes
+    explicit SpatialSpeedModel(float roundSeconds);
+    SpatialSpeedModel(float forgetting, float initialVariance, int nearSteps, int farSteps);
+
+    // Lays the rows out by the graph's edge slots; every row starts unfitted
+    void build(const Graph& graph);
+    size_t getRowCount() const { return states.size(); }
+
+    // One step: fits each horizon on the shares seen that many steps ago,
+    // then remembers the shares
+    void observe(const float* shares);
+
+    // Shares nearSteps and farSteps steps after the given ones
+    void forecast(const float* shares, float* nearOut, float* farOut);
+
+    // Mean neighbour share of every row, for the shares last passed to forecast()
+    const float* getNeighborMeans() const { return neighborMeans.data(); }
+
+    // Steps both horizons have been fitted on
+    float getSamples(size_t row) const { return std::min(states[row].near.samples, states[row].far.samples); }
+    const State& getState(size_t row) const { return states[row]; }
+    void setState(size_t row, const State& state) { states[row] = state; }
+
+    // Checkpointing of the remembered shares, oldest first
+    void appendHistory(size_t row, std::vector<float>& out) const { shareHistory.appendRow(row, out); }
+    void assignHistory(size_t row, const float* data, size_t count) { shareHistory.assignRow(row, data, count); }
+    int getHistorySize(size_t row) const { return shareHistory.size(row); }
+};
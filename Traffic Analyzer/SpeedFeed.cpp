@@ -0,0 +1,232 @@
+#include "SpeedFeed.h"
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#else
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace {
+    constexpr char SOCKET_PREFIX[] = "unix:";
+    constexpr float MAX_OBSERVED_SPEED = 400.0f;   // km/h; anything above is a bad reading
+
+    enum class ReadResult { DATA, NOTHING_YET, END };
+
+    ReadResult readSome(int fd, char* data, size_t size, size_t& bytes) {
+#ifdef __linux__
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return ReadResult::NOTHING_YET;
+        }
+        if (n < 0) {
+            std::cerr << "Error: Speed feed read failed: " << std::strerror(errno) << std::endl;
+        }
+#else
+        int n = _read(fd, data, static_cast<unsigned>(size));
+#endif
+        if (n <= 0) return ReadResult::END;
+        bytes = static_cast<size_t>(n);
+        return ReadResult::DATA;
+    }
+
+    void closeDescriptor(int fd) {
+#ifdef __linux__
+        ::close(fd);
+#else
+        _close(fd);
+#endif
+    }
+
+    template <typename T>
+    const char* parseField(const char* first, const char* last, T& value, char separator) {
+        auto [next, error] = std::from_chars(first, last, value);
+        if (error != std::errc() || (separator != '\0' && (next == last || *next != separator))) {
+            return nullptr;
+        }
+        return separator != '\0' ? next + 1 : next;
+    }
+}
+
+SpeedFeed::SpeedFeed()
+    : fd(-1), ownsDescriptor(false), finished(false),
+    buffer(BUFFER_BYTES), begin(0), end(0),
+    batch(BATCH_OBSERVATIONS), batchSize(0), pending{}, hasPending(false),
+    observationCount(0), unknownCount(0), malformedCount(0) {
+}
+
+SpeedFeed::~SpeedFeed() {
+    close();
+}
+
+bool SpeedFeed::open(const std::string& name) {
+    if (isOpen()) return false;
+
+    int descriptor = -1;
+    bool owned = true;
+    if (name == "-") {
+        descriptor = 0;
+        owned = false;
+#ifdef __linux__
+        fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+#endif
+    }
+    else if (name.rfind(SOCKET_PREFIX, 0) == 0) {
+#ifdef __linux__
+        std::string path = name.substr(sizeof(SOCKET_PREFIX) - 1);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Error: Bad socket path in " << name << std::endl;
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor == -1 || connect(descriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "Error: Could not connect to " << path << ": " << std::strerror(errno) << std::endl;
+            if (descriptor != -1) ::close(descriptor);
+            return false;
+        }
+        fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+#else
+        std::cerr << "Error: Unix socket speed feeds need Linux" << std::endl;
+        return false;
+#endif
+    }
+    else {
+        // Opening a pipe without O_NONBLOCK would wait for a writer
+#ifdef __linux__
+        descriptor = ::open(name.c_str(), O_RDONLY | O_NONBLOCK);
+#else
+        descriptor = _open(name.c_str(), _O_RDONLY | _O_BINARY);
+#endif
+        if (descriptor == -1) {
+            std::cerr << "Error: Could not open file " << name << std::endl;
+            return false;
+        }
+    }
+
+    fd = descriptor;
+    ownsDescriptor = owned;
+    finished = false;
+    source = name;
+    begin = end = 0;
+    batchSize = 0;
+    hasPending = false;
+    observationCount = unknownCount = malformedCount = 0;
+    return true;
+}
+
+void SpeedFeed::close() {
+    if (!isOpen()) return;
+    if (ownsDescriptor) {
+        closeDescriptor(fd);
+    }
+    fd = -1;
+}
+
+// Moves the unparsed tail to the front and reads after it; false if nothing
+// new arrived
+bool SpeedFeed::fill() {
+    if (!isOpen() || finished) return false;
+
+    if (begin > 0) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == buffer.size()) {
+        // A line longer than the buffer is no observation
+        malformedCount++;
+        end = 0;
+    }
+
+    size_t bytes = 0;
+    ReadResult result = readSome(fd, buffer.data() + end, buffer.size() - end, bytes);
+    if (result == ReadResult::END) {
+        finished = true;
+        return false;
+    }
+    if (result == ReadResult::NOTHING_YET) return false;
+
+    end += bytes;
+    return true;
+}
+
+bool SpeedFeed::parseLine(const char* first, const char* last) {
+    if (last > first && last[-1] == '\r') last--;
+    if (first == last || *first == '#') return false;
+
+    SpeedObservation observation;
+    const char* next = parseField(first, last, observation.time, ',');
+    if (next) next = parseField(next, last, observation.edgeId, ',');
+    if (next) next = parseField(next, last, observation.speed, '\0');
+
+    if (!next || next != last || !std::isfinite(observation.time) ||
+        !(observation.speed >= 0.0f && observation.speed <= MAX_OBSERVED_SPEED)) {
+        malformedCount++;
+        return false;
+    }
+
+    pending = observation;
+    hasPending = true;
+    return true;
+}
+
+// Parses lines until one holds an observation; at the end of the source the
+// last line counts without its newline
+bool SpeedFeed::nextObservation() {
+    while (true) {
+        const char* first = buffer.data() + begin;
+        const char* newline = static_cast<const char*>(std::memchr(first, '\n', end - begin));
+        if (newline) {
+            begin = static_cast<size_t>(newline - buffer.data()) + 1;
+            if (parseLine(first, newline)) return true;
+            continue;
+        }
+
+        // fill() may move the unparsed bytes
+        if (fill()) continue;
+        if (finished && begin < end) {
+            first = buffer.data() + begin;
+            begin = end;
+            return parseLine(first, buffer.data() + end);
+        }
+        return false;
+    }
+}
+
+void SpeedFeed::flush(PredictionSystem& predictions) {
+    if (batchSize == 0) return;
+
+    size_t matched = predictions.addObservations(batch.data(), batchSize);
+    observationCount += static_cast<long long>(matched);
+    unknownCount += static_cast<long long>(batchSize - matched);
+    batchSize = 0;
+}
+
+size_t SpeedFeed::pump(double time, PredictionSystem& predictions) {
+    size_t read = 0;
+    while (hasPending || nextObservation()) {
+        if (pending.time > time) break;
+
+        batch[batchSize++] = pending;
+        hasPending = false;
+        read++;
+        if (batchSize == batch.size()) {
+            flush(predictions);
+        }
+    }
+    flush(predictions);
+    return read;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "PredictionSystem.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// Streams speeds measured outside the simulation, by probe vehicles or loop
+// detectors, into PredictionSystem. The source is text, one observation per
+// line:
+//
+//   time,edgeId,speed           simulated seconds, edge id, km/h
+//
+// Blank lines and lines starting with '#' are skipped; any other line that
+// does not parse is counted as malformed and skipped. Lines must be in time
+// order.
+//
+// The source is a file, a named pipe, "-" for standard input, or
+// "unix:<path>" to connect to a Unix stream socket. Pipes and sockets are
+// read without blocking, so a slow producer never holds up the simulation;
+// a round simply sees what had arrived. Text is read into one fixed buffer
+// and parsed with std::from_chars into one fixed batch, so there is no
+// allocation per observation.
+class SpeedFeed {
+public:
+    static constexpr size_t BUFFER_BYTES = 1 << 16;
+    static constexpr size_t BATCH_OBSERVATIONS = 4096;
+
+private:
+    int fd;                              // POSIX descriptor, -1 when closed
+    bool ownsDescriptor;                 // False for standard input
+    bool finished;                       // End of file or the socket was closed
+    std::string source;
+
+    std::vector<char> buffer;
+    size_t begin;                        // Unparsed bytes are [begin, end)
+    size_t end;
+
+    std::vector<SpeedObservation> batch;
+    size_t batchSize;
+    SpeedObservation pending;            // Parsed but later than the last pump
+    bool hasPending;
+
+    long long observationCount;          // Handed to the prediction system
+    long long unknownCount;              // On no edge of the map
+    long long malformedCount;
+
+    bool fill();
+    bool nextObservation();
+    bool parseLine(const char* first, const char* last);
+    void flush(PredictionSystem& predictions);
+
+public:
+    SpeedFeed();
+    ~SpeedFeed();
+
+    SpeedFeed(const SpeedFeed&) = delete;
+    SpeedFeed& operator=(const SpeedFeed&) = delete;
+
+    bool open(const std::string& source);
+    void close();
+    bool isOpen() const { return fd != -1; }
+    bool isFinished() const { return finished && !hasPending && begin == end; }
+
+    // Hands every observation up to `time` that has arrived to the
+    // prediction system, in batches; returns how many were read
+    size_t pump(double time, PredictionSystem& predictions);
+
+    long long getObservationCount() const { return observationCount; }
+    long long getUnknownCount() const { return unknownCount; }
+    long long getMalformedCount() const { return malformedCount; }
+    const std::string& getSource() const { return source; }
+};
@@ -0,0 +1,277 @@
+#include "SpeedHistoryStore.h"
+#include "Checkpoint.h"
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <bit>
+
+namespace {
+    void writeBits(std::vector<std::uint64_t>& words, std::uint64_t& bitLength, std::uint64_t value, int count) {
+        int offset = static_cast<int>(bitLength & 63);
+        if (offset == 0) words.push_back(0);
+
+        int free = 64 - offset;
+        if (count <= free) {
+            words.back() |= value << (free - count);
+        }
+        else {
+            int spill = count - free;
+            words.back() |= value >> spill;
+            words.push_back(value << (64 - spill));
+        }
+        bitLength += count;
+    }
+
+    // Reads past the end of a corrupt stream as zeros rather than out of bounds
+    class BitReader {
+    private:
+        const std::vector<std::uint64_t>& words;
+        std::uint64_t position;
+
+        std::uint64_t word(size_t index) const { return index < words.size() ? words[index] : 0; }
+
+    public:
+        BitReader(const std::vector<std::uint64_t>& words) : words(words), position(0) {}
+
+        void seekWord(std::uint32_t index) { position = static_cast<std::uint64_t>(index) * 64; }
+
+        std::uint32_t read(int count) {
+            size_t index = static_cast<size_t>(position >> 6);
+            int offset = static_cast<int>(position & 63);
+            int free = 64 - offset;
+            std::uint64_t value = (word(index) << offset) >> (64 - count);
+            if (count > free) {
+                value |= word(index + 1) >> (64 - (count - free));
+            }
+            position += count;
+            return static_cast<std::uint32_t>(value);
+        }
+    };
+}
+
+SpeedHistoryStore::SpeedHistoryStore(long long retentionRounds)
+    : rounds(0), retentionRounds(std::max(1LL, retentionRounds)) {
+}
+
+void SpeedHistoryStore::remap(const std::vector<int>& edgeIds) {
+    std::unordered_map<int, size_t> oldRows;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        oldRows[rowEdgeIds[row]] = row;
+    }
+
+    std::vector<Series> moved(edgeIds.size());
+    for (size_t row = 0; row < edgeIds.size(); row++) {
+        auto old = oldRows.find(edgeIds[row]);
+        if (old != oldRows.end()) {
+            moved[row] = std::move(series[old->second]);
+        }
+        else {
+            moved[row].firstRound = rounds;
+        }
+    }
+
+    series = std::move(moved);
+    rowEdgeIds = edgeIds;
+}
+
+void SpeedHistoryStore::append(Series& s, float value) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+
+    if (s.count % BLOCK_ROUNDS == 0) {
+        s.bitLength = static_cast<std::uint64_t>(s.words.size()) * 64;
+        s.blockWords.push_back(static_cast<std::uint32_t>(s.words.size()));
+        writeBits(s.words, s.bitLength, bits, 32);
+        s.length = 0;
+    }
+    else {
+        std::uint32_t x = bits ^ s.previous;
+        if (x == 0) {
+            writeBits(s.words, s.bitLength, 0, 1);
+        }
+        else {
+            int leading = std::countl_zero(x);
+            int trailing = std::countr_zero(x);
+            int windowTrailing = 32 - s.leading - s.length;
+
+            if (s.length > 0 && leading >= s.leading && trailing >= windowTrailing) {
+                std::uint64_t code = (std::uint64_t(0b10) << s.length) | (x >> windowTrailing);
+                writeBits(s.words, s.bitLength, code, 2 + s.length);
+            }
+            else {
+                int length = 32 - leading - trailing;
+                std::uint64_t code = (std::uint64_t(0b11) << 10) | (std::uint64_t(leading) << 5) | (length - 1);
+                code = (code << length) | (x >> trailing);
+                writeBits(s.words, s.bitLength, code, 12 + length);
+                s.leading = static_cast<std::uint8_t>(leading);
+                s.length = static_cast<std::uint8_t>(length);
+            }
+        }
+    }
+
+    s.previous = bits;
+    s.count++;
+}
+
+void SpeedHistoryStore::appendRound(const float* speeds) {
+    for (size_t row = 0; row < series.size(); row++) {
+        Series& s = series[row];
+        append(s, speeds[row]);
+
+        // The oldest block goes once the rest still covers the retention
+        if (s.count >= retentionRounds + BLOCK_ROUNDS) {
+            std::uint32_t dropped = s.blockWords[1];
+            s.words.erase(s.words.begin(), s.words.begin() + dropped);
+            s.blockWords.erase(s.blockWords.begin());
+            for (std::uint32_t& word : s.blockWords) {
+                word -= dropped;
+            }
+            s.bitLength -= static_cast<std::uint64_t>(dropped) * 64;
+            s.firstRound += BLOCK_ROUNDS;
+            s.count -= BLOCK_ROUNDS;
+        }
+    }
+    rounds++;
+}
+
+int SpeedHistoryStore::decode(size_t row, long long first, long long last, std::vector<float>& out) const {
+    const Series& s = series[row];
+    long long begin = std::max(first, s.firstRound) - s.firstRound;
+    long long end = std::min(last, s.firstRound + static_cast<long long>(s.count)) - s.firstRound;
+    if (begin >= end) return 0;
+
+    BitReader reader(s.words);
+    std::uint32_t value = 0;
+    int leading = 0, length = 0;
+
+    for (long long i = begin - begin % BLOCK_ROUNDS; i < end; i++) {
+        if (i % BLOCK_ROUNDS == 0) {
+            reader.seekWord(s.blockWords[static_cast<size_t>(i / BLOCK_ROUNDS)]);
+            value = reader.read(32);
+        }
+        else if (reader.read(1) != 0) {
+            if (reader.read(1) != 0) {
+                leading = static_cast<int>(reader.read(5));
+                length = static_cast<int>(reader.read(5)) + 1;
+            }
+            // A window running past bit 0 only comes from a corrupt stream
+            int trailing = std::max(0, 32 - leading - length);
+            value ^= reader.read(length) << trailing;
+        }
+
+        if (i >= begin) {
+            out.push_back(std::bit_cast<float>(value));
+        }
+    }
+    return static_cast<int>(end - begin);
+}
+
+size_t SpeedHistoryStore::getCompressedBytes() const {
+    size_t bytes = 0;
+    for (const Series& s : series) {
+        bytes += s.words.size() * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
+
+// Flat columns; word and block counts follow from the bit lengths and sample
+// counts
+void SpeedHistoryStore::saveState(BinaryWriter& writer) const {
+    std::vector<long long> firstRounds;
+    std::vector<std::uint32_t> counts, previous;
+    std::vector<std::uint64_t> bitLengths, words;
+    std::vector<std::uint8_t> leadings, lengths;
+    std::vector<std::uint32_t> blockWords;
+
+    for (const Series& s : series) {
+        firstRounds.push_back(s.firstRound);
+        counts.push_back(s.count);
+        previous.push_back(s.previous);
+        bitLengths.push_back(s.bitLength);
+        leadings.push_back(s.leading);
+        lengths.push_back(s.length);
+        words.insert(words.end(), s.words.begin(), s.words.end());
+        blockWords.insert(blockWords.end(), s.blockWords.begin(), s.blockWords.end());
+    }
+
+    writer.writeTag("SPDS");
+    writer.write(rounds);
+    writer.writeArray(rowEdgeIds);
+    writer.writeArray(firstRounds);
+    writer.writeArray(counts);
+    writer.writeArray(previous);
+    writer.writeArray(bitLengths);
+    writer.writeArray(leadings);
+    writer.writeArray(lengths);
+    writer.writeArray(words);
+    writer.writeArray(blockWords);
+}
+
+bool SpeedHistoryStore::loadState(BinaryReader& reader) {
+    long long savedRounds = 0;
+    std::vector<int> ids;
+    std::vector<long long> firstRounds;
+    std::vector<std::uint32_t> counts, previous;
+    std::vector<std::uint64_t> bitLengths, words;
+    std::vector<std::uint8_t> leadings, lengths;
+    std::vector<std::uint32_t> blockWords;
+
+    if (!reader.expectTag("SPDS") || !reader.read(savedRounds) || !reader.readArray(ids) ||
+        !reader.readArray(firstRounds) || !reader.readArray(counts) || !reader.readArray(previous) ||
+        !reader.readArray(bitLengths) || !reader.readArray(leadings) || !reader.readArray(lengths) ||
+        !reader.readArray(words) || !reader.readArray(blockWords)) {
+        return false;
+    }
+
+    size_t rows = ids.size();
+    bool consistent = firstRounds.size() == rows && counts.size() == rows && previous.size() == rows &&
+        bitLengths.size() == rows && leadings.size() == rows && lengths.size() == rows;
+    std::uint64_t wordTotal = 0, blockTotal = 0;
+    for (size_t i = 0; consistent && i < rows; i++) {
+        std::uint64_t wordCount = (bitLengths[i] + 63) / 64;
+        std::uint64_t blockCount = (counts[i] + BLOCK_ROUNDS - 1) / BLOCK_ROUNDS;
+        consistent = firstRounds[i] + counts[i] <= savedRounds && leadings[i] + lengths[i] <= 32 &&
+            wordTotal + wordCount <= words.size() && blockTotal + blockCount <= blockWords.size();
+        for (std::uint64_t b = 0; consistent && b < blockCount; b++) {
+            consistent = blockWords[blockTotal + b] < wordCount &&
+                (b == 0 || blockWords[blockTotal + b] > blockWords[blockTotal + b - 1]);
+        }
+        wordTotal += wordCount;
+        blockTotal += blockCount;
+    }
+    if (!consistent || wordTotal != words.size() || blockTotal != blockWords.size()) {
+        std::cerr << "Error: Corrupt speed history in checkpoint" << std::endl;
+        reader.fail();
+        return false;
+    }
+
+    std::unordered_map<int, size_t> rowById;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        rowById[rowEdgeIds[row]] = row;
+        series[row] = Series();
+        series[row].firstRound = savedRounds;
+    }
+
+    size_t wordPos = 0, blockPos = 0;
+    for (size_t i = 0; i < rows; i++) {
+        size_t wordCount = static_cast<size_t>((bitLengths[i] + 63) / 64);
+        size_t blockCount = (counts[i] + BLOCK_ROUNDS - 1) / BLOCK_ROUNDS;
+        auto found = rowById.find(ids[i]);
+        if (found != rowById.end()) {
+            Series& s = series[found->second];
+            s.words.assign(words.begin() + wordPos, words.begin() + wordPos + wordCount);
+            s.blockWords.assign(blockWords.begin() + blockPos, blockWords.begin() + blockPos + blockCount);
+            s.bitLength = bitLengths[i];
+            s.firstRound = firstRounds[i];
+            s.count = counts[i];
+            s.previous = previous[i];
+            s.leading = leadings[i];
+            s.length = lengths[i];
+        }
+        wordPos += wordCount;
+        blockPos += blockCount;
+    }
+
+    rounds = savedRounds;
+    return true;
+}
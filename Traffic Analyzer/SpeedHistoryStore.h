@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BinaryWriter;
+class BinaryReader;
+
+// Append-only speed history of every edge, one sample per prediction round,
+// compressed with Gorilla's XOR encoding (Pelkonen et al., VLDB 2015). Each
+// sample is XORed with the previous one of its edge:
+//
+//   0                            same value as before
+//   10 <meaningful bits>         differing bits fit the previous window
+//   11 <5: leading> <5: length - 1> <meaningful bits>
+//
+// Measured speeds come from quantised travel times, so most rounds repeat
+// the last value and cost one bit. Samples are cut into blocks of
+// BLOCK_ROUNDS that start on a word with a raw value, so a window decodes
+// from the block holding its first round and old blocks are dropped whole
+// once they fall out of the retention.
+//
+// Rounds are numbered from 0 for the whole store; every row gains one sample
+// per appendRound(), so a row's samples are the contiguous rounds
+// [getFirstRound(row), getRoundCount()).
+class SpeedHistoryStore {
+public:
+    static constexpr int BLOCK_ROUNDS = 720;    // An hour of 5 s rounds
+
+private:
+    struct Series {
+        std::vector<std::uint64_t> words;       // Bit stream, most significant bit first
+        std::vector<std::uint32_t> blockWords;  // First word of each block
+        std::uint64_t bitLength = 0;
+        long long firstRound = 0;               // Round of the first retained sample
+        std::uint32_t count = 0;                // Retained samples
+
+        // Encoder state
+        std::uint32_t previous = 0;             // Bits of the last value
+        std::uint8_t leading = 0;               // Window of the last XOR; length 0 = none yet
+        std::uint8_t length = 0;
+    };
+
+    std::vector<Series> series;
+    std::vector<int> rowEdgeIds;
+    long long rounds;
+    long long retentionRounds;
+
+    static void append(Series& s, float value);
+
+public:
+    // Keeps at least retentionRounds samples per edge, and at most a block more
+    explicit SpeedHistoryStore(long long retentionRounds);
+
+    // Lays the rows out for these edges; an edge keeps its history across
+    // layouts, a new edge starts empty and a removed one is forgotten
+    void remap(const std::vector<int>& edgeIds);
+    size_t getRowCount() const { return series.size(); }
+
+    // One speed per row
+    void appendRound(const float* speeds);
+
+    long long getRoundCount() const { return rounds; }
+    long long getFirstRound(size_t row) const { return series[row].firstRound; }
+    int getSampleCount(size_t row) const { return static_cast<int>(series[row].count); }
+
+    // Appends the row's samples for rounds [first, last) to out, clipped to
+    // the retained ones; returns how many were appended
+    int decode(size_t row, long long first, long long last, std::vector<float>& out) const;
+
+    // Compressed size of all rows, in bytes of bit stream
+    size_t getCompressedBytes() const;
+
+    // Checkpointing, rows matched by edge id
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+};
@@ -0,0 +1,145 @@
+#include "SpeedKalmanFilter.h"
+#include "Config.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+SpeedKalmanFilter::SpeedKalmanFilter()
+    : SpeedKalmanFilter(PredictionConfig::KALMAN_LEVEL_NOISE, PredictionConfig::KALMAN_TREND_NOISE,
+        PredictionConfig::KALMAN_MEASUREMENT_NOISE, PredictionConfig::KALMAN_INITIAL_TREND_VARIANCE,
+        PredictionConfig::KALMAN_TREND_DAMPING) {
+}
+
+SpeedKalmanFilter::SpeedKalmanFilter(float levelNoise, float trendNoise, float measurementNoise,
+    float initialTrendVariance, float damping)
+    : levelNoise(levelNoise), trendNoise(trendNoise), measurementNoise(measurementNoise),
+    initialTrendVariance(initialTrendVariance), damping(damping) {
+}
+
+void SpeedKalmanFilter::resize(size_t rowCount) {
+    for (auto* column : { &levels, &trends, &levelVariances, &covariances, &trendVariances, &samples }) {
+        column->assign(rowCount, 0.0f);
+    }
+}
+
+// Predict with F = [1 d; 0 d] and Q = diag(levelNoise, trendNoise), then
+// correct with the measurement of the level (H = [1 0])
+void SpeedKalmanFilter::updateAll(const float* measurements) {
+    size_t n = levels.size();
+    size_t i = 0;
+    const float d = damping;
+    const float d2 = damping * damping;
+
+#if defined(__AVX2__)
+    const __m256 vD = _mm256_set1_ps(d);
+    const __m256 vD2 = _mm256_set1_ps(d2);
+    const __m256 vTwoD = _mm256_set1_ps(2.0f * d);
+    const __m256 vLevelNoise = _mm256_set1_ps(levelNoise);
+    const __m256 vTrendNoise = _mm256_set1_ps(trendNoise);
+    const __m256 vMeasurementNoise = _mm256_set1_ps(measurementNoise);
+    const __m256 vInitialTrend = _mm256_set1_ps(initialTrendVariance);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vZero = _mm256_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 z = _mm256_loadu_ps(measurements + i);
+        __m256 level = _mm256_loadu_ps(&levels[i]);
+        __m256 trend = _mm256_loadu_ps(&trends[i]);
+        __m256 p00 = _mm256_loadu_ps(&levelVariances[i]);
+        __m256 p01 = _mm256_loadu_ps(&covariances[i]);
+        __m256 p11 = _mm256_loadu_ps(&trendVariances[i]);
+        __m256 count = _mm256_loadu_ps(&samples[i]);
+
+        __m256 predictedLevel = _mm256_add_ps(level, _mm256_mul_ps(vD, trend));
+        __m256 predictedTrend = _mm256_mul_ps(vD, trend);
+        __m256 q00 = _mm256_add_ps(_mm256_add_ps(p00, _mm256_mul_ps(vTwoD, p01)),
+            _mm256_add_ps(_mm256_mul_ps(vD2, p11), vLevelNoise));
+        __m256 q01 = _mm256_add_ps(_mm256_mul_ps(vD, p01), _mm256_mul_ps(vD2, p11));
+        __m256 q11 = _mm256_add_ps(_mm256_mul_ps(vD2, p11), vTrendNoise);
+
+        __m256 innovation = _mm256_sub_ps(z, predictedLevel);
+        __m256 inverse = _mm256_div_ps(vOne, _mm256_add_ps(q00, vMeasurementNoise));
+        __m256 k0 = _mm256_mul_ps(q00, inverse);
+        __m256 k1 = _mm256_mul_ps(q01, inverse);
+        __m256 keep = _mm256_sub_ps(vOne, k0);
+
+        __m256 first = _mm256_cmp_ps(count, vZero, _CMP_EQ_OQ);
+        _mm256_storeu_ps(&levels[i], _mm256_blendv_ps(
+            _mm256_add_ps(predictedLevel, _mm256_mul_ps(k0, innovation)), z, first));
+        _mm256_storeu_ps(&trends[i], _mm256_blendv_ps(
+            _mm256_add_ps(predictedTrend, _mm256_mul_ps(k1, innovation)), vZero, first));
+        _mm256_storeu_ps(&levelVariances[i], _mm256_blendv_ps(
+            _mm256_mul_ps(keep, q00), vMeasurementNoise, first));
+        _mm256_storeu_ps(&covariances[i], _mm256_blendv_ps(_mm256_mul_ps(keep, q01), vZero, first));
+        _mm256_storeu_ps(&trendVariances[i], _mm256_blendv_ps(
+            _mm256_sub_ps(q11, _mm256_mul_ps(k1, q01)), vInitialTrend, first));
+        _mm256_storeu_ps(&samples[i], _mm256_add_ps(count, vOne));
+    }
+#endif
+
+    // Scalar path (and AVX2 remainder)
+    for (; i < n; i++) {
+        float z = measurements[i];
+        if (samples[i] == 0.0f) {
+            levels[i] = z;
+            trends[i] = 0.0f;
+            levelVariances[i] = measurementNoise;
+            covariances[i] = 0.0f;
+            trendVariances[i] = initialTrendVariance;
+            samples[i] = 1.0f;
+            continue;
+        }
+
+        float predictedLevel = levels[i] + d * trends[i];
+        float predictedTrend = d * trends[i];
+        float q00 = levelVariances[i] + 2.0f * d * covariances[i] + d2 * trendVariances[i] + levelNoise;
+        float q01 = d * covariances[i] + d2 * trendVariances[i];
+        float q11 = d2 * trendVariances[i] + trendNoise;
+
+        float innovation = z - predictedLevel;
+        float inverse = 1.0f / (q00 + measurementNoise);
+        float k0 = q00 * inverse;
+        float k1 = q01 * inverse;
+
+        levels[i] = predictedLevel + k0 * innovation;
+        trends[i] = predictedTrend + k1 * innovation;
+        levelVariances[i] = (1.0f - k0) * q00;
+        covariances[i] = (1.0f - k0) * q01;
+        trendVariances[i] = q11 - k1 * q01;
+        samples[i] += 1.0f;
+    }
+}
+
+// F^h = [1 g; 0 d^h] with g = d + d^2 + ... + d^h. The noise added at step i
+// reaches the level through the gain of the steps after it, the same for
+// every edge, so it is summed once here instead of per edge.
+SpeedKalmanFilter::Horizon SpeedKalmanFilter::horizon(int steps) const {
+    double gain = 0.0;
+    double noise = 0.0;
+    double power = 1.0;
+    for (int step = 0; step < steps; step++) {
+        noise += levelNoise + gain * gain * trendNoise;
+        power *= damping;
+        gain += power;
+    }
+    return { static_cast<float>(gain), static_cast<float>(noise) };
+}
+
+SpeedKalmanFilter::Columns SpeedKalmanFilter::getColumns() const {
+    return { levels.data(), trends.data(), levelVariances.data(), covariances.data(),
+        trendVariances.data(), samples.data() };
+}
+
+SpeedKalmanFilter::State SpeedKalmanFilter::getState(size_t row) const {
+    return { levels[row], trends[row], levelVariances[row], covariances[row], trendVariances[row], samples[row] };
+}
+
+void SpeedKalmanFilter::setState(size_t row, const State& state) {
+    levels[row] = state.level;
+    trends[row] = state.trend;
+    levelVariances[row] = state.levelVariance;
+    covariances[row] = state.covariance;
+    trendVariances[row] = state.trendVariance;
+    samples[row] = state.samples;
+}
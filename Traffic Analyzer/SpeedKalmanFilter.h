@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// One linear Kalman filter per edge tracking speed and its trend per step.
+// The trend is damped, so a forecast levels off instead of running away:
+//
+//   level' = level + damping * trend
+//   trend' = damping * trend
+//
+// Filters are stored as SoA columns and every round updates all of them in
+// one pass, with AVX2 when the compiler targets it. An edge's first
+// measurement sets its level directly; until then the row is empty.
+class SpeedKalmanFilter {
+public:
+    struct Columns {
+        const float* level;
+        const float* trend;
+        const float* levelVariance;      // Covariance of the state, symmetric 2x2
+        const float* covariance;
+        const float* trendVariance;
+        const float* samples;            // Measurements so far, 0 for an empty row
+    };
+
+    // Copied when rows move and written to checkpoints
+    struct State {
+        float level = 0.0f;
+        float trend = 0.0f;
+        float levelVariance = 0.0f;
+        float covariance = 0.0f;
+        float trendVariance = 0.0f;
+        float samples = 0.0f;
+    };
+
+    // What `steps` steps ahead adds to a forecast: the level moves by
+    // trendGain * trend, and the process noise piles up to noiseVariance
+    struct Horizon {
+        float trendGain;
+        float noiseVariance;
+    };
+
+private:
+    float levelNoise;                    // Process noise variance per step
+    float trendNoise;
+    float measurementNoise;
+    float initialTrendVariance;
+    float damping;
+
+    std::vector<float> levels;
+    std::vector<float> trends;
+    std::vector<float> levelVariances;
+    std::vector<float> covariances;
+    std::vector<float> trendVariances;
+    std::vector<float> samples;
+
+public:
+    // With the parameters in PredictionConfig
+    SpeedKalmanFilter();
+    SpeedKalmanFilter(float levelNoise, float trendNoise, float measurementNoise,
+        float initialTrendVariance, float damping);
+
+    // Empties every row
+    void resize(size_t rowCount);
+    size_t getRowCount() const { return levels.size(); }
+
+    // One measurement per row
+    void updateAll(const float* measurements);
+
+    Horizon horizon(int steps) const;
+    Columns getColumns() const;
+
+    bool empty(size_t row) const { return samples[row] == 0.0f; }
+    State getState(size_t row) const;
+    void setState(size_t row, const State& state);
+};
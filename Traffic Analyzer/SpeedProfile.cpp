@@ -0,0 +1,242 @@
+#include "SpeedProfile.h"
+#include "Checkpoint.h"
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+int SpeedProfile::binAt(double weekSeconds) {
+    double t = std::fmod(weekSeconds, WEEK_SECONDS);
+    if (t < 0.0) t += WEEK_SECONDS;
+    return std::min(static_cast<int>(t / BIN_SECONDS), BINS - 1);
+}
+
+SpeedProfile::SpeedProfile(int maxDays)
+    : maxDays(std::max(1, std::min(maxDays, 255))), currentBin(-1) {
+}
+
+void SpeedProfile::remap(const std::vector<int>& edgeIds) {
+    std::unordered_map<int, size_t> oldRows;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        oldRows[rowEdgeIds[row]] = row;
+    }
+
+    std::vector<std::uint8_t> movedShares(edgeIds.size() * BINS, 255);
+    std::vector<std::uint8_t> movedDays(edgeIds.size() * BINS, 0);
+    std::vector<float> movedSums(edgeIds.size(), 0.0f);
+    std::vector<std::uint32_t> movedCounts(edgeIds.size(), 0);
+    for (size_t row = 0; row < edgeIds.size(); row++) {
+        auto old = oldRows.find(edgeIds[row]);
+        if (old == oldRows.end()) continue;
+
+        size_t from = old->second;
+        std::copy_n(shares.begin() + from * BINS, BINS, movedShares.begin() + row * BINS);
+        std::copy_n(days.begin() + from * BINS, BINS, movedDays.begin() + row * BINS);
+        movedSums[row] = binSums[from];
+        movedCounts[row] = binCounts[from];
+    }
+
+    shares = std::move(movedShares);
+    days = std::move(movedDays);
+    binSums = std::move(movedSums);
+    binCounts = std::move(movedCounts);
+    rowEdgeIds = edgeIds;
+}
+
+void SpeedProfile::observe(double weekSeconds, const float* rowShares) {
+    int bin = binAt(weekSeconds);
+    if (bin != currentBin) {
+        foldCurrentBin();
+        currentBin = bin;
+    }
+
+    for (size_t row = 0; row < binSums.size(); row++) {
+        binSums[row] += rowShares[row];
+        binCounts[row]++;
+    }
+}
+
+void SpeedProfile::foldCurrentBin() {
+    if (currentBin < 0) return;
+
+    for (size_t row = 0; row < binSums.size(); row++) {
+        if (binCounts[row] == 0) continue;
+
+        size_t cell = row * BINS + currentBin;
+        float mean = std::max(0.0f, std::min(binSums[row] / binCounts[row], 1.0f));
+        int seen = days[cell];
+        float value = mean;
+        if (seen > 0) {
+            float old = shares[cell] / 255.0f;
+            value = old + (mean - old) / std::min(seen + 1, maxDays);
+        }
+
+        shares[cell] = static_cast<std::uint8_t>(std::lround(value * 255.0f));
+        days[cell] = static_cast<std::uint8_t>(std::min(seen + 1, maxDays));
+        binSums[row] = 0.0f;
+        binCounts[row] = 0;
+    }
+}
+
+float SpeedProfile::getShare(size_t row, double weekSeconds, int& dayCount) const {
+    const std::uint8_t* rowShares = shares.data() + row * BINS;
+    const std::uint8_t* rowDays = days.data() + row * BINS;
+
+    for (int back = 0; back < DAYS; back++) {
+        double position = std::fmod(weekSeconds / BIN_SECONDS - 0.5 - back * BINS_PER_DAY,
+            static_cast<double>(BINS));
+        if (position < 0.0) position += BINS;
+
+        int before = std::min(static_cast<int>(position), BINS - 1);
+        int after = before + 1 == BINS ? 0 : before + 1;
+        float fraction = static_cast<float>(position - before);
+        if (rowDays[before] == 0 || rowDays[after] == 0) continue;
+
+        dayCount = std::min(rowDays[before], rowDays[after]);
+        return (rowShares[before] + fraction * (rowShares[after] - rowShares[before])) / 255.0f;
+    }
+
+    dayCount = 0;
+    return 1.0f;
+}
+
+void SpeedProfile::forecast(double weekSeconds, const float* speedLimits, int minDays, float weight,
+    float* speedOut, float* weightOut) const {
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        int dayCount = 0;
+        speedOut[row] = getShare(row, weekSeconds, dayCount) * speedLimits[row];
+        weightOut[row] = dayCount >= minDays ? weight : 0.0f;
+    }
+}
+
+size_t SpeedProfile::getFilledBins() const {
+    return static_cast<size_t>(std::count_if(days.begin(), days.end(), [](std::uint8_t d) { return d > 0; }));
+}
+
+void SpeedProfile::write(BinaryWriter& writer) const {
+    writer.writeArray(rowEdgeIds);
+    writer.writeArray(shares);
+    writer.writeArray(days);
+}
+
+bool SpeedProfile::readTable(BinaryReader& reader, std::vector<int>& ids,
+    std::vector<std::uint8_t>& savedShares, std::vector<std::uint8_t>& savedDays) {
+    if (!reader.readArray(ids) || !reader.readArray(savedShares) || !reader.readArray(savedDays)) {
+        return false;
+    }
+    if (savedShares.size() != ids.size() * BINS || savedDays.size() != ids.size() * BINS) {
+        reader.fail();
+        return false;
+    }
+    return true;
+}
+
+// Saved rows of edges missing from the layout are skipped; rows missing from
+// the saved ones start empty
+void SpeedProfile::assignRows(const std::vector<int>& ids, const std::vector<std::uint8_t>& savedShares,
+    const std::vector<std::uint8_t>& savedDays, const float* sums, const std::uint32_t* counts) {
+    std::unordered_map<int, size_t> rowById;
+    for (size_t row = 0; row < rowEdgeIds.size(); row++) {
+        rowById[rowEdgeIds[row]] = row;
+    }
+    std::fill(shares.begin(), shares.end(), 255);
+    std::fill(days.begin(), days.end(), 0);
+    std::fill(binSums.begin(), binSums.end(), 0.0f);
+    std::fill(binCounts.begin(), binCounts.end(), 0);
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        auto found = rowById.find(ids[i]);
+        if (found == rowById.end()) continue;
+
+        size_t row = found->second;
+        std::copy_n(savedShares.begin() + i * BINS, BINS, shares.begin() + row * BINS);
+        for (int bin = 0; bin < BINS; bin++) {
+            days[row * BINS + bin] = static_cast<std::uint8_t>(std::min<int>(savedDays[i * BINS + bin], maxDays));
+        }
+        if (sums) {
+            binSums[row] = sums[i];
+            binCounts[row] = counts[i];
+        }
+    }
+}
+
+bool SpeedProfile::saveToFile(const std::string& filename) const {
+    BinaryWriter writer(filename);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    writer.write(MAGIC);
+    writer.write(VERSION);
+    write(writer);
+    if (!writer.good()) {
+        std::cerr << "Error: Failed writing profile to " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SpeedProfile::loadFromFile(const std::string& filename) {
+    BinaryReader reader(filename);
+    if (!reader.isOpen()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    if (!reader.read(magic) || std::memcmp(magic, MAGIC, 4) != 0 ||
+        !reader.read(version) || version != VERSION) {
+        std::cerr << "Error: " << filename << " is not a version " << VERSION << " speed profile" << std::endl;
+        return false;
+    }
+
+    std::vector<int> ids;
+    std::vector<std::uint8_t> savedShares, savedDays;
+    if (!readTable(reader, ids, savedShares, savedDays)) {
+        std::cerr << "Error: " << filename << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+
+    rowEdgeIds = ids;
+    binSums.assign(ids.size(), 0.0f);
+    binCounts.assign(ids.size(), 0);
+    shares.resize(ids.size() * BINS);
+    days.resize(ids.size() * BINS);
+    currentBin = -1;
+    assignRows(ids, savedShares, savedDays, nullptr, nullptr);
+    return true;
+}
+
+void SpeedProfile::saveState(BinaryWriter& writer) const {
+    writer.writeTag("PROF");
+    write(writer);
+    writer.write(currentBin);
+
+    // The running sums follow the saved rows
+    writer.writeArray(binSums);
+    writer.writeArray(binCounts);
+}
+
+bool SpeedProfile::loadState(BinaryReader& reader) {
+    std::vector<int> ids;
+    std::vector<std::uint8_t> savedShares, savedDays;
+    int savedBin = -1;
+    std::vector<float> sums;
+    std::vector<std::uint32_t> counts;
+
+    if (!reader.expectTag("PROF") || !readTable(reader, ids, savedShares, savedDays) ||
+        !reader.read(savedBin) || !reader.readArray(sums) || !reader.readArray(counts)) {
+        return false;
+    }
+    if (sums.size() != ids.size() || counts.size() != ids.size() || savedBin < -1 || savedBin >= BINS) {
+        std::cerr << "Error: Corrupt speed profile in checkpoint" << std::endl;
+        reader.fail();
+        return false;
+    }
+
+    assignRows(ids, savedShares, savedDays, sums.data(), counts.data());
+    currentBin = savedBin;
+    return true;
+}
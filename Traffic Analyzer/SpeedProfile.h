@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BinaryWriter;
+class BinaryReader;
+
+// Typical speed of every edge by time of week: 7 days of 96 bins of 15
+// minutes, each holding the edge's mean speed in that bin as a share of its
+// speed limit, quantised to one byte. A bin averages the days it has seen,
+// up to maxDays, and then follows newer days with weight 1 / maxDays, so the
+// profile tracks slow changes in demand.
+//
+// observe() sums each round's shares into the current bin and folds the
+// mean into the table when the bin ends. Profiles are saved to their own
+// file with rows matched by edge id, so one learned in a headless run can be
+// loaded into another run on the same map.
+//
+// File format: "TAPF", version, edge ids, shares (row-major, BINS per row),
+// days folded into each bin.
+class SpeedProfile {
+public:
+    static constexpr char MAGIC[4] = { 'T', 'A', 'P', 'F' };
+    static constexpr std::uint32_t VERSION = 1;
+
+    static constexpr int DAYS = 7;
+    static constexpr int BINS_PER_DAY = 96;
+    static constexpr int BINS = DAYS * BINS_PER_DAY;
+    static constexpr double BIN_SECONDS = 900.0;
+    static constexpr double WEEK_SECONDS = DAYS * BINS_PER_DAY * BIN_SECONDS;
+
+    // Bin of a time of week in seconds since Monday 00:00; wraps both ways
+    static int binAt(double weekSeconds);
+
+private:
+    int maxDays;
+    std::vector<int> rowEdgeIds;
+    std::vector<std::uint8_t> shares;    // [row][bin], share * 255
+    std::vector<std::uint8_t> days;      // Days folded into each bin, at most maxDays
+
+    // The bin being observed
+    int currentBin;
+    std::vector<float> binSums;
+    std::vector<std::uint32_t> binCounts;
+
+public:
+    explicit SpeedProfile(int maxDays);
+
+    // Lays the rows out for these edges; an edge keeps its profile across
+    // layouts, a new edge starts empty and a removed one is forgotten
+    void remap(const std::vector<int>& edgeIds);
+    size_t getRowCount() const { return rowEdgeIds.size(); }
+
+    // One share of the speed limit per row, at this time of week
+    void observe(double weekSeconds, const float* rowShares);
+
+    // Folds the bin being observed into the table now, as if it had ended
+    void foldCurrentBin();
+
+    // Share at a time of week, interpolated between the two bin centres
+    // around it. Until both have data, the same time on the closest earlier
+    // day that has stands in. dayCount is the fewer days of the two bins
+    // used, and 0 (with a share of 1) if no day has data there
+    float getShare(size_t row, double weekSeconds, int& dayCount) const;
+
+    // Speed forecasts for every row at a time of week; weight is `weight`
+    // where getShare() found at least minDays days, 0 elsewhere
+    void forecast(double weekSeconds, const float* speedLimits, int minDays, float weight,
+        float* speedOut, float* weightOut) const;
+
+    // Bins holding at least one day, over all rows
+    size_t getFilledBins() const;
+
+    // A loaded profile takes the file's row layout; remap() it to a map's
+    bool saveToFile(const std::string& filename) const;
+    bool loadFromFile(const std::string& filename);
+
+    // Checkpointing, including the bin being observed; rows matched by edge id
+    void saveState(BinaryWriter& writer) const;
+    bool loadState(BinaryReader& reader);
+
+private:
+    void write(BinaryWriter& writer) const;
+    static bool readTable(BinaryReader& reader, std::vector<int>& ids,
+        std::vector<std::uint8_t>& savedShares, std::vector<std::uint8_t>& savedDays);
+    void assignRows(const std::vector<int>& ids, const std::vector<std::uint8_t>& savedShares,
+        const std::vector<std::uint8_t>& savedDays, const float* sums, const std::uint32_t* counts);
+};
@@ -0,0 +1,201 @@
+#include "SpeedRecorder.h"
+#include "PredictionSystem.h"
+#include "Checkpoint.h"
+#include <iostream>
+#include <limits>
+
+namespace {
+    constexpr char MAP_TAG[5] = "MAP ";
+    constexpr char ROWS_TAG[5] = "ROWS";
+    constexpr char END_TAG[5] = "END ";
+}
+
+SpeedRecorder::SpeedRecorder()
+    : slotsVersion(std::numeric_limits<std::uint64_t>::max()),
+    lastRound(0),
+    frameCount(0) {
+}
+
+SpeedRecorder::~SpeedRecorder() {
+    close();
+}
+
+bool SpeedRecorder::open(const std::string& file, const Graph& graph, float roundSeconds) {
+    if (isOpen()) return false;
+
+    writer = std::make_unique<BinaryWriter>(file);
+    if (!writer->isOpen()) {
+        std::cerr << "Error: Could not open file " << file << std::endl;
+        writer.reset();
+        return false;
+    }
+    filename = file;
+
+    std::vector<int> nodeIds;
+    std::vector<float> xs, ys;
+    for (const auto& pair : graph.getAllNodes()) {
+        nodeIds.push_back(pair.first);
+        xs.push_back(pair.second.x);
+        ys.push_back(pair.second.y);
+    }
+
+    int edgeCount = graph.getEdgeCount();
+    std::vector<int> froms, tos, limits;
+    std::vector<float> lengths;
+    edgeIds.clear();
+    speedLimits.clear();
+    for (int slot = 0; slot < edgeCount; slot++) {
+        const Edge& edge = graph.getEdgeAt(slot);
+        edgeIds.push_back(edge.id);
+        froms.push_back(edge.fromNodeId);
+        tos.push_back(edge.toNodeId);
+        lengths.push_back(edge.length);
+        limits.push_back(edge.speedLimit);
+        speedLimits.push_back(static_cast<float>(edge.speedLimit));
+    }
+
+    writer->write(MAGIC);
+    writer->write(VERSION);
+    writer->writeTag(MAP_TAG);
+    writer->write(roundSeconds);
+    writer->writeArray(nodeIds);
+    writer->writeArray(xs);
+    writer->writeArray(ys);
+    writer->writeArray(edgeIds);
+    writer->writeArray(froms);
+    writer->writeArray(tos);
+    writer->writeArray(lengths);
+    writer->writeArray(limits);
+
+    slotsVersion = std::numeric_limits<std::uint64_t>::max();
+    lastRound = 0;
+    frameCount = 0;
+    blockTimes.clear();
+    blockWeekTimes.clear();
+    blockSpeeds.clear();
+    return true;
+}
+
+bool SpeedRecorder::close() {
+    if (!isOpen()) return true;
+
+    flushBlock();
+    writer->writeTag(END_TAG);
+    writer->write(static_cast<std::uint64_t>(frameCount));
+    bool ok = writer->good();
+    writer.reset();
+
+    if (!ok) {
+        std::cerr << "Error: Failed writing speeds to " << filename << std::endl;
+    }
+    return ok;
+}
+
+void SpeedRecorder::record(const PredictionSnapshot& snapshot, const Graph& graph, double time) {
+    if (!isOpen() || snapshot.version == 0 || snapshot.version == lastRound) return;
+    lastRound = snapshot.version;
+
+    if (slotsVersion != snapshot.topologyVersion) {
+        slots.resize(edgeIds.size());
+        for (size_t i = 0; i < edgeIds.size(); i++) {
+            slots[i] = graph.getEdgeSlot(edgeIds[i]);
+        }
+        slotsVersion = snapshot.topologyVersion;
+    }
+
+    blockTimes.push_back(time);
+    blockWeekTimes.push_back(snapshot.timeOfWeek);
+    for (size_t i = 0; i < edgeIds.size(); i++) {
+        int slot = slots[i];
+        bool present = slot >= 0 && static_cast<size_t>(slot) < snapshot.predictions.size();
+        blockSpeeds.push_back(present ? snapshot.predictions[slot].currentSpeed : speedLimits[i]);
+    }
+    frameCount++;
+
+    if (blockTimes.size() >= BLOCK_FRAMES) {
+        flushBlock();
+    }
+}
+
+void SpeedRecorder::flushBlock() {
+    if (blockTimes.empty()) return;
+
+    writer->writeTag(ROWS_TAG);
+    writer->writeArray(blockTimes);
+    writer->writeArray(blockWeekTimes);
+    writer->writeArray(blockSpeeds);
+    blockTimes.clear();
+    blockWeekTimes.clear();
+    blockSpeeds.clear();
+}
+
+bool SpeedRecorder::load(const std::string& file, SpeedSeries& out) {
+    BinaryReader reader(file);
+    if (!reader.isOpen()) {
+        std::cerr << "Error: Could not open file " << file << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    if (!reader.read(magic) || std::memcmp(magic, MAGIC, 4) != 0 ||
+        !reader.read(version) || version != VERSION) {
+        std::cerr << "Error: " << file << " is not a version " << VERSION << " speed file" << std::endl;
+        return false;
+    }
+
+    std::vector<int> nodeIds, edgeIds, froms, tos, limits;
+    std::vector<float> xs, ys, lengths;
+    if (!reader.expectTag(MAP_TAG) || !reader.read(out.roundSeconds) ||
+        !reader.readArray(nodeIds) || !reader.readArray(xs) || !reader.readArray(ys) ||
+        !reader.readArray(edgeIds) || !reader.readArray(froms) || !reader.readArray(tos) ||
+        !reader.readArray(lengths) || !reader.readArray(limits) ||
+        xs.size() != nodeIds.size() || ys.size() != nodeIds.size() || froms.size() != edgeIds.size() ||
+        tos.size() != edgeIds.size() || lengths.size() != edgeIds.size() || limits.size() != edgeIds.size() ||
+        !(out.roundSeconds > 0.0f)) {
+        std::cerr << "Error: " << file << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+
+    out.map.clearGraph();
+    for (size_t i = 0; i < nodeIds.size(); i++) {
+        out.map.addNode(nodeIds[i], xs[i], ys[i]);
+    }
+    for (size_t i = 0; i < edgeIds.size(); i++) {
+        out.map.addEdge(edgeIds[i], froms[i], tos[i], lengths[i], limits[i]);
+    }
+    if (static_cast<size_t>(out.map.getEdgeCount()) != edgeIds.size()) {
+        std::cerr << "Error: " << file << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+    out.times.clear();
+    out.weekTimes.clear();
+    out.speeds.clear();
+
+    size_t edgeCount = edgeIds.size();
+    std::vector<double> times, weekTimes;
+    std::vector<float> speeds;
+    char tag[4];
+    while (reader.read(tag)) {
+        if (std::memcmp(tag, ROWS_TAG, 4) == 0) {
+            if (!reader.readArray(times) || !reader.readArray(weekTimes) || !reader.readArray(speeds) ||
+                weekTimes.size() != times.size() || speeds.size() != times.size() * edgeCount) {
+                break;
+            }
+            out.times.insert(out.times.end(), times.begin(), times.end());
+            out.weekTimes.insert(out.weekTimes.end(), weekTimes.begin(), weekTimes.end());
+            out.speeds.insert(out.speeds.end(), speeds.begin(), speeds.end());
+        }
+        else if (std::memcmp(tag, END_TAG, 4) == 0) {
+            std::uint64_t frames = 0;
+            if (!reader.read(frames) || frames != out.times.size()) break;
+            return true;
+        }
+        else {
+            break;
+        }
+    }
+
+    std::cerr << "Error: " << file << " is truncated or corrupt" << std::endl;
+    return false;
+}
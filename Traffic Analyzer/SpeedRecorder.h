@@ -0,0 +1,83 @@
+#pragma once
+#include "Graph.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+class BinaryWriter;
+struct PredictionSnapshot;
+
+// Edge speeds of a recorded run, as the prediction system measured them:
+// one frame per prediction round, each holding one speed per edge in the
+// order of the map's edge slots
+struct SpeedSeries {
+    Graph map;                           // Rebuilt from the file, slots in recorded order
+    float roundSeconds = 0.0f;
+    std::vector<double> times;           // Simulated seconds, one per frame
+    std::vector<double> weekTimes;       // Time of week of each frame, seconds since Monday 00:00
+    std::vector<float> speeds;           // Frame-major, km/h
+
+    int getEdgeCount() const { return map.getEdgeCount(); }
+    size_t getFrameCount() const { return times.size(); }
+    const float* frame(size_t index) const { return speeds.data() + index * map.getEdgeCount(); }
+};
+
+// Records the measured speed of every edge once per prediction round, so
+// predictors can be replayed and scored offline. Frames are buffered and
+// written BLOCK_FRAMES at a time on the simulation thread; a frame is one
+// float per edge, small next to the round that produced it.
+//
+// File format: "TASP", version, then tagged sections:
+//   MAP   round seconds, node ids, xs, ys, edge ids, from nodes, to nodes,
+//         lengths, speed limits
+//   ROWS  times, times of week, speeds (frame-major, one per MAP edge)
+//   END   frame count
+class SpeedRecorder {
+public:
+    static constexpr char MAGIC[4] = { 'T', 'A', 'S', 'P' };
+    static constexpr std::uint32_t VERSION = 2;
+    static constexpr size_t BLOCK_FRAMES = 64;
+
+private:
+    std::unique_ptr<BinaryWriter> writer;
+    std::string filename;
+
+    // Edges as recorded in MAP; a road removed later reads as free flowing
+    std::vector<int> edgeIds;
+    std::vector<float> speedLimits;
+    std::vector<int> slots;              // Current slot of each recorded edge, -1 if gone
+    std::uint64_t slotsVersion;
+
+    std::uint64_t lastRound;
+    long long frameCount;
+    std::vector<double> blockTimes;
+    std::vector<double> blockWeekTimes;
+    std::vector<float> blockSpeeds;
+
+public:
+    SpeedRecorder();
+    ~SpeedRecorder();
+
+    SpeedRecorder(const SpeedRecorder&) = delete;
+    SpeedRecorder& operator=(const SpeedRecorder&) = delete;
+
+    // Writes the header and the map
+    bool open(const std::string& filename, const Graph& graph, float roundSeconds);
+
+    // Writes the buffered frames and the END section; returns false if any
+    // write failed
+    bool close();
+    bool isOpen() const { return writer != nullptr; }
+
+    // Adds a frame if the snapshot is a round not recorded yet
+    void record(const PredictionSnapshot& snapshot, const Graph& graph, double time);
+
+    long long getFrameCount() const { return frameCount; }
+    const std::string& getFilename() const { return filename; }
+
+    static bool load(const std::string& filename, SpeedSeries& out);
+
+private:
+    void flushBlock();
+};
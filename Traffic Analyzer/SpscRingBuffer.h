@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// Lock-free single-producer / single-consumer ring buffer of a fixed,
+// power-of-two capacity. Head and tail live on separate cache lines, and
+// each side keeps a private copy of the other's index so it only touches
+// the shared one when the ring looks full (or empty). Neither side ever
+// blocks; a full ring makes tryPush() return false.
+template <typename T>
+class SpscRingBuffer {
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::unique_ptr<T[]> slots;
+    size_t mask;
+
+    alignas(CACHE_LINE) std::atomic<size_t> head;  // Next slot to read, written by the consumer
+    size_t cachedTail;                             // Consumer's view of tail
+
+    alignas(CACHE_LINE) std::atomic<size_t> tail;  // Next slot to write, written by the producer
+    size_t cachedHead;                             // Producer's view of head
+
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscRingBuffer(size_t capacity)
+        : mask(0), head(0), cachedTail(0), tail(0), cachedHead(0) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        slots = std::make_unique<T[]>(size);
+        mask = size - 1;
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Producer side
+    bool tryPush(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (position - cachedHead > mask) return false;
+        }
+        slots[position & mask] = value;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Free slots as seen by the producer, so a multi-slot message can check
+    // it fits before pushing any of it
+    size_t freeSpace() {
+        cachedHead = head.load(std::memory_order_acquire);
+        return capacity() - (tail.load(std::memory_order_relaxed) - cachedHead);
+    }
+
+    // Consumer side
+    bool tryPop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position == cachedTail) return false;
+        }
+        value = slots[position & mask];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,428 @@
+#include "TrafficAssignment.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace {
+
+// Indexed 4-ary min-heap of node ids keyed by their tentative distance.
+// Decrease-key moves a node in place, so the heap never holds stale
+// entries and stays at most one slot per node.
+class NodeHeap {
+private:
+    std::vector<int> heap;
+    std::vector<int> position;           // Index in heap, -1 when not queued
+    const std::vector<double>* keys = nullptr;
+
+public:
+    void reset(size_t nodeCount, const std::vector<double>& distances) {
+        heap.clear();
+        position.assign(nodeCount, -1);
+        keys = &distances;
+    }
+
+    bool empty() const { return heap.empty(); }
+
+    // Insert, or restore the heap order after the node's key went down
+    void push(int node) {
+        int index = position[node];
+        if (index == -1) {
+            index = static_cast<int>(heap.size());
+            heap.push_back(node);
+            position[node] = index;
+        }
+        siftUp(index);
+    }
+
+    int pop() {
+        int top = heap[0];
+        position[top] = -1;
+        int last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heap[0] = last;
+            position[last] = 0;
+            siftDown(0);
+        }
+        return top;
+    }
+
+    void clear() {
+        for (int node : heap) position[node] = -1;
+        heap.clear();
+    }
+
+private:
+    void siftUp(int index) {
+        int node = heap[index];
+        double key = (*keys)[node];
+        while (index > 0) {
+            int parent = (index - 1) / 4;
+            if ((*keys)[heap[parent]] <= key) break;
+            heap[index] = heap[parent];
+            position[heap[index]] = index;
+            index = parent;
+        }
+        heap[index] = node;
+        position[node] = index;
+    }
+
+    void siftDown(int index) {
+        int size = static_cast<int>(heap.size());
+        int node = heap[index];
+        double key = (*keys)[node];
+        while (true) {
+            int first = index * 4 + 1;
+            if (first >= size) break;
+            int best = first;
+            int end = std::min(first + 4, size);
+            for (int child = first + 1; child < end; child++) {
+                if ((*keys)[heap[child]] < (*keys)[heap[best]]) best = child;
+            }
+            if ((*keys)[heap[best]] >= key) break;
+            heap[index] = heap[best];
+            position[heap[index]] = index;
+            index = best;
+        }
+        heap[index] = node;
+        position[node] = index;
+    }
+};
+
+}
+
+TrafficAssignment::TrafficAssignment(const Graph& map)
+    : totalDemand(0.0), unassignedDemand(0.0) {
+    for (const auto& pair : map.getAllNodes()) {
+        nodeIds.push_back(pair.first);
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+    for (size_t i = 0; i < nodeIds.size(); i++) {
+        nodeIndex[nodeIds[i]] = static_cast<int>(i);
+    }
+
+    // Sort by id so link indices do not depend on hash map iteration order
+    std::vector<const Edge*> sortedEdges;
+    for (const auto& pair : map.getAllEdges()) {
+        sortedEdges.push_back(&pair.second);
+    }
+    std::sort(sortedEdges.begin(), sortedEdges.end(),
+        [](const Edge* a, const Edge* b) { return a->id < b->id; });
+
+    for (const Edge* edge : sortedEdges) {
+        auto from = nodeIndex.find(edge->fromNodeId);
+        auto to = nodeIndex.find(edge->toNodeId);
+        if (from == nodeIndex.end() || to == nodeIndex.end()) continue;
+
+        float speedMs = std::max(edge->speedLimit, 1) / 3.6f;
+        double time = std::max(edge->length, 1.0f) / speedMs;
+        int lanes = edge->speedLimit >= MicroConfig::MULTI_LANE_SPEED_LIMIT ? 2 : 1;
+
+        // Roads are two-way, one link per direction
+        for (int direction = 0; direction < 2; direction++) {
+            linkEdgeId.push_back(edge->id);
+            linkTail.push_back(direction == 0 ? from->second : to->second);
+            linkHead.push_back(direction == 0 ? to->second : from->second);
+            freeFlowTime.push_back(time);
+            capacity.push_back(lanes * AssignmentConfig::LANE_CAPACITY);
+        }
+    }
+
+    // Forward star by counting sort on the tail node
+    size_t nodeCount = nodeIds.size();
+    firstOut.assign(nodeCount + 1, 0);
+    for (int tail : linkTail) {
+        firstOut[tail + 1]++;
+    }
+    for (size_t n = 0; n < nodeCount; n++) {
+        firstOut[n + 1] += firstOut[n];
+    }
+    outLinks.resize(linkTail.size());
+    std::vector<int> fill(firstOut.begin(), firstOut.end() - 1);
+    for (size_t link = 0; link < linkTail.size(); link++) {
+        outLinks[fill[linkTail[link]]++] = static_cast<int>(link);
+    }
+
+    flows.assign(linkTail.size(), 0.0);
+}
+
+void TrafficAssignment::setDemand(const std::vector<DemandModel::Flow>& demand) {
+    origins.clear();
+    totalDemand = 0.0;
+    unassignedDemand = 0.0;
+
+    std::unordered_map<int, int> originSlot;
+    for (const auto& flow : demand) {
+        auto from = nodeIndex.find(flow.origin);
+        auto to = nodeIndex.find(flow.destination);
+        if (from == nodeIndex.end() || to == nodeIndex.end() ||
+            from->second == to->second || !(flow.tripsPerHour > 0.0f)) {
+            continue;
+        }
+
+        auto slot = originSlot.find(from->second);
+        if (slot == originSlot.end()) {
+            slot = originSlot.emplace(from->second, static_cast<int>(origins.size())).first;
+            origins.push_back(OriginDemand{ from->second, {}, {} });
+        }
+        origins[slot->second].destinations.push_back(to->second);
+        origins[slot->second].trips.push_back(flow.tripsPerHour);
+        totalDemand += flow.tripsPerHour;
+    }
+
+    // Largest origins first, so the last trees handed out are the cheap ones
+    std::stable_sort(origins.begin(), origins.end(),
+        [](const OriginDemand& a, const OriginDemand& b) { return a.destinations.size() > b.destinations.size(); });
+}
+
+// BPR volume-delay function
+double TrafficAssignment::linkTime(int link, double flow) const {
+    double ratio = flow / capacity[link];
+    double power = 1.0;
+    for (int i = 0; i < AssignmentConfig::BPR_BETA; i++) {
+        power *= ratio;
+    }
+    return freeFlowTime[link] * (1.0 + AssignmentConfig::BPR_ALPHA * power);
+}
+
+void TrafficAssignment::updateCosts(const std::vector<double>& linkFlows, std::vector<double>& costs) const {
+    costs.resize(linkFlows.size());
+    for (size_t link = 0; link < linkFlows.size(); link++) {
+        costs[link] = linkTime(static_cast<int>(link), linkFlows[link]);
+    }
+}
+
+double TrafficAssignment::allOrNothing(const std::vector<double>& costs, std::vector<double>& target, int threads) {
+    size_t nodeCount = nodeIds.size();
+    size_t linkCount = costs.size();
+
+    struct Worker {
+        std::vector<double> flow;
+        std::vector<double> dist;
+        std::vector<int> predLink;
+        std::vector<double> nodeDemand;
+        std::vector<int> touched;
+        std::vector<int> settled;
+        NodeHeap queue;
+        double pathTime = 0.0;
+        double unassigned = 0.0;
+    };
+
+    int threadCount = std::max(1, std::min(threads, static_cast<int>(origins.size())));
+    std::vector<Worker> workers(threadCount);
+    std::atomic<int> nextOrigin(0);
+
+    auto run = [&](Worker& worker) {
+        const double infinity = std::numeric_limits<double>::infinity();
+        worker.flow.assign(linkCount, 0.0);
+        worker.dist.assign(nodeCount, infinity);
+        worker.predLink.assign(nodeCount, -1);
+        worker.nodeDemand.assign(nodeCount, 0.0);
+        worker.queue.reset(nodeCount, worker.dist);
+
+        for (int i = nextOrigin++; i < static_cast<int>(origins.size()); i = nextOrigin++) {
+            const OriginDemand& origin = origins[i];
+
+            int remaining = 0;
+            for (size_t d = 0; d < origin.destinations.size(); d++) {
+                int destination = origin.destinations[d];
+                if (worker.nodeDemand[destination] == 0.0) remaining++;
+                worker.nodeDemand[destination] += origin.trips[d];
+            }
+
+            // Dijkstra, stopping once every destination of this origin is settled
+            worker.dist[origin.origin] = 0.0;
+            worker.touched.push_back(origin.origin);
+            worker.queue.push(origin.origin);
+
+            while (!worker.queue.empty() && remaining > 0) {
+                int node = worker.queue.pop();
+                double distance = worker.dist[node];
+
+                worker.settled.push_back(node);
+                if (worker.nodeDemand[node] > 0.0) remaining--;
+
+                for (int k = firstOut[node]; k < firstOut[node + 1]; k++) {
+                    int link = outLinks[k];
+                    int head = linkHead[link];
+                    double candidate = distance + costs[link];
+                    if (candidate < worker.dist[head]) {
+                        if (worker.dist[head] == infinity) worker.touched.push_back(head);
+                        worker.dist[head] = candidate;
+                        worker.predLink[head] = link;
+                        worker.queue.push(head);
+                    }
+                }
+            }
+            worker.queue.clear();
+
+            for (size_t d = 0; d < origin.destinations.size(); d++) {
+                int destination = origin.destinations[d];
+                if (worker.dist[destination] == infinity) {
+                    worker.unassigned += origin.trips[d];
+                }
+                else {
+                    worker.pathTime += origin.trips[d] * worker.dist[destination];
+                }
+            }
+
+            // Push the demand up the tree from the leaves: every settled node
+            // hands what ends at or passes through it to its predecessor link
+            for (auto it = worker.settled.rbegin(); it != worker.settled.rend(); ++it) {
+                int node = *it;
+                int link = worker.predLink[node];
+                if (link != -1 && worker.nodeDemand[node] > 0.0) {
+                    worker.flow[link] += worker.nodeDemand[node];
+                    worker.nodeDemand[linkTail[link]] += worker.nodeDemand[node];
+                }
+            }
+
+            for (int node : worker.touched) {
+                worker.dist[node] = infinity;
+                worker.predLink[node] = -1;
+                worker.nodeDemand[node] = 0.0;
+            }
+            for (int destination : origin.destinations) {
+                worker.nodeDemand[destination] = 0.0;
+            }
+            worker.touched.clear();
+            worker.settled.clear();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threadCount; t++) {
+        pool.emplace_back(run, std::ref(workers[t]));
+    }
+    run(workers[0]);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // Combined in worker order; which origins a worker took depends on
+    // scheduling, so flows can differ between runs in the last bits
+    target.assign(linkCount, 0.0);
+    double pathTime = 0.0;
+    unassignedDemand = 0.0;
+    for (const auto& worker : workers) {
+        for (size_t link = 0; link < linkCount; link++) {
+            target[link] += worker.flow[link];
+        }
+        pathTime += worker.pathTime;
+        unassignedDemand += worker.unassigned;
+    }
+    return pathTime;
+}
+
+// Step that minimises the Beckmann objective between the current flows and
+// target: bisection on its derivative, which is increasing in the step
+double TrafficAssignment::lineSearch(const std::vector<double>& target) const {
+    auto derivative = [&](double step) {
+        double sum = 0.0;
+        for (size_t link = 0; link < flows.size(); link++) {
+            double direction = target[link] - flows[link];
+            if (direction != 0.0) {
+                sum += direction * linkTime(static_cast<int>(link), flows[link] + step * direction);
+            }
+        }
+        return sum;
+    };
+
+    if (derivative(1.0) <= 0.0) return 1.0;
+
+    double low = 0.0, high = 1.0;
+    for (int i = 0; i < AssignmentConfig::LINE_SEARCH_STEPS; i++) {
+        double mid = 0.5 * (low + high);
+        if (derivative(mid) > 0.0) high = mid;
+        else low = mid;
+    }
+    return 0.5 * (low + high);
+}
+
+bool TrafficAssignment::solve(const AssignmentOptions& options) {
+    int threads = options.threads > 0 ? options.threads
+        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    history.clear();
+    flows.assign(linkTail.size(), 0.0);
+    if (origins.empty() || linkTail.empty()) return false;
+
+    std::vector<double> costs;
+    std::vector<double> target;
+
+    // Iteration 0 loads everything onto the free-flow shortest paths
+    updateCosts(flows, costs);
+    allOrNothing(costs, flows, threads);
+
+    for (int iteration = 1; iteration <= options.maxIterations; iteration++) {
+        auto start = std::chrono::steady_clock::now();
+
+        updateCosts(flows, costs);
+        double pathTime = allOrNothing(costs, target, threads);
+
+        double totalTime = 0.0;
+        for (size_t link = 0; link < flows.size(); link++) {
+            totalTime += flows[link] * costs[link];
+        }
+        double gap = totalTime > 0.0 ? (totalTime - pathTime) / totalTime : 0.0;
+
+        AssignmentIteration report;
+        report.iteration = iteration;
+        report.relativeGap = gap;
+        report.totalTravelTime = totalTime / 3600.0;
+        report.stepSize = 0.0;
+
+        if (gap > options.targetGap) {
+            report.stepSize = options.method == AssignmentOptions::Method::MSA
+                ? 1.0 / (iteration + 1) : lineSearch(target);
+
+            for (size_t link = 0; link < flows.size(); link++) {
+                flows[link] += report.stepSize * (target[link] - flows[link]);
+            }
+        }
+
+        report.milliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        history.push_back(report);
+
+        if (gap <= options.targetGap) return true;
+    }
+    return false;
+}
+
+std::vector<TrafficAssignment::LinkResult> TrafficAssignment::getLinkResults() const {
+    std::vector<LinkResult> results;
+    results.reserve(flows.size());
+    for (size_t link = 0; link < flows.size(); link++) {
+        LinkResult result;
+        result.edgeId = linkEdgeId[link];
+        result.fromNode = nodeIds[linkTail[link]];
+        result.toNode = nodeIds[linkHead[link]];
+        result.flow = flows[link];
+        result.capacity = capacity[link];
+        result.freeFlowTime = freeFlowTime[link];
+        result.travelTime = linkTime(static_cast<int>(link), flows[link]);
+        results.push_back(result);
+    }
+    return results;
+}
+
+void TrafficAssignment::writeHistory(const std::vector<AssignmentIteration>& history, std::ostream& out) {
+    out << "iteration,relative_gap,total_travel_time_vehh,step_size,milliseconds\n";
+    for (const auto& report : history) {
+        out << report.iteration << "," << report.relativeGap << "," << report.totalTravelTime << ","
+            << report.stepSize << "," << report.milliseconds << "\n";
+    }
+}
+
+void TrafficAssignment::writeLinkResults(const std::vector<LinkResult>& results, std::ostream& out) {
+    out << "edge,from,to,flow_vph,capacity_vph,volume_capacity,free_flow_time_s,travel_time_s\n";
+    for (const auto& result : results) {
+        out << result.edgeId << "," << result.fromNode << "," << result.toNode << ","
+            << result.flow << "," << result.capacity << "," << result.flow / result.capacity << ","
+            << result.freeFlowTime << "," << result.travelTime << "\n";
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "Graph.h"
+#include "DemandModel.h"
+#include "Config.h"
+#include <vector>
+#include <ostream>
+#include <unordered_map>
+
+struct AssignmentOptions {
+    enum class Method {
+        FRANK_WOLFE,                     // Step size from a line search on the Beckmann objective
+        MSA                              // Method of successive averages, step 1 / (k + 1)
+    };
+
+    Method method = Method::FRANK_WOLFE;
+    int maxIterations = AssignmentConfig::MAX_ITERATIONS;
+    double targetGap = AssignmentConfig::TARGET_RELATIVE_GAP;
+    int threads = 0;                     // 0 = one per hardware thread
+};
+
+struct AssignmentIteration {
+    int iteration;
+    double relativeGap;                  // (TSTT - shortest path TSTT) / TSTT
+    double totalTravelTime;              // Vehicle hours per hour of demand
+    double stepSize;
+    double milliseconds;
+};
+
+// Static user-equilibrium assignment of an OD matrix to the road network.
+// Every road is two directed links with a BPR volume-delay function:
+// free-flow time from Edge::length and speedLimit, capacity from the lane
+// count. Each iteration loads the demand all-or-nothing onto the current
+// shortest paths, one shortest-path tree per origin, with the origins spread
+// over worker threads, then moves the flows towards that solution.
+class TrafficAssignment {
+public:
+    struct LinkResult {
+        int edgeId;
+        int fromNode;
+        int toNode;
+        double flow;                     // veh/h
+        double capacity;                 // veh/h
+        double freeFlowTime;             // Seconds
+        double travelTime;               // Seconds at the assigned flow
+    };
+
+private:
+    struct OriginDemand {
+        int origin;                      // Node index
+        std::vector<int> destinations;   // Node indices
+        std::vector<double> trips;       // veh/h to each destination
+    };
+
+    // Directed links, two per edge in edge id order, plus a forward star
+    std::vector<int> nodeIds;
+    std::unordered_map<int, int> nodeIndex;
+    std::vector<int> linkEdgeId;
+    std::vector<int> linkTail;
+    std::vector<int> linkHead;
+    std::vector<double> freeFlowTime;
+    std::vector<double> capacity;
+    std::vector<int> firstOut;           // Links leaving node n: outLinks[firstOut[n] .. firstOut[n + 1])
+    std::vector<int> outLinks;
+
+    std::vector<OriginDemand> origins;
+    double totalDemand;
+    double unassignedDemand;             // Trips between nodes with no connecting path
+
+    std::vector<double> flows;
+    std::vector<AssignmentIteration> history;
+
+public:
+    explicit TrafficAssignment(const Graph& map);
+
+    // Pairs with unknown nodes are ignored
+    void setDemand(const std::vector<DemandModel::Flow>& demand);
+
+    // Returns true when the target gap was reached
+    bool solve(const AssignmentOptions& options = AssignmentOptions());
+
+    const std::vector<AssignmentIteration>& getHistory() const { return history; }
+    std::vector<LinkResult> getLinkResults() const;
+    double getTotalDemand() const { return totalDemand; }
+    double getUnassignedDemand() const { return unassignedDemand; }
+    int getLinkCount() const { return static_cast<int>(linkEdgeId.size()); }
+    int getOriginCount() const { return static_cast<int>(origins.size()); }
+
+    static void writeHistory(const std::vector<AssignmentIteration>& history, std::ostream& out);
+    static void writeLinkResults(const std::vector<LinkResult>& results, std::ostream& out);
+
+private:
+    double linkTime(int link, double flow) const;
+    void updateCosts(const std::vector<double>& linkFlows, std::vector<double>& costs) const;
+
+    // Loads all demand onto shortest paths under costs; returns the total
+    // travel time of that loading (sum of demand x shortest path cost)
+    double allOrNothing(const std::vector<double>& costs, std::vector<double>& target, int threads);
+
+    double lineSearch(const std::vector<double>& target) const;
+};
@@ -0,0 +1,301 @@
+#include "TripRecorder.h"
+#include "Checkpoint.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    constexpr char TRIP_TAG[5] = "TRIP";
+    constexpr char TRAJ_TAG[5] = "TRAJ";
+    constexpr char END_TAG[5] = "END ";
+}
+
+TripRecorder::TripRecorder(const TripRecorderOptions& options)
+    : options(options),
+    trips(options.tripCapacity),
+    routeNodes(options.routeCapacity),
+    samples(options.sampleCapacity),
+    stopRequested(false),
+    writeFailed(false),
+    tripCount(0),
+    sampleCount(0),
+    stalls(0),
+    nextSampleTime(0.0) {
+    this->options.trajectoryCarStride = std::max(1, options.trajectoryCarStride);
+}
+
+TripRecorder::~TripRecorder() {
+    close();
+}
+
+bool TripRecorder::open(const std::string& file) {
+    if (isOpen()) return false;
+
+    writer = std::make_unique<BinaryWriter>(file);
+    if (!writer->isOpen()) {
+        std::cerr << "Error: Could not open file " << file << std::endl;
+        writer.reset();
+        return false;
+    }
+    writer->write(MAGIC);
+    writer->write(VERSION);
+
+    filename = file;
+    stopRequested = false;
+    writeFailed = false;
+    writerThread = std::thread(&TripRecorder::writerLoop, this);
+    return true;
+}
+
+bool TripRecorder::close() {
+    if (!isOpen()) return !writeFailed;
+
+    stopRequested.store(true, std::memory_order_release);
+    writerThread.join();
+    writer.reset();
+
+    if (writeFailed) {
+        std::cerr << "Error: Failed writing trips to " << filename << std::endl;
+    }
+    return !writeFailed;
+}
+
+void TripRecorder::recordTrip(int carId, const std::vector<int>& route, double departureTime,
+    double arrivalTime, float freeFlowSeconds) {
+    bool stalled = false;
+
+    // The route goes first, so the writer finds all of it once it sees the record
+    size_t length = std::min(route.size(), routeNodes.capacity());
+    while (routeNodes.freeSpace() < length) {
+        stalled = true;
+        std::this_thread::yield();
+    }
+    for (size_t i = 0; i < length; i++) {
+        routeNodes.tryPush(route[i]);
+    }
+
+    TripRecord record{ carId, route.empty() ? -1 : route.front(), route.empty() ? -1 : route.back(),
+        static_cast<std::uint32_t>(length), departureTime, arrivalTime, freeFlowSeconds };
+    while (!trips.tryPush(record)) {
+        stalled = true;
+        std::this_thread::yield();
+    }
+
+    tripCount++;
+    if (stalled) stalls++;
+}
+
+bool TripRecorder::trajectoryDue(double time) {
+    if (options.trajectoryInterval <= 0.0f || time < nextSampleTime) return false;
+    nextSampleTime = time + options.trajectoryInterval;
+    return true;
+}
+
+void TripRecorder::recordPosition(double time, int carId, float x, float y) {
+    TrajectorySample sample{ time, carId, x, y };
+    if (!samples.tryPush(sample)) {
+        stalls++;
+        while (!samples.tryPush(sample)) {
+            std::this_thread::yield();
+        }
+    }
+    sampleCount++;
+}
+
+// Runs on the writer thread. Batches records into BLOCK_SIZE columns and
+// writes each block with a handful of bulk writes.
+void TripRecorder::writerLoop() {
+    std::vector<int> carIds, origins, destinations, nodes;
+    std::vector<double> departures, arrivals;
+    std::vector<float> freeFlow;
+    std::vector<std::uint32_t> routeOffsets{ 0 };
+
+    std::vector<double> sampleTimes;
+    std::vector<int> sampleCarIds;
+    std::vector<float> sampleXs, sampleYs;
+
+    long long tripsWritten = 0, samplesWritten = 0;
+
+    auto flushTrips = [&]() {
+        if (carIds.empty()) return;
+        writer->writeTag(TRIP_TAG);
+        writer->writeArray(carIds);
+        writer->writeArray(origins);
+        writer->writeArray(destinations);
+        writer->writeArray(departures);
+        writer->writeArray(arrivals);
+        writer->writeArray(freeFlow);
+        writer->writeArray(routeOffsets);
+        writer->writeArray(nodes);
+
+        tripsWritten += carIds.size();
+        carIds.clear();
+        origins.clear();
+        destinations.clear();
+        departures.clear();
+        arrivals.clear();
+        freeFlow.clear();
+        routeOffsets.assign(1, 0);
+        nodes.clear();
+    };
+
+    auto flushSamples = [&]() {
+        if (sampleTimes.empty()) return;
+        writer->writeTag(TRAJ_TAG);
+        writer->writeArray(sampleTimes);
+        writer->writeArray(sampleCarIds);
+        writer->writeArray(sampleXs);
+        writer->writeArray(sampleYs);
+
+        samplesWritten += sampleTimes.size();
+        sampleTimes.clear();
+        sampleCarIds.clear();
+        sampleXs.clear();
+        sampleYs.clear();
+    };
+
+    while (true) {
+        // Checked before draining: everything pushed before the stop request is seen below
+        bool stopping = stopRequested.load(std::memory_order_acquire);
+        bool idle = true;
+
+        TripRecord record;
+        while (trips.tryPop(record)) {
+            idle = false;
+            for (std::uint32_t i = 0; i < record.routeLength; i++) {
+                int node = -1;
+                routeNodes.tryPop(node);
+                nodes.push_back(node);
+            }
+            carIds.push_back(record.carId);
+            origins.push_back(record.origin);
+            destinations.push_back(record.destination);
+            departures.push_back(record.departureTime);
+            arrivals.push_back(record.arrivalTime);
+            freeFlow.push_back(record.freeFlowSeconds);
+            routeOffsets.push_back(static_cast<std::uint32_t>(nodes.size()));
+
+            if (carIds.size() >= BLOCK_SIZE) flushTrips();
+        }
+
+        TrajectorySample sample;
+        while (samples.tryPop(sample)) {
+            idle = false;
+            sampleTimes.push_back(sample.time);
+            sampleCarIds.push_back(sample.carId);
+            sampleXs.push_back(sample.x);
+            sampleYs.push_back(sample.y);
+
+            if (sampleTimes.size() >= BLOCK_SIZE) flushSamples();
+        }
+
+        if (stopping) break;
+        if (idle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    flushTrips();
+    flushSamples();
+
+    writer->writeTag(END_TAG);
+    writer->write(tripsWritten);
+    writer->write(samplesWritten);
+    writer->write(stalls);
+
+    if (!writer->good()) {
+        writeFailed = true;
+    }
+}
+
+bool TripRecorder::exportTrips(const std::string& file, std::ostream& out) {
+    return readFile(file, &out, nullptr);
+}
+
+bool TripRecorder::exportTrajectories(const std::string& file, std::ostream& out) {
+    return readFile(file, nullptr, &out);
+}
+
+bool TripRecorder::readFile(const std::string& file, std::ostream* tripsOut, std::ostream* samplesOut) {
+    BinaryReader reader(file);
+    if (!reader.isOpen()) {
+        std::cerr << "Error: Could not open file " << file << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    if (!reader.read(magic) || std::memcmp(magic, MAGIC, 4) != 0 ||
+        !reader.read(version) || version != VERSION) {
+        std::cerr << "Error: " << file << " is not a version " << VERSION << " trip file" << std::endl;
+        return false;
+    }
+
+    if (tripsOut) {
+        *tripsOut << "car_id,origin,destination,departure,arrival,travel_seconds,"
+            "free_flow_seconds,delay_seconds,route\n";
+    }
+    if (samplesOut) {
+        *samplesOut << "time,car_id,x,y\n";
+    }
+
+    std::vector<int> carIds, origins, destinations, nodes;
+    std::vector<double> departures, arrivals, times;
+    std::vector<float> freeFlow, xs, ys;
+    std::vector<std::uint32_t> routeOffsets;
+
+    char tag[4];
+    while (reader.read(tag)) {
+        if (std::memcmp(tag, TRIP_TAG, 4) == 0) {
+            if (!reader.readArray(carIds) || !reader.readArray(origins) || !reader.readArray(destinations) ||
+                !reader.readArray(departures) || !reader.readArray(arrivals) || !reader.readArray(freeFlow) ||
+                !reader.readArray(routeOffsets) || !reader.readArray(nodes)) {
+                break;
+            }
+
+            size_t count = carIds.size();
+            bool consistent = origins.size() == count && destinations.size() == count &&
+                departures.size() == count && arrivals.size() == count && freeFlow.size() == count &&
+                routeOffsets.size() == count + 1 && routeOffsets.back() == nodes.size();
+            for (size_t i = 0; consistent && i < count; i++) {
+                consistent = routeOffsets[i] <= routeOffsets[i + 1];
+            }
+            if (!consistent) break;
+            if (!tripsOut) continue;
+
+            for (size_t i = 0; i < count; i++) {
+                double travel = arrivals[i] - departures[i];
+                *tripsOut << carIds[i] << "," << origins[i] << "," << destinations[i] << ","
+                    << departures[i] << "," << arrivals[i] << "," << travel << ","
+                    << freeFlow[i] << "," << travel - freeFlow[i] << ",";
+                for (std::uint32_t n = routeOffsets[i]; n < routeOffsets[i + 1]; n++) {
+                    *tripsOut << (n > routeOffsets[i] ? " " : "") << nodes[n];
+                }
+                *tripsOut << "\n";
+            }
+        }
+        else if (std::memcmp(tag, TRAJ_TAG, 4) == 0) {
+            if (!reader.readArray(times) || !reader.readArray(carIds) ||
+                !reader.readArray(xs) || !reader.readArray(ys)) {
+                break;
+            }
+
+            size_t count = times.size();
+            if (carIds.size() != count || xs.size() != count || ys.size() != count) break;
+            if (!samplesOut) continue;
+
+            for (size_t i = 0; i < count; i++) {
+                *samplesOut << times[i] << "," << carIds[i] << "," << xs[i] << "," << ys[i] << "\n";
+            }
+        }
+        else if (std::memcmp(tag, END_TAG, 4) == 0) {
+            return true;
+        }
+        else {
+            break;
+        }
+    }
+
+    std::cerr << "Error: " << file << " is truncated or corrupt" << std::endl;
+    return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "SpscRingBuffer.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <memory>
+#include <limits>
+
+class BinaryWriter;
+
+struct TripRecorderOptions {
+    float trajectoryInterval = 0.0f;     // Seconds between position samples, 0 = trips only
+    int trajectoryCarStride = 1;         // Sample every n-th car id
+    size_t tripCapacity = 1 << 16;       // Ring sizes, in records and route nodes
+    size_t routeCapacity = 1 << 20;
+    size_t sampleCapacity = 1 << 18;
+};
+
+// Records every completed trip, and optionally sampled vehicle positions, to
+// a binary file. The simulation thread only copies records into lock-free
+// SPSC rings; a background writer drains them and writes columnar blocks.
+// When a ring is full the simulation waits for the writer rather than drop
+// records, and counts the stall.
+//
+// File format: "TATR", version, then a sequence of blocks, each a tag and
+// flat columns:
+//   TRIP  carIds, origins, destinations, departures, arrivals,
+//         freeFlowSeconds, routeOffsets (count + 1), routeNodes
+//   TRAJ  times, carIds, xs, ys
+//   END   trip count, sample count, producer stalls
+class TripRecorder {
+public:
+    static constexpr char MAGIC[4] = { 'T', 'A', 'T', 'R' };
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr size_t BLOCK_SIZE = 4096;  // Records per block
+
+    struct TripRecord {
+        int carId;
+        int origin;
+        int destination;
+        std::uint32_t routeLength;       // Nodes that precede this record in the route ring
+        double departureTime;            // Simulated seconds since the start of the run
+        double arrivalTime;
+        float freeFlowSeconds;           // Travel time on empty roads with no signals
+    };
+
+    struct TrajectorySample {
+        double time;
+        int carId;
+        float x, y;
+    };
+
+private:
+    TripRecorderOptions options;
+    SpscRingBuffer<TripRecord> trips;
+    SpscRingBuffer<int> routeNodes;
+    SpscRingBuffer<TrajectorySample> samples;
+
+    std::unique_ptr<BinaryWriter> writer;  // Owned by the writer thread while it runs
+    std::thread writerThread;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> writeFailed;
+    std::string filename;
+
+    // Producer side
+    long long tripCount;
+    long long sampleCount;
+    long long stalls;
+    double nextSampleTime;
+
+public:
+    explicit TripRecorder(const TripRecorderOptions& options = TripRecorderOptions());
+    ~TripRecorder();
+
+    TripRecorder(const TripRecorder&) = delete;
+    TripRecorder& operator=(const TripRecorder&) = delete;
+
+    // Opens the file and starts the writer thread
+    bool open(const std::string& filename);
+
+    // Drains the rings, writes the END block and joins the writer; returns
+    // false if any write failed
+    bool close();
+    bool isOpen() const { return writerThread.joinable(); }
+
+    // Simulation thread only
+    void recordTrip(int carId, const std::vector<int>& route, double departureTime,
+        double arrivalTime, float freeFlowSeconds);
+    bool trajectoryDue(double time);
+    double getSecondsToTrajectory(double time) const {
+        return options.trajectoryInterval > 0.0f ? nextSampleTime - time : std::numeric_limits<double>::infinity();
+    }
+    bool wantsTrajectory(int carId) const { return carId % options.trajectoryCarStride == 0; }
+    void recordPosition(double time, int carId, float x, float y);
+
+    long long getTripCount() const { return tripCount; }
+    long long getSampleCount() const { return sampleCount; }
+    long long getStallCount() const { return stalls; }
+    const std::string& getFilename() const { return filename; }
+
+    // Convert a recorded file to CSV
+    static bool exportTrips(const std::string& filename, std::ostream& out);
+    static bool exportTrajectories(const std::string& filename, std::ostream& out);
+
+private:
+    void writerLoop();
+    static bool readFile(const std::string& filename, std::ostream* tripsOut, std::ostream* samplesOut);
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+
+// Lock-free single-producer / single-consumer triple buffer.
+// The writer fills back(), then publish() swaps it with the shared middle slot.
+// The reader calls acquire() to swap the middle slot in if a newer one was
+// published, then reads front(). Neither side ever waits for the other, and
+// the slots are reused so their heap capacity survives between publishes.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr unsigned INDEX_MASK = 3;
+    static constexpr unsigned DIRTY = 4;
+
+    T slots[3];
+    std::atomic<unsigned> middle;  // Index of the shared slot | DIRTY if unread
+    unsigned backIndex;            // Owned by the writer
+    unsigned frontIndex;           // Owned by the reader
+
+public:
+    TripleBuffer() : middle(1), backIndex(0), frontIndex(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side
+    T& back() { return slots[backIndex]; }
+
+    void publish() {
+        unsigned previous = middle.exchange(backIndex | DIRTY, std::memory_order_acq_rel);
+        backIndex = previous & INDEX_MASK;
+    }
+
+    // Reader side: returns true if front() changed
+    bool acquire() {
+        if ((middle.load(std::memory_order_acquire) & DIRTY) == 0) {
+            return false;
+        }
+        unsigned previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const { return slots[frontIndex]; }
+};